@@ -0,0 +1,392 @@
+/***************************************************************************************
+ * @file benchmark.cpp                                                                 *
+ *                                                                                     *
+ * @brief Defines functions for timing the rows of a suite.                            *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "benchmark.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TinyTest {
+namespace {
+using std::endl;
+using std::string;
+using std::vector;
+using std::chrono::nanoseconds;
+
+// The width of each variant column in PrintBenchmarkResults.
+constexpr int kVariantColumnWidth = 22;
+
+nanoseconds ThreadCpuTime() {
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return std::chrono::seconds(now.tv_sec) + nanoseconds(now.tv_nsec);
+}
+
+// Writes a line of the table without the padding after its last column.
+void PrintLine(std::ostream& os, const string& line) {
+  os << line.substr(0, line.find_last_not_of(' ') + 1) << endl;
+}
+
+double TimePerIteration(const BenchmarkResult& result) {
+  return result.iterations == 0 ? 0 : static_cast<double>(result.real_time.count()) / result.iterations;
+}
+
+void AddOnce(vector<string>& values, const string& value) {
+  if (std::find(values.begin(), values.end(), value) == values.end()) {
+    values.push_back(value);
+  }
+}
+
+// Prints a table with a row for each label and a column for each variant.
+void PrintTable(std::ostream& os,
+                const string& title,
+                const vector<string>& labels,
+                const vector<string>& variants,
+                const std::function<string(const string& label, const string& variant)>& format_cell) {
+  size_t label_width = title.size();
+  for (const string& label : labels) {
+    label_width = std::max(label_width, label.size());
+  }
+  std::ostringstream header;
+  header << std::left << std::setw(label_width) << title;
+  for (const string& variant : variants) {
+    header << ' ' << std::setw(kVariantColumnWidth) << variant;
+  }
+  PrintLine(os, header.str());
+  for (const string& label : labels) {
+    std::ostringstream line;
+    line << std::left << std::setw(label_width) << label;
+    for (const string& variant : variants) {
+      line << ' ' << std::setw(kVariantColumnWidth) << format_cell(label, variant);
+    }
+    PrintLine(os, line.str());
+  }
+}
+
+// Writes a number with enough digits to read back the same double. compare.py reads the output with Python's json
+// module which accepts NaN and Infinity.
+void WriteJsonNumber(std::ostream& os, double value) {
+  if (std::isnan(value)) {
+    os << "NaN";
+  } else if (std::isinf(value)) {
+    os << (value < 0 ? "-Infinity" : "Infinity");
+  } else {
+    char formatted[32];
+    snprintf(formatted, sizeof(formatted), "%.17g", value);
+    os << formatted;
+  }
+}
+}  // End namespace
+
+BenchmarkMeasurement MeasureBenchmark(const BenchmarkOptions& options,
+                                      const BenchmarkIterationsFunction& run_iterations) {
+  std::unique_ptr<PerfCounterGroup> counters;
+  if (options.count_instructions) {
+    counters = std::make_unique<PerfCounterGroup>(options.count_cache_misses);
+  }
+  // ReportEnergyAvailability has already said why if energy can not be measured.
+  std::unique_ptr<EnergyCounters> energy_counters;
+  if (options.measure_energy && EnergyCounters::IsAvailable(options.powercap_directory)) {
+    energy_counters = std::make_unique<EnergyCounters>(options.powercap_directory);
+  }
+  run_iterations(1);
+  uint64_t iterations = 1;
+  while (true) {
+    if (energy_counters != nullptr) {
+      energy_counters->Start();
+    }
+    std::chrono::steady_clock::time_point real_start = std::chrono::steady_clock::now();
+    nanoseconds cpu_start = ThreadCpuTime();
+    // The counters are started inside the timed region so they only see run_iterations and not the clocks.
+    if (counters != nullptr) {
+      counters->Start();
+    }
+    run_iterations(iterations);
+    std::optional<PerfCounts> perf_counts;
+    if (counters != nullptr) {
+      perf_counts = counters->Stop();
+    }
+    nanoseconds cpu_time = ThreadCpuTime() - cpu_start;
+    nanoseconds real_time = std::chrono::steady_clock::now() - real_start;
+    std::optional<EnergyCounts> energy;
+    if (energy_counters != nullptr) {
+      energy = energy_counters->Stop();
+    }
+    if (real_time >= options.min_time || iterations >= options.max_iterations) {
+      return {iterations, real_time, cpu_time, perf_counts, energy};
+    }
+    // Aim a little past min_time so the next run is usually the last one, but never grow more than ten times at once.
+    double multiplier = 10;
+    if (real_time.count() > 0) {
+      multiplier = std::min(multiplier, 1.4 * options.min_time.count() / real_time.count());
+    }
+    iterations = std::min(options.max_iterations,
+                          std::max(iterations + 1, static_cast<uint64_t>(iterations * multiplier)));
+  }
+}
+
+void BenchmarkRow(vector<BenchmarkResult>& results,
+                  const string& suite_label,
+                  const string& test_label,
+                  const string& variant,
+                  const MaybeTestConfigureFunction& before_each,
+                  const MaybeTestConfigureFunction& after_each,
+                  const BenchmarkOptions& options,
+                  const BenchmarkIterationsFunction& run_iterations,
+                  const BenchmarkCountersFunction& add_counters) {
+  auto report_error = [&]() {
+    std::cout << "    🔥ERROR: " << suite_label << "::" << test_label << " [" << variant << "] "
+              << DescribeCaughtException(std::current_exception()) << endl;
+  };
+  std::optional<BenchmarkResult> result;
+  try {
+    if (before_each.has_value()) {
+      (*before_each)();
+    }
+    BenchmarkMeasurement measurement = MeasureBenchmark(options, run_iterations);
+    result = BenchmarkResult{
+        suite_label, test_label, variant, measurement.iterations, measurement.real_time, measurement.cpu_time, {}};
+    if (measurement.perf_counts.has_value()) {
+      double iterations = std::max<uint64_t>(measurement.iterations, 1);
+      result->counters["instructions_per_call"] = measurement.perf_counts->instructions / iterations;
+      std::optional<double> estimated_cycles = EstimatedCycles(*measurement.perf_counts);
+      if (estimated_cycles.has_value()) {
+        result->counters["estimated_cycles_per_call"] = *estimated_cycles / iterations;
+      }
+    }
+    if (measurement.energy.has_value()) {
+      double iterations = std::max<uint64_t>(measurement.iterations, 1);
+      result->counters["package_joules_per_call"] = measurement.energy->package_joules / iterations;
+      if (measurement.energy->core_joules.has_value()) {
+        result->counters["core_joules_per_call"] = *measurement.energy->core_joules / iterations;
+      }
+    }
+    if (add_counters) {
+      add_counters(*result);
+    }
+  } catch (...) {
+    report_error();
+    result = std::nullopt;
+  }
+  // after_each runs even if the row threw so it can undo before_each.
+  try {
+    if (after_each.has_value()) {
+      (*after_each)();
+    }
+  } catch (...) {
+    report_error();
+    result = std::nullopt;
+  }
+  if (result.has_value()) {
+    results.push_back(std::move(*result));
+  }
+}
+
+void ReportEnergyAvailability(std::ostream& os, const string& suite_label, const BenchmarkOptions& options) {
+  if (!options.measure_energy) {
+    return;
+  }
+  try {
+    EnergyCounters counters(options.powercap_directory);
+  } catch (const std::exception& error) {
+    os << "⚡Not measuring energy for " << suite_label << ": " << error.what() << endl;
+  }
+}
+
+void AddMemoryResourceCounters(BenchmarkResult& result, const MemoryResourceStats& stats) {
+  double iterations = std::max<uint64_t>(result.iterations, 1);
+  result.counters["allocations_per_call"] = stats.allocations / iterations;
+  result.counters["bytes_per_call"] = stats.allocated_bytes / iterations;
+  result.counters["upstream_allocations_per_call"] = stats.upstream_allocations / iterations;
+  result.counters["peak_bytes"] = stats.peak_bytes;
+}
+
+void PrintBenchmarkResults(std::ostream& os, const vector<BenchmarkResult>& results) {
+  vector<string> labels;
+  vector<string> variants;
+  vector<string> counters;
+  std::map<std::pair<string, string>, const BenchmarkResult*> cells;
+  for (const BenchmarkResult& result : results) {
+    string label = result.suite_label + "::" + result.test_label;
+    AddOnce(labels, label);
+    AddOnce(variants, result.variant);
+    for (const auto& counter : result.counters) {
+      AddOnce(counters, counter.first);
+    }
+    cells[{label, result.variant}] = &result;
+  }
+
+  PrintTable(os, "Benchmark", labels, variants, [&](const string& label, const string& variant) -> string {
+    auto cell = cells.find({label, variant});
+    if (cell == cells.end()) {
+      return "-";
+    }
+    double time = TimePerIteration(*cell->second);
+    string formatted = FormatDuration(std::chrono::duration<double, std::nano>(time));
+    // The first variant with a result for this row is the baseline.
+    const BenchmarkResult* baseline = nullptr;
+    for (auto other = variants.begin(); baseline == nullptr; other++) {
+      auto found = cells.find({label, *other});
+      baseline = found == cells.end() ? nullptr : found->second;
+    }
+    if (baseline != cell->second && TimePerIteration(*baseline) > 0) {
+      char ratio[32];
+      snprintf(ratio, sizeof(ratio), " (%.2fx)", time / TimePerIteration(*baseline));
+      formatted += ratio;
+    }
+    return formatted;
+  });
+  for (const string& counter : counters) {
+    os << endl;
+    PrintTable(os, counter, labels, variants, [&](const string& label, const string& variant) -> string {
+      auto cell = cells.find({label, variant});
+      if (cell == cells.end() || cell->second->counters.count(counter) == 0) {
+        return "-";
+      }
+      char formatted[32];
+      snprintf(formatted, sizeof(formatted), "%.4g", cell->second->counters.at(counter));
+      return formatted;
+    });
+  }
+}
+
+BenchmarkContext CurrentBenchmarkContext() {
+  BenchmarkContext context = {};
+
+  time_t now = time(nullptr);
+  tm local;
+  localtime_r(&now, &local);
+  char date[32];
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", &local);
+  context.date = date;
+  // strftime writes the offset as +hhmm but ISO 8601 dates with times use +hh:mm.
+  if (context.date.size() > 2) {
+    context.date.insert(context.date.size() - 2, ":");
+  }
+
+  char host_name[HOST_NAME_MAX + 1] = {};
+  if (gethostname(host_name, sizeof(host_name) - 1) == 0) {
+    context.host_name = host_name;
+  }
+  char executable[PATH_MAX];
+  ssize_t executable_size = readlink("/proc/self/exe", executable, sizeof(executable));
+  if (executable_size > 0) {
+    context.executable.assign(executable, executable_size);
+  }
+
+  context.num_cpus = static_cast<int>(std::thread::hardware_concurrency());
+  std::ifstream cpu_info("/proc/cpuinfo");
+  string line;
+  while (std::getline(cpu_info, line)) {
+    if (line.compare(0, 7, "cpu MHz") == 0 && line.find(':') != string::npos) {
+      context.mhz_per_cpu = static_cast<int>(std::lround(atof(line.c_str() + line.find(':') + 1)));
+      break;
+    }
+  }
+  string governor = ReadFirstLine("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor").value_or("");
+  context.cpu_scaling_enabled = !governor.empty() && governor != "performance";
+
+  double load_avg[3];
+  int load_avg_count = getloadavg(load_avg, 3);
+  context.load_avg.assign(load_avg, load_avg + std::max(load_avg_count, 0));
+
+#ifdef NDEBUG
+  context.library_build_type = "release";
+#else
+  context.library_build_type = "debug";
+#endif
+  return context;
+}
+
+void WriteBenchmarkJson(std::ostream& os, const vector<BenchmarkResult>& results, const BenchmarkContext& context) {
+  os << "{" << endl;
+  os << "  \"context\": {" << endl;
+  os << "    \"date\": ";
+  WriteJsonString(os, context.date);
+  os << "," << endl << "    \"host_name\": ";
+  WriteJsonString(os, context.host_name);
+  os << "," << endl << "    \"executable\": ";
+  WriteJsonString(os, context.executable);
+  os << "," << endl;
+  os << "    \"num_cpus\": " << context.num_cpus << "," << endl;
+  os << "    \"mhz_per_cpu\": " << context.mhz_per_cpu << "," << endl;
+  os << "    \"cpu_scaling_enabled\": " << (context.cpu_scaling_enabled ? "true" : "false") << "," << endl;
+  os << "    \"caches\": [" << endl << "    ]," << endl;
+  os << "    \"load_avg\": [";
+  for (size_t index = 0; index < context.load_avg.size(); index++) {
+    if (index > 0) {
+      os << ",";
+    }
+    WriteJsonNumber(os, context.load_avg[index]);
+  }
+  os << "]," << endl << "    \"library_build_type\": ";
+  WriteJsonString(os, context.library_build_type);
+  os << endl << "  }," << endl;
+
+  // Each row is a family and each of its variants is an instance of the family.
+  std::map<string, std::pair<size_t, size_t>> families;
+  os << "  \"benchmarks\": [";
+  for (size_t index = 0; index < results.size(); index++) {
+    const BenchmarkResult& result = results[index];
+    string label = result.suite_label + "::" + result.test_label;
+    auto family = families.emplace(label, std::make_pair(families.size(), 0)).first;
+    size_t instance_index = family->second.second++;
+    string name = result.variant.empty() ? label : label + "/" + result.variant;
+    double iterations = std::max<uint64_t>(result.iterations, 1);
+
+    os << (index > 0 ? "," : "") << endl << "    {" << endl;
+    os << "      \"name\": ";
+    WriteJsonString(os, name);
+    os << "," << endl;
+    os << "      \"family_index\": " << family->second.first << "," << endl;
+    os << "      \"per_family_instance_index\": " << instance_index << "," << endl;
+    os << "      \"run_name\": ";
+    WriteJsonString(os, name);
+    os << "," << endl;
+    os << "      \"run_type\": \"iteration\"," << endl;
+    os << "      \"repetitions\": 1," << endl;
+    os << "      \"repetition_index\": 0," << endl;
+    os << "      \"threads\": 1," << endl;
+    os << "      \"iterations\": " << result.iterations << "," << endl;
+    os << "      \"real_time\": ";
+    WriteJsonNumber(os, result.real_time.count() / iterations);
+    os << "," << endl << "      \"cpu_time\": ";
+    WriteJsonNumber(os, result.cpu_time.count() / iterations);
+    os << "," << endl << "      \"time_unit\": \"ns\"";
+    for (const auto& counter : result.counters) {
+      os << "," << endl << "      ";
+      WriteJsonString(os, counter.first);
+      os << ": ";
+      WriteJsonNumber(os, counter.second);
+    }
+    os << endl << "    }";
+  }
+  os << endl << "  ]" << endl << "}" << endl;
+}
+
+void WriteBenchmarkJson(std::ostream& os, const vector<BenchmarkResult>& results) {
+  WriteBenchmarkJson(os, results, CurrentBenchmarkContext());
+}
+
+}  // End namespace TinyTest
@@ -0,0 +1,372 @@
+#ifndef TinyTest__benchmark_h__
+#define TinyTest__benchmark_h__
+/***************************************************************************************
+ * @file benchmark.h                                                                   *
+ *                                                                                     *
+ * @brief Defines functions for timing the rows of a suite.                            *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "energy_counters.h"
+#include "memory_resources.h"
+#include "page_arena.h"
+#include "perf_counters.h"
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup benchmark Benchmarks
+///
+/// ExecuteBenchmarkSuite times function_to_test on the inputs of each row of a suite instead of checking its result.
+/// Each row is run once per variant, for example once per PageKind or once per MemoryResourceVariant, and
+/// PrintBenchmarkResults shows the variants of a row side by side. WriteBenchmarkJson writes the same results in Google
+/// Benchmark's JSON format.
+///
+/// The inputs of each row are copied into a PageArena with uses-allocator construction before they are timed, so inputs
+/// that are std::pmr containers live in pages of the variant's kind. Declare such parameters as const references so
+/// they are not copied again on every call. before_each runs while the arena is current so fixtures can allocate from
+/// CurrentPageArena().
+///
+/// @code{.cpp}
+/// BenchmarkOptions options;
+/// options.page_kinds = {PageKind::kSmall, PageKind::kTransparentHuge};
+/// PrintBenchmarkResults(std::cout, ExecuteBenchmarkSuite("Lookup", lookup, {rows...}, options));
+/// @endcode
+
+/// @addtogroup benchmark
+/// @{
+
+/// @brief Options that control how rows are timed.
+struct BenchmarkOptions {
+  /// @brief Each measurement repeats function_to_test until it has taken at least this long.
+  std::chrono::nanoseconds min_time = std::chrono::milliseconds(100);
+  /// @brief The most times function_to_test is called in a measurement.
+  uint64_t max_iterations = 1000000000;
+  /// @brief Each row is timed once with its inputs in an arena of each of these kinds. Kinds that can not be mapped
+  /// are left out of the results.
+  std::vector<PageKind> page_kinds = {PageKind::kSmall};
+  /// @brief The capacity of each arena.
+  size_t arena_bytes = 64 << 20;
+  /// @brief If true the user space instructions retired by function_to_test are counted with a PerfCounterGroup and
+  /// added as the instructions_per_call counter. Rows fail if the counters are not available.
+  bool count_instructions = false;
+  /// @brief If true and count_instructions is true, cache misses are counted too and cachegrind's estimated cycles are
+  /// added as the estimated_cycles_per_call counter.
+  bool count_cache_misses = false;
+  /// @brief If true the energy used by the CPU packages and cores is measured with EnergyCounters and added as the
+  /// package_joules_per_call and core_joules_per_call counters. If the counters are not available this is printed once
+  /// per suite and rows are timed without them.
+  bool measure_energy = false;
+  /// @brief The directory EnergyCounters reads the RAPL zones from.
+  std::string powercap_directory = "/sys/class/powercap";
+};
+
+/// @brief The timing of one row under one variant.
+struct BenchmarkResult {
+  /// @brief The label of the suite.
+  std::string suite_label;
+  /// @brief The label of the row.
+  std::string test_label;
+  /// @brief The name of the variant the row was timed under.
+  std::string variant;
+  /// @brief The number of times function_to_test was called.
+  uint64_t iterations;
+  /// @brief The wall clock time of every iteration together.
+  std::chrono::nanoseconds real_time;
+  /// @brief The CPU time of the timing thread for every iteration together.
+  std::chrono::nanoseconds cpu_time;
+  /// @brief Extra measurements by name.
+  std::map<std::string, double> counters;
+};
+
+/// @brief The raw numbers from MeasureBenchmark.
+struct BenchmarkMeasurement {
+  /// @brief The number of iterations timed.
+  uint64_t iterations;
+  /// @brief The wall clock time of every iteration together.
+  std::chrono::nanoseconds real_time;
+  /// @brief The CPU time of the calling thread for every iteration together.
+  std::chrono::nanoseconds cpu_time;
+  /// @brief The counts for every iteration together if options.count_instructions was set.
+  std::optional<PerfCounts> perf_counts;
+  /// @brief The energy used by every iteration together if options.measure_energy was set and it could be measured.
+  std::optional<EnergyCounts> energy;
+};
+
+/// @brief This is a type that represents a function that runs the code being timed a number of times.
+using BenchmarkIterationsFunction = std::function<void(uint64_t iterations)>;
+
+/// @brief Times run_iterations, increasing the iteration count until options.min_time is reached.
+///
+/// run_iterations is called once before timing starts to warm up caches and fault in pages. If
+/// options.count_instructions is set each timed call of run_iterations is also counted and the counts of the final one
+/// are returned. If options.measure_energy is set and EnergyCounters are available the energy of each timed call is
+/// measured too. The energy counters are read outside the timed region because reading them takes microseconds.
+/// @param options The options that control how long to run.
+/// @param run_iterations The function that runs the code being timed.
+/// @return The iterations and times of the final run.
+/// @throws std::runtime_error if options.count_instructions is set and the counters can not be opened or read.
+BenchmarkMeasurement MeasureBenchmark(const BenchmarkOptions& options,
+                                      const BenchmarkIterationsFunction& run_iterations);
+
+/// @brief This is a type that represents a function that adds counters to a result after it is measured.
+using BenchmarkCountersFunction = std::function<void(BenchmarkResult& result)>;
+
+/// @brief Times one row under one variant and adds its result.
+///
+/// before_each is called before timing and after_each after, even if timing throws. If anything throws, the error is
+/// printed and no result is added.
+/// @param results The results to add to.
+/// @param suite_label The label of the suite.
+/// @param test_label The label of the row.
+/// @param variant The name of the variant.
+/// @param before_each This is called before the row is timed.
+/// @param after_each This is called after the row is timed.
+/// @param options The options that control how long to run.
+/// @param run_iterations The function that runs the row.
+/// @param add_counters If set, this is called with the result after timing and before after_each.
+void BenchmarkRow(std::vector<BenchmarkResult>& results,
+                  const std::string& suite_label,
+                  const std::string& test_label,
+                  const std::string& variant,
+                  const MaybeTestConfigureFunction& before_each,
+                  const MaybeTestConfigureFunction& after_each,
+                  const BenchmarkOptions& options,
+                  const BenchmarkIterationsFunction& run_iterations,
+                  const BenchmarkCountersFunction& add_counters = nullptr);
+
+/// @brief Prints why energy is not measured if options.measure_energy is set and EnergyCounters are not available.
+/// @param os The stream to print to.
+/// @param suite_label The label of the suite.
+/// @param options The options of the suite.
+void ReportEnergyAvailability(std::ostream& os, const std::string& suite_label, const BenchmarkOptions& options);
+
+/// @brief Adds the allocation counts of a measurement as counters. Counts are per call except peak_bytes.
+/// @param result The result to add to.
+/// @param stats The counts for every iteration of the measurement.
+void AddMemoryResourceCounters(BenchmarkResult& result, const MemoryResourceStats& stats);
+
+/// @brief Keeps the compiler from optimizing away the computation of value.
+/// @tparam T The type of the value.
+/// @param value The value.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// @brief Prints results as a table with a row for each test and a column for each variant.
+///
+/// Times are per iteration. Every variant after the first also shows its time relative to the first. Each counter is
+/// printed after the times as another table with the same layout.
+/// @param os The stream to print to.
+/// @param results The results to print.
+void PrintBenchmarkResults(std::ostream& os, const std::vector<BenchmarkResult>& results);
+
+/// @brief The machine a benchmark ran on. This is the "context" object of Google Benchmark's JSON output.
+struct BenchmarkContext {
+  /// @brief When the benchmark ran in ISO 8601 format with the local time zone offset.
+  std::string date;
+  /// @brief The name of this machine.
+  std::string host_name;
+  /// @brief The path of the benchmark binary.
+  std::string executable;
+  /// @brief The number of CPUs.
+  int num_cpus;
+  /// @brief The clock speed of the first CPU or 0 if it is unknown.
+  int mhz_per_cpu;
+  /// @brief True if the CPU frequency governor is not "performance" so times may vary with the clock speed.
+  bool cpu_scaling_enabled;
+  /// @brief The 1, 5, and 15 minute load averages.
+  std::vector<double> load_avg;
+  /// @brief "debug" or "release" depending on NDEBUG.
+  std::string library_build_type;
+};
+
+/// @brief Gets the context of the machine this is running on.
+/// @return The context.
+BenchmarkContext CurrentBenchmarkContext();
+
+/// @brief Writes results in the JSON format Google Benchmark writes with --benchmark_format=json so they can be read
+/// by its compare.py and other tools built around it.
+///
+/// Each result is one benchmark named "suite_label::test_label/variant". The results of one row are a family and each
+/// variant is an instance of it. real_time and cpu_time are per iteration in nanoseconds and counters are written as
+/// extra fields of their benchmark.
+/// @param os The stream to write to.
+/// @param results The results to write.
+/// @param context The context to write.
+void WriteBenchmarkJson(std::ostream& os, const std::vector<BenchmarkResult>& results, const BenchmarkContext& context);
+
+/// @brief Writes results in Google Benchmark's JSON format with the context of the machine this is running on.
+/// @param os The stream to write to.
+/// @param results The results to write.
+void WriteBenchmarkJson(std::ostream& os, const std::vector<BenchmarkResult>& results);
+
+/// @brief Times each row of a suite under each PageKind in options.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this suite.
+/// @param function_to_test The function to time.
+/// @param tests The rows. Disabled rows are left out. Expected values and compare functions are ignored. Rows hold
+/// their inputs by value so function_to_test may take them as const references.
+/// @param options The options that control how rows are timed.
+/// @param before_all This is called before any row is timed.
+/// @param after_all This is called after every row has been timed.
+/// @return The results of each row under each variant.
+template <typename TResult, typename... TInputParams>
+std::vector<BenchmarkResult> ExecuteBenchmarkSuite(
+    const std::string& suite_label,
+    std::function<TResult(TInputParams...)> function_to_test,
+    std::initializer_list<TestTuple<TResult, std::decay_t<TInputParams>...>> tests,
+    BenchmarkOptions options = {},
+    MaybeTestConfigureFunction before_all = std::nullopt,
+    MaybeTestConfigureFunction after_all = std::nullopt);
+
+/// @brief Times each row of a suite under each MemoryResourceVariant.
+///
+/// function_to_test is called with the variant's resource first. The variant's release_after_call runs after every
+/// call and is included in the time. Allocation counts are added as counters by AddMemoryResourceCounters.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function after the memory resource.
+/// @param suite_label The label for this suite.
+/// @param function_to_test The function to time.
+/// @param tests The rows. Disabled rows are left out. Expected values and compare functions are ignored.
+/// @param variants The variants to time every row under.
+/// @param options The options that control how rows are timed. page_kinds is ignored.
+/// @param before_all This is called before any row is timed.
+/// @param after_all This is called after every row has been timed.
+/// @return The results of each row under each variant.
+template <typename TResult, typename... TInputParams>
+std::vector<BenchmarkResult> ExecuteBenchmarkSuiteWithResources(
+    const std::string& suite_label,
+    std::function<TResult(std::pmr::memory_resource*, TInputParams...)> function_to_test,
+    std::initializer_list<TestTuple<TResult, std::decay_t<TInputParams>...>> tests,
+    std::vector<MemoryResourceVariant> variants = StandardMemoryResourceVariants(),
+    BenchmarkOptions options = {},
+    MaybeTestConfigureFunction before_all = std::nullopt,
+    MaybeTestConfigureFunction after_all = std::nullopt);
+
+/// @}
+
+template <typename TResult, typename... TInputParams>
+std::vector<BenchmarkResult> ExecuteBenchmarkSuite(
+    const std::string& suite_label,
+    std::function<TResult(TInputParams...)> function_to_test,
+    std::initializer_list<TestTuple<TResult, std::decay_t<TInputParams>...>> tests,
+    BenchmarkOptions options,
+    MaybeTestConfigureFunction before_all,
+    MaybeTestConfigureFunction after_all) {
+  std::vector<BenchmarkResult> results;
+  ReportEnergyAvailability(std::cout, suite_label, options);
+  if (before_all.has_value()) {
+    (*before_all)();
+  }
+  for (const TestTuple<TResult, std::decay_t<TInputParams>...>& test : tests) {
+    if (!std::get<6>(test)) {
+      continue;
+    }
+    for (PageKind kind : options.page_kinds) {
+      PageArena arena(kind, options.arena_bytes);
+      if (!arena.IsAvailable()) {
+        continue;
+      }
+      PageArenaScope scope(arena);
+      std::optional<std::tuple<std::decay_t<TInputParams>...>> inputs;
+      BenchmarkIterationsFunction run_iterations = [&](uint64_t iterations) {
+        if (!inputs.has_value()) {
+          inputs.emplace(std::allocator_arg, std::pmr::polymorphic_allocator<std::byte>(&arena), std::get<2>(test));
+        }
+        for (uint64_t iteration = 0; iteration < iterations; iteration++) {
+          if constexpr (std::is_void_v<TResult>) {
+            std::apply(function_to_test, *inputs);
+          } else {
+            DoNotOptimize(std::apply(function_to_test, *inputs));
+          }
+        }
+      };
+      BenchmarkRow(results,
+                   suite_label,
+                   std::get<0>(test),
+                   PageKindName(kind),
+                   std::get<4>(test),
+                   std::get<5>(test),
+                   options,
+                   run_iterations);
+    }
+  }
+  if (after_all.has_value()) {
+    (*after_all)();
+  }
+  return results;
+}
+
+template <typename TResult, typename... TInputParams>
+std::vector<BenchmarkResult> ExecuteBenchmarkSuiteWithResources(
+    const std::string& suite_label,
+    std::function<TResult(std::pmr::memory_resource*, TInputParams...)> function_to_test,
+    std::initializer_list<TestTuple<TResult, std::decay_t<TInputParams>...>> tests,
+    std::vector<MemoryResourceVariant> variants,
+    BenchmarkOptions options,
+    MaybeTestConfigureFunction before_all,
+    MaybeTestConfigureFunction after_all) {
+  std::vector<BenchmarkResult> results;
+  ReportEnergyAvailability(std::cout, suite_label, options);
+  if (before_all.has_value()) {
+    (*before_all)();
+  }
+  for (const TestTuple<TResult, std::decay_t<TInputParams>...>& test : tests) {
+    if (!std::get<6>(test)) {
+      continue;
+    }
+    for (const MemoryResourceVariant& variant : variants) {
+      VariantMemoryResource resource(variant);
+      MemoryResourceScope scope(resource.Resource());
+      // The inputs are not allocated from the variant's resource because release_after_call would free them.
+      std::tuple<std::decay_t<TInputParams>...> inputs = std::get<2>(test);
+      auto call = [&](auto&... arguments) { return function_to_test(resource.Resource(), arguments...); };
+      BenchmarkIterationsFunction run_iterations = [&](uint64_t iterations) {
+        resource.ResetStats();
+        for (uint64_t iteration = 0; iteration < iterations; iteration++) {
+          if constexpr (std::is_void_v<TResult>) {
+            std::apply(call, inputs);
+          } else {
+            DoNotOptimize(std::apply(call, inputs));
+          }
+          resource.ReleaseAfterCall();
+        }
+      };
+      BenchmarkRow(results,
+                   suite_label,
+                   std::get<0>(test),
+                   variant.name,
+                   std::get<4>(test),
+                   std::get<5>(test),
+                   options,
+                   run_iterations,
+                   [&resource](BenchmarkResult& result) { AddMemoryResourceCounters(result, resource.Stats()); });
+    }
+  }
+  if (after_all.has_value()) {
+    (*after_all)();
+  }
+  return results;
+}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__benchmark_h__)
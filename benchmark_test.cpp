@@ -0,0 +1,295 @@
+/***************************************************************************************
+ * @file benchmark_test.cpp                                                            *
+ *                                                                                     *
+ * @brief Tests for timing the rows of a suite.                                        *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "benchmark.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "page_arena.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::string;
+using std::vector;
+using testing::Eq;
+using testing::Ge;
+using testing::Gt;
+using testing::HasSubstr;
+using TinyTest::BenchmarkContext;
+using TinyTest::BenchmarkMeasurement;
+using TinyTest::BenchmarkOptions;
+using TinyTest::BenchmarkResult;
+using TinyTest::CurrentPageArena;
+using TinyTest::ExecuteBenchmarkSuite;
+using TinyTest::ExecuteBenchmarkSuiteWithResources;
+using TinyTest::MakeTest;
+using TinyTest::MaybeTestCompareFunction;
+using TinyTest::MaybeTestConfigureFunction;
+using TinyTest::MeasureBenchmark;
+using TinyTest::PageKind;
+using TinyTest::PrintBenchmarkResults;
+using TinyTest::WriteBenchmarkJson;
+
+TEST(MeasureBenchmark, ShouldRunUntilTheMinimumTime) {
+  BenchmarkOptions options;
+  options.min_time = std::chrono::milliseconds(5);
+  uint64_t calls = 0;
+  BenchmarkMeasurement measurement = MeasureBenchmark(options, [&calls](uint64_t iterations) {
+    for (uint64_t iteration = 0; iteration < iterations; iteration++) {
+      TinyTest::DoNotOptimize(++calls);
+    }
+  });
+  EXPECT_THAT(measurement.real_time, Ge(options.min_time));
+  EXPECT_THAT(measurement.iterations, Gt(1));
+  EXPECT_THAT(calls, Gt(measurement.iterations));
+}
+
+TEST(MeasureBenchmark, ShouldStopAtTheMaximumIterations) {
+  BenchmarkOptions options;
+  options.min_time = std::chrono::hours(1);
+  options.max_iterations = 50;
+  BenchmarkMeasurement measurement = MeasureBenchmark(options, [](uint64_t) {});
+  EXPECT_THAT(measurement.iterations, Eq(50));
+}
+
+TEST(ExecuteBenchmarkSuite, ShouldTimeEachRowWithItsInputsInEachArena) {
+  BenchmarkOptions options;
+  options.min_time = std::chrono::microseconds(100);
+  options.page_kinds = {PageKind::kSmall, PageKind::kTransparentHuge};
+  MaybeTestCompareFunction<size_t> compare = std::nullopt;
+  MaybeTestConfigureFunction configure = std::nullopt;
+  bool is_in_arena = true;
+  function<size_t(const std::pmr::vector<int>&)> sum = [&is_in_arena](const std::pmr::vector<int>& values) {
+    is_in_arena = is_in_arena && values.get_allocator().resource() == CurrentPageArena();
+    size_t total = 0;
+    for (int value : values) {
+      total += value;
+    }
+    return total;
+  };
+  vector<BenchmarkResult> results = ExecuteBenchmarkSuite(
+      "Sum",
+      sum,
+      {
+          MakeTest("Small", (size_t)6, make_tuple(std::pmr::vector<int>({1, 2, 3}))),
+          MakeTest("Disabled", (size_t)0, make_tuple(std::pmr::vector<int>()), compare, configure, configure, false),
+      },
+      options);
+  ASSERT_THAT(results.size(), Eq(2));
+  EXPECT_THAT(results[0].test_label, Eq("Small"));
+  EXPECT_THAT(results[0].variant, Eq("4 KB pages"));
+  EXPECT_THAT(results[1].variant, Eq("THP"));
+  EXPECT_THAT(results[1].iterations, Gt(0));
+  EXPECT_THAT(is_in_arena, Eq(true));
+}
+
+TEST(ExecuteBenchmarkSuiteWithResources, ShouldCountAllocationsPerCallForEachVariant) {
+  BenchmarkOptions options;
+  options.min_time = std::chrono::microseconds(100);
+  function<size_t(std::pmr::memory_resource*, int)> fill = [](std::pmr::memory_resource* resource, int count) {
+    std::pmr::vector<int> values(count, 1, resource);
+    return values.size();
+  };
+  vector<BenchmarkResult> results = ExecuteBenchmarkSuiteWithResources(
+      "Fill",
+      fill,
+      {MakeTest("Four", (size_t)4, make_tuple(4))},
+      {TinyTest::NewDeleteResourceVariant(), TinyTest::MonotonicBufferResourceVariant(1024)},
+      options);
+  ASSERT_THAT(results.size(), Eq(2));
+  EXPECT_THAT(results[0].variant, Eq("new_delete"));
+  EXPECT_THAT(results[0].counters["allocations_per_call"], Eq(1));
+  EXPECT_THAT(results[0].counters["bytes_per_call"], Eq(4 * sizeof(int)));
+  EXPECT_THAT(results[0].counters["upstream_allocations_per_call"], Eq(1));
+  EXPECT_THAT(results[1].variant, Eq("monotonic"));
+  EXPECT_THAT(results[1].counters["allocations_per_call"], Eq(1));
+  // The monotonic buffer is released after every call so it allocates its buffer from upstream every time.
+  EXPECT_THAT(results[1].counters["upstream_allocations_per_call"], Eq(1));
+}
+
+TEST(ExecuteBenchmarkSuite, ShouldCountInstructionsPerCallWhenAsked) {
+  BenchmarkOptions options;
+  options.min_time = std::chrono::microseconds(100);
+  options.count_instructions = true;
+  function<int(int)> sum = [](int count) {
+    int total = 0;
+    for (int value = 0; value < count; value++) {
+      TinyTest::DoNotOptimize(total += value);
+    }
+    return total;
+  };
+  vector<BenchmarkResult> results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteBenchmarkSuite("Sum", sum, {MakeTest("Thousand", 0, make_tuple(1000))}, options);
+  };
+  string captured = TinyTest::InterceptCout(wrapper);
+  if (!TinyTest::PerfCounterGroup::IsAvailable()) {
+    EXPECT_THAT(results.size(), Eq(0));
+    EXPECT_THAT(captured,
+                HasSubstr("🔥ERROR: Sum::Thousand [4 KB pages] Caught exception \"Unable to count instructions: "));
+    return;
+  }
+  ASSERT_THAT(results.size(), Eq(1));
+  EXPECT_THAT(results[0].counters["instructions_per_call"], Ge(1000));
+  EXPECT_THAT(results[0].counters.count("estimated_cycles_per_call"), Eq(0));
+}
+
+TEST(ExecuteBenchmarkSuite, ShouldRunAfterEachWhenTheRowThrows) {
+  BenchmarkOptions options;
+  options.min_time = std::chrono::microseconds(100);
+  MaybeTestCompareFunction<int> compare = std::nullopt;
+  MaybeTestConfigureFunction before_each = std::nullopt;
+  int after_each_calls = 0;
+  MaybeTestConfigureFunction after_each = [&after_each_calls]() { after_each_calls++; };
+  function<int(int)> throws = [](int) -> int { throw std::runtime_error("row failed"); };
+  vector<BenchmarkResult> results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteBenchmarkSuite(
+        "Throws", throws, {MakeTest("One", 0, make_tuple(1), compare, before_each, after_each)}, options);
+  };
+  string captured = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.size(), Eq(0));
+  EXPECT_THAT(after_each_calls, Eq(1));
+  EXPECT_THAT(captured, HasSubstr("🔥ERROR: Throws::One [4 KB pages] Caught exception \"row failed\"."));
+}
+
+TEST(ExecuteBenchmarkSuite, ShouldSaySoWhenEnergyCanNotBeMeasured) {
+  BenchmarkOptions options;
+  options.min_time = std::chrono::microseconds(100);
+  options.measure_energy = true;
+  options.powercap_directory = testing::TempDir() + "benchmark_test_missing_powercap";
+  function<int(int)> identity = [](int value) { return value; };
+  vector<BenchmarkResult> results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteBenchmarkSuite("Identity", identity, {MakeTest("One", 0, make_tuple(1))}, options);
+  };
+  string captured = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(captured, HasSubstr("⚡Not measuring energy for Identity: No RAPL package zones were found in "));
+  ASSERT_THAT(results.size(), Eq(1));
+  EXPECT_THAT(results[0].counters.count("package_joules_per_call"), Eq(0));
+}
+
+TEST(PrintBenchmarkResults, ShouldShowVariantsSideBySide) {
+  vector<BenchmarkResult> results = {
+      {"Suite", "Lookup", "4 KB pages", 100, std::chrono::nanoseconds(2000), std::chrono::nanoseconds(2000), {}},
+      {"Suite", "Lookup", "THP", 100, std::chrono::nanoseconds(1500), std::chrono::nanoseconds(1500), {}},
+      {"Suite", "Scan", "4 KB pages", 10, std::chrono::nanoseconds(30000), std::chrono::nanoseconds(30000), {}},
+  };
+  std::ostringstream os;
+  PrintBenchmarkResults(os, results);
+  EXPECT_THAT(os.str(),
+              Eq("Benchmark     4 KB pages             THP\n"
+                 "Suite::Lookup 20.0 ns                15.0 ns (0.75x)\n"
+                 "Suite::Scan   3.0 us                 -\n"));
+}
+
+TEST(PrintBenchmarkResults, ShouldPrintATableForEachCounter) {
+  vector<BenchmarkResult> results = {
+      {"Suite", "Fill", "new_delete", 10, std::chrono::nanoseconds(100), std::chrono::nanoseconds(9), {{"bytes", 16}}},
+      {"Suite", "Fill", "monotonic", 10, std::chrono::nanoseconds(50), std::chrono::nanoseconds(40), {{"bytes", 16}}},
+  };
+  std::ostringstream os;
+  PrintBenchmarkResults(os, results);
+  EXPECT_THAT(os.str(),
+              Eq("Benchmark   new_delete             monotonic\n"
+                 "Suite::Fill 10.0 ns                5.0 ns (0.50x)\n"
+                 "\n"
+                 "bytes       new_delete             monotonic\n"
+                 "Suite::Fill 16                     16\n"));
+}
+
+TEST(WriteBenchmarkJson, ShouldWriteGoogleBenchmarkJson) {
+  vector<BenchmarkResult> results = {
+      {"Suite", "Fill", "new_delete", 10, std::chrono::nanoseconds(100), std::chrono::nanoseconds(90), {{"bytes", 16}}},
+      {"Suite", "Fill", "monotonic", 4, std::chrono::nanoseconds(10), std::chrono::nanoseconds(10), {}},
+      {"Suite", "\"Quoted\"", "", 1, std::chrono::nanoseconds(5), std::chrono::nanoseconds(5), {}},
+  };
+  BenchmarkContext context = {"2023-06-01T12:00:00+00:00", "host", "/bin/bench", 8, 2400, false, {0.5, 1}, "release"};
+  std::ostringstream os;
+  WriteBenchmarkJson(os, results, context);
+  EXPECT_THAT(os.str(),
+              Eq("{\n"
+                 "  \"context\": {\n"
+                 "    \"date\": \"2023-06-01T12:00:00+00:00\",\n"
+                 "    \"host_name\": \"host\",\n"
+                 "    \"executable\": \"/bin/bench\",\n"
+                 "    \"num_cpus\": 8,\n"
+                 "    \"mhz_per_cpu\": 2400,\n"
+                 "    \"cpu_scaling_enabled\": false,\n"
+                 "    \"caches\": [\n"
+                 "    ],\n"
+                 "    \"load_avg\": [0.5,1],\n"
+                 "    \"library_build_type\": \"release\"\n"
+                 "  },\n"
+                 "  \"benchmarks\": [\n"
+                 "    {\n"
+                 "      \"name\": \"Suite::Fill/new_delete\",\n"
+                 "      \"family_index\": 0,\n"
+                 "      \"per_family_instance_index\": 0,\n"
+                 "      \"run_name\": \"Suite::Fill/new_delete\",\n"
+                 "      \"run_type\": \"iteration\",\n"
+                 "      \"repetitions\": 1,\n"
+                 "      \"repetition_index\": 0,\n"
+                 "      \"threads\": 1,\n"
+                 "      \"iterations\": 10,\n"
+                 "      \"real_time\": 10,\n"
+                 "      \"cpu_time\": 9,\n"
+                 "      \"time_unit\": \"ns\",\n"
+                 "      \"bytes\": 16\n"
+                 "    },\n"
+                 "    {\n"
+                 "      \"name\": \"Suite::Fill/monotonic\",\n"
+                 "      \"family_index\": 0,\n"
+                 "      \"per_family_instance_index\": 1,\n"
+                 "      \"run_name\": \"Suite::Fill/monotonic\",\n"
+                 "      \"run_type\": \"iteration\",\n"
+                 "      \"repetitions\": 1,\n"
+                 "      \"repetition_index\": 0,\n"
+                 "      \"threads\": 1,\n"
+                 "      \"iterations\": 4,\n"
+                 "      \"real_time\": 2.5,\n"
+                 "      \"cpu_time\": 2.5,\n"
+                 "      \"time_unit\": \"ns\"\n"
+                 "    },\n"
+                 "    {\n"
+                 "      \"name\": \"Suite::\\\"Quoted\\\"\",\n"
+                 "      \"family_index\": 1,\n"
+                 "      \"per_family_instance_index\": 0,\n"
+                 "      \"run_name\": \"Suite::\\\"Quoted\\\"\",\n"
+                 "      \"run_type\": \"iteration\",\n"
+                 "      \"repetitions\": 1,\n"
+                 "      \"repetition_index\": 0,\n"
+                 "      \"threads\": 1,\n"
+                 "      \"iterations\": 1,\n"
+                 "      \"real_time\": 5,\n"
+                 "      \"cpu_time\": 5,\n"
+                 "      \"time_unit\": \"ns\"\n"
+                 "    }\n"
+                 "  ]\n"
+                 "}\n"));
+}
+
+TEST(CurrentBenchmarkContext, ShouldDescribeThisMachine) {
+  BenchmarkContext context = TinyTest::CurrentBenchmarkContext();
+  EXPECT_THAT(context.num_cpus, Gt(0));
+  EXPECT_THAT(context.date, HasSubstr("T"));
+  EXPECT_THAT(context.executable, HasSubstr("benchmark_test"));
+}
+}  // End namespace
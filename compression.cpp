@@ -0,0 +1,195 @@
+/***************************************************************************************
+ * @file compression.cpp                                                               *
+ *                                                                                     *
+ * @brief Defines a small block compressor used to shrink large stored test output.    *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "compression.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace TinyTest {
+namespace {
+using std::string;
+using std::string_view;
+
+// These limits come from the LZ4 block format. Matches are at least 4 bytes, the last 5 bytes are always literals, and
+// the last match must start at least 12 bytes before the end of the block.
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMatchFindLimit = 12;
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashBits = 12;
+
+uint32_t Read32(const char* data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+uint32_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+void WriteLength(string& output, size_t length) {
+  while (length >= 255) {
+    output.push_back(static_cast<char>(255));
+    length -= 255;
+  }
+  output.push_back(static_cast<char>(length));
+}
+
+void WriteSequence(string& output, string_view literals, size_t offset, size_t match_length) {
+  size_t token_index = output.size();
+  output.push_back(0);
+  uint8_t token = 0;
+  if (literals.size() >= 15) {
+    token = 15 << 4;
+    WriteLength(output, literals.size() - 15);
+  } else {
+    token = literals.size() << 4;
+  }
+  output.append(literals);
+  if (match_length > 0) {
+    output.push_back(static_cast<char>(offset & 0xFF));
+    output.push_back(static_cast<char>(offset >> 8));
+    size_t extra_length = match_length - kMinMatch;
+    if (extra_length >= 15) {
+      token |= 15;
+      WriteLength(output, extra_length - 15);
+    } else {
+      token |= extra_length;
+    }
+  }
+  output[token_index] = static_cast<char>(token);
+}
+
+size_t ReadLength(string_view block, size_t& index, size_t length) {
+  if (length != 15) {
+    return length;
+  }
+  uint8_t next;
+  do {
+    if (index >= block.size()) {
+      throw std::runtime_error("Truncated LZ4 block.");
+    }
+    next = block[index++];
+    length += next;
+  } while (next == 255);
+  return length;
+}
+}  // End namespace
+
+string CompressBlock(string_view data) {
+  string output;
+  output.reserve(data.size() + data.size() / 255 + 16);
+  size_t anchor = 0;
+  if (data.size() > kMatchFindLimit) {
+    std::vector<uint32_t> table(1 << kHashBits, 0);
+    const char* input = data.data();
+    size_t match_start_limit = data.size() - kMatchFindLimit;
+    size_t match_end_limit = data.size() - kLastLiterals;
+    size_t position = 0;
+    size_t misses = 0;
+    while (position < match_start_limit) {
+      uint32_t sequence = Read32(input + position);
+      uint32_t hash = Hash(sequence);
+      size_t candidate = table[hash];
+      table[hash] = position;
+      if (candidate >= position || position - candidate > kMaxOffset || Read32(input + candidate) != sequence) {
+        // Skip ahead faster the longer we go without finding a match, like LZ4 does for incompressible data.
+        position += 1 + (misses++ >> 6);
+        continue;
+      }
+      misses = 0;
+      while (position > anchor && candidate > 0 && input[position - 1] == input[candidate - 1]) {
+        position--;
+        candidate--;
+      }
+      size_t match_length = kMinMatch;
+      while (position + match_length < match_end_limit &&
+             input[candidate + match_length] == input[position + match_length]) {
+        match_length++;
+      }
+      WriteSequence(output, data.substr(anchor, position - anchor), position - candidate, match_length);
+      position += match_length;
+      anchor = position;
+      if (position < match_start_limit) {
+        table[Hash(Read32(input + position - 2))] = position - 2;
+      }
+    }
+  }
+  WriteSequence(output, data.substr(anchor), 0, 0);
+  return output;
+}
+
+string DecompressBlock(string_view block, size_t decompressed_size) {
+  string output;
+  output.reserve(decompressed_size);
+  size_t index = 0;
+  while (index < block.size()) {
+    uint8_t token = block[index++];
+    size_t literal_length = ReadLength(block, index, token >> 4);
+    if (literal_length > block.size() - index || literal_length > decompressed_size - output.size()) {
+      throw std::runtime_error("LZ4 literals run past the end of the block.");
+    }
+    output.append(block.substr(index, literal_length));
+    index += literal_length;
+    if (index == block.size()) {
+      break;
+    }
+    if (block.size() - index < 2) {
+      throw std::runtime_error("Truncated LZ4 block.");
+    }
+    size_t offset = static_cast<uint8_t>(block[index]) | (static_cast<uint8_t>(block[index + 1]) << 8);
+    index += 2;
+    size_t match_length = ReadLength(block, index, token & 15) + kMinMatch;
+    if (offset == 0 || offset > output.size() || match_length > decompressed_size - output.size()) {
+      throw std::runtime_error("LZ4 match is out of range.");
+    }
+    size_t source = output.size() - offset;
+    output.resize(output.size() + match_length);
+    char* destination = output.data() + output.size() - match_length;
+    if (offset >= match_length) {
+      memcpy(destination, output.data() + source, match_length);
+    } else {
+      // Overlapping matches repeat the last offset bytes so they have to be copied one byte at a time.
+      for (size_t copied = 0; copied < match_length; copied++) {
+        destination[copied] = output[source + copied];
+      }
+    }
+  }
+  if (output.size() != decompressed_size) {
+    throw std::runtime_error("LZ4 block does not match the expected size.");
+  }
+  return output;
+}
+
+// Begin CompressedString methods
+CompressedString::CompressedString() : block_(CompressBlock("")), size_(0) {}
+
+CompressedString::CompressedString(string_view text) : block_(CompressBlock(text)), size_(text.size()) {
+  block_.shrink_to_fit();
+}
+
+size_t CompressedString::CompressedSize() const {
+  return block_.size();
+}
+
+size_t CompressedString::Size() const {
+  return size_;
+}
+
+string CompressedString::Text() const {
+  return DecompressBlock(block_, size_);
+}
+// End CompressedString methods
+
+}  // End namespace TinyTest
@@ -0,0 +1,68 @@
+#ifndef TinyTest__compression_h__
+#define TinyTest__compression_h__
+/***************************************************************************************
+ * @file compression.h                                                                 *
+ *                                                                                     *
+ * @brief Defines a small block compressor used to shrink large stored test output.    *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace TinyTest {
+
+/// @defgroup compression Compression
+
+/// @addtogroup compression
+/// @{
+
+/// @brief Compresses data into a single LZ4 block.
+///
+/// The output uses the LZ4 block format so it can be read by any LZ4 block decoder. It favors speed over ratio and is
+/// meant for large, repetitive text like captured output and failure messages.
+/// @param data The data to compress.
+/// @return The compressed block.
+std::string CompressBlock(std::string_view data);
+
+/// @brief Decompresses a single LZ4 block.
+/// @param block The compressed block.
+/// @param decompressed_size The size of the data before it was compressed.
+/// @return The decompressed data.
+/// @throws std::runtime_error if block is not a valid LZ4 block of decompressed_size bytes.
+std::string DecompressBlock(std::string_view block, size_t decompressed_size);
+
+/// @brief A string that is stored compressed and decompressed each time its text is needed.
+class CompressedString {
+ public:
+  /// @brief Creates an empty compressed string.
+  CompressedString();
+
+  /// @brief Creates a compressed string by compressing text.
+  /// @param text The text to compress.
+  explicit CompressedString(std::string_view text);
+
+  /// @brief Getter for the number of bytes used to store the compressed text.
+  /// @return The compressed size in bytes.
+  size_t CompressedSize() const;
+
+  /// @brief Getter for the length of the text.
+  /// @return The decompressed size in bytes.
+  size_t Size() const;
+
+  /// @brief Decompresses the text.
+  /// @return The text.
+  std::string Text() const;
+
+ private:
+  std::string block_;
+  size_t size_;
+};
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__compression_h__)
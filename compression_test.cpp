@@ -0,0 +1,125 @@
+/***************************************************************************************
+ * @file compression_test.cpp                                                          *
+ *                                                                                     *
+ * @brief Tests for the block compressor used to shrink large stored test output.      *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "compression.h"
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::string;
+using testing::Eq;
+using testing::Lt;
+using TinyTest::CompressBlock;
+using TinyTest::CompressedString;
+using TinyTest::DecompressBlock;
+using TinyTest::TestMessage;
+using TinyTest::TestResults;
+
+string MakeRepetitiveText(size_t size) {
+  string text;
+  for (size_t line = 0; text.size() < size; line++) {
+    text += "    Beginning Test: Row " + std::to_string(line % 97) + "\n";
+  }
+  return text.substr(0, size);
+}
+
+TEST(CompressBlock, ShouldRoundTripAnEmptyString) {
+  string block = CompressBlock("");
+  EXPECT_THAT(block.size(), Eq(1));
+  EXPECT_THAT(DecompressBlock(block, 0), Eq(""));
+}
+
+TEST(CompressBlock, ShouldRoundTripShortStrings) {
+  for (const char* text : {"a", "abcdabcdabcd", "abcdabcdabcdabcd", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"}) {
+    EXPECT_THAT(DecompressBlock(CompressBlock(text), strlen(text)), Eq(text));
+  }
+}
+
+TEST(CompressBlock, ShouldShrinkRepetitiveText) {
+  string text = MakeRepetitiveText(1 << 20);
+  string block = CompressBlock(text);
+  EXPECT_THAT(block.size(), Lt(text.size() / 10));
+  EXPECT_THAT(DecompressBlock(block, text.size()), Eq(text));
+}
+
+TEST(CompressBlock, ShouldRoundTripRandomData) {
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> small_alphabet('a', 'd');
+  string random_bytes;
+  string random_letters;
+  for (int index = 0; index < 100000; index++) {
+    random_bytes.push_back(static_cast<char>(byte(generator)));
+    random_letters.push_back(static_cast<char>(small_alphabet(generator)));
+  }
+  EXPECT_THAT(DecompressBlock(CompressBlock(random_bytes), random_bytes.size()), Eq(random_bytes));
+  EXPECT_THAT(DecompressBlock(CompressBlock(random_letters), random_letters.size()), Eq(random_letters));
+}
+
+TEST(DecompressBlock, ShouldThrowForTheWrongSize) {
+  string text = MakeRepetitiveText(1000);
+  string block = CompressBlock(text);
+  EXPECT_THROW(DecompressBlock(block, text.size() - 1), std::runtime_error);
+  EXPECT_THROW(DecompressBlock(block, text.size() + 1), std::runtime_error);
+}
+
+TEST(DecompressBlock, ShouldThrowForATruncatedBlock) {
+  string text = MakeRepetitiveText(1000);
+  string block = CompressBlock(text);
+  EXPECT_THROW(DecompressBlock(block.substr(0, block.size() / 2), text.size()), std::runtime_error);
+}
+
+TEST(DecompressBlock, ShouldThrowForAnOffsetBeforeTheStart) {
+  // A token with no literals and a match 1 byte back when nothing has been written yet.
+  string block = {'\x00', '\x01', '\x00'};
+  EXPECT_THROW(DecompressBlock(block, 4), std::runtime_error);
+}
+
+TEST(CompressedString, ShouldStoreTextCompressed) {
+  string text = MakeRepetitiveText(100000);
+  CompressedString compressed(text);
+  EXPECT_THAT(compressed.Size(), Eq(text.size()));
+  EXPECT_THAT(compressed.CompressedSize(), Lt(text.size() / 10));
+  EXPECT_THAT(compressed.Text(), Eq(text));
+}
+
+TEST(CompressedString, ShouldDefaultToEmpty) {
+  CompressedString compressed;
+  EXPECT_THAT(compressed.Size(), Eq(0));
+  EXPECT_THAT(compressed.Text(), Eq(""));
+}
+
+TEST(TestMessage, ShouldCompressLongMessages) {
+  string text = MakeRepetitiveText(TestMessage::kCompressionThreshold);
+  TestMessage long_message(text);
+  TestMessage short_message(text.substr(1));
+  EXPECT_THAT(long_message.IsCompressed(), Eq(true));
+  EXPECT_THAT(short_message.IsCompressed(), Eq(false));
+  EXPECT_THAT(long_message.Text(), Eq(text));
+  EXPECT_THAT(short_message.Text(), Eq(text.substr(1)));
+}
+
+TEST(TestResults, ShouldCompressLongMessagesOfEveryKind) {
+  string text = MakeRepetitiveText(100000);
+  TestResults results;
+  results.Error(text).Fail(text).Skip(text);
+  EXPECT_THAT(results.LazyErrorMessages().at(0).IsCompressed(), Eq(true));
+  EXPECT_THAT(results.LazyFailureMessages().at(0).IsCompressed(), Eq(true));
+  EXPECT_THAT(results.LazySkipMessages().at(0).IsCompressed(), Eq(true));
+  EXPECT_THAT(results.ErrorMessages().at(0), Eq(text));
+  EXPECT_THAT(results.FailureMessages().at(0), Eq(text));
+  EXPECT_THAT(results.SkipMessages().at(0), Eq(text));
+}
+}  // End namespace
@@ -0,0 +1,256 @@
+/***************************************************************************************
+ * @file crash_reporter.cpp                                                            *
+ *                                                                                     *
+ * @brief Defines a crash handler that reports the test that was running.              *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "crash_reporter.h"
+
+#include <execinfo.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+namespace {
+using std::string;
+
+constexpr int kCrashSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGABRT};
+
+// The most bytes of a qualified test label kept for the report. Longer labels are cut off.
+constexpr size_t kMaxLabelBytes = 512;
+
+// The most frames in a backtrace.
+constexpr int kMaxFrames = 64;
+
+// The size of the alternate signal stack given to each thread that runs a test.
+constexpr size_t kAltStackBytes = 64 * 1024;
+
+std::atomic<bool> is_installed(false);
+std::atomic<int> report_fd(STDERR_FILENO);
+std::atomic<uint64_t> passed_count(0);
+std::atomic<uint64_t> failed_count(0);
+std::atomic<uint64_t> skipped_count(0);
+std::atomic<uint64_t> error_count(0);
+
+// The test running on each thread. The handler only reads the one for the thread that crashed.
+struct InFlightTest {
+  char label[kMaxLabelBytes];
+  volatile sig_atomic_t length;
+};
+thread_local InFlightTest in_flight_test = {{}, 0};
+
+// Gives a thread an alternate signal stack the first time it runs a test and takes it away when the thread exits.
+struct AltStack {
+  std::unique_ptr<char[]> memory;
+
+  ~AltStack() {
+    if (memory != nullptr) {
+      stack_t disabled = {};
+      disabled.ss_flags = SS_DISABLE;
+      sigaltstack(&disabled, nullptr);
+    }
+  }
+
+  void Install() {
+    if (memory != nullptr) {
+      return;
+    }
+    stack_t existing;
+    if (sigaltstack(nullptr, &existing) == 0 && (existing.ss_flags & SS_DISABLE) == 0) {
+      // Someone else already gave this thread a stack.
+      return;
+    }
+    size_t size = std::max<size_t>(kAltStackBytes, SIGSTKSZ);
+    memory.reset(new char[size]);
+    stack_t stack = {};
+    stack.ss_sp = memory.get();
+    stack.ss_size = size;
+    if (sigaltstack(&stack, nullptr) != 0) {
+      memory.reset();
+    }
+  }
+};
+thread_local AltStack alt_stack;
+
+void WriteString(int fd, const char* text) {
+  size_t length = strlen(text);
+  while (length > 0) {
+    ssize_t written = write(fd, text, length);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return;
+    }
+    text += written;
+    length -= written;
+  }
+}
+
+void WriteNumber(int fd, uint64_t value) {
+  char digits[24];
+  char* start = digits + sizeof(digits) - 1;
+  *start = '\0';
+  do {
+    *--start = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  WriteString(fd, start);
+}
+
+const char* SignalName(int signal_number) {
+  switch (signal_number) {
+    case SIGSEGV:
+      return "SIGSEGV";
+    case SIGBUS:
+      return "SIGBUS";
+    case SIGFPE:
+      return "SIGFPE";
+    case SIGABRT:
+      return "SIGABRT";
+  }
+  return "a signal";
+}
+
+void OnTestEvent(const TestEvent& event) {
+  // The test code may run on a different thread than the one that published kTestBegin, so the label is kept for the
+  // threads that actually run it.
+  if (event.type == TestEventType::kTestThreadBegin) {
+    alt_stack.Install();
+    in_flight_test.length = 0;
+    size_t length = 0;
+    auto append = [&length](std::string_view text) {
+      size_t count = std::min(text.size(), kMaxLabelBytes - 1 - length);
+      memcpy(in_flight_test.label + length, text.data(), count);
+      length += count;
+    };
+    append(event.suite_label);
+    append("::");
+    append(event.test_label);
+    in_flight_test.label[length] = '\0';
+    in_flight_test.length = static_cast<sig_atomic_t>(length);
+  } else if (event.type == TestEventType::kTestThreadEnd) {
+    in_flight_test.length = 0;
+  } else if (event.type == TestEventType::kTestEnd) {
+    if (event.has_error) {
+      error_count++;
+    }
+    switch (event.outcome) {
+      case TestOutcome::kPassed:
+        passed_count++;
+        break;
+      case TestOutcome::kFailed:
+        failed_count++;
+        break;
+      case TestOutcome::kSkipped:
+        skipped_count++;
+        break;
+    }
+  }
+}
+
+void OnCrash(int signal_number) {
+  int saved_errno = errno;
+  WriteCrashReport(report_fd.load(), signal_number);
+  errno = saved_errno;
+  // The handler was installed with SA_RESETHAND so this gets the default action.
+  raise(signal_number);
+}
+}  // End namespace
+
+void WriteCrashReport(int fd, int signal_number) {
+  WriteString(fd, "💥CRASH: Caught ");
+  WriteString(fd, SignalName(signal_number));
+  if (in_flight_test.length > 0) {
+    WriteString(fd, " while running ");
+    WriteString(fd, in_flight_test.label);
+  } else {
+    WriteString(fd, " while no test was running on this thread");
+  }
+  WriteString(fd, "\nFinished before the crash: ");
+  WriteNumber(fd, passed_count.load());
+  WriteString(fd, " passed, ");
+  WriteNumber(fd, failed_count.load());
+  WriteString(fd, " failed, ");
+  WriteNumber(fd, skipped_count.load());
+  WriteString(fd, " skipped, ");
+  WriteNumber(fd, error_count.load());
+  WriteString(fd, " errors\nBacktrace:\n");
+  void* frames[kMaxFrames];
+  int frame_count = backtrace(frames, kMaxFrames);
+  backtrace_symbols_fd(frames, frame_count, fd);
+}
+
+// Begin CrashReporter methods
+CrashReporter::CrashReporter(const string& report_path) : listener_id_(0), previous_actions_() {
+  if (is_installed.exchange(true)) {
+    throw std::runtime_error("Only one CrashReporter may exist at a time.");
+  }
+  int fd = STDERR_FILENO;
+  if (!report_path.empty()) {
+    fd = open(report_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      is_installed = false;
+      throw std::runtime_error("Unable to open " + report_path + ": " + strerror(errno));
+    }
+  }
+  report_fd = fd;
+  passed_count = 0;
+  failed_count = 0;
+  skipped_count = 0;
+  error_count = 0;
+
+  // backtrace loads libgcc the first time it is called, which is not safe in a signal handler.
+  void* frame;
+  backtrace(&frame, 1);
+  alt_stack.Install();
+
+  struct sigaction action = {};
+  action.sa_handler = OnCrash;
+  action.sa_flags = SA_ONSTACK | SA_RESETHAND | SA_NODEFER;
+  sigemptyset(&action.sa_mask);
+  for (size_t index = 0; index < std::size(kCrashSignals); index++) {
+    if (sigaction(kCrashSignals[index], &action, &previous_actions_[index]) != 0) {
+      string error = strerror(errno);
+      for (size_t restore = 0; restore < index; restore++) {
+        sigaction(kCrashSignals[restore], &previous_actions_[restore], nullptr);
+      }
+      if (fd != STDERR_FILENO) {
+        close(fd);
+      }
+      report_fd = STDERR_FILENO;
+      is_installed = false;
+      throw std::runtime_error("Unable to install the crash handler: " + error);
+    }
+  }
+  listener_id_ = AddTestEventListener(OnTestEvent);
+}
+
+CrashReporter::~CrashReporter() {
+  RemoveTestEventListener(listener_id_);
+  for (size_t index = 0; index < std::size(kCrashSignals); index++) {
+    sigaction(kCrashSignals[index], &previous_actions_[index], nullptr);
+  }
+  int fd = report_fd.exchange(STDERR_FILENO);
+  if (fd != STDERR_FILENO) {
+    close(fd);
+  }
+  is_installed = false;
+}
+// End CrashReporter methods
+
+}  // End namespace TinyTest
@@ -0,0 +1,71 @@
+#ifndef TinyTest__crash_reporter_h__
+#define TinyTest__crash_reporter_h__
+/***************************************************************************************
+ * @file crash_reporter.h                                                              *
+ *                                                                                     *
+ * @brief Defines a crash handler that reports the test that was running.              *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <csignal>
+#include <cstdint>
+#include <string>
+
+namespace TinyTest {
+
+/// @defgroup crash_reporter Crash Reporter
+///
+/// A CrashReporter catches SIGSEGV, SIGBUS, SIGFPE, and SIGABRT in the test process and writes a short report before
+/// the process dies. The report names the test that was running on the crashing thread, the counts of tests that
+/// finished before the crash, and a backtrace.
+///
+/// The handler runs on an alternate signal stack so a stack overflow can still be reported, and only makes
+/// async-signal-safe calls. Everything it needs, including the report file, is set up ahead of time. The test that is
+/// running and the counts come from test events, so suites run by any of the Execute functions are tracked.
+///
+/// After the report is written the signal's default action is restored and the signal is raised again, so the process
+/// still dies the way it would have. The backtrace is raw addresses with whatever symbols the dynamic symbol table has.
+/// Link with -rdynamic to get function names.
+///
+/// @code{.cpp}
+/// int main() {
+///   TinyTest::CrashReporter crash_reporter;
+///   ...
+/// }
+/// @endcode
+
+/// @addtogroup crash_reporter
+/// @{
+
+/// @brief Reports crashes in the test process while it exists. Only one may exist at a time.
+class CrashReporter {
+ public:
+  /// @brief Installs the crash handler.
+  /// @param report_path The file to write reports to. It is created or truncated now. If this is empty reports are
+  /// written to stderr.
+  /// @throws std::runtime_error if another CrashReporter exists, the file can not be opened, or the handler can not be
+  /// installed.
+  explicit CrashReporter(const std::string& report_path = "");
+
+  CrashReporter(const CrashReporter& other) = delete;
+  CrashReporter& operator=(const CrashReporter& other) = delete;
+
+  /// @brief Restores the handlers that were installed before and closes the report file.
+  ~CrashReporter();
+
+ private:
+  uint64_t listener_id_;
+  struct sigaction previous_actions_[4];
+};
+
+/// @brief Writes the crash report for a signal. This is what the installed handler calls. It is async-signal-safe.
+/// @param fd The file descriptor to write the report to.
+/// @param signal_number The signal that was caught.
+void WriteCrashReport(int fd, int signal_number);
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__crash_reporter_h__)
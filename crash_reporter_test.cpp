@@ -0,0 +1,135 @@
+/***************************************************************************************
+ * @file crash_reporter_test.cpp                                                       *
+ *                                                                                     *
+ * @brief Tests for the crash handler that reports the test that was running.          *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "crash_reporter.h"
+
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::string;
+using testing::HasSubstr;
+using testing::KilledBySignal;
+using TinyTest::CrashReporter;
+using TinyTest::ExecuteSuite;
+using TinyTest::ExecuteSuitePipelined;
+using TinyTest::MakeTest;
+
+// Runs a suite where the first test passes, the second fails, and the third raises signal_number.
+void RunSuiteThatCrashes(int signal_number) {
+  function<int(int)> crash_on_three = [signal_number](int value) {
+    if (value == 3) {
+      raise(signal_number);
+    }
+    return value;
+  };
+  ExecuteSuite("Crashing",
+               crash_on_three,
+               {
+                   MakeTest("Passes", 1, make_tuple(1)),
+                   MakeTest("Fails", 0, make_tuple(2)),
+                   MakeTest("Crashes", 3, make_tuple(3)),
+               });
+}
+
+TEST(CrashReporterDeathTest, ShouldReportTheRunningTestAndCountsToStderr) {
+  EXPECT_EXIT(
+      {
+        CrashReporter crash_reporter;
+        RunSuiteThatCrashes(SIGSEGV);
+      },
+      KilledBySignal(SIGSEGV),
+      "💥CRASH: Caught SIGSEGV while running Crashing::Crashes\n"
+      "Finished before the crash: 1 passed, 1 failed, 0 skipped, 0 errors\n"
+      "Backtrace:\n");
+}
+
+TEST(CrashReporterDeathTest, ShouldReportAborts) {
+  EXPECT_EXIT(
+      {
+        CrashReporter crash_reporter;
+        RunSuiteThatCrashes(SIGABRT);
+      },
+      KilledBySignal(SIGABRT),
+      "Caught SIGABRT while running Crashing::Crashes");
+}
+
+TEST(CrashReporterDeathTest, ShouldReportStackOverflows) {
+  EXPECT_EXIT(
+      {
+        CrashReporter crash_reporter;
+        function<int(int)> recurse;
+        recurse = [&recurse](int depth) {
+          volatile char frame[1024];
+          frame[0] = static_cast<char>(depth);
+          return recurse(depth + 1) + frame[0];
+        };
+        ExecuteSuite("Overflowing", recurse, {MakeTest("Recurses", 0, make_tuple(0))});
+      },
+      KilledBySignal(SIGSEGV),
+      "Caught SIGSEGV while running Overflowing::Recurses");
+}
+
+TEST(CrashReporterDeathTest, ShouldReportTheRunningTestOfPipelinedSuites) {
+  EXPECT_EXIT(
+      {
+        CrashReporter crash_reporter;
+        function<int(int)> crash_on_three = [](int value) {
+          if (value == 3) {
+            raise(SIGSEGV);
+          }
+          return value;
+        };
+        ExecuteSuitePipelined("Pipelined",
+                              crash_on_three,
+                              {
+                                  MakeTest("Passes", 1, make_tuple(1)),
+                                  MakeTest("Fails", 0, make_tuple(2)),
+                                  MakeTest("Crashes", 3, make_tuple(3)),
+                                  MakeTest("Never Runs", 4, make_tuple(4)),
+                              });
+      },
+      KilledBySignal(SIGSEGV),
+      "💥CRASH: Caught SIGSEGV while running Pipelined::Crashes\n");
+}
+
+TEST(CrashReporterDeathTest, ShouldWriteToTheReportFile) {
+  string report_path = testing::TempDir() + "crash_reporter_test_" + std::to_string(getpid()) + ".txt";
+  EXPECT_EXIT(
+      {
+        CrashReporter crash_reporter(report_path);
+        RunSuiteThatCrashes(SIGFPE);
+      },
+      KilledBySignal(SIGFPE),
+      "");
+  std::ifstream report(report_path);
+  std::stringstream contents;
+  contents << report.rdbuf();
+  EXPECT_THAT(contents.str(), HasSubstr("💥CRASH: Caught SIGFPE while running Crashing::Crashes\n"));
+  std::remove(report_path.c_str());
+}
+
+TEST(CrashReporter, ShouldOnlyAllowOneAtATime) {
+  CrashReporter crash_reporter;
+  EXPECT_THROW(CrashReporter(), std::runtime_error);
+}
+}  // End namespace
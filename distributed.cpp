@@ -0,0 +1,427 @@
+/***************************************************************************************
+ * @file distributed.cpp                                                               *
+ *                                                                                     *
+ * @brief Defines a coordinator and workers for running suites across many machines.  *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "distributed.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TinyTest {
+namespace {
+using std::string;
+using std::vector;
+
+// How long the coordinator waits for messages before checking for expired leases.
+constexpr int kPollIntervalMilliseconds = 50;
+
+struct DistributedSuite {
+  size_t row_count;
+  DistributedSuiteRunner runner;
+};
+
+struct DistributedSuites {
+  std::mutex mutex;
+  std::map<string, DistributedSuite> suites;
+};
+
+DistributedSuites& GetDistributedSuites() {
+  static DistributedSuites suites;
+  return suites;
+}
+
+struct Message {
+  vector<string> fields;
+  string payload;
+};
+
+string MakeMessage(const string& header, const string& payload = "") {
+  return header + " " + std::to_string(payload.size()) + "\n" + payload;
+}
+
+// Removes one complete message from the front of input. Returns nullopt if input does not hold a whole message yet.
+std::optional<Message> TakeMessage(string& input) {
+  size_t line_end = input.find('\n');
+  if (line_end == string::npos) {
+    return std::nullopt;
+  }
+  Message message;
+  std::istringstream header(input.substr(0, line_end));
+  string field;
+  while (header >> field) {
+    message.fields.push_back(field);
+  }
+  if (message.fields.size() < 2) {
+    throw std::runtime_error("Invalid distributed message header.");
+  }
+  size_t payload_size = std::stoull(message.fields.back());
+  if (input.size() - line_end - 1 < payload_size) {
+    return std::nullopt;
+  }
+  message.payload = input.substr(line_end + 1, payload_size);
+  input.erase(0, line_end + 1 + payload_size);
+  return message;
+}
+
+bool SendAll(int socket, const string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t result = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    sent += result;
+  }
+  return true;
+}
+
+// Reads whatever is available into input. Returns false if the connection was closed.
+bool Receive(int socket, string& input) {
+  char buffer[65536];
+  while (true) {
+    ssize_t size = recv(socket, buffer, sizeof(buffer), 0);
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size <= 0) {
+      return false;
+    }
+    input.append(buffer, size);
+    return true;
+  }
+}
+}  // End namespace
+
+// Begin distributed suite functions
+void RegisterDistributedSuite(const string& suite_label, size_t row_count, DistributedSuiteRunner runner) {
+  DistributedSuites& registry = GetDistributedSuites();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.suites[suite_label] = {row_count, std::move(runner)};
+}
+
+vector<string> RegisteredDistributedSuites() {
+  DistributedSuites& registry = GetDistributedSuites();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  vector<string> suite_labels;
+  for (const auto& suite : registry.suites) {
+    suite_labels.push_back(suite.first);
+  }
+  return suite_labels;
+}
+
+TestResults ExecuteDistributedRows(const string& suite_label, size_t first_row, size_t row_count) {
+  DistributedSuiteRunner runner;
+  {
+    DistributedSuites& registry = GetDistributedSuites();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto suite = registry.suites.find(suite_label);
+    if (suite == registry.suites.end()) {
+      return TestResults().Error(suite_label + " is not registered as a distributed suite.");
+    }
+    runner = suite->second.runner;
+  }
+  // A worker that dies here would have its lease reissued forever so errors outside of the tests are reported instead.
+  try {
+    return runner(first_row, row_count);
+  } catch (...) {
+    return TestResults().Error(suite_label + " " + DescribeCaughtException(std::current_exception()));
+  }
+}
+// End distributed suite functions
+
+// Begin DistributedCoordinator methods
+DistributedCoordinator::DistributedCoordinator(const string& host,
+                                               uint16_t port,
+                                               size_t rows_per_lease,
+                                               std::chrono::milliseconds lease_timeout,
+                                               size_t max_attempts,
+                                               std::chrono::milliseconds connect_timeout)
+    : connect_timeout_(connect_timeout),
+      listen_socket_(-1),
+      lease_timeout_(lease_timeout),
+      max_attempts_(std::max<size_t>(max_attempts, 1)),
+      next_lease_id_(1),
+      port_(0),
+      reissued_leases_(0),
+      remaining_rows_(0),
+      rows_per_lease_(std::max<size_t>(rows_per_lease, 1)) {
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+    throw std::runtime_error("Invalid coordinator address: " + host);
+  }
+  listen_socket_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_socket_ < 0) {
+    throw std::runtime_error("Unable to create coordinator socket: " + string(strerror(errno)));
+  }
+  int reuse_address = 1;
+  setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse_address, sizeof(reuse_address));
+  socklen_t address_size = sizeof(address);
+  if (bind(listen_socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(listen_socket_, 64) != 0 ||
+      getsockname(listen_socket_, reinterpret_cast<sockaddr*>(&address), &address_size) != 0) {
+    string error = strerror(errno);
+    close(listen_socket_);
+    throw std::runtime_error("Unable to listen on " + host + ":" + std::to_string(port) + ": " + error);
+  }
+  port_ = ntohs(address.sin_port);
+}
+
+DistributedCoordinator::~DistributedCoordinator() {
+  for (Worker& worker : workers_) {
+    if (worker.socket >= 0) {
+      close(worker.socket);
+    }
+  }
+  close(listen_socket_);
+}
+
+uint16_t DistributedCoordinator::Port() const {
+  return port_;
+}
+
+size_t DistributedCoordinator::ReissuedLeases() const {
+  return reissued_leases_;
+}
+
+TestResults DistributedCoordinator::Run(vector<string> suite_labels) {
+  if (suite_labels.empty()) {
+    suite_labels = RegisteredDistributedSuites();
+  }
+  pending_leases_.clear();
+  remaining_rows_ = 0;
+  results_ = TestResults();
+  {
+    DistributedSuites& registry = GetDistributedSuites();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const string& suite_label : suite_labels) {
+      auto suite = registry.suites.find(suite_label);
+      if (suite == registry.suites.end()) {
+        throw std::runtime_error(suite_label + " is not registered as a distributed suite.");
+      }
+      size_t row_count = suite->second.row_count;
+      for (size_t first_row = 0; first_row < row_count; first_row += rows_per_lease_) {
+        pending_leases_.push_back(
+            {next_lease_id_++, suite_label, first_row, std::min(rows_per_lease_, row_count - first_row), 0});
+      }
+      remaining_rows_ += row_count;
+    }
+  }
+
+  bool has_had_workers = false;
+  string not_run_reason = "every worker disconnected.";
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while (remaining_rows_ > 0) {
+    // Step 1: Give a lease to every idle worker.
+    for (Worker& worker : workers_) {
+      if (worker.socket < 0 || !worker.is_ready || worker.lease.has_value() || pending_leases_.empty()) {
+        continue;
+      }
+      worker.lease = pending_leases_.front();
+      pending_leases_.pop_front();
+      worker.lease_start = std::chrono::steady_clock::now();
+      const Lease& lease = *worker.lease;
+      string header = "LEASE " + std::to_string(lease.id) + " " + std::to_string(lease.first_row) + " " +
+                      std::to_string(lease.row_count);
+      if (!SendAll(worker.socket, MakeMessage(header, lease.suite_label))) {
+        Disconnect(worker);
+      }
+    }
+
+    // Step 2: Wait for new workers and messages.
+    vector<pollfd> poll_fds = {{listen_socket_, POLLIN, 0}};
+    for (const Worker& worker : workers_) {
+      poll_fds.push_back({worker.socket, POLLIN, 0});
+    }
+    if (poll(poll_fds.data(), poll_fds.size(), kPollIntervalMilliseconds) < 0 && errno != EINTR) {
+      throw std::runtime_error("Unable to wait for workers: " + string(strerror(errno)));
+    }
+
+    // Step 3: Handle messages from workers.
+    for (size_t index = 0; index < workers_.size(); index++) {
+      Worker& worker = workers_[index];
+      if (worker.socket < 0 || poll_fds[index + 1].revents == 0) {
+        continue;
+      }
+      if (!Receive(worker.socket, worker.input)) {
+        Disconnect(worker);
+        continue;
+      }
+      try {
+        while (std::optional<Message> message = TakeMessage(worker.input)) {
+          if (message->fields[0] == "READY") {
+            worker.is_ready = true;
+          } else if (message->fields[0] == "RESULT" && message->fields.size() == 3 && worker.lease.has_value() &&
+                     worker.lease->id == std::stoull(message->fields[1])) {
+            std::istringstream payload(message->payload);
+            results_ += ReadTestResults(payload);
+            remaining_rows_ -= worker.lease->row_count;
+            worker.lease = std::nullopt;
+          }
+        }
+      } catch (const std::exception&) {
+        // A worker that sends something we can not read is treated like one that died.
+        Disconnect(worker);
+      }
+    }
+
+    // Step 4: Take leases back from workers that have held them too long.
+    if (lease_timeout_.count() > 0) {
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      for (Worker& worker : workers_) {
+        if (worker.socket >= 0 && worker.lease.has_value() && now - worker.lease_start > lease_timeout_) {
+          Disconnect(worker);
+        }
+      }
+    }
+    workers_.erase(std::remove_if(workers_.begin(),
+                                  workers_.end(),
+                                  [](const Worker& worker) { return worker.socket < 0; }),
+                   workers_.end());
+
+    // Step 5: Accept new workers.
+    if (poll_fds[0].revents != 0) {
+      int worker_socket;
+      while ((worker_socket = accept4(listen_socket_, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+        workers_.push_back({worker_socket, "", false, std::nullopt, {}});
+        has_had_workers = true;
+      }
+    }
+
+    // Step 6: Stop if every worker has died and no new one is waiting to connect.
+    if (has_had_workers && workers_.empty()) {
+      pollfd listen_fd = {listen_socket_, POLLIN, 0};
+      if (poll(&listen_fd, 1, kPollIntervalMilliseconds) == 0) {
+        break;
+      }
+    }
+
+    // Step 7: Stop if no worker has connected within the connect timeout.
+    if (!has_had_workers && connect_timeout_.count() > 0 &&
+        std::chrono::steady_clock::now() - start >= connect_timeout_) {
+      not_run_reason = "no worker connected within " + FormatDuration(connect_timeout_) + ".";
+      break;
+    }
+  }
+
+  for (const Lease& lease : pending_leases_) {
+    for (size_t row = lease.first_row; row < lease.first_row + lease.row_count; row++) {
+      results_.Error(lease.suite_label + " row " + std::to_string(row) + " was not run because " + not_run_reason);
+    }
+  }
+  pending_leases_.clear();
+  for (Worker& worker : workers_) {
+    SendAll(worker.socket, MakeMessage("DONE"));
+    close(worker.socket);
+  }
+  workers_.clear();
+  return std::move(results_);
+}
+
+void DistributedCoordinator::Disconnect(Worker& worker) {
+  if (worker.lease.has_value()) {
+    const Lease& lease = *worker.lease;
+    const size_t attempts = lease.attempts + 1;
+    if (lease.row_count == 1 && attempts >= max_attempts_) {
+      results_.Error(TestErrorKind::kCrashed,
+                     lease.suite_label + " row " + std::to_string(lease.first_row) + " was leased to " +
+                         std::to_string(attempts) + " workers that all disconnected or timed out.");
+      remaining_rows_--;
+    } else {
+      // Reissue each row under a new id so a row that kills its worker can not take the rest of the lease with it, and
+      // a late result from this worker is ignored.
+      for (size_t row = lease.first_row + lease.row_count; row > lease.first_row; row--) {
+        pending_leases_.push_front({next_lease_id_++, lease.suite_label, row - 1, 1, attempts});
+      }
+      reissued_leases_++;
+    }
+    worker.lease = std::nullopt;
+  }
+  close(worker.socket);
+  worker.socket = -1;
+}
+// End DistributedCoordinator methods
+
+size_t RunDistributedWorker(const string& host, uint16_t port) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  int error = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+  if (error != 0) {
+    throw std::runtime_error("Unable to resolve coordinator " + host + ": " + gai_strerror(error));
+  }
+  int coordinator = -1;
+  for (addrinfo* address = addresses; address != nullptr && coordinator < 0; address = address->ai_next) {
+    coordinator = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+    if (coordinator >= 0 && connect(coordinator, address->ai_addr, address->ai_addrlen) != 0) {
+      close(coordinator);
+      coordinator = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (coordinator < 0) {
+    throw std::runtime_error("Unable to connect to coordinator " + host + ":" + std::to_string(port) + ".");
+  }
+
+  size_t lease_count = 0;
+  string input;
+  bool is_connected = SendAll(coordinator, MakeMessage("READY"));
+  while (is_connected) {
+    std::optional<Message> message;
+    size_t first_row = 0;
+    size_t row_count = 0;
+    try {
+      message = TakeMessage(input);
+      if (message.has_value() && message->fields[0] == "LEASE" && message->fields.size() == 5) {
+        first_row = std::stoull(message->fields[2]);
+        row_count = std::stoull(message->fields[3]);
+      }
+    } catch (const std::exception&) {
+      // A coordinator that sends something we can not read is treated like one that hung up.
+      break;
+    }
+    if (!message.has_value()) {
+      is_connected = Receive(coordinator, input);
+      continue;
+    }
+    if (message->fields[0] == "DONE") {
+      break;
+    }
+    if (message->fields[0] == "LEASE" && message->fields.size() == 5) {
+      TestResults results = ExecuteDistributedRows(message->payload, first_row, row_count);
+      std::ostringstream payload;
+      WriteTestResults(payload, results);
+      is_connected = SendAll(coordinator, MakeMessage("RESULT " + message->fields[1], payload.str()));
+      lease_count++;
+    }
+  }
+  close(coordinator);
+  return lease_count;
+}
+
+}  // End namespace TinyTest
@@ -0,0 +1,194 @@
+#ifndef TinyTest__distributed_h__
+#define TinyTest__distributed_h__
+/***************************************************************************************
+ * @file distributed.h                                                                 *
+ *                                                                                     *
+ * @brief Defines a coordinator and workers for running suites across many machines.  *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup distributed Distributed Execution
+///
+/// A DistributedCoordinator splits registered suites into leases of consecutive rows and hands them to workers that
+/// connect to it over TCP. Workers run each lease with RunDistributedWorker and send the TestResults back, which the
+/// coordinator merges. The coordinator and the workers are usually the same test binary so every process has the same
+/// suites registered. If a worker disconnects, or holds a lease longer than the lease timeout, each row of its lease is
+/// given to another worker in a lease of its own. A row that loses max_attempts workers is recorded as a kCrashed error
+/// instead of being given out again. If every worker is lost, or no worker connects within the connect timeout, the
+/// rows that were not run are recorded as errors.
+///
+/// Messages are a header line of space separated fields ending with the size of a payload that follows the line.
+/// - READY 0: A worker is ready for a lease.
+/// - LEASE lease_id first_row row_count size: Run the rows of the suite whose label is the payload.
+/// - RESULT lease_id size: The payload is the results of the lease written by WriteTestResults.
+/// - DONE 0: There is no more work. The worker should exit.
+
+/// @addtogroup distributed
+/// @{
+
+/// @brief This is a type that represents a function that runs some of the rows of a suite.
+///
+/// It is called with the index of the first row to run and the number of rows to run.
+using DistributedSuiteRunner = std::function<TestResults(size_t first_row, size_t row_count)>;
+
+/// @brief Registers a suite so it can be run by a DistributedCoordinator and its workers.
+///
+/// Registering a suite with the same label again replaces it.
+/// @param suite_label The label of the suite.
+/// @param row_count The number of rows in the suite.
+/// @param runner The function that runs a range of rows.
+void RegisterDistributedSuite(const std::string& suite_label, size_t row_count, DistributedSuiteRunner runner);
+
+/// @brief Registers a suite of TestTuples so it can be run by a DistributedCoordinator and its workers.
+///
+/// before_all and after_all run once per lease on the worker that runs it.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label of the suite.
+/// @param function_to_test The function to be tested.
+/// @param tests The test runs. These are copied and kept for the life of the process.
+/// @param suite_Compare A function used to Compare the expected and actual test results.
+/// @param before_all This is called before the rows of each lease are run.
+/// @param after_all This is called after the rows of each lease are run.
+template <typename TResult, typename... TInputParams>
+void RegisterDistributedSuite(const std::string& suite_label,
+                              std::function<TResult(TInputParams...)> function_to_test,
+                              std::vector<TestTuple<TResult, TInputParams...>> tests,
+                              MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt,
+                              MaybeTestConfigureFunction before_all = std::nullopt,
+                              MaybeTestConfigureFunction after_all = std::nullopt);
+
+/// @brief Gets the labels of every registered suite.
+/// @return The labels in sorted order.
+std::vector<std::string> RegisteredDistributedSuites();
+
+/// @brief Runs some rows of a registered suite in this process.
+/// @param suite_label The label of the suite.
+/// @param first_row The index of the first row to run.
+/// @param row_count The number of rows to run.
+/// @return The results of the rows. If the suite is not registered this is a single error.
+TestResults ExecuteDistributedRows(const std::string& suite_label, size_t first_row, size_t row_count);
+
+/// @brief Hands out leases of registered suites to workers and merges their results.
+class DistributedCoordinator {
+ public:
+  /// @brief Starts listening for workers.
+  /// @param host The address to listen on. Use "0.0.0.0" to accept workers from other machines.
+  /// @param port The port to listen on or 0 to pick any free port.
+  /// @param rows_per_lease The most rows in each lease.
+  /// @param lease_timeout How long a worker may hold a lease before it is given to another worker. Zero means forever.
+  /// @param max_attempts The most workers a row may be leased to that disconnect or time out before it is recorded as
+  /// crashed.
+  /// @param connect_timeout How long Run waits for the first worker to connect. Zero means forever.
+  /// @throws std::runtime_error if the socket can not be created.
+  explicit DistributedCoordinator(const std::string& host = "127.0.0.1",
+                                  uint16_t port = 0,
+                                  size_t rows_per_lease = 64,
+                                  std::chrono::milliseconds lease_timeout = std::chrono::milliseconds(0),
+                                  size_t max_attempts = 3,
+                                  std::chrono::milliseconds connect_timeout = std::chrono::minutes(1));
+
+  DistributedCoordinator(const DistributedCoordinator& other) = delete;
+  DistributedCoordinator& operator=(const DistributedCoordinator& other) = delete;
+
+  /// @brief Stops listening and disconnects any remaining workers.
+  ~DistributedCoordinator();
+
+  /// @brief Getter for the port workers should connect to.
+  /// @return The port.
+  uint16_t Port() const;
+
+  /// @brief Getter for the number of leases whose rows were given to other workers because their worker died or timed
+  /// out.
+  /// @return The number of reissued leases.
+  size_t ReissuedLeases() const;
+
+  /// @brief Runs the suites on the connected workers and waits until every row has been run.
+  ///
+  /// Workers may connect before or during the run. When the run finishes every connected worker is told it is done. If
+  /// every worker that connected has disconnected and no new one is waiting, or no worker connects within the connect
+  /// timeout, the run stops and each row that was not run is recorded as an error.
+  /// @param suite_labels The suites to run. If this is empty every registered suite is run.
+  /// @return The merged results of every lease.
+  /// @throws std::runtime_error if a suite is not registered.
+  TestResults Run(std::vector<std::string> suite_labels = {});
+
+ private:
+  struct Lease {
+    uint64_t id;
+    std::string suite_label;
+    size_t first_row;
+    size_t row_count;
+    size_t attempts;
+  };
+
+  struct Worker {
+    int socket;
+    std::string input;
+    bool is_ready;
+    std::optional<Lease> lease;
+    std::chrono::steady_clock::time_point lease_start;
+  };
+
+  void Disconnect(Worker& worker);
+
+  std::chrono::milliseconds connect_timeout_;
+  int listen_socket_;
+  std::chrono::milliseconds lease_timeout_;
+  size_t max_attempts_;
+  uint64_t next_lease_id_;
+  std::deque<Lease> pending_leases_;
+  uint16_t port_;
+  size_t reissued_leases_;
+  size_t remaining_rows_;
+  TestResults results_;
+  size_t rows_per_lease_;
+  std::vector<Worker> workers_;
+};
+
+/// @brief Connects to a DistributedCoordinator and runs leases until it says there is no more work.
+/// @param host The host name or address of the coordinator.
+/// @param port The port of the coordinator.
+/// @return The number of leases this worker ran.
+/// @throws std::runtime_error if the coordinator can not be reached. If the coordinator sends a message that can not be
+/// read the connection is dropped instead.
+size_t RunDistributedWorker(const std::string& host, uint16_t port);
+
+template <typename TResult, typename... TInputParams>
+void RegisterDistributedSuite(const std::string& suite_label,
+                              std::function<TResult(TInputParams...)> function_to_test,
+                              std::vector<TestTuple<TResult, TInputParams...>> tests,
+                              MaybeTestCompareFunction<TResult> suite_Compare,
+                              MaybeTestConfigureFunction before_all,
+                              MaybeTestConfigureFunction after_all) {
+  auto rows = std::make_shared<const std::vector<TestTuple<TResult, TInputParams...>>>(std::move(tests));
+  RegisterDistributedSuite(suite_label, rows->size(), [=](size_t first_row, size_t row_count) {
+    first_row = std::min(first_row, rows->size());
+    row_count = std::min(row_count, rows->size() - first_row);
+    std::vector<TestTuple<TResult, TInputParams...>> lease_rows(rows->begin() + first_row,
+                                                               rows->begin() + first_row + row_count);
+    return ExecuteSuiteTests(suite_label, function_to_test, lease_rows, suite_Compare, before_all, after_all, true);
+  });
+}
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__distributed_h__)
@@ -0,0 +1,209 @@
+/***************************************************************************************
+ * @file distributed_test.cpp                                                          *
+ *                                                                                     *
+ * @brief Tests for running suites on distributed workers.                             *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "distributed.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::string;
+using std::vector;
+using testing::Eq;
+using testing::Gt;
+using TinyTest::DistributedCoordinator;
+using TinyTest::ExecuteDistributedRows;
+using TinyTest::MakeTest;
+using TinyTest::RegisterDistributedSuite;
+using TinyTest::RunDistributedWorker;
+using TinyTest::TestErrorKind;
+using TinyTest::TestResults;
+using TinyTest::TestTuple;
+
+// Registers a suite that doubles its input where row 7 expects the wrong value.
+void RegisterDoubleSuite(const string& suite_label) {
+  vector<TestTuple<int, int>> tests;
+  for (int row = 0; row < 10; row++) {
+    tests.push_back(MakeTest("Row " + std::to_string(row), row == 7 ? -1 : row * 2, make_tuple(row)));
+  }
+  RegisterDistributedSuite(suite_label, function<int(int)>([](int value) { return value * 2; }), tests);
+}
+
+// Connects to the coordinator, takes one lease, and then either hangs up or holds on to it without answering.
+int ConnectAndTakeALease(uint16_t port) {
+  int coordinator = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+  EXPECT_THAT(connect(coordinator, reinterpret_cast<sockaddr*>(&address), sizeof(address)), Eq(0));
+  string ready = "READY 0\n";
+  EXPECT_THAT(send(coordinator, ready.data(), ready.size(), MSG_NOSIGNAL), Eq(ready.size()));
+  char buffer[256];
+  EXPECT_THAT(recv(coordinator, buffer, sizeof(buffer), 0), Gt(0));
+  return coordinator;
+}
+
+TEST(ExecuteDistributedRows, ShouldRunOnlyTheRowsInTheLease) {
+  RegisterDoubleSuite("Distributed Rows");
+  TestResults results;
+  function<void()> wrapper = [&]() { results = ExecuteDistributedRows("Distributed Rows", 6, 3); };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Total(), Eq(3));
+  EXPECT_THAT(results.Passed(), Eq(2));
+  EXPECT_THAT(results.FailureMessages(), Eq(vector<string>({"Distributed Rows::Row 7 expected: -1, actual: 14"})));
+}
+
+TEST(ExecuteDistributedRows, ShouldReportSuitesThatAreNotRegistered) {
+  TestResults results = ExecuteDistributedRows("Not Registered", 0, 1);
+  EXPECT_THAT(results.ErrorMessages(),
+              Eq(vector<string>({"Not Registered is not registered as a distributed suite."})));
+}
+
+TEST(DistributedCoordinator, ShouldMergeResultsFromManyWorkers) {
+  RegisterDoubleSuite("Distributed Many");
+  DistributedCoordinator coordinator("127.0.0.1", 0, 3);
+  vector<size_t> lease_counts(3);
+  vector<std::thread> workers;
+  for (size_t index = 0; index < lease_counts.size(); index++) {
+    workers.emplace_back([&lease_counts, index, &coordinator]() {
+      lease_counts[index] = RunDistributedWorker("127.0.0.1", coordinator.Port());
+    });
+  }
+  TestResults results = coordinator.Run({"Distributed Many"});
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  EXPECT_THAT(results.Total(), Eq(10));
+  EXPECT_THAT(results.Passed(), Eq(9));
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.FailureMessages(), Eq(vector<string>({"Distributed Many::Row 7 expected: -1, actual: 14"})));
+  EXPECT_THAT(lease_counts[0] + lease_counts[1] + lease_counts[2], Eq(4));
+  EXPECT_THAT(coordinator.ReissuedLeases(), Eq(0));
+}
+
+TEST(DistributedCoordinator, ShouldReissueTheLeaseOfAWorkerThatDies) {
+  RegisterDoubleSuite("Distributed Dies");
+  DistributedCoordinator coordinator("127.0.0.1", 0, 5);
+  std::thread workers([&coordinator]() {
+    close(ConnectAndTakeALease(coordinator.Port()));
+    RunDistributedWorker("127.0.0.1", coordinator.Port());
+  });
+  TestResults results = coordinator.Run({"Distributed Dies"});
+  workers.join();
+
+  EXPECT_THAT(results.Total(), Eq(10));
+  EXPECT_THAT(results.Passed(), Eq(9));
+  EXPECT_THAT(coordinator.ReissuedLeases(), Eq(1));
+}
+
+TEST(DistributedCoordinator, ShouldReissueTheLeaseOfAWorkerThatHangs) {
+  RegisterDoubleSuite("Distributed Hangs");
+  DistributedCoordinator coordinator("127.0.0.1", 0, 5, std::chrono::milliseconds(200));
+  int hung_worker = -1;
+  std::thread workers([&coordinator, &hung_worker]() {
+    hung_worker = ConnectAndTakeALease(coordinator.Port());
+    RunDistributedWorker("127.0.0.1", coordinator.Port());
+  });
+  TestResults results = coordinator.Run({"Distributed Hangs"});
+  workers.join();
+  close(hung_worker);
+
+  EXPECT_THAT(results.Total(), Eq(10));
+  EXPECT_THAT(results.Passed(), Eq(9));
+  EXPECT_THAT(coordinator.ReissuedLeases(), Eq(1));
+}
+
+TEST(DistributedCoordinator, ShouldRecordRowsThatKillEveryWorkerAsCrashed) {
+  RegisterDistributedSuite("Distributed Crashes", 1, [](size_t, size_t) { return TestResults().Pass(); });
+  DistributedCoordinator coordinator("127.0.0.1", 0, 5, std::chrono::milliseconds(0), 2);
+  std::thread workers([&coordinator]() {
+    close(ConnectAndTakeALease(coordinator.Port()));
+    close(ConnectAndTakeALease(coordinator.Port()));
+  });
+  TestResults results = coordinator.Run({"Distributed Crashes"});
+  workers.join();
+
+  EXPECT_THAT(results.Total(), Eq(0));
+  EXPECT_THAT(results.Errors(TestErrorKind::kCrashed), Eq(1));
+  EXPECT_THAT(results.ErrorMessages(),
+              Eq(vector<string>(
+                  {"Distributed Crashes row 0 was leased to 2 workers that all disconnected or timed out."})));
+  EXPECT_THAT(coordinator.ReissuedLeases(), Eq(1));
+}
+
+TEST(DistributedCoordinator, ShouldStopWhenEveryWorkerIsGone) {
+  RegisterDoubleSuite("Distributed Gone");
+  DistributedCoordinator coordinator("127.0.0.1", 0, 5);
+  std::thread workers([&coordinator]() { close(ConnectAndTakeALease(coordinator.Port())); });
+  TestResults results = coordinator.Run({"Distributed Gone"});
+  workers.join();
+
+  EXPECT_THAT(results.Total(), Eq(0));
+  EXPECT_THAT(results.Errors(), Eq(10));
+  EXPECT_THAT(results.ErrorMessages()[0], Eq("Distributed Gone row 0 was not run because every worker disconnected."));
+}
+
+TEST(DistributedCoordinator, ShouldStopWhenNoWorkerConnects) {
+  RegisterDoubleSuite("Distributed Lonely");
+  DistributedCoordinator coordinator(
+      "127.0.0.1", 0, 5, std::chrono::milliseconds(0), 3, std::chrono::milliseconds(100));
+  TestResults results = coordinator.Run({"Distributed Lonely"});
+
+  EXPECT_THAT(results.Total(), Eq(0));
+  EXPECT_THAT(results.Errors(), Eq(10));
+  EXPECT_THAT(results.ErrorMessages()[0],
+              Eq("Distributed Lonely row 0 was not run because no worker connected within 100.0 ms."));
+}
+
+TEST(DistributedCoordinator, ShouldThrowForSuitesThatAreNotRegistered) {
+  DistributedCoordinator coordinator;
+  EXPECT_THROW(coordinator.Run({"Not Registered"}), std::runtime_error);
+}
+
+TEST(RunDistributedWorker, ShouldHangUpOnMessagesItCanNotRead) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+  socklen_t address_size = sizeof(address);
+  ASSERT_THAT(bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)), Eq(0));
+  ASSERT_THAT(listen(listener, 1), Eq(0));
+  ASSERT_THAT(getsockname(listener, reinterpret_cast<sockaddr*>(&address), &address_size), Eq(0));
+  size_t lease_count = 1;
+  std::thread worker(
+      [&lease_count, &address]() { lease_count = RunDistributedWorker("127.0.0.1", ntohs(address.sin_port)); });
+  int connection = accept(listener, nullptr, nullptr);
+  char buffer[256];
+  EXPECT_THAT(recv(connection, buffer, sizeof(buffer), 0), Gt(0));
+  string lease = "LEASE 1 first 5 4\nRows";
+  EXPECT_THAT(send(connection, lease.data(), lease.size(), MSG_NOSIGNAL), Eq(lease.size()));
+  worker.join();
+
+  EXPECT_THAT(lease_count, Eq(0));
+  EXPECT_THAT(recv(connection, buffer, sizeof(buffer), 0), Eq(0));
+  close(connection);
+  close(listener);
+}
+}  // End namespace
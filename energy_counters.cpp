@@ -0,0 +1,126 @@
+/***************************************************************************************
+ * @file energy_counters.cpp                                                           *
+ *                                                                                     *
+ * @brief Defines counters for the energy used by the CPU while a test runs.           *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "energy_counters.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+namespace {
+using std::string;
+using std::vector;
+
+uint64_t ReadMicrojoules(const string& path) {
+  std::optional<string> line = ReadFirstLine(path);
+  if (!line.has_value()) {
+    throw std::runtime_error("Unable to read " + path);
+  }
+  return std::stoull(*line);
+}
+
+// Gets the names of the RAPL zones, like intel-rapl:0 and intel-rapl:0:0, in order. Every zone is listed at the top
+// level of the powercap directory including the subzones. The intel-rapl-mmio zones are left out because they count
+// the same packages through another interface.
+vector<string> ListRaplZones(const string& powercap_directory) {
+  vector<string> zones;
+  DIR* directory = opendir(powercap_directory.c_str());
+  if (directory == nullptr) {
+    return zones;
+  }
+  while (dirent* entry = readdir(directory)) {
+    string name = entry->d_name;
+    if (name.find("rapl") != string::npos && name.find(':') != string::npos && name.find("mmio") == string::npos) {
+      zones.push_back(name);
+    }
+  }
+  closedir(directory);
+  std::sort(zones.begin(), zones.end());
+  return zones;
+}
+}  // End namespace
+
+// Begin EnergyCounters methods
+EnergyCounters::EnergyCounters(const string& powercap_directory) : has_core_zones_(false) {
+  bool has_package_zones = false;
+  for (const string& zone_name : ListRaplZones(powercap_directory)) {
+    string zone_directory = powercap_directory + "/" + zone_name;
+    std::optional<string> name = ReadFirstLine(zone_directory + "/name");
+    if (!name.has_value()) {
+      continue;
+    }
+    bool is_package = name->rfind("package-", 0) == 0;
+    if (!is_package && *name != "core") {
+      continue;
+    }
+    string max_energy_range_path = zone_directory + "/max_energy_range_uj";
+    std::optional<string> max_energy_range = ReadFirstLine(max_energy_range_path);
+    Zone zone = {zone_directory + "/energy_uj", 0, is_package, 0};
+    try {
+      zone.max_energy_range_uj = max_energy_range.has_value() ? std::stoull(*max_energy_range) : 0;
+    } catch (const std::logic_error&) {
+      zone.max_energy_range_uj = 0;
+    }
+    // Stop needs the range to measure a counter that wrapped after Start.
+    if (zone.max_energy_range_uj == 0) {
+      throw std::runtime_error("Unable to read " + max_energy_range_path +
+                               ". Energy can not be measured across a counter wrap without it.");
+    }
+    if (!ReadFirstLine(zone.energy_path).has_value()) {
+      throw std::runtime_error("Unable to read " + zone.energy_path + ". It is only readable by root by default.");
+    }
+    has_package_zones = has_package_zones || is_package;
+    has_core_zones_ = has_core_zones_ || !is_package;
+    zones_.push_back(zone);
+  }
+  if (!has_package_zones) {
+    throw std::runtime_error("No RAPL package zones were found in " + powercap_directory + ".");
+  }
+}
+
+bool EnergyCounters::IsAvailable(const string& powercap_directory) {
+  try {
+    EnergyCounters counters(powercap_directory);
+    return true;
+  } catch (const std::exception& error) {
+    return false;
+  }
+}
+
+void EnergyCounters::Start() {
+  for (Zone& zone : zones_) {
+    zone.start_uj = ReadMicrojoules(zone.energy_path);
+  }
+}
+
+EnergyCounts EnergyCounters::Stop() {
+  uint64_t package_uj = 0;
+  uint64_t core_uj = 0;
+  for (const Zone& zone : zones_) {
+    uint64_t end_uj = ReadMicrojoules(zone.energy_path);
+    // The counter wraps to zero after max_energy_range_uj.
+    uint64_t used_uj =
+        end_uj >= zone.start_uj ? end_uj - zone.start_uj : zone.max_energy_range_uj - zone.start_uj + end_uj;
+    (zone.is_package ? package_uj : core_uj) += used_uj;
+  }
+  EnergyCounts counts = {package_uj / 1e6, std::nullopt};
+  if (has_core_zones_) {
+    counts.core_joules = core_uj / 1e6;
+  }
+  return counts;
+}
+// End EnergyCounters methods
+
+}  // End namespace TinyTest
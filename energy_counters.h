@@ -0,0 +1,77 @@
+#ifndef TinyTest__energy_counters_h__
+#define TinyTest__energy_counters_h__
+/***************************************************************************************
+ * @file energy_counters.h                                                             *
+ *                                                                                     *
+ * @brief Defines counters for the energy used by the CPU while a test runs.           *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace TinyTest {
+
+/// @defgroup energy_counters Energy Counters
+///
+/// EnergyCounters reads the RAPL energy counters the Linux powercap interface exposes in /sys/class/powercap. The
+/// intel-rapl zones are also used for AMD processors by recent kernels. The package zones count the energy of each
+/// whole processor and the core zones count the energy of its cores.
+///
+/// The counters cover the whole package, not just the calling thread, so anything else running on the machine is
+/// counted too. They are updated about once a millisecond, so measurements should be much longer than that. Since
+/// Linux 5.10 energy_uj is only readable by root unless its permissions are changed.
+
+/// @addtogroup energy_counters
+/// @{
+
+/// @brief The energy used between EnergyCounters::Start and EnergyCounters::Stop.
+struct EnergyCounts {
+  /// @brief The energy used by every package together in joules.
+  double package_joules;
+  /// @brief The energy used by the cores of every package together in joules or nullopt if there are no core zones.
+  std::optional<double> core_joules;
+};
+
+/// @brief Measures the energy used by the CPU packages and cores between Start and Stop.
+class EnergyCounters {
+ public:
+  /// @brief Finds the package and core zones.
+  /// @param powercap_directory The directory with the powercap zones.
+  /// @throws std::runtime_error if there are no package zones or the counters or ranges of a zone can not be read.
+  explicit EnergyCounters(const std::string& powercap_directory = "/sys/class/powercap");
+
+  /// @brief Checks if energy can be measured on this machine.
+  /// @param powercap_directory The directory with the powercap zones.
+  /// @return True if EnergyCounters can be created.
+  static bool IsAvailable(const std::string& powercap_directory = "/sys/class/powercap");
+
+  /// @brief Reads the counters to start measuring.
+  /// @throws std::runtime_error if a counter can not be read.
+  void Start();
+
+  /// @brief Reads the counters again.
+  /// @return The energy used since Start.
+  /// @throws std::runtime_error if a counter can not be read.
+  EnergyCounts Stop();
+
+ private:
+  struct Zone {
+    std::string energy_path;
+    uint64_t max_energy_range_uj;
+    bool is_package;
+    uint64_t start_uj;
+  };
+
+  std::vector<Zone> zones_;
+  bool has_core_zones_;
+};
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__energy_counters_h__)
@@ -0,0 +1,111 @@
+/***************************************************************************************
+ * @file energy_counters_test.cpp                                                      *
+ *                                                                                     *
+ * @brief Tests for counters for the energy used by the CPU while a test runs.         *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "energy_counters.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+using std::string;
+using testing::DoubleEq;
+using testing::Eq;
+using testing::HasSubstr;
+using TinyTest::EnergyCounters;
+using TinyTest::EnergyCounts;
+
+void WriteFile(const string& path, const string& contents) {
+  std::ofstream file(path);
+  file << contents << std::endl;
+}
+
+// Makes an empty powercap directory for a test.
+string MakePowercapDirectory(const string& test_name) {
+  string directory = testing::TempDir() + "energy_counters_test_" + test_name + "_" + std::to_string(getpid());
+  mkdir(directory.c_str(), 0755);
+  return directory;
+}
+
+void AddZone(const string& powercap_directory, const string& zone, const string& name, uint64_t energy_uj) {
+  string zone_directory = powercap_directory + "/" + zone;
+  mkdir(zone_directory.c_str(), 0755);
+  WriteFile(zone_directory + "/name", name);
+  WriteFile(zone_directory + "/energy_uj", std::to_string(energy_uj));
+  WriteFile(zone_directory + "/max_energy_range_uj", "1000000000");
+}
+
+TEST(EnergyCounters, ShouldSumThePackagesAndCores) {
+  string directory = MakePowercapDirectory("sum");
+  AddZone(directory, "intel-rapl:0", "package-0", 5000000);
+  AddZone(directory, "intel-rapl:0:0", "core", 1000000);
+  AddZone(directory, "intel-rapl:0:1", "uncore", 0);
+  AddZone(directory, "intel-rapl:1", "package-1", 999000000);
+  AddZone(directory, "intel-rapl-mmio:0", "package-0", 0);
+  ASSERT_TRUE(EnergyCounters::IsAvailable(directory));
+
+  EnergyCounters counters(directory);
+  counters.Start();
+  WriteFile(directory + "/intel-rapl:0/energy_uj", "7500000");
+  WriteFile(directory + "/intel-rapl:0:0/energy_uj", "1250000");
+  WriteFile(directory + "/intel-rapl:0:1/energy_uj", "9000000");
+  // Package 1 wraps around.
+  WriteFile(directory + "/intel-rapl:1/energy_uj", "500000");
+  WriteFile(directory + "/intel-rapl-mmio:0/energy_uj", "9000000");
+  EnergyCounts counts = counters.Stop();
+
+  EXPECT_THAT(counts.package_joules, DoubleEq(2.5 + 1.5));
+  ASSERT_TRUE(counts.core_joules.has_value());
+  EXPECT_THAT(*counts.core_joules, DoubleEq(0.25));
+}
+
+TEST(EnergyCounters, ShouldLeaveOutCoresIfThereAreNoCoreZones) {
+  string directory = MakePowercapDirectory("no_cores");
+  AddZone(directory, "intel-rapl:0", "package-0", 0);
+  EnergyCounters counters(directory);
+  counters.Start();
+  EXPECT_THAT(counters.Stop().core_joules, Eq(std::nullopt));
+}
+
+TEST(EnergyCounters, ShouldThrowWithoutPackageZones) {
+  string directory = MakePowercapDirectory("empty");
+  EXPECT_FALSE(EnergyCounters::IsAvailable(directory));
+  try {
+    EnergyCounters counters(directory);
+    FAIL() << "Expected a std::runtime_error.";
+  } catch (const std::runtime_error& error) {
+    EXPECT_THAT(error.what(), HasSubstr("No RAPL package zones were found in "));
+  }
+}
+
+TEST(EnergyCounters, ShouldThrowWithoutTheMaxEnergyRangeOfAZone) {
+  string directory = MakePowercapDirectory("no_range");
+  AddZone(directory, "intel-rapl:0", "package-0", 0);
+  AddZone(directory, "intel-rapl:0:0", "core", 0);
+  std::remove((directory + "/intel-rapl:0:0/max_energy_range_uj").c_str());
+  EXPECT_FALSE(EnergyCounters::IsAvailable(directory));
+  try {
+    EnergyCounters counters(directory);
+    FAIL() << "Expected a std::runtime_error.";
+  } catch (const std::runtime_error& error) {
+    EXPECT_THAT(error.what(), HasSubstr("intel-rapl:0:0/max_energy_range_uj. Energy can not be measured across a "));
+  }
+
+  WriteFile(directory + "/intel-rapl:0:0/max_energy_range_uj", "");
+  EXPECT_FALSE(EnergyCounters::IsAvailable(directory));
+}
+}  // End namespace
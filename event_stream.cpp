@@ -0,0 +1,235 @@
+/***************************************************************************************
+ * @file event_stream.cpp                                                              *
+ *                                                                                     *
+ * @brief Defines a live stream of test events published over a Unix domain socket.    *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "event_stream.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace TinyTest {
+namespace {
+using std::string;
+
+// The most bytes we will hold for a subscriber that is not keeping up before dropping events for it.
+constexpr size_t kMaxPendingBytes = 1 << 16;
+
+// How long the publishing thread waits for events before checking for new subscribers.
+constexpr std::chrono::milliseconds kAcceptInterval(20);
+
+const char* EventName(TestEventType type) {
+  switch (type) {
+    case TestEventType::kSuiteBegin:
+      return "suite_begin";
+    case TestEventType::kSuiteEnd:
+      return "suite_end";
+    case TestEventType::kTestBegin:
+      return "test_begin";
+    case TestEventType::kTestEnd:
+      return "test_end";
+    case TestEventType::kTestThreadBegin:
+      return "test_thread_begin";
+    case TestEventType::kTestThreadEnd:
+      return "test_thread_end";
+  }
+  return "unknown";
+}
+
+const char* OutcomeName(TestOutcome outcome) {
+  switch (outcome) {
+    case TestOutcome::kPassed:
+      return "passed";
+    case TestOutcome::kFailed:
+      return "failed";
+    case TestOutcome::kSkipped:
+      return "skipped";
+  }
+  return "unknown";
+}
+}  // End namespace
+
+TestEventStream::TestEventStream(string socket_path, size_t max_queued_events)
+    : dropped_events_(0),
+      is_stopping_(false),
+      listen_socket_(-1),
+      listener_id_(0),
+      max_queued_events_(max_queued_events),
+      published_events_(0),
+      socket_path_(std::move(socket_path)),
+      subscriber_count_(0) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path_.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Event stream socket path is too long: " + socket_path_);
+  }
+  strncpy(address.sun_path, socket_path_.c_str(), sizeof(address.sun_path) - 1);
+  listen_socket_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_socket_ < 0) {
+    throw std::runtime_error("Unable to create event stream socket: " + string(strerror(errno)));
+  }
+  unlink(socket_path_.c_str());
+  if (bind(listen_socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(listen_socket_, 16) != 0) {
+    string error = strerror(errno);
+    close(listen_socket_);
+    throw std::runtime_error("Unable to listen on " + socket_path_ + ": " + error);
+  }
+  thread_ = std::thread(&TestEventStream::Run, this);
+  listener_id_ = AddTestEventListener([this](const TestEvent& event) { Enqueue(event); });
+}
+
+TestEventStream::~TestEventStream() {
+  RemoveTestEventListener(listener_id_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+  for (Subscriber& subscriber : subscribers_) {
+    close(subscriber.socket);
+  }
+  close(listen_socket_);
+  unlink(socket_path_.c_str());
+}
+
+uint64_t TestEventStream::DroppedEvents() const {
+  return dropped_events_;
+}
+
+uint64_t TestEventStream::PublishedEvents() const {
+  return published_events_;
+}
+
+const string& TestEventStream::SocketPath() const {
+  return socket_path_;
+}
+
+size_t TestEventStream::SubscriberCount() const {
+  return subscriber_count_;
+}
+
+string TestEventStream::ToJson(const TestEvent& event, int64_t timestamp_ns) {
+  std::ostringstream os;
+  os << "{\"event\":\"" << EventName(event.type) << "\",\"suite\":";
+  WriteJsonString(os, event.suite_label);
+  if (event.type == TestEventType::kTestBegin || event.type == TestEventType::kTestEnd) {
+    os << ",\"test\":";
+    WriteJsonString(os, event.test_label);
+  }
+  if (event.type == TestEventType::kTestEnd) {
+    os << ",\"outcome\":\"" << OutcomeName(event.outcome) << "\",\"error\":" << (event.has_error ? "true" : "false");
+  }
+  if (event.type == TestEventType::kTestEnd || event.type == TestEventType::kSuiteEnd) {
+    os << ",\"duration_ns\":" << event.duration.count();
+  }
+  os << ",\"timestamp_ns\":" << timestamp_ns << "}\n";
+  return os.str();
+}
+
+void TestEventStream::Enqueue(const TestEvent& event) {
+  // Nobody is listening so there is no point formatting the event. Thread events only say which thread runs a test
+  // so they are not streamed.
+  if (subscriber_count_ == 0 || event.type == TestEventType::kTestThreadBegin ||
+      event.type == TestEventType::kTestThreadEnd) {
+    return;
+  }
+  int64_t timestamp_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  string line = ToJson(event, timestamp_ns);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (events_.size() >= max_queued_events_) {
+      dropped_events_++;
+      return;
+    }
+    events_.push_back(std::move(line));
+    published_events_++;
+  }
+  changed_.notify_one();
+}
+
+void TestEventStream::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    changed_.wait_for(lock, kAcceptInterval, [this]() { return is_stopping_ || !events_.empty(); });
+    bool is_stopping = is_stopping_;
+    std::deque<string> events;
+    events.swap(events_);
+    lock.unlock();
+
+    AcceptSubscribers();
+    for (const string& line : events) {
+      for (Subscriber& subscriber : subscribers_) {
+        if (subscriber.pending.size() + line.size() > kMaxPendingBytes) {
+          dropped_events_++;
+        } else {
+          subscriber.pending += line;
+        }
+      }
+    }
+    for (Subscriber& subscriber : subscribers_) {
+      Flush(subscriber);
+    }
+    subscribers_.erase(std::remove_if(subscribers_.begin(),
+                                      subscribers_.end(),
+                                      [](const Subscriber& subscriber) { return subscriber.socket < 0; }),
+                       subscribers_.end());
+    subscriber_count_ = subscribers_.size();
+
+    if (is_stopping) {
+      return;
+    }
+    lock.lock();
+  }
+}
+
+void TestEventStream::AcceptSubscribers() {
+  while (true) {
+    int subscriber_socket = accept4(listen_socket_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (subscriber_socket < 0) {
+      return;
+    }
+    subscribers_.push_back({subscriber_socket, ""});
+  }
+}
+
+void TestEventStream::Flush(Subscriber& subscriber) {
+  size_t sent = 0;
+  while (sent < subscriber.pending.size()) {
+    ssize_t result = send(subscriber.socket,
+                          subscriber.pending.data() + sent,
+                          subscriber.pending.size() - sent,
+                          MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (result > 0) {
+      sent += result;
+    } else if (result < 0 && errno == EINTR) {
+      continue;
+    } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      // The subscriber went away.
+      close(subscriber.socket);
+      subscriber.socket = -1;
+      subscriber.pending.clear();
+      return;
+    }
+  }
+  subscriber.pending.erase(0, sent);
+}
+
+}  // End namespace TinyTest
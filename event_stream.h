@@ -0,0 +1,104 @@
+#ifndef TinyTest__event_stream_h__
+#define TinyTest__event_stream_h__
+/***************************************************************************************
+ * @file event_stream.h                                                                *
+ *                                                                                     *
+ * @brief Defines a live stream of test events published over a Unix domain socket.    *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @addtogroup test_events
+/// @{
+
+/// @brief Publishes every TestEvent as a line of JSON to subscribers connected to a Unix domain socket.
+///
+/// Each event is written as one JSON object per line (NDJSON) with the fields "event", "suite", "test", "outcome",
+/// "error", "duration_ns", and "timestamp_ns". Suite events leave out the test fields. Subscribers connect to the socket
+/// and read lines. Events are queued by the thread running the tests and written by a background thread using
+/// non-blocking sends. If the queue is full or a subscriber is not reading fast enough events are dropped instead of
+/// blocking the tests. Subscribers only ever see whole lines.
+class TestEventStream {
+ public:
+  /// @brief Starts listening on socket_path and publishing events.
+  /// @param socket_path The path of the Unix domain socket to create. Any existing file at this path is replaced.
+  /// @param max_queued_events The most events to queue before new events are dropped.
+  /// @throws std::runtime_error if the socket can not be created.
+  explicit TestEventStream(std::string socket_path, size_t max_queued_events = 4096);
+
+  TestEventStream(const TestEventStream& other) = delete;
+  TestEventStream& operator=(const TestEventStream& other) = delete;
+
+  /// @brief Stops publishing, disconnects every subscriber, and removes the socket.
+  ~TestEventStream();
+
+  /// @brief Getter for the number of events dropped because the queue was full or a subscriber was too slow.
+  ///
+  /// An event dropped for more than one subscriber is counted once per subscriber.
+  /// @return The number of dropped events.
+  uint64_t DroppedEvents() const;
+
+  /// @brief Getter for the number of events queued for publishing.
+  /// @return The number of queued events.
+  uint64_t PublishedEvents() const;
+
+  /// @brief Getter for the path of the socket.
+  /// @return The socket path.
+  const std::string& SocketPath() const;
+
+  /// @brief Getter for the number of connected subscribers.
+  /// @return The number of subscribers.
+  size_t SubscriberCount() const;
+
+  /// @brief Formats an event the way it is written to subscribers.
+  /// @param event The event to format.
+  /// @param timestamp_ns The time the event was published in nanoseconds since the Unix epoch.
+  /// @return The event as a single line of JSON including the trailing newline.
+  static std::string ToJson(const TestEvent& event, int64_t timestamp_ns);
+
+ private:
+  struct Subscriber {
+    int socket;
+    std::string pending;
+  };
+
+  void Enqueue(const TestEvent& event);
+  void Run();
+  void AcceptSubscribers();
+  void Flush(Subscriber& subscriber);
+
+  std::condition_variable changed_;
+  std::atomic<uint64_t> dropped_events_;
+  std::deque<std::string> events_;
+  bool is_stopping_;
+  int listen_socket_;
+  uint64_t listener_id_;
+  size_t max_queued_events_;
+  mutable std::mutex mutex_;
+  std::atomic<uint64_t> published_events_;
+  std::string socket_path_;
+  std::atomic<size_t> subscriber_count_;
+  // Subscribers are only touched by the publishing thread.
+  std::vector<Subscriber> subscribers_;
+  std::thread thread_;
+};
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__event_stream_h__)
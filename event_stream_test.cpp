@@ -0,0 +1,148 @@
+/***************************************************************************************
+ * @file event_stream_test.cpp                                                         *
+ *                                                                                     *
+ * @brief Tests for the live stream of test events.                                    *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "event_stream.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::string;
+using std::vector;
+using testing::Eq;
+using testing::Gt;
+using testing::HasSubstr;
+using testing::Lt;
+using TinyTest::ExecuteSuite;
+using TinyTest::InterceptCout;
+using TinyTest::MakeTest;
+using TinyTest::PublishTestEnd;
+using TinyTest::TestEvent;
+using TinyTest::TestEventStream;
+using TinyTest::TestEventType;
+using TinyTest::TestOutcome;
+
+string MakeSocketPath(const string& name) {
+  return "/tmp/tinytest_" + name + "_" + std::to_string(getpid()) + ".sock";
+}
+
+int Subscribe(const TestEventStream& stream) {
+  int subscriber = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, stream.SocketPath().c_str(), sizeof(address.sun_path) - 1);
+  EXPECT_THAT(connect(subscriber, reinterpret_cast<sockaddr*>(&address), sizeof(address)), Eq(0));
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (stream.SubscriberCount() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return subscriber;
+}
+
+// Reads lines until one contains stop_text or nothing arrives for a while.
+vector<string> ReadLines(int subscriber, const string& stop_text) {
+  vector<string> lines;
+  string buffer;
+  pollfd poll_fd = {subscriber, POLLIN, 0};
+  while (poll(&poll_fd, 1, 2000) > 0) {
+    char chunk[4096];
+    ssize_t size = read(subscriber, chunk, sizeof(chunk));
+    if (size <= 0) {
+      break;
+    }
+    buffer.append(chunk, size);
+    size_t end;
+    while ((end = buffer.find('\n')) != string::npos) {
+      lines.push_back(buffer.substr(0, end));
+      buffer.erase(0, end + 1);
+      if (lines.back().find(stop_text) != string::npos) {
+        return lines;
+      }
+    }
+  }
+  return lines;
+}
+
+TEST(TestEventStream, ShouldFormatTestEndEventsAsJson) {
+  TestEvent event = {
+      TestEventType::kTestEnd, "My \"Suite\"", "Row\n1", TestOutcome::kFailed, true, std::chrono::nanoseconds(42)};
+  EXPECT_THAT(TestEventStream::ToJson(event, 7),
+              Eq("{\"event\":\"test_end\",\"suite\":\"My \\\"Suite\\\"\",\"test\":\"Row\\n1\",\"outcome\":\"failed\","
+                 "\"error\":true,\"duration_ns\":42,\"timestamp_ns\":7}\n"));
+}
+
+TEST(TestEventStream, ShouldFormatSuiteBeginEventsAsJson) {
+  TestEvent event = {TestEventType::kSuiteBegin, "My Suite", "", TestOutcome::kPassed, false, {}};
+  EXPECT_THAT(TestEventStream::ToJson(event, 7), Eq("{\"event\":\"suite_begin\",\"suite\":\"My Suite\",\"timestamp_ns\":7}\n"));
+}
+
+TEST(TestEventStream, ShouldStreamEventsFromExecuteSuite) {
+  TestEventStream stream(MakeSocketPath("stream"));
+  int subscriber = Subscribe(stream);
+  ASSERT_THAT(stream.SubscriberCount(), Eq(1));
+
+  function<void()> wrapper = [&]() {
+    ExecuteSuite("My Suite",
+                 function<int(int)>([](int value) { return value + 1; }),
+                 {
+                     MakeTest("Passes", 2, make_tuple(1)),
+                     MakeTest("Fails", 3, make_tuple(1)),
+                 });
+  };
+  InterceptCout(wrapper);
+  vector<string> lines = ReadLines(subscriber, "suite_end");
+  close(subscriber);
+
+  ASSERT_THAT(lines.size(), Eq(6));
+  EXPECT_THAT(lines[0], HasSubstr("\"event\":\"suite_begin\",\"suite\":\"My Suite\""));
+  EXPECT_THAT(lines[1], HasSubstr("\"event\":\"test_begin\",\"suite\":\"My Suite\",\"test\":\"Passes\""));
+  EXPECT_THAT(lines[2], HasSubstr("\"test\":\"Passes\",\"outcome\":\"passed\",\"error\":false"));
+  EXPECT_THAT(lines[3], HasSubstr("\"event\":\"test_begin\",\"suite\":\"My Suite\",\"test\":\"Fails\""));
+  EXPECT_THAT(lines[4], HasSubstr("\"test\":\"Fails\",\"outcome\":\"failed\",\"error\":false"));
+  EXPECT_THAT(lines[5], HasSubstr("\"event\":\"suite_end\""));
+  EXPECT_THAT(stream.DroppedEvents(), Eq(0));
+}
+
+TEST(TestEventStream, ShouldDropEventsInsteadOfBlockingWhenASubscriberLags) {
+  TestEventStream stream(MakeSocketPath("lagging"), 64);
+  int subscriber = Subscribe(stream);
+  ASSERT_THAT(stream.SubscriberCount(), Eq(1));
+
+  auto start = std::chrono::steady_clock::now();
+  for (int index = 0; index < 200000; index++) {
+    PublishTestEnd("Lagging Suite", "Row " + std::to_string(index), TestOutcome::kPassed, false, {});
+  }
+  EXPECT_THAT(std::chrono::steady_clock::now() - start, Lt(std::chrono::seconds(10)));
+  EXPECT_THAT(stream.DroppedEvents(), Gt(0));
+
+  // Whatever did arrive is made of whole lines.
+  vector<string> lines = ReadLines(subscriber, "Row 199999");
+  close(subscriber);
+  ASSERT_THAT(lines.size(), Gt(0));
+  for (const string& line : lines) {
+    EXPECT_THAT(line.front(), Eq('{'));
+    EXPECT_THAT(line.back(), Eq('}'));
+  }
+}
+}  // End namespace
@@ -0,0 +1,357 @@
+/***************************************************************************************
+ * @file heap_profiler.cpp                                                             *
+ *                                                                                     *
+ * @brief Defines a sampling profiler for the allocations made by tests.               *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "heap_profiler.h"
+
+#include <cxxabi.h>
+#include <execinfo.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+namespace {
+using std::endl;
+using std::string;
+using std::vector;
+
+// The most frames recorded for a sample.
+constexpr int kMaxFrames = 64;
+
+// The frames of Allocate and operator new at the top of every recorded stack.
+constexpr int kSkippedFrames = 2;
+
+// The most frames printed for each site.
+constexpr size_t kPrintedFrames = 8;
+
+std::atomic<HeapProfiler*> active_profiler(nullptr);
+
+// The number of ProfiledScopes on this thread.
+thread_local int profiled_depth = 0;
+// True while this thread is recording a sample so the allocations made while recording are not sampled.
+thread_local bool is_recording = false;
+// The bytes this thread may allocate before the next sample. Zero means it has not been drawn yet.
+thread_local int64_t bytes_until_sample = 0;
+thread_local uint64_t random_state = 0;
+// The qualified label of the test running on this thread or empty if none is.
+thread_local string in_flight_test;
+
+// Draws the gap to the next sample from an exponential distribution with a mean of interval bytes.
+int64_t NextSampleGap(size_t interval) {
+  if (random_state == 0) {
+    random_state = reinterpret_cast<uintptr_t>(&random_state) ^ 0x9e3779b97f4a7c15ULL;
+  }
+  // xorshift64* keeps this allocation free and cheap.
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  double uniform = ((random_state * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+  return static_cast<int64_t>(-std::log(1 - uniform) * interval) + 1;
+}
+
+// Gets how many allocations of size bytes one sample stands for.
+double SampleWeight(double size, size_t interval) {
+  return 1 / (1 - std::exp(-size / interval));
+}
+
+// This is never inlined so the frames it and operator new add to every stack can be skipped.
+__attribute__((noinline)) void* Allocate(size_t size, size_t alignment, bool is_nothrow) {
+  HeapProfiler* profiler = active_profiler.load(std::memory_order_relaxed);
+  if (profiler != nullptr && profiled_depth > 0 && !is_recording) {
+    if (bytes_until_sample == 0) {
+      // This is the first profiled allocation on a thread other than the one that started the profiler.
+      bytes_until_sample = NextSampleGap(profiler->SamplingIntervalBytes());
+    }
+    bytes_until_sample -= static_cast<int64_t>(size);
+    if (bytes_until_sample <= 0) {
+      is_recording = true;
+      void* frames[kMaxFrames];
+      int frame_count = backtrace(frames, kMaxFrames);
+      int skipped = std::min(frame_count, kSkippedFrames);
+      try {
+        profiler->RecordSample(size, frames + skipped, frame_count - skipped);
+      } catch (const std::bad_alloc&) {
+        // The sample is lost but the allocation it was for can still be tried.
+      }
+      is_recording = false;
+    }
+  }
+  if (size == 0) {
+    size = 1;
+  }
+  while (true) {
+    void* memory = alignment > alignof(std::max_align_t)
+                       ? aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+                       : malloc(size);
+    if (memory != nullptr) {
+      return memory;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      if (is_nothrow) {
+        return nullptr;
+      }
+      throw std::bad_alloc();
+    }
+    if (is_nothrow) {
+      try {
+        handler();
+      } catch (const std::bad_alloc&) {
+        return nullptr;
+      }
+    } else {
+      handler();
+    }
+  }
+}
+
+// Turns a line from backtrace_symbols like "binary(_Z3Foov+0x1c) [0x401234]" into "binary(Foo()+0x1c) [0x401234]".
+string Demangle(const string& symbol) {
+  size_t name_start = symbol.find('(');
+  size_t name_end = symbol.find('+', name_start);
+  if (name_start == string::npos || name_end == string::npos || name_end == name_start + 1) {
+    return symbol;
+  }
+  int status = 0;
+  char* demangled =
+      abi::__cxa_demangle(symbol.substr(name_start + 1, name_end - name_start - 1).c_str(), nullptr, nullptr, &status);
+  if (status != 0 || demangled == nullptr) {
+    return symbol;
+  }
+  string result = symbol.substr(0, name_start + 1) + demangled + symbol.substr(name_end);
+  free(demangled);
+  return result;
+}
+
+string FormatBytes(double bytes) {
+  const char* unit = "B";
+  if (bytes >= 1 << 30) {
+    bytes /= 1 << 30;
+    unit = "GB";
+  } else if (bytes >= 1 << 20) {
+    bytes /= 1 << 20;
+    unit = "MB";
+  } else if (bytes >= 1 << 10) {
+    bytes /= 1 << 10;
+    unit = "KB";
+  }
+  char formatted[32];
+  snprintf(formatted, sizeof(formatted), "%.1f %s", bytes, unit);
+  return formatted;
+}
+
+// Makes a label safe to use as a file name.
+string FileNameFor(const string& qualified_test_label) {
+  string file_name = qualified_test_label;
+  for (char& c : file_name) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') {
+      c = '_';
+    }
+  }
+  return file_name + ".heap";
+}
+}  // End namespace
+
+// Begin HeapProfiler methods
+HeapProfiler::HeapProfiler(const HeapProfilerOptions& options) : listener_id_(0), options_(options) {
+  options_.sampling_interval_bytes = std::max<size_t>(options_.sampling_interval_bytes, 1);
+  // backtrace loads libgcc the first time it is called, which allocates.
+  void* frame;
+  backtrace(&frame, 1);
+  HeapProfiler* expected = nullptr;
+  if (!active_profiler.compare_exchange_strong(expected, this)) {
+    throw std::runtime_error("Only one HeapProfiler may exist at a time.");
+  }
+  in_flight_test.clear();
+  bytes_until_sample = NextSampleGap(options_.sampling_interval_bytes);
+  listener_id_ = AddTestEventListener([this](const TestEvent& event) {
+    // Samples are keyed by the test whose code is running on the allocating thread, which under
+    // ExecuteSuitePipelined is not the thread that publishes kTestBegin and kTestEnd.
+    if (event.type == TestEventType::kTestThreadBegin) {
+      in_flight_test.assign(event.suite_label).append("::").append(event.test_label);
+    } else if (event.type == TestEventType::kTestThreadEnd) {
+      in_flight_test.clear();
+    } else if (event.type == TestEventType::kTestEnd && event.outcome != TestOutcome::kSkipped) {
+      string qualified_test_label;
+      qualified_test_label.append(event.suite_label).append("::").append(event.test_label);
+      OnTestEnd(qualified_test_label, event.duration);
+    }
+  });
+}
+
+HeapProfiler::~HeapProfiler() {
+  RemoveTestEventListener(listener_id_);
+  active_profiler = nullptr;
+}
+
+vector<AllocationSite> HeapProfiler::Sites(const string& qualified_test_label) const {
+  vector<AllocationSite> sites;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto test = samples_.find(qualified_test_label);
+  if (test == samples_.end()) {
+    return sites;
+  }
+  for (const auto& [stack, sampled] : test->second) {
+    AllocationSite site = {stack, sampled.first, sampled.second, 0, 0};
+    // Every sample at a site is weighted by the average size of the site's samples.
+    double weight = SampleWeight(static_cast<double>(sampled.second) / sampled.first, options_.sampling_interval_bytes);
+    site.estimated_count = sampled.first * weight;
+    site.estimated_bytes = sampled.second * weight;
+    sites.push_back(std::move(site));
+  }
+  std::stable_sort(sites.begin(), sites.end(), [](const AllocationSite& left, const AllocationSite& right) {
+    return left.estimated_bytes > right.estimated_bytes;
+  });
+  return sites;
+}
+
+size_t HeapProfiler::SamplingIntervalBytes() const {
+  return options_.sampling_interval_bytes;
+}
+
+void HeapProfiler::RecordSample(size_t size, void* const* frames, size_t frame_count) {
+  bytes_until_sample = NextSampleGap(options_.sampling_interval_bytes);
+  vector<void*> stack(frames, frames + frame_count);
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::pair<uint64_t, uint64_t>& sampled = samples_[in_flight_test][stack];
+  sampled.first++;
+  sampled.second += size;
+}
+
+void HeapProfiler::OnTestEnd(const string& qualified_test_label, std::chrono::nanoseconds duration) {
+  is_recording = true;
+  vector<AllocationSite> sites = Sites(qualified_test_label);
+  double estimated_bytes = 0;
+  for (const AllocationSite& site : sites) {
+    estimated_bytes += site.estimated_bytes;
+  }
+  bool is_checked = options_.slow_test_threshold.count() > 0 || options_.byte_budget > 0;
+  bool is_slow = options_.slow_test_threshold.count() > 0 && duration >= options_.slow_test_threshold;
+  bool is_over_budget = options_.byte_budget > 0 && estimated_bytes >= options_.byte_budget;
+  if (!sites.empty() && (!is_checked || is_slow || is_over_budget)) {
+    PrintAllocationSites(*options_.os, qualified_test_label, sites, options_.top_sites);
+    if (!options_.profile_directory.empty()) {
+      string path = options_.profile_directory + "/" + FileNameFor(qualified_test_label);
+      std::ofstream profile(path);
+      WriteHeapProfile(profile, sites, options_.sampling_interval_bytes);
+      *options_.os << "      Wrote " << path << endl;
+    }
+  }
+  is_recording = false;
+}
+// End HeapProfiler methods
+
+// Begin ProfiledScope methods
+ProfiledScope::ProfiledScope() {
+  profiled_depth++;
+}
+
+ProfiledScope::~ProfiledScope() {
+  profiled_depth--;
+}
+// End ProfiledScope methods
+
+void PrintAllocationSites(std::ostream& os,
+                          const string& qualified_test_label,
+                          const vector<AllocationSite>& sites,
+                          size_t top_sites) {
+  double total_bytes = 0;
+  double total_count = 0;
+  for (const AllocationSite& site : sites) {
+    total_bytes += site.estimated_bytes;
+    total_count += site.estimated_count;
+  }
+  char line[128];
+  snprintf(line, sizeof(line), " (~%s in ~%.0f allocations):", FormatBytes(total_bytes).c_str(), total_count);
+  os << "    🧠Top allocation sites for " << qualified_test_label << line << endl;
+  for (size_t index = 0; index < sites.size() && index < top_sites; index++) {
+    const AllocationSite& site = sites[index];
+    snprintf(line,
+             sizeof(line),
+             "      %zu. ~%s (%.1f%%) in ~%.0f allocations",
+             index + 1,
+             FormatBytes(site.estimated_bytes).c_str(),
+             total_bytes > 0 ? 100 * site.estimated_bytes / total_bytes : 0,
+             site.estimated_count);
+    os << line << endl;
+    size_t frame_count = std::min(site.stack.size(), kPrintedFrames);
+    char** symbols = backtrace_symbols(site.stack.data(), static_cast<int>(frame_count));
+    for (size_t frame = 0; frame < frame_count; frame++) {
+      os << "         #" << frame << " " << (symbols != nullptr ? Demangle(symbols[frame]) : "?") << endl;
+    }
+    free(symbols);
+  }
+}
+
+void WriteHeapProfile(std::ostream& os, const vector<AllocationSite>& sites, size_t sampling_interval_bytes) {
+  // Only allocations are recorded so the in use counts are zero.
+  uint64_t total_count = 0;
+  uint64_t total_bytes = 0;
+  for (const AllocationSite& site : sites) {
+    total_count += site.sampled_count;
+    total_bytes += site.sampled_bytes;
+  }
+  os << "heap profile: 0: 0 [" << total_count << ": " << total_bytes << "] @ heap_v2/" << sampling_interval_bytes
+     << '\n';
+  for (const AllocationSite& site : sites) {
+    os << "0: 0 [" << site.sampled_count << ": " << site.sampled_bytes << "] @";
+    for (void* frame : site.stack) {
+      os << ' ' << frame;
+    }
+    os << '\n';
+  }
+  // pprof reads the mappings to find the binaries the addresses are in.
+  os << "\nMAPPED_LIBRARIES:\n";
+  std::ifstream maps("/proc/self/maps");
+  os << maps.rdbuf();
+}
+
+}  // End namespace TinyTest
+
+void* operator new(size_t size) {
+  return TinyTest::Allocate(size, 0, false);
+}
+
+void* operator new[](size_t size) {
+  return TinyTest::Allocate(size, 0, false);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return TinyTest::Allocate(size, 0, true);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return TinyTest::Allocate(size, 0, true);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  return TinyTest::Allocate(size, static_cast<size_t>(alignment), false);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return TinyTest::Allocate(size, static_cast<size_t>(alignment), false);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return TinyTest::Allocate(size, static_cast<size_t>(alignment), true);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return TinyTest::Allocate(size, static_cast<size_t>(alignment), true);
+}
@@ -0,0 +1,168 @@
+#ifndef TinyTest__heap_profiler_h__
+#define TinyTest__heap_profiler_h__
+/***************************************************************************************
+ * @file heap_profiler.h                                                               *
+ *                                                                                     *
+ * @brief Defines a sampling profiler for the allocations made by tests.               *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TinyTest {
+
+/// @defgroup heap_profiler Heap Profiler
+///
+/// A HeapProfiler samples the allocations made by function_to_test and records the call stack of each sample, so a test
+/// whose allocations regressed can be traced to the code that allocates. Linking this library replaces the global
+/// operator new. While no HeapProfiler exists the replacement only adds one atomic load to each allocation.
+///
+/// Allocations are sampled by bytes. Each thread samples the allocation that crosses a randomly chosen byte count, and
+/// the gaps between samples are exponentially distributed with a mean of the sampling interval. This is a Poisson
+/// process over the allocated bytes, so large allocations are more likely to be sampled and the totals can be
+/// estimated without bias.
+///
+/// Only calls of functions wrapped with ProfileAllocations are sampled, and only on the thread that calls them. Samples
+/// are attributed to the test running on that thread, or to the empty label outside of tests. When a test ends its top
+/// allocation sites are printed if it was slower than slow_test_threshold or allocated more than byte_budget. If
+/// neither is set every test with samples is printed. If profile_directory is set each printed test also gets a heap
+/// profile there in the heap_v2 text format that pprof reads. Use pprof -sample_index=alloc_space because only
+/// allocations are recorded.
+///
+/// Stacks are printed with the symbols in the dynamic symbol table. Link with -rdynamic to get function names.
+/// @code{.cpp}
+/// TinyTest::HeapProfilerOptions options;
+/// options.byte_budget = 1 << 20;
+/// TinyTest::HeapProfiler profiler(options);
+/// results += ExecuteSuite("Parse", TinyTest::ProfileAllocations(parse), {...});
+/// @endcode
+
+/// @addtogroup heap_profiler
+/// @{
+
+/// @brief Options that control what a HeapProfiler samples and reports.
+struct HeapProfilerOptions {
+  /// @brief The mean number of bytes allocated between samples.
+  size_t sampling_interval_bytes = 512 * 1024;
+  /// @brief The most allocation sites printed for a test.
+  size_t top_sites = 10;
+  /// @brief Tests that take at least this long are printed. Zero means duration is not checked.
+  std::chrono::nanoseconds slow_test_threshold = std::chrono::nanoseconds(0);
+  /// @brief Tests estimated to allocate at least this many bytes are printed. Zero means bytes are not checked.
+  size_t byte_budget = 0;
+  /// @brief If set, a heap profile named after the qualified test label is written here for each printed test.
+  std::string profile_directory;
+  /// @brief The stream reports are printed to.
+  std::ostream* os = &std::cout;
+};
+
+/// @brief The sampled allocations made from one call stack.
+struct AllocationSite {
+  /// @brief The return addresses of the call stack, innermost first, starting with the caller of operator new.
+  std::vector<void*> stack;
+  /// @brief The number of sampled allocations.
+  uint64_t sampled_count;
+  /// @brief The bytes of the sampled allocations.
+  uint64_t sampled_bytes;
+  /// @brief The estimated number of allocations, sampled or not, made from this stack.
+  double estimated_count;
+  /// @brief The estimated bytes of the allocations, sampled or not, made from this stack.
+  double estimated_bytes;
+};
+
+/// @brief Samples allocations made by functions wrapped with ProfileAllocations while it exists. Only one may exist at
+/// a time.
+class HeapProfiler {
+ public:
+  /// @brief Starts sampling.
+  /// @param options The options that control what is sampled and reported.
+  /// @throws std::runtime_error if another HeapProfiler exists.
+  explicit HeapProfiler(const HeapProfilerOptions& options = HeapProfilerOptions());
+
+  HeapProfiler(const HeapProfiler& other) = delete;
+  HeapProfiler& operator=(const HeapProfiler& other) = delete;
+
+  /// @brief Stops sampling. Profiled functions must not be running on other threads.
+  ~HeapProfiler();
+
+  /// @brief Gets the allocation sites sampled for a test.
+  /// @param qualified_test_label The qualified label of the test, "suite_label::test_label".
+  /// @return The sites sorted by estimated bytes, largest first.
+  std::vector<AllocationSite> Sites(const std::string& qualified_test_label) const;
+
+  /// @brief Gets the mean number of bytes allocated between samples.
+  /// @return The sampling interval, which is at least one byte.
+  size_t SamplingIntervalBytes() const;
+
+  /// @brief Records a sampled allocation and draws the gap to the next sample. This is called by operator new.
+  /// @param size The size of the allocation.
+  /// @param frames The return addresses of the call stack of the allocation, innermost first.
+  /// @param frame_count The number of return addresses in frames.
+  void RecordSample(size_t size, void* const* frames, size_t frame_count);
+
+ private:
+  void OnTestEnd(const std::string& qualified_test_label, std::chrono::nanoseconds duration);
+
+  uint64_t listener_id_;
+  mutable std::mutex mutex_;
+  HeapProfilerOptions options_;
+  std::map<std::string, std::map<std::vector<void*>, std::pair<uint64_t, uint64_t>>> samples_;
+};
+
+/// @brief Prints the top allocation sites of a test.
+/// @param os The stream to print to.
+/// @param qualified_test_label The qualified label of the test.
+/// @param sites The sites sorted by estimated bytes, largest first.
+/// @param top_sites The most sites to print.
+void PrintAllocationSites(std::ostream& os,
+                          const std::string& qualified_test_label,
+                          const std::vector<AllocationSite>& sites,
+                          size_t top_sites);
+
+/// @brief Writes a heap profile in the heap_v2 text format that pprof reads.
+/// @param os The stream to write to.
+/// @param sites The sites to write.
+/// @param sampling_interval_bytes The sampling interval the sites were sampled with.
+void WriteHeapProfile(std::ostream& os, const std::vector<AllocationSite>& sites, size_t sampling_interval_bytes);
+
+/// @brief Marks the calling thread as running profiled code while it exists.
+class ProfiledScope {
+ public:
+  /// @brief Starts sampling allocations on the calling thread.
+  ProfiledScope();
+
+  ProfiledScope(const ProfiledScope& other) = delete;
+  ProfiledScope& operator=(const ProfiledScope& other) = delete;
+
+  /// @brief Stops sampling allocations on the calling thread unless an outer ProfiledScope exists.
+  ~ProfiledScope();
+};
+
+/// @brief Wraps a function so the allocations it makes are sampled by the HeapProfiler.
+/// @tparam TResult The result type of the function.
+/// @tparam TInputParams... The types of parameters sent to the function.
+/// @param function_to_test The function to wrap.
+/// @return A function that calls function_to_test inside a ProfiledScope.
+template <typename TResult, typename... TInputParams>
+std::function<TResult(TInputParams...)> ProfileAllocations(std::function<TResult(TInputParams...)> function_to_test) {
+  return [function_to_test](TInputParams... params) -> TResult {
+    ProfiledScope scope;
+    return function_to_test(std::forward<TInputParams>(params)...);
+  };
+}
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__heap_profiler_h__)
@@ -0,0 +1,173 @@
+/***************************************************************************************
+ * @file heap_profiler_test.cpp                                                        *
+ *                                                                                     *
+ * @brief Tests for the sampling profiler for the allocations made by tests.           *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "heap_profiler.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::string;
+using std::vector;
+using testing::Eq;
+using testing::Ge;
+using testing::HasSubstr;
+using testing::Le;
+using testing::Not;
+using TinyTest::AllocationSite;
+using TinyTest::ExecuteSuite;
+using TinyTest::ExecuteSuitePipelined;
+using TinyTest::HeapProfiler;
+using TinyTest::HeapProfilerOptions;
+using TinyTest::MakeTest;
+using TinyTest::ProfileAllocations;
+using TinyTest::ProfiledScope;
+
+// Allocates count blocks of 64 bytes and frees them.
+void AllocateBlocks(int count) {
+  vector<std::unique_ptr<char[]>> blocks;
+  blocks.reserve(count);
+  ProfiledScope scope;
+  for (int index = 0; index < count; index++) {
+    blocks.emplace_back(new char[64]);
+  }
+}
+
+double TotalEstimatedBytes(const vector<AllocationSite>& sites) {
+  double total = 0;
+  for (const AllocationSite& site : sites) {
+    total += site.estimated_bytes;
+  }
+  return total;
+}
+
+TEST(HeapProfiler, ShouldReportTheTestsOverBudget) {
+  std::ostringstream os;
+  HeapProfilerOptions options;
+  options.sampling_interval_bytes = 1;
+  options.byte_budget = 1000;
+  options.os = &os;
+  HeapProfiler profiler(options);
+  function<size_t(int)> fill = [](int count) {
+    vector<int> values(count, 1);
+    return values.size();
+  };
+  function<void()> wrapper = [&]() {
+    ExecuteSuite("Fill",
+                 ProfileAllocations(fill),
+                 {
+                     MakeTest("Small", (size_t)10, make_tuple(10)),
+                     MakeTest("Large", (size_t)1000, make_tuple(1000)),
+                 });
+  };
+  TinyTest::InterceptCout(wrapper);
+  vector<AllocationSite> small = profiler.Sites("Fill::Small");
+  ASSERT_THAT(small.size(), Eq(1));
+  EXPECT_THAT(small[0].sampled_count, Eq(1));
+  EXPECT_THAT(small[0].sampled_bytes, Eq(10 * sizeof(int)));
+  EXPECT_THAT(small[0].estimated_bytes, Eq(10 * sizeof(int)));
+  EXPECT_THAT(profiler.Sites("Fill::Large")[0].sampled_bytes, Eq(1000 * sizeof(int)));
+  EXPECT_THAT(os.str(), Not(HasSubstr("Fill::Small")));
+  EXPECT_THAT(os.str(), HasSubstr("    🧠Top allocation sites for Fill::Large (~3.9 KB in ~1 allocations):\n"));
+  EXPECT_THAT(os.str(), HasSubstr("      1. ~3.9 KB (100.0%) in ~1 allocations\n         #0 "));
+}
+
+TEST(HeapProfiler, ShouldKeySamplesByTheTestOfPipelinedSuites) {
+  std::ostringstream os;
+  HeapProfilerOptions options;
+  options.sampling_interval_bytes = 1;
+  options.os = &os;
+  HeapProfiler profiler(options);
+  function<size_t(int)> fill = [](int count) {
+    vector<int> values(count, 1);
+    return values.size();
+  };
+  function<void()> wrapper = [&]() {
+    ExecuteSuitePipelined("Fill",
+                          ProfileAllocations(fill),
+                          {
+                              MakeTest("Small", (size_t)10, make_tuple(10)),
+                              MakeTest("Large", (size_t)1000, make_tuple(1000)),
+                          });
+  };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(profiler.Sites("").size(), Eq(0));
+  ASSERT_THAT(profiler.Sites("Fill::Small").size(), Eq(1));
+  EXPECT_THAT(profiler.Sites("Fill::Small")[0].sampled_bytes, Eq(10 * sizeof(int)));
+  ASSERT_THAT(profiler.Sites("Fill::Large").size(), Eq(1));
+  EXPECT_THAT(profiler.Sites("Fill::Large")[0].sampled_bytes, Eq(1000 * sizeof(int)));
+  EXPECT_THAT(os.str(), HasSubstr("    🧠Top allocation sites for Fill::Large "));
+}
+
+TEST(HeapProfiler, ShouldEstimateTotalsFromSamples) {
+  HeapProfilerOptions options;
+  options.sampling_interval_bytes = 4096;
+  HeapProfiler profiler(options);
+  AllocateBlocks(20000);
+  // About 312 samples so the estimate should be well within a quarter of the real total.
+  double estimated_bytes = TotalEstimatedBytes(profiler.Sites(""));
+  EXPECT_THAT(estimated_bytes, Ge(20000 * 64 * 0.75));
+  EXPECT_THAT(estimated_bytes, Le(20000 * 64 * 1.25));
+}
+
+TEST(HeapProfiler, ShouldOnlySampleProfiledCode) {
+  HeapProfilerOptions options;
+  options.sampling_interval_bytes = 1;
+  HeapProfiler profiler(options);
+  vector<std::unique_ptr<char[]>> blocks;
+  for (int index = 0; index < 100; index++) {
+    blocks.emplace_back(new char[64]);
+  }
+  EXPECT_THAT(profiler.Sites("").size(), Eq(0));
+}
+
+TEST(HeapProfiler, ShouldDrawTheFirstSampleGapOfOtherThreads) {
+  HeapProfiler profiler;
+  std::unique_ptr<char[]> block;
+  std::thread allocator([&block]() {
+    ProfiledScope scope;
+    block.reset(new char[24]);
+  });
+  allocator.join();
+  // The gap drawn for the new thread is at most 24 bytes about once in 20,000 runs.
+  EXPECT_THAT(profiler.Sites("").size(), Eq(0));
+}
+
+TEST(HeapProfiler, ShouldOnlyAllowOneAtATime) {
+  HeapProfiler profiler;
+  EXPECT_THROW(HeapProfiler(), std::runtime_error);
+}
+
+TEST(WriteHeapProfile, ShouldWriteTheHeapV2Format) {
+  vector<AllocationSite> sites = {
+      {{reinterpret_cast<void*>(0x1234), reinterpret_cast<void*>(0x5678)}, 2, 300, 4, 600},
+      {{reinterpret_cast<void*>(0x9abc)}, 1, 100, 1, 100},
+  };
+  std::ostringstream os;
+  TinyTest::WriteHeapProfile(os, sites, 512);
+  EXPECT_THAT(os.str(),
+              testing::StartsWith("heap profile: 0: 0 [3: 400] @ heap_v2/512\n"
+                                  "0: 0 [2: 300] @ 0x1234 0x5678\n"
+                                  "0: 0 [1: 100] @ 0x9abc\n"
+                                  "\n"
+                                  "MAPPED_LIBRARIES:\n"));
+}
+}  // End namespace
@@ -0,0 +1,67 @@
+/***************************************************************************************
+ * @file isa_dispatch.cpp                                                              *
+ *                                                                                     *
+ * @brief Defines suites that run every row against each SIMD code path.               *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "isa_dispatch.h"
+
+#include <exception>
+#include <iostream>
+
+namespace TinyTest {
+
+const char* IsaTargetName(IsaTarget target) {
+  switch (target) {
+    case IsaTarget::kScalar:
+      return "scalar";
+    case IsaTarget::kSse42:
+      return "sse4.2";
+    case IsaTarget::kAvx2:
+      return "avx2";
+    case IsaTarget::kAvx512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+bool IsIsaTargetSupported(IsaTarget target) {
+#if defined(__x86_64__) || defined(__i386__)
+  // The CPU is normally identified before main, but this may be called from a static initializer.
+  __builtin_cpu_init();
+  switch (target) {
+    case IsaTarget::kScalar:
+      return true;
+    case IsaTarget::kSse42:
+      return __builtin_cpu_supports("sse4.2");
+    case IsaTarget::kAvx2:
+      return __builtin_cpu_supports("avx2");
+    case IsaTarget::kAvx512:
+      return __builtin_cpu_supports("avx512f");
+  }
+  return false;
+#else
+  return target == IsaTarget::kScalar;
+#endif
+}
+
+// Begin IsaTargetScope methods
+IsaTargetScope::IsaTargetScope(const IsaDispatchOptions& options) : options_(options) {}
+
+IsaTargetScope::~IsaTargetScope() {
+  if (!options_.reset_target.has_value()) {
+    return;
+  }
+  // This may run while a suite's exception unwinds the stack, where letting another one escape calls std::terminate.
+  try {
+    (*options_.reset_target)();
+  } catch (...) {
+    std::cout << "    🔥ERROR: Unable to reset the ISA target. " << DescribeCaughtException(std::current_exception())
+              << std::endl;
+  }
+}
+// End IsaTargetScope methods
+
+}  // End namespace TinyTest
@@ -0,0 +1,283 @@
+#ifndef TinyTest__isa_dispatch_h__
+#define TinyTest__isa_dispatch_h__
+/***************************************************************************************
+ * @file isa_dispatch.h                                                                *
+ *                                                                                     *
+ * @brief Defines suites that run every row against each SIMD code path.               *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "benchmark.h"
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup isa_dispatch ISA Dispatch
+///
+/// Code that picks a scalar, SSE4.2, AVX2, or AVX-512 implementation at runtime is only tested on the path the CPU
+/// running the tests picks. ExecuteIsaDispatchSuite runs every row once per IsaTarget instead. Before each row it calls
+/// a user supplied hook that forces the code being tested onto that target, and each result is labeled with the target
+/// like "Row [avx2]". Targets the CPU does not support are skipped.
+///
+/// ExecuteIsaBenchmarkSuite times every row on each target instead. Each target is a variant, so PrintBenchmarkResults
+/// shows every target side by side with its time relative to the first. Keep kScalar first in targets so every target
+/// is compared against the scalar code.
+/// @code{.cpp}
+/// TinyTest::IsaDispatchOptions options;
+/// options.force_target = [](TinyTest::IsaTarget target) { SetCrc32Implementation(target); };
+/// options.reset_target = []() { SetCrc32Implementation(std::nullopt); };
+/// results += ExecuteIsaDispatchSuite("Crc32", crc32, {rows...}, options);
+/// @endcode
+
+/// @addtogroup isa_dispatch
+/// @{
+
+/// @brief An instruction set a SIMD code path is written for.
+enum class IsaTarget {
+  /// @brief Plain C++ that runs on every CPU.
+  kScalar,
+  /// @brief SSE4.2.
+  kSse42,
+  /// @brief AVX2.
+  kAvx2,
+  /// @brief AVX-512 foundation instructions.
+  kAvx512,
+};
+
+/// @brief Gets the name of a target.
+/// @param target The target.
+/// @return "scalar", "sse4.2", "avx2", or "avx512".
+const char* IsaTargetName(IsaTarget target);
+
+/// @brief Checks if the CPU this is running on supports a target. Only kScalar is supported off of x86.
+/// @param target The target to check.
+/// @return True if code written for target can run here.
+bool IsIsaTargetSupported(IsaTarget target);
+
+/// @brief This is a type that represents a function that forces the code being tested onto a target.
+using ForceIsaTargetFunction = std::function<void(IsaTarget target)>;
+
+/// @brief Options that control which targets rows are run against.
+struct IsaDispatchOptions {
+  /// @brief The targets to run each row against in order. ExecuteIsaBenchmarkSuite compares every target against the
+  /// first one, so kScalar should stay first.
+  std::vector<IsaTarget> targets = {IsaTarget::kScalar, IsaTarget::kSse42, IsaTarget::kAvx2, IsaTarget::kAvx512};
+  /// @brief This is called before each row with the target it should run on.
+  ForceIsaTargetFunction force_target;
+  /// @brief If set this is called after the suite, even if it throws, to go back to the target the CPU would pick.
+  /// Anything it throws is printed instead of thrown.
+  MaybeTestConfigureFunction reset_target;
+  /// @brief Decides which targets this CPU can run. Targets it returns false for are skipped.
+  std::function<bool(IsaTarget target)> is_supported = IsIsaTargetSupported;
+};
+
+/// @brief Calls the reset_target of some options when it is destroyed, so a suite that throws does not leave the code
+/// being tested forced onto one target.
+class IsaTargetScope {
+ public:
+  /// @brief Creates a scope.
+  /// @param options The options with the reset_target to call. These must outlive the scope.
+  explicit IsaTargetScope(const IsaDispatchOptions& options);
+
+  IsaTargetScope(const IsaTargetScope& other) = delete;
+  IsaTargetScope& operator=(const IsaTargetScope& other) = delete;
+
+  /// @brief Calls options.reset_target if it is set. Anything it throws is printed to std::cout instead of thrown.
+  ~IsaTargetScope();
+
+ private:
+  const IsaDispatchOptions& options_;
+};
+
+/// @brief This is a type that represents a row run against one target. It is used by ExecuteIsaDispatchSuite.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+template <typename TResult, typename... TInputParams>
+using IsaTestTuple = std::tuple<
+    /// test_name - The label of the test including its target.
+    std::string,
+    /// test - The test to run.
+    const TestTuple<TResult, TInputParams...>*,
+    /// target - The target to run the test on.
+    IsaTarget,
+    /// options - The options with the hook that forces the target.
+    const IsaDispatchOptions*>;
+
+/// @brief Forces a target and runs a single test on it, or skips the test if the CPU does not support the target.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite.
+/// @param test_data The test with its target.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const IsaTestTuple<TResult, TInputParams...>& test_data);
+
+/// @brief Executes a suite with every row run once per target in options.
+///
+/// The rows run on the first target, then all of them on the next, and so on. Each result is labeled like
+/// "Row [avx2]".
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param tests An std::initializer_list of test runs.
+/// @param options The targets and the hook that forces each one.
+/// @param suite_Compare A function used to compare the expected and actual test results.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @return The results of the suite.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteIsaDispatchSuite(std::string suite_label,
+                                    std::function<TResult(TInputParams...)> function_to_test,
+                                    std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                    IsaDispatchOptions options,
+                                    MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt,
+                                    MaybeTestConfigureFunction before_all = std::nullopt,
+                                    MaybeTestConfigureFunction after_all = std::nullopt,
+                                    bool is_enabled = true);
+
+/// @brief Times each row of a suite on each target in isa_options.
+///
+/// Each target is a variant named by IsaTargetName. Targets the CPU does not support are left out, so they show as "-"
+/// in PrintBenchmarkResults. PrintBenchmarkResults compares each target against the first one in isa_options.targets.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this suite.
+/// @param function_to_test The function to time.
+/// @param tests The rows. Disabled rows are left out. Expected values and compare functions are ignored.
+/// @param isa_options The targets and the hook that forces each one.
+/// @param options The options that control how rows are timed. page_kinds is ignored.
+/// @param before_all This is called before any row is timed.
+/// @param after_all This is called after every row has been timed.
+/// @return The results of each row on each target.
+template <typename TResult, typename... TInputParams>
+std::vector<BenchmarkResult> ExecuteIsaBenchmarkSuite(
+    const std::string& suite_label,
+    std::function<TResult(TInputParams...)> function_to_test,
+    std::initializer_list<TestTuple<TResult, std::decay_t<TInputParams>...>> tests,
+    IsaDispatchOptions isa_options,
+    BenchmarkOptions options = {},
+    MaybeTestConfigureFunction before_all = std::nullopt,
+    MaybeTestConfigureFunction after_all = std::nullopt);
+/// @}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const IsaTestTuple<TResult, TInputParams...>& test_data) {
+  const IsaTarget target = std::get<2>(test_data);
+  const IsaDispatchOptions& options = *std::get<3>(test_data);
+  if (!options.is_supported(target)) {
+    SkipTest(os,
+             results,
+             suite_label,
+             std::get<0>(test_data),
+             std::string("the CPU does not support ") + IsaTargetName(target));
+    return;
+  }
+  TestTuple<TResult, TInputParams...> test = *std::get<1>(test_data);
+  std::get<0>(test) = std::get<0>(test_data);
+  if (options.force_target) {
+    options.force_target(target);
+  }
+  ExecuteTest(os, results, suite_label, function_to_test, suite_Compare, test);
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteIsaDispatchSuite(std::string suite_label,
+                                    std::function<TResult(TInputParams...)> function_to_test,
+                                    std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                    IsaDispatchOptions options,
+                                    MaybeTestCompareFunction<TResult> suite_Compare,
+                                    MaybeTestConfigureFunction before_all,
+                                    MaybeTestConfigureFunction after_all,
+                                    bool is_enabled) {
+  std::vector<IsaTestTuple<TResult, TInputParams...>> isa_tests;
+  isa_tests.reserve(tests.size() * options.targets.size());
+  for (IsaTarget target : options.targets) {
+    for (const TestTuple<TResult, TInputParams...>& test : tests) {
+      isa_tests.emplace_back(std::get<0>(test) + " [" + IsaTargetName(target) + "]", &test, target, &options);
+    }
+  }
+  IsaTargetScope target_scope(options);
+  return ExecuteSuiteTests(suite_label, function_to_test, isa_tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+template <typename TResult, typename... TInputParams>
+std::vector<BenchmarkResult> ExecuteIsaBenchmarkSuite(
+    const std::string& suite_label,
+    std::function<TResult(TInputParams...)> function_to_test,
+    std::initializer_list<TestTuple<TResult, std::decay_t<TInputParams>...>> tests,
+    IsaDispatchOptions isa_options,
+    BenchmarkOptions options,
+    MaybeTestConfigureFunction before_all,
+    MaybeTestConfigureFunction after_all) {
+  std::vector<BenchmarkResult> results;
+  ReportEnergyAvailability(std::cout, suite_label, options);
+  if (before_all.has_value()) {
+    (*before_all)();
+  }
+  {
+    IsaTargetScope target_scope(isa_options);
+    for (const TestTuple<TResult, std::decay_t<TInputParams>...>& test : tests) {
+      if (!std::get<6>(test)) {
+        continue;
+      }
+      for (IsaTarget target : isa_options.targets) {
+        if (!isa_options.is_supported(target)) {
+          continue;
+        }
+        std::tuple<std::decay_t<TInputParams>...> inputs = std::get<2>(test);
+        BenchmarkIterationsFunction run_iterations = [&](uint64_t iterations) {
+          for (uint64_t iteration = 0; iteration < iterations; iteration++) {
+            if constexpr (std::is_void_v<TResult>) {
+              std::apply(function_to_test, inputs);
+            } else {
+              DoNotOptimize(std::apply(function_to_test, inputs));
+            }
+          }
+        };
+        if (isa_options.force_target) {
+          isa_options.force_target(target);
+        }
+        BenchmarkRow(results,
+                     suite_label,
+                     std::get<0>(test),
+                     IsaTargetName(target),
+                     std::get<4>(test),
+                     std::get<5>(test),
+                     options,
+                     run_iterations);
+      }
+    }
+  }
+  if (after_all.has_value()) {
+    (*after_all)();
+  }
+  return results;
+}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__isa_dispatch_h__)
@@ -0,0 +1,176 @@
+/***************************************************************************************
+ * @file isa_dispatch_test.cpp                                                         *
+ *                                                                                     *
+ * @brief Tests for suites that run every row against each SIMD code path.             *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "isa_dispatch.h"
+
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "benchmark.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::string;
+using std::vector;
+using testing::ElementsAre;
+using testing::Eq;
+using testing::HasSubstr;
+using testing::StrEq;
+using TinyTest::BenchmarkOptions;
+using TinyTest::BenchmarkResult;
+using TinyTest::ExecuteIsaBenchmarkSuite;
+using TinyTest::ExecuteIsaDispatchSuite;
+using TinyTest::IsaDispatchOptions;
+using TinyTest::IsaTarget;
+using TinyTest::IsaTargetName;
+using TinyTest::IsIsaTargetSupported;
+using TinyTest::MakeTest;
+using TinyTest::TestResults;
+
+// Pretends the CPU supports everything but AVX-512.
+bool IsSupportedWithoutAvx512(IsaTarget target) {
+  return target != IsaTarget::kAvx512;
+}
+
+TEST(IsaTarget, ShouldNameEachTarget) {
+  EXPECT_THAT(IsaTargetName(IsaTarget::kScalar), StrEq("scalar"));
+  EXPECT_THAT(IsaTargetName(IsaTarget::kSse42), StrEq("sse4.2"));
+  EXPECT_THAT(IsaTargetName(IsaTarget::kAvx2), StrEq("avx2"));
+  EXPECT_THAT(IsaTargetName(IsaTarget::kAvx512), StrEq("avx512"));
+  EXPECT_TRUE(IsIsaTargetSupported(IsaTarget::kScalar));
+  // Every CPU with AVX2 has SSE4.2.
+  EXPECT_TRUE(!IsIsaTargetSupported(IsaTarget::kAvx2) || IsIsaTargetSupported(IsaTarget::kSse42));
+}
+
+TEST(ExecuteIsaDispatchSuite, ShouldRunEachRowOnEachSupportedTarget) {
+  IsaTarget current = IsaTarget::kAvx2;
+  vector<IsaTarget> forced;
+  bool was_reset = false;
+  IsaDispatchOptions options;
+  options.force_target = [&](IsaTarget target) {
+    forced.push_back(target);
+    current = target;
+  };
+  options.reset_target = [&]() { was_reset = true; };
+  options.is_supported = IsSupportedWithoutAvx512;
+  // The AVX2 path drops the last element.
+  function<int(vector<int>)> sum = [&current](vector<int> values) {
+    int total = 0;
+    for (size_t index = 0; index < values.size() - (current == IsaTarget::kAvx2 ? 1 : 0); index++) {
+      total += values[index];
+    }
+    return total;
+  };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteIsaDispatchSuite("Sum",
+                                      sum,
+                                      {MakeTest("Three", 6, make_tuple(vector<int>({1, 2, 3}))),
+                                       MakeTest("One", 5, make_tuple(vector<int>({5})))},
+                                      options);
+  };
+  string output = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(forced,
+              ElementsAre(IsaTarget::kScalar,
+                          IsaTarget::kScalar,
+                          IsaTarget::kSse42,
+                          IsaTarget::kSse42,
+                          IsaTarget::kAvx2,
+                          IsaTarget::kAvx2));
+  EXPECT_TRUE(was_reset);
+  EXPECT_THAT(results.Passed(), Eq(4));
+  EXPECT_THAT(results.Failed(), Eq(2));
+  EXPECT_THAT(results.Skipped(), Eq(2));
+  EXPECT_THAT(results.FailureMessages()[0], HasSubstr("Sum::Three [avx2]"));
+  EXPECT_THAT(results.FailureMessages()[1], HasSubstr("Sum::One [avx2]"));
+  EXPECT_THAT(output, HasSubstr("  🚧Skipping Test: Three [avx512] because the CPU does not support avx512\n"));
+  EXPECT_THAT(output, HasSubstr("  Beginning Test: One [sse4.2]\n"));
+}
+
+TEST(ExecuteIsaDispatchSuite, ShouldResetTheTargetWhenTheSuiteThrows) {
+  bool was_reset = false;
+  IsaDispatchOptions options;
+  options.force_target = [](IsaTarget) {};
+  options.reset_target = [&was_reset]() { was_reset = true; };
+  options.is_supported = IsSupportedWithoutAvx512;
+  TinyTest::MaybeTestCompareFunction<int> compare = std::nullopt;
+  TinyTest::MaybeTestConfigureFunction before_all = std::nullopt;
+  TinyTest::MaybeTestConfigureFunction after_all = []() { throw std::runtime_error("teardown failed"); };
+  function<int(int)> identity = [](int value) { return value; };
+  // InterceptCout does not restore std::cout if its function throws, so the exception is caught inside it.
+  bool did_throw = false;
+  function<void()> wrapper = [&]() {
+    try {
+      ExecuteIsaDispatchSuite(
+          "Identity", identity, {MakeTest("One", 1, make_tuple(1))}, options, compare, before_all, after_all);
+    } catch (const std::runtime_error&) {
+      did_throw = true;
+    }
+  };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_TRUE(did_throw);
+  EXPECT_TRUE(was_reset);
+}
+
+TEST(ExecuteIsaDispatchSuite, ShouldPrintErrorsFromResetTargetWhenTheSuiteThrows) {
+  IsaDispatchOptions options;
+  options.force_target = [](IsaTarget) {};
+  options.reset_target = []() { throw std::runtime_error("reset failed"); };
+  options.is_supported = IsSupportedWithoutAvx512;
+  TinyTest::MaybeTestCompareFunction<int> compare = std::nullopt;
+  TinyTest::MaybeTestConfigureFunction before_all = std::nullopt;
+  TinyTest::MaybeTestConfigureFunction after_all = []() { throw std::runtime_error("teardown failed"); };
+  function<int(int)> identity = [](int value) { return value; };
+  string error;
+  function<void()> wrapper = [&]() {
+    try {
+      ExecuteIsaDispatchSuite(
+          "Identity", identity, {MakeTest("One", 1, make_tuple(1))}, options, compare, before_all, after_all);
+    } catch (const std::runtime_error& ex) {
+      error = ex.what();
+    }
+  };
+  string output = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(error, Eq("teardown failed"));
+  EXPECT_THAT(output, HasSubstr("    🔥ERROR: Unable to reset the ISA target. Caught exception \"reset failed\".\n"));
+}
+
+TEST(ExecuteIsaBenchmarkSuite, ShouldTimeEachSupportedTargetAsAVariant) {
+  IsaTarget current = IsaTarget::kScalar;
+  IsaDispatchOptions isa_options;
+  isa_options.targets = {IsaTarget::kScalar, IsaTarget::kAvx512, IsaTarget::kAvx2};
+  isa_options.force_target = [&current](IsaTarget target) { current = target; };
+  isa_options.is_supported = IsSupportedWithoutAvx512;
+  vector<IsaTarget> called;
+  function<int(int)> identity = [&](int value) {
+    if (called.empty() || called.back() != current) {
+      called.push_back(current);
+    }
+    return value;
+  };
+  BenchmarkOptions options;
+  options.min_time = std::chrono::microseconds(100);
+  vector<BenchmarkResult> results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteIsaBenchmarkSuite("Identity", identity, {MakeTest("One", 1, make_tuple(1))}, isa_options, options);
+  };
+  TinyTest::InterceptCout(wrapper);
+  ASSERT_THAT(results.size(), Eq(2));
+  EXPECT_THAT(results[0].variant, StrEq("scalar"));
+  EXPECT_THAT(results[1].variant, StrEq("avx2"));
+  EXPECT_THAT(called, ElementsAre(IsaTarget::kScalar, IsaTarget::kAvx2));
+}
+}  // End namespace
@@ -0,0 +1,259 @@
+/***************************************************************************************
+ * @file isolation.cpp                                                                 *
+ *                                                                                     *
+ * @brief Defines functions for running each test in its own resource limited process. *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "isolation.h"
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace TinyTest {
+namespace {
+using std::endl;
+using std::string;
+
+// This is only ever set in the child process.
+std::atomic<bool> is_out_of_memory(false);
+
+void OnOutOfMemory() {
+  is_out_of_memory = true;
+  std::set_new_handler(nullptr);
+  throw std::bad_alloc();
+}
+
+void SetLimit(int resource, rlim_t limit, rlim_t hard_limit, const char* name) {
+  rlimit current;
+  if (getrlimit(resource, &current) != 0) {
+    throw std::runtime_error(string("Unable to read ") + name + ": " + strerror(errno));
+  }
+  // Only root can raise the hard limit so limits above it are clamped.
+  if (current.rlim_max != RLIM_INFINITY) {
+    limit = std::min(limit, current.rlim_max);
+    hard_limit = std::min(hard_limit, current.rlim_max);
+  }
+  rlimit updated = {limit, hard_limit};
+  if (setrlimit(resource, &updated) != 0) {
+    throw std::runtime_error(string("Unable to set ") + name + ": " + strerror(errno));
+  }
+}
+
+bool IsFileDescriptorTableFull() {
+  int probe = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (probe >= 0) {
+    close(probe);
+    return false;
+  }
+  return errno == EMFILE;
+}
+
+void WriteAll(int fd, const string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t result = write(fd, data.data() + written, data.size() - written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return;
+    }
+    written += result;
+  }
+}
+
+string ReadAll(int fd) {
+  string data;
+  char buffer[65536];
+  while (true) {
+    ssize_t result = read(fd, buffer, sizeof(buffer));
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return data;
+    }
+    data.append(buffer, result);
+  }
+}
+
+// Records a limit violation as the only result of a test.
+TestResults LimitExceeded(std::ostream& os,
+                          const string& qualified_test_label,
+                          TestErrorKind kind,
+                          const string& description) {
+  os << "    🔥ERROR: " << qualified_test_label << " " << description << endl;
+  TestResults results;
+  results.Error(kind, qualified_test_label + " " + description);
+  results.Fail();
+  return results;
+}
+
+// Runs the test in the child process and writes its output and results to fd. This never returns.
+[[noreturn]] void RunChild(int fd,
+                           const string& qualified_test_label,
+                           const ResourceLimits& limits,
+                           const IsolatedTestFunction& run_test) {
+  std::ostringstream output;
+  TestResults results;
+  try {
+    ApplyResourceLimits(limits);
+    // Without an address space limit a std::bad_alloc is the test's own business.
+    if (limits.address_space_bytes.has_value()) {
+      std::set_new_handler(OnOutOfMemory);
+    }
+    run_test(output, results);
+  } catch (...) {
+    // Exceptions from the test itself are handled by run_test. This catches failures in before_each and after_each.
+    ReportTestError(output, results, qualified_test_label, DescribeCaughtException(std::current_exception()));
+    results.Fail();
+  }
+  std::set_new_handler(nullptr);
+  if (is_out_of_memory && limits.address_space_bytes.has_value()) {
+    results = LimitExceeded(output,
+                            qualified_test_label,
+                            TestErrorKind::kMemoryLimit,
+                            "exceeded its address space limit of " + std::to_string(*limits.address_space_bytes) +
+                                " bytes.");
+  } else if (limits.open_files.has_value() && (results.Failed() > 0 || results.Errors() > 0) &&
+             IsFileDescriptorTableFull()) {
+    results = LimitExceeded(output,
+                            qualified_test_label,
+                            TestErrorKind::kOpenFileLimit,
+                            "left open every file descriptor it was allowed, " +
+                                std::to_string(*limits.open_files) + ".");
+  }
+  // _exit does not flush stdio, so anything the test printed that is still buffered would be lost. This is done before
+  // the results are sent so it is written before the parent prints them.
+  std::cout.flush();
+  fflush(nullptr);
+  std::ostringstream payload;
+  payload << output.str().size() << '\n' << output.str();
+  WriteTestResults(payload, results);
+  WriteAll(fd, payload.str());
+  close(fd);
+  // Skip atexit handlers and static destructors. They belong to the parent.
+  _exit(0);
+}
+}  // End namespace
+
+ResourceLimits MergeResourceLimits(const ResourceLimits& suite_limits, const ResourceLimits& test_limits) {
+  ResourceLimits limits = suite_limits;
+  if (test_limits.address_space_bytes.has_value()) {
+    limits.address_space_bytes = test_limits.address_space_bytes;
+  }
+  if (test_limits.cpu_time.has_value()) {
+    limits.cpu_time = test_limits.cpu_time;
+  }
+  if (test_limits.open_files.has_value()) {
+    limits.open_files = test_limits.open_files;
+  }
+  return limits;
+}
+
+void ApplyResourceLimits(const ResourceLimits& limits) {
+  if (limits.address_space_bytes.has_value()) {
+    SetLimit(RLIMIT_AS, *limits.address_space_bytes, *limits.address_space_bytes, "RLIMIT_AS");
+  }
+  if (limits.cpu_time.has_value()) {
+    // The soft limit sends SIGXCPU. The hard limit one second later sends SIGKILL in case SIGXCPU is ignored.
+    rlim_t seconds = std::max<rlim_t>(limits.cpu_time->count(), 1);
+    SetLimit(RLIMIT_CPU, seconds, seconds + 1, "RLIMIT_CPU");
+  }
+  if (limits.open_files.has_value()) {
+    SetLimit(RLIMIT_NOFILE, *limits.open_files, *limits.open_files, "RLIMIT_NOFILE");
+  }
+}
+
+TestResults RunIsolated(const string& qualified_test_label,
+                        const ResourceLimits& limits,
+                        std::ostream& os,
+                        const IsolatedTestFunction& run_test) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    return LimitExceeded(
+        os, qualified_test_label, TestErrorKind::kCrashed, "could not be isolated: " + string(strerror(errno)));
+  }
+  // Anything still buffered would be written by both processes.
+  os.flush();
+  std::cout.flush();
+  fflush(nullptr);
+  pid_t child = fork();
+  if (child < 0) {
+    string error = strerror(errno);
+    close(fds[0]);
+    close(fds[1]);
+    return LimitExceeded(os, qualified_test_label, TestErrorKind::kCrashed, "could not be isolated: " + error);
+  }
+  if (child == 0) {
+    close(fds[0]);
+    RunChild(fds[1], qualified_test_label, limits, run_test);
+  }
+
+  close(fds[1]);
+  string payload = ReadAll(fds[0]);
+  close(fds[0]);
+  int status = 0;
+  rusage usage = {};
+  while (wait4(child, &status, 0, &usage) < 0 && errno == EINTR) {
+  }
+
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    try {
+      std::istringstream is(payload);
+      size_t output_size;
+      if (is >> output_size && is.get() == '\n') {
+        string output(output_size, '\0');
+        if (is.read(output.data(), output_size)) {
+          TestResults results = ReadTestResults(is);
+          os << output;
+          return results;
+        }
+      }
+    } catch (const std::runtime_error&) {
+      // Fall through and report the test as crashed.
+    }
+  }
+  if (WIFSIGNALED(status)) {
+    int signal_number = WTERMSIG(status);
+    // SIGKILL is only the CPU time limit if the child used up its CPU time. Anything else could have sent it.
+    double cpu_seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    if (limits.cpu_time.has_value() &&
+        (signal_number == SIGXCPU ||
+         (signal_number == SIGKILL && cpu_seconds >= std::max<rlim_t>(limits.cpu_time->count(), 1)))) {
+      return LimitExceeded(os,
+                           qualified_test_label,
+                           TestErrorKind::kCpuTimeLimit,
+                           "exceeded its CPU time limit of " + std::to_string(limits.cpu_time->count()) + " seconds.");
+    }
+    return LimitExceeded(os,
+                         qualified_test_label,
+                         TestErrorKind::kCrashed,
+                         "was killed by signal " + std::to_string(signal_number) + " (" + strsignal(signal_number) +
+                             ").");
+  }
+  return LimitExceeded(os,
+                       qualified_test_label,
+                       TestErrorKind::kCrashed,
+                       "exited with status " + std::to_string(WEXITSTATUS(status)) + " without reporting results.");
+}
+
+}  // End namespace TinyTest
@@ -0,0 +1,187 @@
+#ifndef TinyTest__isolation_h__
+#define TinyTest__isolation_h__
+/***************************************************************************************
+ * @file isolation.h                                                                   *
+ *                                                                                     *
+ * @brief Defines functions for running each test in its own resource limited process. *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup isolation Isolation
+///
+/// Isolated tests run in a child process made with fork so a test that runs away can be stopped without taking the
+/// rest of the run with it. The child applies ResourceLimits with setrlimit before running the test and sends its
+/// output and TestResults back to the parent through a pipe. Limit violations are reported as errors with their own
+/// TestErrorKind and the test counts as failed.
+///
+/// Because the test runs in a child process, before_each and after_each also run in the child. Their side effects are
+/// not visible to the parent or to later tests.
+
+/// @addtogroup isolation
+/// @{
+
+/// @brief The resource limits applied to an isolated test. Limits that are not set are inherited from the parent.
+struct ResourceLimits {
+  /// @brief The most bytes of address space the test may use. This is RLIMIT_AS.
+  std::optional<uint64_t> address_space_bytes;
+  /// @brief The most CPU time the test may use. This is RLIMIT_CPU.
+  std::optional<std::chrono::seconds> cpu_time;
+  /// @brief The most file descriptors the test may have open, including the ones it inherits. This is RLIMIT_NOFILE.
+  std::optional<uint64_t> open_files;
+};
+
+/// @brief Combines the limits for a suite and a test.
+/// @param suite_limits The limits for every test in the suite.
+/// @param test_limits The limits for one test. These take priority over suite_limits.
+/// @return The limits to apply to the test.
+ResourceLimits MergeResourceLimits(const ResourceLimits& suite_limits, const ResourceLimits& test_limits);
+
+/// @brief Applies limits to the current process with setrlimit.
+/// @param limits The limits to apply.
+/// @throws std::runtime_error if a limit can not be applied.
+void ApplyResourceLimits(const ResourceLimits& limits);
+
+/// @brief This is a type that represents a function that runs a test and records its results.
+using IsolatedTestFunction = std::function<void(std::ostream& os, TestResults& results)>;
+
+/// @brief Runs a test in a child process with limits applied and returns its results.
+///
+/// The output of the test is written to os after the child finishes. If the child runs out of memory, uses too much
+/// CPU time, fails with every allowed file descriptor open, or crashes, the results hold a single error of the
+/// matching TestErrorKind and a failed test.
+/// @param qualified_test_label The label of the test including the suite label.
+/// @param limits The limits to apply in the child.
+/// @param os The stream to write the output of the test to.
+/// @param run_test The function that runs the test in the child.
+/// @return The results of the test.
+TestResults RunIsolated(const std::string& qualified_test_label,
+                        const ResourceLimits& limits,
+                        std::ostream& os,
+                        const IsolatedTestFunction& run_test);
+
+/// @brief This is a type that represents a test run in its own process. It is used by ExecuteSuiteIsolated.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+template <typename TResult, typename... TInputParams>
+using IsolatedTestTuple = std::tuple<
+    /// test_name
+    std::string,
+    /// test - The test to run.
+    const TestTuple<TResult, TInputParams...>*,
+    /// limits - The limits to apply while running the test.
+    ResourceLimits>;
+
+/// @brief Executes a single test in its own process.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite.
+/// @param test_data The test to execute and its limits.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const IsolatedTestTuple<TResult, TInputParams...>& test_data);
+
+/// @brief Executes a TestSuite with each test in its own resource limited process.
+///
+/// before_all and after_all run in this process.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param tests An std::initializer_list of test runs.
+/// @param suite_limits The limits applied to every test.
+/// @param test_limits Limits for individual tests by test label. These take priority over suite_limits.
+/// @param suite_Compare A function used to Compare the expected and actual test results.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @return The results of the suite.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteIsolated(std::string suite_label,
+                                 std::function<TResult(TInputParams...)> function_to_test,
+                                 std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                 ResourceLimits suite_limits = {},
+                                 std::map<std::string, ResourceLimits> test_limits = {},
+                                 MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt,
+                                 MaybeTestConfigureFunction before_all = std::nullopt,
+                                 MaybeTestConfigureFunction after_all = std::nullopt,
+                                 bool is_enabled = true);
+/// @}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const IsolatedTestTuple<TResult, TInputParams...>& test_data) {
+  const TestTuple<TResult, TInputParams...>& test = *std::get<1>(test_data);
+  const std::string& test_label = std::get<0>(test);
+  if (!std::get<6>(test)) {
+    SkipTest(os, results, suite_label, test_label);
+    return;
+  }
+  // Events published by the child never reach this process so they are published again here.
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PublishTestBegin(suite_label, test_label);
+  IsolatedTestFunction run_test = [&](std::ostream& child_os, TestResults& child_results) {
+    ExecuteTest(child_os, child_results, suite_label, function_to_test, suite_Compare, test);
+  };
+  TestResults test_results = RunIsolated(suite_label + "::" + test_label, std::get<2>(test_data), os, run_test);
+  PublishTestEnd(suite_label,
+                 test_label,
+                 test_results.Passed() > 0 ? TestOutcome::kPassed : TestOutcome::kFailed,
+                 test_results.Errors() > 0,
+                 std::chrono::steady_clock::now() - start);
+  results += test_results;
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteIsolated(std::string suite_label,
+                                 std::function<TResult(TInputParams...)> function_to_test,
+                                 std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                 ResourceLimits suite_limits,
+                                 std::map<std::string, ResourceLimits> test_limits,
+                                 MaybeTestCompareFunction<TResult> suite_Compare,
+                                 MaybeTestConfigureFunction before_all,
+                                 MaybeTestConfigureFunction after_all,
+                                 bool is_enabled) {
+  std::vector<IsolatedTestTuple<TResult, TInputParams...>> isolated_tests;
+  isolated_tests.reserve(tests.size());
+  for (const TestTuple<TResult, TInputParams...>& test : tests) {
+    auto limits = test_limits.find(std::get<0>(test));
+    isolated_tests.emplace_back(
+        std::get<0>(test),
+        &test,
+        limits == test_limits.end() ? suite_limits : MergeResourceLimits(suite_limits, limits->second));
+  }
+  return ExecuteSuiteTests(
+      suite_label, function_to_test, isolated_tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__isolation_h__)
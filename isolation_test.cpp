@@ -0,0 +1,247 @@
+/***************************************************************************************
+ * @file isolation_test.cpp                                                            *
+ *                                                                                     *
+ * @brief Tests for running tests in resource limited processes.                       *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "isolation.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::map;
+using std::string;
+using std::tuple;
+using std::vector;
+using testing::Eq;
+using testing::HasSubstr;
+using TinyTest::ExecuteSuiteIsolated;
+using TinyTest::MakeTest;
+using TinyTest::MergeResourceLimits;
+using TinyTest::ResourceLimits;
+using TinyTest::RunIsolated;
+using TinyTest::TestErrorKind;
+using TinyTest::TestResults;
+
+// Runs a suite of one test named "Test" that calls body.
+TestResults ExecuteOneIsolatedTest(function<int()> body, ResourceLimits limits) {
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuiteIsolated("Isolated", body, {MakeTest("Test", 1, tuple())}, limits);
+  };
+  TinyTest::InterceptCout(wrapper);
+  return results;
+}
+
+TEST(MergeResourceLimits, ShouldPreferTheTestLimits) {
+  ResourceLimits suite_limits;
+  suite_limits.address_space_bytes = 1024;
+  suite_limits.cpu_time = std::chrono::seconds(5);
+  ResourceLimits test_limits;
+  test_limits.cpu_time = std::chrono::seconds(1);
+  test_limits.open_files = 32;
+
+  ResourceLimits limits = MergeResourceLimits(suite_limits, test_limits);
+  EXPECT_THAT(limits.address_space_bytes, Eq(1024));
+  EXPECT_THAT(limits.cpu_time, Eq(std::chrono::seconds(1)));
+  EXPECT_THAT(limits.open_files, Eq(32));
+}
+
+TEST(RunIsolated, ShouldReturnTheResultsAndOutputOfTheChild) {
+  std::ostringstream os;
+  TestResults results = RunIsolated("Suite::Test", {}, os, [](std::ostream& child_os, TestResults& child_results) {
+    child_os << "from the child" << std::endl;
+    child_results.Pass().Fail("Suite::Test failed");
+  });
+  EXPECT_THAT(os.str(), Eq("from the child\n"));
+  EXPECT_THAT(results.Total(), Eq(2));
+  EXPECT_THAT(results.FailureMessages(), Eq(vector<string>({"Suite::Test failed"})));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldRunEachTestLikeExecuteSuite) {
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuiteIsolated("Isolated Double",
+                                   function<int(int)>([](int value) { return value * 2; }),
+                                   {
+                                       MakeTest("Passes", 4, make_tuple(2)),
+                                       MakeTest("Fails", 5, make_tuple(2)),
+                                   });
+  };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Total(), Eq(2));
+  EXPECT_THAT(results.Passed(), Eq(1));
+  EXPECT_THAT(results.FailureMessages(), Eq(vector<string>({"Isolated Double::Fails expected: 5, actual: 4"})));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldReportTestsThatExceedTheirMemoryLimit) {
+  ResourceLimits limits;
+  limits.address_space_bytes = 1024ULL * 1024 * 1024;
+  TestResults results = ExecuteOneIsolatedTest(
+      []() {
+        vector<char> hog(4ULL * 1024 * 1024 * 1024, 1);
+        return static_cast<int>(hog.back());
+      },
+      limits);
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.Errors(TestErrorKind::kMemoryLimit), Eq(1));
+  EXPECT_THAT(results.ErrorMessages().at(0), HasSubstr("Isolated::Test exceeded its address space limit"));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldLetTestsWithoutAMemoryLimitCatchBadAlloc) {
+  TestResults results = ExecuteOneIsolatedTest(
+      []() {
+        try {
+          ::operator delete(::operator new(std::numeric_limits<size_t>::max() / 2));
+          return 0;
+        } catch (const std::bad_alloc&) {
+          return 1;
+        }
+      },
+      {});
+  EXPECT_THAT(results.Passed(), Eq(1));
+  EXPECT_THAT(results.Errors(), Eq(0));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldReportTestsThatExceedTheirCpuTimeLimit) {
+  ResourceLimits limits;
+  limits.cpu_time = std::chrono::seconds(1);
+  TestResults results = ExecuteOneIsolatedTest(
+      []() {
+        volatile unsigned int spin = 0;
+        while (true) {
+          spin = spin + 1;
+        }
+        return 1;
+      },
+      limits);
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.Errors(TestErrorKind::kCpuTimeLimit), Eq(1));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldReportTestsThatLeakEveryFileDescriptor) {
+  ResourceLimits limits;
+  limits.open_files = 64;
+  TestResults results = ExecuteOneIsolatedTest(
+      []() {
+        int fd;
+        while ((fd = open("/dev/null", O_RDONLY)) >= 0) {
+        }
+        return fd;
+      },
+      limits);
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.Errors(TestErrorKind::kOpenFileLimit), Eq(1));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldNotBlameTheFileDescriptorLimitForPassingTests) {
+  ResourceLimits limits;
+  limits.open_files = 64;
+  TestResults results = ExecuteOneIsolatedTest(
+      []() {
+        while (open("/dev/null", O_RDONLY) >= 0) {
+        }
+        return 1;
+      },
+      limits);
+  EXPECT_THAT(results.Passed(), Eq(1));
+  EXPECT_THAT(results.Errors(), Eq(0));
+}
+
+TEST(RunIsolated, ShouldFlushWhatTheChildPrintedToStdout) {
+  FILE* capture = tmpfile();
+  ASSERT_NE(capture, nullptr);
+  fflush(stdout);
+  int saved_stdout = dup(STDOUT_FILENO);
+  dup2(fileno(capture), STDOUT_FILENO);
+  std::ostringstream os;
+  RunIsolated("Suite::Test", {}, os, [](std::ostream&, TestResults& child_results) {
+    printf("from printf");
+    child_results.Pass();
+  });
+  fflush(stdout);
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(saved_stdout);
+  char printed[32] = {};
+  rewind(capture);
+  size_t length = fread(printed, 1, sizeof(printed) - 1, capture);
+  fclose(capture);
+  EXPECT_THAT(string(printed, length), Eq("from printf"));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldReportTestsThatCrash) {
+  TestResults results = ExecuteOneIsolatedTest(
+      []() {
+        std::abort();
+        return 1;
+      },
+      {});
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.Errors(TestErrorKind::kCrashed), Eq(1));
+  EXPECT_THAT(results.ErrorMessages().at(0), HasSubstr("Isolated::Test was killed by signal"));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldReportKillsBeforeTheCpuTimeLimitAsCrashes) {
+  ResourceLimits limits;
+  limits.cpu_time = std::chrono::seconds(5);
+  TestResults results = ExecuteOneIsolatedTest(
+      []() {
+        raise(SIGKILL);
+        return 1;
+      },
+      limits);
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.Errors(TestErrorKind::kCpuTimeLimit), Eq(0));
+  EXPECT_THAT(results.Errors(TestErrorKind::kCrashed), Eq(1));
+}
+
+TEST(ExecuteSuiteIsolated, ShouldApplyTestLimitsOverSuiteLimits) {
+  ResourceLimits suite_limits;
+  suite_limits.open_files = 16;
+  ResourceLimits roomy;
+  roomy.open_files = 256;
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuiteIsolated("Isolated Files",
+                                   function<int(int)>([](int count) {
+                                     for (int index = 0; index < count; index++) {
+                                       if (open("/dev/null", O_RDONLY) < 0) {
+                                         return index;
+                                       }
+                                     }
+                                     return count;
+                                   }),
+                                   {
+                                       MakeTest("Small", 4, make_tuple(4)),
+                                       MakeTest("Large", 100, make_tuple(100)),
+                                   },
+                                   suite_limits,
+                                   map<string, ResourceLimits>({{"Large", roomy}}));
+  };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Total(), Eq(2));
+  EXPECT_THAT(results.Passed(), Eq(2));
+}
+}  // End namespace
@@ -0,0 +1,370 @@
+/***************************************************************************************
+ * @file load_generator.cpp                                                            *
+ *                                                                                     *
+ * @brief Defines an open loop load generator that checks latency against SLOs.        *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "load_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TinyTest {
+namespace {
+using std::endl;
+using std::string;
+using std::vector;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+// Each power of two is split into 2^kSubBucketBits buckets.
+constexpr int kSubBucketBits = 4;
+constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+
+size_t BucketIndex(uint64_t value) {
+  if (value < kSubBuckets) {
+    return value;
+  }
+  int exponent = 63 - __builtin_clzll(value);
+  uint64_t sub_bucket = (value >> (exponent - kSubBucketBits)) - kSubBuckets;
+  return kSubBuckets + (exponent - kSubBucketBits) * kSubBuckets + sub_bucket;
+}
+
+// Gets the largest value that falls in a bucket.
+uint64_t BucketUpperBound(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  int exponent = (index - kSubBuckets) / kSubBuckets + kSubBucketBits;
+  uint64_t sub_bucket = (index - kSubBuckets) % kSubBuckets;
+  uint64_t width = uint64_t(1) << (exponent - kSubBucketBits);
+  return (kSubBuckets + sub_bucket) * width + (width - 1);
+}
+
+// Formats a percentile like p50, p99, or p99.9.
+string FormatPercentile(double percentile) {
+  char formatted[32];
+  snprintf(formatted, sizeof(formatted), "p%g", percentile * 100);
+  return formatted;
+}
+
+string FormatRate(double requests_per_second) {
+  char formatted[32];
+  snprintf(formatted, sizeof(formatted), "%.1f/s", requests_per_second);
+  return formatted;
+}
+// Formats a cell of a table right aligned in a column as wide as its heading.
+string FormatCell(const string& value, const string& heading) {
+  size_t width = std::max<size_t>(heading.size(), 10);
+  return string(value.size() < width ? width - value.size() : 0, ' ') + value;
+}
+}  // End namespace
+
+// Begin LatencyHistogram methods
+LatencyHistogram::LatencyHistogram() : buckets_(), count_(0), max_(0) {}
+
+void LatencyHistogram::Record(nanoseconds latency) {
+  uint64_t value = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0;
+  buckets_[BucketIndex(value)]++;
+  count_++;
+  max_ = std::max(max_, nanoseconds(value));
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (size_t index = 0; index < kBuckets; index++) {
+    buckets_[index] += other.buckets_[index];
+  }
+  count_ += other.count_;
+  max_ = std::max(max_, other.max_);
+}
+
+uint64_t LatencyHistogram::Count() const {
+  return count_;
+}
+
+nanoseconds LatencyHistogram::Max() const {
+  return max_;
+}
+
+nanoseconds LatencyHistogram::Percentile(double fraction) const {
+  if (count_ == 0) {
+    return nanoseconds(0);
+  }
+  uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * count_)));
+  uint64_t seen = 0;
+  for (size_t index = 0; index < kBuckets; index++) {
+    seen += buckets_[index];
+    if (seen >= target) {
+      return std::min(max_, nanoseconds(BucketUpperBound(index)));
+    }
+  }
+  return max_;
+}
+// End LatencyHistogram methods
+
+LoadReport GenerateLoad(const LoadOptions& options, const std::function<void()>& call) {
+  if (!(options.requests_per_second > 0) || options.worker_threads == 0) {
+    throw std::invalid_argument("Load needs a positive requests_per_second and at least one worker thread.");
+  }
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<steady_clock::time_point> scheduled;
+  bool is_scheduling = true;
+  LoadReport report = {0, 0, std::nullopt, nanoseconds(0), LatencyHistogram()};
+  vector<LatencyHistogram> latencies(options.worker_threads);
+  vector<uint64_t> errors(options.worker_threads, 0);
+  vector<steady_clock::time_point> last_finish(options.worker_threads);
+
+  vector<std::thread> workers;
+  for (size_t worker = 0; worker < options.worker_threads; worker++) {
+    workers.emplace_back([&, worker]() {
+      while (true) {
+        steady_clock::time_point intended_start;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          changed.wait(lock, [&]() { return !scheduled.empty() || !is_scheduling; });
+          if (scheduled.empty()) {
+            return;
+          }
+          intended_start = scheduled.front();
+          scheduled.pop_front();
+        }
+        try {
+          call();
+        } catch (...) {
+          errors[worker]++;
+          string error = DescribeCaughtException(std::current_exception());
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!report.first_error.has_value()) {
+            report.first_error = error;
+          }
+        }
+        last_finish[worker] = steady_clock::now();
+        latencies[worker].Record(last_finish[worker] - intended_start);
+      }
+    });
+  }
+
+  // The scheduler releases each request at its intended start whether or not a worker is free to take it.
+  std::mt19937_64 random(options.seed);
+  std::exponential_distribution<double> gap(options.requests_per_second);
+  const double duration_seconds = std::chrono::duration<double>(options.duration).count();
+  steady_clock::time_point start = steady_clock::now();
+  double offset_seconds = 0;
+  for (uint64_t request = 0; offset_seconds < duration_seconds; request++) {
+    steady_clock::time_point intended_start =
+        start + std::chrono::duration_cast<nanoseconds>(std::chrono::duration<double>(offset_seconds));
+    std::this_thread::sleep_until(intended_start);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      scheduled.push_back(intended_start);
+    }
+    changed.notify_one();
+    offset_seconds = options.arrival_process == ArrivalProcess::kConstant
+                         ? (request + 1) / options.requests_per_second
+                         : offset_seconds + gap(random);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    is_scheduling = false;
+  }
+  changed.notify_all();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  steady_clock::time_point finish = start;
+  for (size_t worker = 0; worker < options.worker_threads; worker++) {
+    report.latency.Merge(latencies[worker]);
+    report.errors += errors[worker];
+    if (latencies[worker].Count() > 0) {
+      finish = std::max(finish, last_finish[worker]);
+    }
+  }
+  report.requests = report.latency.Count();
+  report.elapsed = finish - start;
+  return report;
+}
+
+vector<string> CheckLatencySlos(const LoadReport& report, const vector<LatencySlo>& slos) {
+  vector<string> missed;
+  for (const LatencySlo& slo : slos) {
+    nanoseconds latency = report.latency.Percentile(slo.percentile);
+    if (latency > slo.max_latency) {
+      missed.push_back(FormatPercentile(slo.percentile) + " latency " + FormatDuration(latency) +
+                       " is over the SLO of " + FormatDuration(slo.max_latency));
+    }
+  }
+  return missed;
+}
+
+void PrintLatencyPercentiles(std::ostream& os, const LatencyHistogram& latency) {
+  for (double percentile : {0.5, 0.9, 0.99, 0.999}) {
+    os << FormatPercentile(percentile) << " " << FormatDuration(latency.Percentile(percentile)) << ", ";
+  }
+  os << "max " << FormatDuration(latency.Max()) << endl;
+}
+
+void PrintLoadReport(std::ostream& os, const LoadReport& report, const LoadOptions& options) {
+  double elapsed_seconds = std::chrono::duration<double>(report.elapsed).count();
+  os << "    📈" << report.requests << " requests in " << FormatDuration(report.elapsed) << " ("
+     << FormatRate(options.requests_per_second) << " scheduled, "
+     << FormatRate(elapsed_seconds > 0 ? report.requests / elapsed_seconds : 0) << " served): ";
+  PrintLatencyPercentiles(os, report.latency);
+}
+
+TestOutcome ReportLoadOutcome(std::ostream& os,
+                              TestResults& results,
+                              const string& qualified_test_label,
+                              const LoadReport& report,
+                              const vector<LatencySlo>& slos) {
+  if (report.first_error.has_value()) {
+    ReportTestError(os,
+                    results,
+                    qualified_test_label,
+                    *report.first_error + " (" + std::to_string(report.errors) + " of " +
+                        std::to_string(report.requests) + " requests threw)");
+  }
+  vector<string> problems = CheckLatencySlos(report, slos);
+  if (report.first_error.has_value()) {
+    problems.push_back(std::to_string(report.errors) + " of " + std::to_string(report.requests) + " requests threw");
+  }
+  if (!problems.empty()) {
+    string message;
+    for (const string& problem : problems) {
+      message += (message.empty() ? "" : ", ") + problem;
+    }
+    os << "    ❌FAILED: " << message << endl;
+    results.Fail(qualified_test_label + " " + message);
+    return TestOutcome::kFailed;
+  }
+  results.Pass();
+  os << "    ✅PASSED" << endl;
+  return TestOutcome::kPassed;
+}
+
+CapacitySearchResult SearchCapacity(const CapacitySearchOptions& options,
+                                    const vector<LatencySlo>& slos,
+                                    const LoadFunction& run_load) {
+  if (!(options.start_requests_per_second > 0) ||
+      !(options.max_requests_per_second >= options.start_requests_per_second) || !(options.ramp_factor > 1) ||
+      !(options.precision > 0)) {
+    throw std::invalid_argument(
+        "A capacity search needs a positive start rate, a max rate at least the start rate, a ramp factor over 1, and "
+        "a positive precision.");
+  }
+  CapacitySearchResult result;
+  auto is_sustainable_at = [&](double requests_per_second) {
+    LoadOptions load = options.load;
+    load.requests_per_second = requests_per_second;
+    LoadReport report = run_load(load);
+    double elapsed_seconds = std::chrono::duration<double>(report.elapsed).count();
+    CapacityPoint point = {requests_per_second,
+                           elapsed_seconds > 0 ? report.requests / elapsed_seconds : 0,
+                           {},
+                           report.errors,
+                           report.errors == 0 && CheckLatencySlos(report, slos).empty()};
+    for (const LatencySlo& slo : slos) {
+      point.slo_latencies.push_back(report.latency.Percentile(slo.percentile));
+    }
+    result.curve.push_back(point);
+    return point.is_sustainable;
+  };
+
+  // Ramp up exponentially until a rate is not sustainable.
+  double highest_passing = 0;
+  std::optional<double> lowest_failing;
+  size_t steps = 0;
+  for (double rate = options.start_requests_per_second; steps < options.max_steps; rate *= options.ramp_factor) {
+    rate = std::min(rate, options.max_requests_per_second);
+    steps++;
+    if (!is_sustainable_at(rate)) {
+      lowest_failing = rate;
+      break;
+    }
+    highest_passing = rate;
+    if (rate >= options.max_requests_per_second) {
+      break;
+    }
+  }
+
+  // Bisect between the highest sustainable rate and the lowest unsustainable one.
+  while (lowest_failing.has_value() && steps < options.max_steps &&
+         *lowest_failing - highest_passing > options.precision * *lowest_failing) {
+    double rate = (highest_passing + *lowest_failing) / 2;
+    steps++;
+    if (is_sustainable_at(rate)) {
+      highest_passing = rate;
+    } else {
+      lowest_failing = rate;
+    }
+  }
+
+  std::sort(result.curve.begin(), result.curve.end(), [](const CapacityPoint& left, const CapacityPoint& right) {
+    return left.requests_per_second < right.requests_per_second;
+  });
+  if (highest_passing > 0) {
+    result.sustainable_requests_per_second = highest_passing;
+  }
+  return result;
+}
+
+CapacitySearchResult SearchCapacity(const CapacitySearchOptions& options,
+                                    const vector<LatencySlo>& slos,
+                                    const std::function<void()>& call) {
+  return SearchCapacity(options, slos, [&call](const LoadOptions& load) { return GenerateLoad(load, call); });
+}
+
+void PrintCapacityCurve(std::ostream& os,
+                        const CapacitySearchResult& result,
+                        const vector<LatencySlo>& slos,
+                        const CapacitySearchOptions& options) {
+  vector<string> headings = {"Requests/s", "Served/s"};
+  for (const LatencySlo& slo : slos) {
+    headings.push_back(FormatPercentile(slo.percentile));
+  }
+  headings.push_back("Errors");
+  headings.push_back("Meets SLOs");
+  os << "   ";
+  for (const string& heading : headings) {
+    os << " " << FormatCell(heading, heading);
+  }
+  os << endl;
+  for (const CapacityPoint& point : result.curve) {
+    vector<string> cells = {FormatRate(point.requests_per_second), FormatRate(point.served_per_second)};
+    for (nanoseconds latency : point.slo_latencies) {
+      cells.push_back(FormatDuration(latency));
+    }
+    cells.push_back(std::to_string(point.errors));
+    cells.push_back(point.is_sustainable ? "yes" : "no");
+    os << "   ";
+    for (size_t column = 0; column < cells.size() && column < headings.size(); column++) {
+      os << " " << FormatCell(cells[column], headings[column]);
+    }
+    os << endl;
+  }
+  if (result.sustainable_requests_per_second.has_value()) {
+    os << "    🎯Sustainable: " << FormatRate(*result.sustainable_requests_per_second) << " on "
+       << options.load.worker_threads << " worker threads" << endl;
+  } else {
+    // A failing start rate is bisected downward, so the curve's first point is the lowest rate tried.
+    double lowest_rate =
+        result.curve.empty() ? options.start_requests_per_second : result.curve.front().requests_per_second;
+    os << "    🎯No rate from " << FormatRate(lowest_rate) << " met the SLOs on "
+       << options.load.worker_threads << " worker threads" << endl;
+  }
+}
+
+}  // End namespace TinyTest
@@ -0,0 +1,489 @@
+#ifndef TinyTest__load_generator_h__
+#define TinyTest__load_generator_h__
+/***************************************************************************************
+ * @file load_generator.h                                                              *
+ *                                                                                     *
+ * @brief Defines an open loop load generator that checks latency against SLOs.        *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup load_generator Load Generator
+///
+/// Calling function_to_test again as soon as the last call returns understates its tail latency. A slow call delays
+/// every call after it, but only the slow call is measured as slow. A service sees requests arrive on their own
+/// schedule whether or not it is keeping up.
+///
+/// ExecuteLoadSuite drives function_to_test the same way. A scheduler thread releases requests at a fixed rate with
+/// constant or Poisson distributed gaps, and a pool of worker threads serves them. The latency of a request is measured
+/// from when it was scheduled to start, not from when a worker picked it up, so time spent waiting behind slow requests
+/// is counted. Latencies are recorded in a LatencyHistogram and each row passes if its latency percentiles are within
+/// its LatencySlos. The scheduler sleeps until each start, so the few tens of microseconds it takes to wake up are
+/// counted too.
+///
+/// ExecuteCapacitySearchSuite finds the highest rate each row meets its SLOs at instead. It doubles the rate until the
+/// SLOs are missed and then bisects between the last rate that met them and the first that did not. Every rate tried is
+/// printed as a row of a table, so the knee where latency starts to climb can be seen.
+///
+/// function_to_test is called from several threads at once, so it must be thread safe.
+/// @code{.cpp}
+/// TinyTest::LoadOptions options;
+/// options.requests_per_second = 5000;
+/// results += ExecuteLoadSuite("Lookup", lookup, {rows...}, options, {{0.99, std::chrono::milliseconds(2)}});
+/// @endcode
+
+/// @addtogroup load_generator
+/// @{
+
+/// @brief A histogram of latencies with buckets at most 1/16 of their value wide.
+///
+/// Values under 16 ns have their own bucket. Every power of two above that is split into 16 buckets.
+class LatencyHistogram {
+ public:
+  /// @brief The number of buckets.
+  static constexpr size_t kBuckets = 16 + 60 * 16;
+
+  /// @brief Creates an empty histogram.
+  LatencyHistogram();
+
+  /// @brief Records a latency.
+  /// @param latency The latency. Negative latencies are recorded as zero.
+  void Record(std::chrono::nanoseconds latency);
+
+  /// @brief Adds every latency recorded in another histogram.
+  /// @param other The histogram to add.
+  void Merge(const LatencyHistogram& other);
+
+  /// @brief Gets the number of latencies recorded.
+  /// @return The count.
+  uint64_t Count() const;
+
+  /// @brief Gets the largest latency recorded.
+  /// @return The exact largest latency or zero if nothing was recorded.
+  std::chrono::nanoseconds Max() const;
+
+  /// @brief Gets the latency that a fraction of the recorded latencies are no more than.
+  /// @param fraction The fraction, for example 0.99 for the 99th percentile.
+  /// @return The upper bound of the bucket the percentile is in, but no more than Max.
+  std::chrono::nanoseconds Percentile(double fraction) const;
+
+ private:
+  std::array<uint64_t, kBuckets> buckets_;
+  uint64_t count_;
+  std::chrono::nanoseconds max_;
+};
+
+/// @brief How the gaps between requests are chosen.
+enum class ArrivalProcess {
+  /// @brief Every gap is 1 / requests_per_second.
+  kConstant,
+  /// @brief Gaps are exponentially distributed with a mean of 1 / requests_per_second.
+  kPoisson,
+};
+
+/// @brief Options that control the load put on each row.
+struct LoadOptions {
+  /// @brief The rate requests are scheduled at.
+  double requests_per_second = 1000;
+  /// @brief How the gaps between requests are chosen.
+  ArrivalProcess arrival_process = ArrivalProcess::kPoisson;
+  /// @brief How long requests are scheduled for.
+  std::chrono::nanoseconds duration = std::chrono::seconds(1);
+  /// @brief The number of threads serving requests.
+  size_t worker_threads = 8;
+  /// @brief The seed for the Poisson gaps so runs schedule the same requests.
+  uint64_t seed = 1;
+};
+
+/// @brief A limit on a latency percentile.
+struct LatencySlo {
+  /// @brief The percentile as a fraction, for example 0.99 for the 99th percentile.
+  double percentile;
+  /// @brief The most the percentile may be.
+  std::chrono::nanoseconds max_latency;
+};
+
+/// @brief What happened while load was generated.
+struct LoadReport {
+  /// @brief The number of requests served.
+  uint64_t requests;
+  /// @brief The number of requests that threw.
+  uint64_t errors;
+  /// @brief A description of what the first request to throw threw.
+  std::optional<std::string> first_error;
+  /// @brief The time from the first scheduled start until the last request finished.
+  std::chrono::nanoseconds elapsed;
+  /// @brief The latency of every request measured from when it was scheduled to start.
+  LatencyHistogram latency;
+};
+
+/// @brief Calls call at the rate in options from worker threads and measures the latency of each call.
+/// @param options The options that control the load.
+/// @param call The request to make. It is called from several threads at once.
+/// @return What happened.
+/// @throws std::invalid_argument if options.requests_per_second is not positive or options.worker_threads is zero.
+LoadReport GenerateLoad(const LoadOptions& options, const std::function<void()>& call);
+
+/// @brief Checks the latency of a report against SLOs.
+/// @param report The report.
+/// @param slos The SLOs.
+/// @return A description of each SLO that was missed.
+std::vector<std::string> CheckLatencySlos(const LoadReport& report, const std::vector<LatencySlo>& slos);
+
+/// @brief Prints the 50th, 90th, 99th, and 99.9th percentiles and the maximum of a histogram on one line.
+/// @param os The stream to print to.
+/// @param latency The histogram.
+void PrintLatencyPercentiles(std::ostream& os, const LatencyHistogram& latency);
+
+/// @brief Prints the rate and latency percentiles of a report.
+/// @param os The stream to print to.
+/// @param report The report.
+/// @param options The options the report was generated with.
+void PrintLoadReport(std::ostream& os, const LoadReport& report, const LoadOptions& options);
+
+/// @brief Reports the errors of a report, checks it against SLOs, and records a pass or failure.
+///
+/// A report with errors fails even if it met its SLOs.
+/// @param os The stream to write the outcome to.
+/// @param results The TestResults to update.
+/// @param qualified_test_label The label of the test including the suite label.
+/// @param report The report.
+/// @param slos The SLOs.
+/// @return The outcome of the test.
+TestOutcome ReportLoadOutcome(std::ostream& os,
+                              TestResults& results,
+                              const std::string& qualified_test_label,
+                              const LoadReport& report,
+                              const std::vector<LatencySlo>& slos);
+
+/// @brief Options that control a capacity search.
+struct CapacitySearchOptions {
+  /// @brief The load put on function_to_test at each rate tried. Its requests_per_second is replaced by the rate.
+  LoadOptions load;
+  /// @brief The first rate tried.
+  double start_requests_per_second = 100;
+  /// @brief The highest rate tried.
+  double max_requests_per_second = 1000000;
+  /// @brief Each rate of the ramp is this many times the last one.
+  double ramp_factor = 2;
+  /// @brief The bisection stops when the gap between the highest passing and lowest failing rates is this fraction of
+  /// the failing rate.
+  double precision = 0.05;
+  /// @brief The most rates tried.
+  size_t max_steps = 30;
+  /// @brief A row fails if its sustainable rate is lower than this.
+  double required_requests_per_second = 0;
+};
+
+/// @brief The latency at one rate tried by a capacity search.
+struct CapacityPoint {
+  /// @brief The rate requests were scheduled at.
+  double requests_per_second;
+  /// @brief The rate requests were served at.
+  double served_per_second;
+  /// @brief The latency at the percentile of each SLO in the same order as the SLOs.
+  std::vector<std::chrono::nanoseconds> slo_latencies;
+  /// @brief The number of requests that threw.
+  uint64_t errors;
+  /// @brief True if every SLO was met and no request threw.
+  bool is_sustainable;
+};
+
+/// @brief The result of a capacity search.
+struct CapacitySearchResult {
+  /// @brief Every rate tried ordered by rate.
+  std::vector<CapacityPoint> curve;
+  /// @brief The highest sustainable rate found or nullopt if no rate tried was sustainable.
+  std::optional<double> sustainable_requests_per_second;
+};
+
+/// @brief This is a type that represents a function that puts a load on the code being searched and reports what
+/// happened.
+using LoadFunction = std::function<LoadReport(const LoadOptions& options)>;
+
+/// @brief Finds the highest rate that meets every SLO without errors.
+///
+/// The rate starts at options.start_requests_per_second and is multiplied by options.ramp_factor until a rate fails or
+/// options.max_requests_per_second is reached. The gap between the last passing and first failing rates is then
+/// bisected until it is within options.precision.
+/// @param options The options that control the search.
+/// @param slos The SLOs each rate must meet.
+/// @param run_load The function that puts each load on the code being searched.
+/// @return Every rate tried and the highest sustainable one.
+CapacitySearchResult SearchCapacity(const CapacitySearchOptions& options,
+                                    const std::vector<LatencySlo>& slos,
+                                    const LoadFunction& run_load);
+
+/// @brief Finds the highest rate call can be made at with GenerateLoad that meets every SLO without errors.
+/// @param options The options that control the search.
+/// @param slos The SLOs each rate must meet.
+/// @param call The request to make. It is called from several threads at once.
+/// @return Every rate tried and the highest sustainable one.
+CapacitySearchResult SearchCapacity(const CapacitySearchOptions& options,
+                                    const std::vector<LatencySlo>& slos,
+                                    const std::function<void()>& call);
+
+/// @brief Prints the load latency curve of a capacity search as a table followed by its sustainable rate.
+/// @param os The stream to print to.
+/// @param result The result of the search.
+/// @param slos The SLOs the search checked.
+/// @param options The options of the search.
+void PrintCapacityCurve(std::ostream& os,
+                        const CapacitySearchResult& result,
+                        const std::vector<LatencySlo>& slos,
+                        const CapacitySearchOptions& options);
+
+/// @brief This is a type that represents a row run under load. It is used by ExecuteLoadSuite.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+template <typename TResult, typename... TInputParams>
+using LoadTestTuple = std::tuple<
+    /// test_name - The label of the test.
+    std::string,
+    /// test - The test to run.
+    const TestTuple<TResult, TInputParams...>*,
+    /// options - The load to put on the test.
+    const LoadOptions*,
+    /// slos - The latency SLOs of the test.
+    std::vector<LatencySlo>>;
+
+/// @brief Executes a single test under load and checks its latency against its SLOs.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite. This is ignored.
+/// @param test_data The test to execute with its load and SLOs.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const LoadTestTuple<TResult, TInputParams...>& test_data);
+
+/// @brief Executes a suite with each row under open loop load.
+///
+/// Each row passes if no request threw and its latency percentiles are within its SLOs. Expected values and
+/// compare functions are ignored. before_each and after_each are called once per row around the load.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested. It must be thread safe.
+/// @param tests An std::initializer_list of test runs.
+/// @param options The load to put on each row.
+/// @param suite_slos The SLOs of every test.
+/// @param test_slos The SLOs of individual tests by test label. These replace suite_slos.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @return The results of the suite.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteLoadSuite(std::string suite_label,
+                             std::function<TResult(TInputParams...)> function_to_test,
+                             std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                             LoadOptions options = {},
+                             std::vector<LatencySlo> suite_slos = {},
+                             std::map<std::string, std::vector<LatencySlo>> test_slos = {},
+                             MaybeTestConfigureFunction before_all = std::nullopt,
+                             MaybeTestConfigureFunction after_all = std::nullopt,
+                             bool is_enabled = true);
+
+/// @brief This is a type that represents a row whose capacity is searched for. It is used by
+/// ExecuteCapacitySearchSuite.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+template <typename TResult, typename... TInputParams>
+using CapacityTestTuple = std::tuple<
+    /// test_name - The label of the test.
+    std::string,
+    /// test - The test to run.
+    const TestTuple<TResult, TInputParams...>*,
+    /// options - The options that control the search.
+    const CapacitySearchOptions*,
+    /// slos - The latency SLOs every rate must meet.
+    const std::vector<LatencySlo>*>;
+
+/// @brief Searches for the capacity of a single test and prints its load latency curve.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite. This is ignored.
+/// @param test_data The test to search with its options and SLOs.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const CapacityTestTuple<TResult, TInputParams...>& test_data);
+
+/// @brief Executes a suite that searches for the highest rate each row can be called at while meeting the SLOs.
+///
+/// Each row prints every rate tried with its latency as a table. A row passes if its sustainable rate is at least
+/// options.required_requests_per_second. Expected values and compare functions are ignored. before_each and after_each
+/// are called once per row around the search.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested. It must be thread safe.
+/// @param tests An std::initializer_list of test runs.
+/// @param options The options that control each search.
+/// @param slos The SLOs every rate must meet.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @return The results of the suite.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteCapacitySearchSuite(std::string suite_label,
+                                       std::function<TResult(TInputParams...)> function_to_test,
+                                       std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                       CapacitySearchOptions options,
+                                       std::vector<LatencySlo> slos,
+                                       MaybeTestConfigureFunction before_all = std::nullopt,
+                                       MaybeTestConfigureFunction after_all = std::nullopt,
+                                       bool is_enabled = true);
+/// @}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>&,
+                 const LoadTestTuple<TResult, TInputParams...>& test_data) {
+  // Step 1: Extract our variables from the TestTuple.
+  const TestTuple<TResult, TInputParams...>& test = *std::get<1>(test_data);
+  const std::string& test_label = std::get<0>(test_data);
+  const std::string qualified_test_label = suite_label + "::" + test_label;
+  const LoadOptions& options = *std::get<2>(test_data);
+
+  if (!std::get<6>(test)) {
+    SkipTest(os, results, suite_label, test_label);
+    return;
+  }
+
+  ExecuteTestLifecycle(os, suite_label, test_label, std::get<4>(test), std::get<5>(test), [&]() {
+    // Step 3: Put the test method under load.
+    const std::tuple<TInputParams...>& inputs = std::get<2>(test);
+    LoadReport report =
+        GenerateLoad(options, [&function_to_test, &inputs]() { std::apply(function_to_test, inputs); });
+    PrintLoadReport(os, report, options);
+
+    // Step 4: Pass or fail.
+    TestOutcome outcome = ReportLoadOutcome(os, results, qualified_test_label, report, std::get<3>(test_data));
+    return TestBodyResult{outcome, report.first_error.has_value()};
+  });
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteLoadSuite(std::string suite_label,
+                             std::function<TResult(TInputParams...)> function_to_test,
+                             std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                             LoadOptions options,
+                             std::vector<LatencySlo> suite_slos,
+                             std::map<std::string, std::vector<LatencySlo>> test_slos,
+                             MaybeTestConfigureFunction before_all,
+                             MaybeTestConfigureFunction after_all,
+                             bool is_enabled) {
+  std::vector<LoadTestTuple<TResult, TInputParams...>> load_tests;
+  load_tests.reserve(tests.size());
+  for (const TestTuple<TResult, TInputParams...>& test : tests) {
+    auto slos = test_slos.find(std::get<0>(test));
+    load_tests.emplace_back(std::get<0>(test), &test, &options, slos == test_slos.end() ? suite_slos : slos->second);
+  }
+  MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt;
+  return ExecuteSuiteTests(suite_label, function_to_test, load_tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>&,
+                 const CapacityTestTuple<TResult, TInputParams...>& test_data) {
+  // Step 1: Extract our variables from the TestTuple.
+  const TestTuple<TResult, TInputParams...>& test = *std::get<1>(test_data);
+  const std::string& test_label = std::get<0>(test_data);
+  const std::string qualified_test_label = suite_label + "::" + test_label;
+  const CapacitySearchOptions& options = *std::get<2>(test_data);
+  const std::vector<LatencySlo>& slos = *std::get<3>(test_data);
+
+  if (!std::get<6>(test)) {
+    SkipTest(os, results, suite_label, test_label);
+    return;
+  }
+
+  ExecuteTestLifecycle(os, suite_label, test_label, std::get<4>(test), std::get<5>(test), [&]() {
+    // Step 3: Search for the capacity of the test method.
+    const std::tuple<TInputParams...>& inputs = std::get<2>(test);
+    CapacitySearchResult search =
+        SearchCapacity(options, slos, [&function_to_test, &inputs]() { std::apply(function_to_test, inputs); });
+    PrintCapacityCurve(os, search, slos, options);
+
+    // Step 4: Pass or fail.
+    if (!search.sustainable_requests_per_second.has_value()) {
+      os << "    ❌FAILED: no rate met the SLOs" << std::endl;
+      results.Fail(qualified_test_label + " no rate met the SLOs");
+      return TestBodyResult{TestOutcome::kFailed, false};
+    }
+    if (*search.sustainable_requests_per_second < options.required_requests_per_second) {
+      std::string message =
+          "the sustainable rate of " + std::to_string(static_cast<uint64_t>(*search.sustainable_requests_per_second)) +
+          "/s is below the required " + std::to_string(static_cast<uint64_t>(options.required_requests_per_second)) +
+          "/s";
+      os << "    ❌FAILED: " << message << std::endl;
+      results.Fail(qualified_test_label + " " + message);
+      return TestBodyResult{TestOutcome::kFailed, false};
+    }
+    results.Pass();
+    os << "    ✅PASSED" << std::endl;
+    return TestBodyResult{TestOutcome::kPassed, false};
+  });
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteCapacitySearchSuite(std::string suite_label,
+                                       std::function<TResult(TInputParams...)> function_to_test,
+                                       std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                       CapacitySearchOptions options,
+                                       std::vector<LatencySlo> slos,
+                                       MaybeTestConfigureFunction before_all,
+                                       MaybeTestConfigureFunction after_all,
+                                       bool is_enabled) {
+  std::vector<CapacityTestTuple<TResult, TInputParams...>> capacity_tests;
+  capacity_tests.reserve(tests.size());
+  for (const TestTuple<TResult, TInputParams...>& test : tests) {
+    capacity_tests.emplace_back(std::get<0>(test), &test, &options, &slos);
+  }
+  MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt;
+  return ExecuteSuiteTests(
+      suite_label, function_to_test, capacity_tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__load_generator_h__)
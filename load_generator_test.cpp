@@ -0,0 +1,269 @@
+/***************************************************************************************
+ * @file load_generator_test.cpp                                                       *
+ *                                                                                     *
+ * @brief Tests for an open loop load generator that checks latency against SLOs.      *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "load_generator.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::map;
+using std::string;
+using std::vector;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using testing::ElementsAre;
+using testing::Eq;
+using testing::Ge;
+using testing::HasSubstr;
+using testing::Le;
+using testing::Lt;
+using TinyTest::ArrivalProcess;
+using TinyTest::CapacitySearchOptions;
+using TinyTest::CapacitySearchResult;
+using TinyTest::CheckLatencySlos;
+using TinyTest::ExecuteCapacitySearchSuite;
+using TinyTest::ExecuteLoadSuite;
+using TinyTest::GenerateLoad;
+using TinyTest::LatencyHistogram;
+using TinyTest::LatencySlo;
+using TinyTest::LoadOptions;
+using TinyTest::LoadReport;
+using TinyTest::MakeTest;
+using TinyTest::PrintCapacityCurve;
+using TinyTest::SearchCapacity;
+using TinyTest::TestResults;
+
+TEST(LatencyHistogram, ShouldKeepPercentilesWithinASixteenthOfTheirValue) {
+  LatencyHistogram histogram;
+  for (int latency = 1; latency <= 1000; latency++) {
+    histogram.Record(nanoseconds(latency));
+  }
+  EXPECT_THAT(histogram.Count(), Eq(1000));
+  EXPECT_THAT(histogram.Max(), Eq(nanoseconds(1000)));
+  EXPECT_THAT(histogram.Percentile(0.01), Eq(nanoseconds(10)));
+  EXPECT_THAT(histogram.Percentile(0.5), Ge(nanoseconds(500)));
+  EXPECT_THAT(histogram.Percentile(0.5), Le(nanoseconds(500 + 500 / 16)));
+  EXPECT_THAT(histogram.Percentile(1.0), Eq(nanoseconds(1000)));
+
+  LatencyHistogram other;
+  other.Record(milliseconds(3));
+  histogram.Merge(other);
+  EXPECT_THAT(histogram.Count(), Eq(1001));
+  EXPECT_THAT(histogram.Percentile(1.0), Eq(milliseconds(3)));
+}
+
+TEST(GenerateLoad, ShouldScheduleRequestsAtAConstantRate) {
+  LoadOptions options;
+  options.requests_per_second = 2000;
+  options.arrival_process = ArrivalProcess::kConstant;
+  options.duration = milliseconds(50);
+  std::atomic<int> calls = 0;
+  LoadReport report = GenerateLoad(options, [&calls]() { calls++; });
+  EXPECT_THAT(report.requests, Eq(100));
+  EXPECT_THAT(calls.load(), Eq(100));
+  EXPECT_THAT(report.errors, Eq(0));
+  EXPECT_THAT(report.elapsed, Ge(milliseconds(49)));
+}
+
+TEST(GenerateLoad, ShouldCountTimeSpentWaitingBehindSlowRequests) {
+  // One worker gets a request every millisecond but takes two to serve each, so the queue keeps growing.
+  LoadOptions options;
+  options.requests_per_second = 1000;
+  options.arrival_process = ArrivalProcess::kConstant;
+  options.duration = milliseconds(40);
+  options.worker_threads = 1;
+  LoadReport report = GenerateLoad(options, []() { std::this_thread::sleep_for(milliseconds(2)); });
+  EXPECT_THAT(report.requests, Eq(40));
+  EXPECT_THAT(report.latency.Percentile(0.01), Ge(milliseconds(2)));
+  EXPECT_THAT(report.latency.Max(), Ge(milliseconds(30)));
+}
+
+TEST(GenerateLoad, ShouldCountRequestsThatThrow) {
+  LoadOptions options;
+  options.requests_per_second = 1000;
+  options.duration = milliseconds(20);
+  LoadReport report = GenerateLoad(options, []() { throw std::runtime_error("overloaded"); });
+  EXPECT_THAT(report.errors, Eq(report.requests));
+  ASSERT_TRUE(report.first_error.has_value());
+  EXPECT_THAT(*report.first_error, HasSubstr("overloaded"));
+  options.requests_per_second = 0;
+  EXPECT_THROW(GenerateLoad(options, []() {}), std::invalid_argument);
+}
+
+TEST(CheckLatencySlos, ShouldDescribeEachMissedSlo) {
+  LoadReport report = {};
+  for (int latency = 1; latency <= 100; latency++) {
+    report.latency.Record(microseconds(latency * 10));
+  }
+  EXPECT_THAT(CheckLatencySlos(report, {{0.5, milliseconds(1)}, {0.99, microseconds(500)}, {0.999, microseconds(900)}}),
+              ElementsAre("p99 latency 1.0 ms is over the SLO of 500.0 us",
+                          "p99.9 latency 1.0 ms is over the SLO of 900.0 us"));
+}
+
+TEST(ExecuteLoadSuite, ShouldFailRowsWhoseRequestsThrow) {
+  LoadOptions options;
+  options.requests_per_second = 500;
+  options.duration = milliseconds(20);
+  function<int(int)> overloaded = [](int) -> int { throw std::runtime_error("overloaded"); };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteLoadSuite("Overloaded", overloaded, {MakeTest("Throws", 0, make_tuple(0))}, options);
+  };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Total(), Eq(1));
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.Errors(), Eq(1));
+  EXPECT_THAT(results.FailureMessages()[0], HasSubstr("Overloaded::Throws "));
+  EXPECT_THAT(results.FailureMessages()[0], HasSubstr(" requests threw"));
+}
+
+TEST(ExecuteLoadSuite, ShouldCheckEachRowAgainstItsSlos) {
+  LoadOptions options;
+  options.requests_per_second = 500;
+  options.duration = milliseconds(20);
+  function<int(int)> wait = [](int wait_ms) {
+    std::this_thread::sleep_for(milliseconds(wait_ms));
+    return wait_ms;
+  };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteLoadSuite("Wait",
+                               wait,
+                               {MakeTest("Fast", 0, make_tuple(0)), MakeTest("Slow", 0, make_tuple(5))},
+                               options,
+                               {{0.99, milliseconds(4)}},
+                               map<string, vector<LatencySlo>>({{"Slow", {{0.5, milliseconds(1)}}}}));
+  };
+  string output = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Passed(), Eq(1));
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.FailureMessages()[0], HasSubstr("Wait::Slow p50 latency "));
+  EXPECT_THAT(output, HasSubstr(" scheduled, "));
+  EXPECT_THAT(output, HasSubstr("    📈"));
+}
+
+// Makes a load that meets a 1 ms SLO up to capacity_per_second and misses it above.
+TinyTest::LoadFunction MakeFakeLoad(double capacity_per_second, vector<double>& rates) {
+  return [capacity_per_second, &rates](const LoadOptions& options) {
+    rates.push_back(options.requests_per_second);
+    LoadReport report = {};
+    report.elapsed = std::chrono::seconds(1);
+    for (int request = 0; request < 100; request++) {
+      report.latency.Record(options.requests_per_second > capacity_per_second ? milliseconds(5) : microseconds(100));
+    }
+    report.requests = report.latency.Count();
+    return report;
+  };
+}
+
+TEST(SearchCapacity, ShouldRampUpAndThenBisectToTheKnee) {
+  CapacitySearchOptions options;
+  options.start_requests_per_second = 100;
+  options.precision = 0.01;
+  vector<double> rates;
+  CapacitySearchResult result = SearchCapacity(options, {{0.99, milliseconds(1)}}, MakeFakeLoad(1234, rates));
+  ASSERT_THAT(rates.size(), Ge(6));
+  EXPECT_THAT(vector<double>(rates.begin(), rates.begin() + 6), ElementsAre(100, 200, 400, 800, 1600, 1200));
+  ASSERT_TRUE(result.sustainable_requests_per_second.has_value());
+  EXPECT_THAT(*result.sustainable_requests_per_second, Le(1234));
+  EXPECT_THAT(*result.sustainable_requests_per_second, Ge(1234 * 0.99));
+  ASSERT_THAT(result.curve.size(), Eq(rates.size()));
+  for (size_t point = 1; point < result.curve.size(); point++) {
+    EXPECT_THAT(result.curve[point - 1].requests_per_second, Lt(result.curve[point].requests_per_second));
+    EXPECT_THAT(result.curve[point].is_sustainable, Eq(result.curve[point].requests_per_second <= 1234));
+  }
+}
+
+TEST(SearchCapacity, ShouldStopAtTheMaxRateOrMaxSteps) {
+  CapacitySearchOptions options;
+  options.start_requests_per_second = 100;
+  options.max_requests_per_second = 500;
+  vector<double> rates;
+  CapacitySearchResult result = SearchCapacity(options, {{0.99, milliseconds(1)}}, MakeFakeLoad(1000000, rates));
+  EXPECT_THAT(rates, ElementsAre(100, 200, 400, 500));
+  EXPECT_THAT(result.sustainable_requests_per_second, Eq(500));
+
+  rates.clear();
+  options.max_steps = 3;
+  result = SearchCapacity(options, {{0.99, milliseconds(1)}}, MakeFakeLoad(1, rates));
+  EXPECT_THAT(rates, ElementsAre(100, 50, 25));
+  EXPECT_THAT(result.sustainable_requests_per_second, Eq(std::nullopt));
+  options.ramp_factor = 1;
+  EXPECT_THROW(SearchCapacity(options, {}, MakeFakeLoad(1, rates)), std::invalid_argument);
+}
+
+TEST(PrintCapacityCurve, ShouldPrintATableAndTheKnee) {
+  CapacitySearchOptions options;
+  options.load.worker_threads = 4;
+  options.start_requests_per_second = 100;
+  options.max_requests_per_second = 200;
+  vector<double> rates;
+  vector<LatencySlo> slos = {{0.5, milliseconds(1)}, {0.99, milliseconds(1)}};
+  std::ostringstream os;
+  PrintCapacityCurve(os, SearchCapacity(options, slos, MakeFakeLoad(150, rates)), slos, options);
+  EXPECT_THAT(os.str(), HasSubstr("    Requests/s   Served/s        p50        p99     Errors Meets SLOs\n"));
+  EXPECT_THAT(os.str(), HasSubstr("       100.0/s    100.0/s   100.0 us   100.0 us          0        yes\n"));
+  EXPECT_THAT(os.str(), HasSubstr("       200.0/s    100.0/s     5.0 ms     5.0 ms          0         no\n"));
+  EXPECT_THAT(os.str(), HasSubstr("    🎯Sustainable: 150.0/s on 4 worker threads\n"));
+}
+
+TEST(PrintCapacityCurve, ShouldPrintTheLowestRateTriedWhenNoneMeetTheSlos) {
+  CapacitySearchOptions options;
+  options.load.worker_threads = 4;
+  options.start_requests_per_second = 100;
+  options.max_steps = 3;
+  vector<double> rates;
+  vector<LatencySlo> slos = {{0.99, milliseconds(1)}};
+  std::ostringstream os;
+  PrintCapacityCurve(os, SearchCapacity(options, slos, MakeFakeLoad(1, rates)), slos, options);
+  EXPECT_THAT(os.str(), HasSubstr("    🎯No rate from 25.0/s met the SLOs on 4 worker threads\n"));
+}
+
+TEST(ExecuteCapacitySearchSuite, ShouldFailRowsBelowTheRequiredRate) {
+  CapacitySearchOptions options;
+  options.load.duration = milliseconds(20);
+  options.load.worker_threads = 2;
+  options.start_requests_per_second = 100;
+  options.max_requests_per_second = 200;
+  options.max_steps = 4;
+  options.required_requests_per_second = 200;
+  function<int(int)> wait = [](int wait_ms) {
+    std::this_thread::sleep_for(milliseconds(wait_ms));
+    return wait_ms;
+  };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteCapacitySearchSuite("Wait",
+                                         wait,
+                                         {MakeTest("Fast", 0, make_tuple(0)), MakeTest("Slow", 0, make_tuple(50))},
+                                         options,
+                                         {{0.5, milliseconds(20)}});
+  };
+  string output = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Passed(), Eq(1));
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.FailureMessages()[0], HasSubstr("Wait::Slow no rate met the SLOs"));
+  EXPECT_THAT(output, HasSubstr("    🎯Sustainable: 200.0/s on 2 worker threads"));
+}
+}  // End namespace
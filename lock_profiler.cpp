@@ -0,0 +1,261 @@
+/***************************************************************************************
+ * @file lock_profiler.cpp                                                             *
+ *                                                                                     *
+ * @brief Defines instrumented locks and a suite runner that reports their contention. *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "lock_profiler.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace TinyTest {
+
+class LockCounters {
+ public:
+  void RecordAcquisition() { acquisitions_.fetch_add(1, std::memory_order_relaxed); }
+
+  void RecordWait(std::chrono::nanoseconds wait) {
+    uint64_t wait_ns = wait.count() > 0 ? static_cast<uint64_t>(wait.count()) : 0;
+    size_t bucket = wait_ns < 2 ? 0 : 63 - __builtin_clzll(wait_ns);
+    if (bucket >= kLockWaitBuckets) {
+      bucket = kLockWaitBuckets - 1;
+    }
+    acquisitions_.fetch_add(1, std::memory_order_relaxed);
+    contended_.fetch_add(1, std::memory_order_relaxed);
+    total_wait_ns_.fetch_add(wait_ns, std::memory_order_relaxed);
+    wait_histogram_[bucket].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  LockStats Stats() const {
+    LockStats stats;
+    stats.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+    stats.contended = contended_.load(std::memory_order_relaxed);
+    stats.total_wait = std::chrono::nanoseconds(total_wait_ns_.load(std::memory_order_relaxed));
+    for (size_t bucket = 0; bucket < kLockWaitBuckets; bucket++) {
+      stats.wait_histogram[bucket] = wait_histogram_[bucket].load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
+
+ private:
+  std::atomic<uint64_t> acquisitions_ = 0;
+  std::atomic<uint64_t> contended_ = 0;
+  std::atomic<uint64_t> total_wait_ns_ = 0;
+  std::array<std::atomic<uint64_t>, kLockWaitBuckets> wait_histogram_ = {};
+};
+
+namespace {
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::map;
+using std::string;
+using std::vector;
+
+struct LockRegistry {
+  std::mutex mutex;
+  map<string, std::unique_ptr<LockCounters>> counters;
+};
+
+// Never destroyed so locks with static storage duration can still record while the program exits.
+LockRegistry& Registry() {
+  static LockRegistry* registry = new LockRegistry();
+  return *registry;
+}
+
+LockCounters* CountersFor(const string& name) {
+  LockRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::unique_ptr<LockCounters>& counters = registry.counters[name];
+  if (counters == nullptr) {
+    counters = std::make_unique<LockCounters>();
+  }
+  return counters.get();
+}
+
+string FormatPercent(double ratio) {
+  char formatted[32];
+  snprintf(formatted, sizeof(formatted), "%.1f%%", ratio * 100);
+  return formatted;
+}
+
+double ContendedRatio(const LockStats& stats) {
+  return stats.acquisitions == 0 ? 0 : static_cast<double>(stats.contended) / stats.acquisitions;
+}
+}  // End namespace
+
+nanoseconds WaitPercentile(const LockStats& stats, double fraction) {
+  if (stats.contended == 0) {
+    return nanoseconds(0);
+  }
+  uint64_t target = static_cast<uint64_t>(std::ceil(fraction * stats.contended));
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < kLockWaitBuckets; bucket++) {
+    seen += stats.wait_histogram[bucket];
+    if (seen >= target && seen > 0) {
+      return nanoseconds(int64_t(1) << (bucket + 1));
+    }
+  }
+  return nanoseconds(int64_t(1) << kLockWaitBuckets);
+}
+
+map<string, LockStats> SnapshotLockStats() {
+  LockRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  map<string, LockStats> snapshot;
+  for (const auto& [name, counters] : registry.counters) {
+    snapshot[name] = counters->Stats();
+  }
+  return snapshot;
+}
+
+map<string, LockStats> DiffLockStats(const map<string, LockStats>& before, const map<string, LockStats>& after) {
+  map<string, LockStats> diff;
+  for (const auto& [name, stats] : after) {
+    LockStats used = stats;
+    auto previous = before.find(name);
+    if (previous != before.end()) {
+      used.acquisitions -= previous->second.acquisitions;
+      used.contended -= previous->second.contended;
+      used.total_wait -= previous->second.total_wait;
+      for (size_t bucket = 0; bucket < kLockWaitBuckets; bucket++) {
+        used.wait_histogram[bucket] -= previous->second.wait_histogram[bucket];
+      }
+    }
+    if (used.acquisitions > 0) {
+      diff[name] = used;
+    }
+  }
+  return diff;
+}
+
+string FormatLockStats(const LockStats& stats) {
+  string formatted = std::to_string(stats.acquisitions) + " acquisitions, " + std::to_string(stats.contended) +
+                     " contended (" + FormatPercent(ContendedRatio(stats)) + ")";
+  if (stats.contended > 0) {
+    formatted += ", waited " + FormatDuration(stats.total_wait) + ", p50 < " +
+                 FormatDuration(WaitPercentile(stats, 0.5)) + ", p99 < " + FormatDuration(WaitPercentile(stats, 0.99));
+  }
+  return formatted;
+}
+
+vector<string> CheckLockContention(const map<string, LockStats>& stats, const LockContentionThresholds& thresholds) {
+  vector<string> violations;
+  for (const auto& [name, lock_stats] : stats) {
+    if (thresholds.max_contended_ratio.has_value() && ContendedRatio(lock_stats) > *thresholds.max_contended_ratio) {
+      violations.push_back(name + " was contended " + FormatPercent(ContendedRatio(lock_stats)) +
+                           " of the time, more than " + FormatPercent(*thresholds.max_contended_ratio));
+    }
+    if (thresholds.max_total_wait.has_value() && lock_stats.total_wait > *thresholds.max_total_wait) {
+      violations.push_back(name + " was waited for " + FormatDuration(lock_stats.total_wait) + ", more than " +
+                           FormatDuration(*thresholds.max_total_wait));
+    }
+    if (thresholds.max_p99_wait.has_value() && WaitPercentile(lock_stats, 0.99) > *thresholds.max_p99_wait) {
+      violations.push_back(name + " had a p99 wait under " + FormatDuration(WaitPercentile(lock_stats, 0.99)) +
+                           ", more than " + FormatDuration(*thresholds.max_p99_wait));
+    }
+  }
+  return violations;
+}
+
+// Begin ProfiledMutex methods
+ProfiledMutex::ProfiledMutex(const string& name) : counters_(CountersFor(name)) {}
+
+void ProfiledMutex::lock() {
+  if (mutex_.try_lock()) {
+    counters_->RecordAcquisition();
+    return;
+  }
+  steady_clock::time_point start = steady_clock::now();
+  mutex_.lock();
+  counters_->RecordWait(steady_clock::now() - start);
+}
+
+bool ProfiledMutex::try_lock() {
+  if (!mutex_.try_lock()) {
+    return false;
+  }
+  counters_->RecordAcquisition();
+  return true;
+}
+
+void ProfiledMutex::unlock() {
+  mutex_.unlock();
+}
+// End ProfiledMutex methods
+
+// Begin ProfiledSharedMutex methods
+ProfiledSharedMutex::ProfiledSharedMutex(const string& name) : counters_(CountersFor(name)) {}
+
+void ProfiledSharedMutex::lock() {
+  if (mutex_.try_lock()) {
+    counters_->RecordAcquisition();
+    return;
+  }
+  steady_clock::time_point start = steady_clock::now();
+  mutex_.lock();
+  counters_->RecordWait(steady_clock::now() - start);
+}
+
+bool ProfiledSharedMutex::try_lock() {
+  if (!mutex_.try_lock()) {
+    return false;
+  }
+  counters_->RecordAcquisition();
+  return true;
+}
+
+void ProfiledSharedMutex::unlock() {
+  mutex_.unlock();
+}
+
+void ProfiledSharedMutex::lock_shared() {
+  if (mutex_.try_lock_shared()) {
+    counters_->RecordAcquisition();
+    return;
+  }
+  steady_clock::time_point start = steady_clock::now();
+  mutex_.lock_shared();
+  counters_->RecordWait(steady_clock::now() - start);
+}
+
+bool ProfiledSharedMutex::try_lock_shared() {
+  if (!mutex_.try_lock_shared()) {
+    return false;
+  }
+  counters_->RecordAcquisition();
+  return true;
+}
+
+void ProfiledSharedMutex::unlock_shared() {
+  mutex_.unlock_shared();
+}
+// End ProfiledSharedMutex methods
+
+// Begin ProfiledConditionVariable methods
+ProfiledConditionVariable::ProfiledConditionVariable(const string& name) : counters_(CountersFor(name)) {}
+
+void ProfiledConditionVariable::notify_one() noexcept {
+  condition_.notify_one();
+}
+
+void ProfiledConditionVariable::notify_all() noexcept {
+  condition_.notify_all();
+}
+
+void ProfiledConditionVariable::RecordAcquisition() {
+  counters_->RecordAcquisition();
+}
+
+void ProfiledConditionVariable::RecordWait(nanoseconds reacquire_wait) {
+  counters_->RecordWait(reacquire_wait);
+}
+// End ProfiledConditionVariable methods
+
+}  // End namespace TinyTest
@@ -0,0 +1,379 @@
+#ifndef TinyTest__lock_profiler_h__
+#define TinyTest__lock_profiler_h__
+/***************************************************************************************
+ * @file lock_profiler.h                                                               *
+ *                                                                                     *
+ * @brief Defines instrumented locks and a suite runner that reports their contention. *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup lock_profiler Lock Profiler
+///
+/// ProfiledMutex, ProfiledSharedMutex, and ProfiledConditionVariable are drop-in replacements for std::mutex,
+/// std::shared_mutex, and std::condition_variable_any that count how often they are acquired, how often an acquisition
+/// had to wait because another thread held the lock, and how long it waited. Locks are grouped by name, so every lock
+/// of a class can share one name. An acquisition that does not wait costs one try_lock and one atomic increment more
+/// than the standard lock.
+///
+/// ExecuteSuiteWithLockProfiling runs a suite and prints the contention of every lock used by function_to_test after
+/// each test. A row fails if any lock goes over the LockContentionThresholds, even if its result was correct.
+/// @code{.cpp}
+/// class WorkQueue {
+///   TinyTest::ProfiledMutex mutex_{"WorkQueue"};
+///   ...
+/// };
+/// @endcode
+
+/// @addtogroup lock_profiler
+/// @{
+
+/// @brief The number of buckets in a wait histogram. Bucket i counts waits of less than 2^(i+1) ns and at least 2^i ns.
+constexpr size_t kLockWaitBuckets = 40;
+
+/// @brief How a lock, or every lock with the same name, was used.
+struct LockStats {
+  /// @brief The number of times the lock was acquired, shared or exclusive, or for condition variables waited on.
+  uint64_t acquisitions = 0;
+  /// @brief The number of acquisitions that had to wait. A condition variable wait counts if reacquiring its lock after
+  /// the wait had to wait.
+  uint64_t contended = 0;
+  /// @brief The time spent waiting by every contended acquisition together.
+  std::chrono::nanoseconds total_wait = std::chrono::nanoseconds(0);
+  /// @brief The number of contended acquisitions in each wait bucket.
+  std::array<uint64_t, kLockWaitBuckets> wait_histogram = {};
+};
+
+/// @brief Gets the wait that a fraction of contended acquisitions took no longer than.
+/// @param stats The stats.
+/// @param fraction The fraction, for example 0.99 for the 99th percentile.
+/// @return The upper bound of the histogram bucket the percentile is in or zero if nothing waited.
+std::chrono::nanoseconds WaitPercentile(const LockStats& stats, double fraction);
+
+/// @brief Gets the stats of every named lock.
+/// @return The stats by lock name.
+std::map<std::string, LockStats> SnapshotLockStats();
+
+/// @brief Gets what happened between two snapshots.
+/// @param before The earlier snapshot.
+/// @param after The later snapshot.
+/// @return The stats of each lock used between the snapshots.
+std::map<std::string, LockStats> DiffLockStats(const std::map<std::string, LockStats>& before,
+                                               const std::map<std::string, LockStats>& after);
+
+/// @brief Formats stats like "12 acquisitions, 3 contended (25.0%), waited 1.2 ms, p50 < 2.0 us, p99 < 1.0 ms".
+/// @param stats The stats to format.
+/// @return The formatted stats.
+std::string FormatLockStats(const LockStats& stats);
+
+/// @brief Limits on the contention of every lock used by a test. A limit that is not set is not checked.
+struct LockContentionThresholds {
+  /// @brief The largest fraction of acquisitions that may wait.
+  std::optional<double> max_contended_ratio;
+  /// @brief The longest a lock may be waited for in total.
+  std::optional<std::chrono::nanoseconds> max_total_wait;
+  /// @brief The longest the 99th percentile wait may be.
+  std::optional<std::chrono::nanoseconds> max_p99_wait;
+};
+
+/// @brief Checks the stats of every lock against thresholds.
+/// @param stats The stats by lock name.
+/// @param thresholds The thresholds.
+/// @return A description of each threshold that was exceeded.
+std::vector<std::string> CheckLockContention(const std::map<std::string, LockStats>& stats,
+                                             const LockContentionThresholds& thresholds);
+
+/// @brief The counters shared by every lock with the same name.
+class LockCounters;
+
+/// @brief A std::mutex that records its contention.
+class ProfiledMutex {
+ public:
+  /// @brief Creates a mutex.
+  /// @param name The name to record its contention under.
+  explicit ProfiledMutex(const std::string& name = "unnamed mutex");
+
+  ProfiledMutex(const ProfiledMutex& other) = delete;
+  ProfiledMutex& operator=(const ProfiledMutex& other) = delete;
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+ private:
+  LockCounters* counters_;
+  std::mutex mutex_;
+};
+
+/// @brief A std::shared_mutex that records its contention. Shared and exclusive acquisitions are counted together.
+class ProfiledSharedMutex {
+ public:
+  /// @brief Creates a mutex.
+  /// @param name The name to record its contention under.
+  explicit ProfiledSharedMutex(const std::string& name = "unnamed shared_mutex");
+
+  ProfiledSharedMutex(const ProfiledSharedMutex& other) = delete;
+  ProfiledSharedMutex& operator=(const ProfiledSharedMutex& other) = delete;
+
+  void lock();
+  bool try_lock();
+  void unlock();
+  void lock_shared();
+  bool try_lock_shared();
+  void unlock_shared();
+
+ private:
+  LockCounters* counters_;
+  std::shared_mutex mutex_;
+};
+
+/// @brief A std::condition_variable_any that records how often it is waited on.
+///
+/// It works with any lock including std::unique_lock<ProfiledMutex>. Waiting for a notification is not contention, so a
+/// wait is only counted as contended if reacquiring the lock after it had to wait for another thread. That wait is
+/// also recorded by the lock if it is profiled.
+class ProfiledConditionVariable {
+ public:
+  /// @brief Creates a condition variable.
+  /// @param name The name to record its waits under.
+  explicit ProfiledConditionVariable(const std::string& name = "unnamed condition_variable");
+
+  ProfiledConditionVariable(const ProfiledConditionVariable& other) = delete;
+  ProfiledConditionVariable& operator=(const ProfiledConditionVariable& other) = delete;
+
+  void notify_one() noexcept;
+  void notify_all() noexcept;
+
+  template <typename TLock>
+  void wait(TLock& lock);
+
+  template <typename TLock, typename TPredicate>
+  void wait(TLock& lock, TPredicate predicate);
+
+  template <typename TLock, typename TRep, typename TPeriod>
+  std::cv_status wait_for(TLock& lock, const std::chrono::duration<TRep, TPeriod>& timeout);
+
+  template <typename TLock, typename TRep, typename TPeriod, typename TPredicate>
+  bool wait_for(TLock& lock, const std::chrono::duration<TRep, TPeriod>& timeout, TPredicate predicate);
+
+ private:
+  // Wraps the lock passed to a wait so reacquiring it after the wait is recorded.
+  template <typename TLock>
+  class ReacquiringLock {
+   public:
+    ReacquiringLock(ProfiledConditionVariable& condition, TLock& lock);
+
+    void lock();
+    void unlock();
+
+   private:
+    ProfiledConditionVariable& condition_;
+    TLock& lock_;
+  };
+
+  // Records a wait whose lock was reacquired without waiting.
+  void RecordAcquisition();
+
+  // Records a wait whose lock took reacquire_wait to reacquire.
+  void RecordWait(std::chrono::nanoseconds reacquire_wait);
+
+  LockCounters* counters_;
+  std::condition_variable_any condition_;
+};
+
+/// @brief This is a type that represents a row run with lock profiling. It is used by ExecuteSuiteWithLockProfiling.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+template <typename TResult, typename... TInputParams>
+using LockProfiledTestTuple = std::tuple<
+    /// test_name - The label of the test.
+    std::string,
+    /// test - The test to run.
+    const TestTuple<TResult, TInputParams...>*,
+    /// thresholds - The limits on the contention of the locks the test uses.
+    const LockContentionThresholds*>;
+
+/// @brief Executes a single test and reports the contention of the locks it used.
+///
+/// The test fails if its result is correct but a lock went over the thresholds.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite.
+/// @param test_data The test to execute and its thresholds.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const LockProfiledTestTuple<TResult, TInputParams...>& test_data);
+
+/// @brief Executes a suite and reports the contention of the locks used by each test.
+///
+/// Only locks used while function_to_test runs are counted. Locks used by other threads at the same time are counted
+/// too.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param tests An std::initializer_list of test runs.
+/// @param thresholds The limits on the contention of every lock used by each test.
+/// @param suite_Compare A function used to Compare the expected and actual test results.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @return The results of the suite.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteWithLockProfiling(std::string suite_label,
+                                          std::function<TResult(TInputParams...)> function_to_test,
+                                          std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                          LockContentionThresholds thresholds = LockContentionThresholds(),
+                                          MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt,
+                                          MaybeTestConfigureFunction before_all = std::nullopt,
+                                          MaybeTestConfigureFunction after_all = std::nullopt,
+                                          bool is_enabled = true);
+/// @}
+
+template <typename TLock>
+ProfiledConditionVariable::ReacquiringLock<TLock>::ReacquiringLock(ProfiledConditionVariable& condition, TLock& lock)
+    : condition_(condition), lock_(lock) {}
+
+template <typename TLock>
+void ProfiledConditionVariable::ReacquiringLock<TLock>::lock() {
+  if (lock_.try_lock()) {
+    condition_.RecordAcquisition();
+    return;
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  lock_.lock();
+  condition_.RecordWait(std::chrono::steady_clock::now() - start);
+}
+
+template <typename TLock>
+void ProfiledConditionVariable::ReacquiringLock<TLock>::unlock() {
+  lock_.unlock();
+}
+
+template <typename TLock>
+void ProfiledConditionVariable::wait(TLock& lock) {
+  ReacquiringLock<TLock> reacquiring_lock(*this, lock);
+  condition_.wait(reacquiring_lock);
+}
+
+template <typename TLock, typename TPredicate>
+void ProfiledConditionVariable::wait(TLock& lock, TPredicate predicate) {
+  while (!predicate()) {
+    wait(lock);
+  }
+}
+
+template <typename TLock, typename TRep, typename TPeriod>
+std::cv_status ProfiledConditionVariable::wait_for(TLock& lock, const std::chrono::duration<TRep, TPeriod>& timeout) {
+  ReacquiringLock<TLock> reacquiring_lock(*this, lock);
+  return condition_.wait_for(reacquiring_lock, timeout);
+}
+
+template <typename TLock, typename TRep, typename TPeriod, typename TPredicate>
+bool ProfiledConditionVariable::wait_for(TLock& lock,
+                                         const std::chrono::duration<TRep, TPeriod>& timeout,
+                                         TPredicate predicate) {
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+  while (!predicate()) {
+    if (wait_for(lock, deadline - std::chrono::steady_clock::now()) == std::cv_status::timeout) {
+      return predicate();
+    }
+  }
+  return true;
+}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const LockProfiledTestTuple<TResult, TInputParams...>& test_data) {
+  // Step 1: Extract our variables from the TestTuple.
+  const TestTuple<TResult, TInputParams...>& test = *std::get<1>(test_data);
+  const std::string& test_label = std::get<0>(test_data);
+  const std::string qualified_test_label = suite_label + "::" + test_label;
+
+  if (!std::get<6>(test)) {
+    SkipTest(os, results, suite_label, test_label);
+    return;
+  }
+
+  ExecuteTestLifecycle(os, suite_label, test_label, std::get<4>(test), std::get<5>(test), [&]() {
+    // Step 3: Execute the test method and count the locks it used.
+    std::map<std::string, LockStats> before = SnapshotLockStats();
+    TResult actual{};
+    std::optional<std::string> error = InvokeTestFunction(function_to_test, std::get<2>(test), actual);
+    std::map<std::string, LockStats> lock_stats = DiffLockStats(before, SnapshotLockStats());
+    if (error.has_value()) {
+      ReportTestError(os, results, qualified_test_label, *error);
+    }
+    for (const auto& [name, stats] : lock_stats) {
+      os << "    🔒" << name << ": " << FormatLockStats(stats) << std::endl;
+    }
+
+    // Step 4: Pass or fail. A correct result still fails if a lock was too contended.
+    TestCompareFunction<TResult> compare = ChooseCompareFunction(std::get<3>(test), suite_Compare);
+    std::vector<std::string> violations = CheckLockContention(lock_stats, *std::get<2>(test_data));
+    if (!violations.empty() && compare(std::get<1>(test), actual)) {
+      std::string message;
+      for (const std::string& violation : violations) {
+        message += (message.empty() ? "" : ", ") + violation;
+      }
+      os << "    ❌FAILED: " << message << std::endl;
+      results.Fail(qualified_test_label + " " + message);
+      return TestBodyResult{TestOutcome::kFailed, error.has_value()};
+    }
+    TestOutcome outcome = ReportTestOutcome(os, results, qualified_test_label, compare, std::get<1>(test), actual);
+    return TestBodyResult{outcome, error.has_value()};
+  });
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteWithLockProfiling(std::string suite_label,
+                                          std::function<TResult(TInputParams...)> function_to_test,
+                                          std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                          LockContentionThresholds thresholds,
+                                          MaybeTestCompareFunction<TResult> suite_Compare,
+                                          MaybeTestConfigureFunction before_all,
+                                          MaybeTestConfigureFunction after_all,
+                                          bool is_enabled) {
+  std::vector<LockProfiledTestTuple<TResult, TInputParams...>> profiled_tests;
+  profiled_tests.reserve(tests.size());
+  for (const TestTuple<TResult, TInputParams...>& test : tests) {
+    profiled_tests.emplace_back(std::get<0>(test), &test, &thresholds);
+  }
+  return ExecuteSuiteTests(
+      suite_label, function_to_test, profiled_tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__lock_profiler_h__)
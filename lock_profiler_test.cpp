@@ -0,0 +1,207 @@
+/***************************************************************************************
+ * @file lock_profiler_test.cpp                                                        *
+ *                                                                                     *
+ * @brief Tests for locks that report their contention.                                *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "lock_profiler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::map;
+using std::string;
+using std::tuple;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using testing::ElementsAre;
+using testing::Eq;
+using testing::Ge;
+using testing::HasSubstr;
+using TinyTest::CheckLockContention;
+using TinyTest::DiffLockStats;
+using TinyTest::ExecuteSuiteWithLockProfiling;
+using TinyTest::LockContentionThresholds;
+using TinyTest::LockStats;
+using TinyTest::MakeTest;
+using TinyTest::ProfiledConditionVariable;
+using TinyTest::ProfiledMutex;
+using TinyTest::ProfiledSharedMutex;
+using TinyTest::SnapshotLockStats;
+using TinyTest::TestResults;
+using TinyTest::WaitPercentile;
+
+// Locks mutex on another thread and holds it for hold_time after this returns.
+template <typename TMutex>
+std::thread HoldLock(TMutex& mutex, milliseconds hold_time) {
+  std::mutex started_mutex;
+  std::condition_variable started;
+  bool is_held = false;
+  std::thread holder([&mutex, &started_mutex, &started, &is_held, hold_time]() {
+    std::lock_guard<TMutex> lock(mutex);
+    {
+      std::lock_guard<std::mutex> started_lock(started_mutex);
+      is_held = true;
+      started.notify_one();
+    }
+    std::this_thread::sleep_for(hold_time);
+  });
+  std::unique_lock<std::mutex> started_lock(started_mutex);
+  started.wait(started_lock, [&is_held]() { return is_held; });
+  return holder;
+}
+
+TEST(ProfiledMutex, ShouldCountUncontendedAcquisitions) {
+  map<string, LockStats> before = SnapshotLockStats();
+  ProfiledMutex mutex("ProfiledMutex uncontended");
+  for (int index = 0; index < 3; index++) {
+    std::lock_guard<ProfiledMutex> lock(mutex);
+  }
+  EXPECT_TRUE(mutex.try_lock());
+  EXPECT_FALSE(mutex.try_lock());
+  mutex.unlock();
+
+  map<string, LockStats> used = DiffLockStats(before, SnapshotLockStats());
+  ASSERT_THAT(used.count("ProfiledMutex uncontended"), Eq(1));
+  EXPECT_THAT(used["ProfiledMutex uncontended"].acquisitions, Eq(4));
+  EXPECT_THAT(used["ProfiledMutex uncontended"].contended, Eq(0));
+}
+
+TEST(ProfiledMutex, ShouldRecordHowLongContendedAcquisitionsWait) {
+  map<string, LockStats> before = SnapshotLockStats();
+  ProfiledMutex mutex("ProfiledMutex contended");
+  std::thread holder = HoldLock(mutex, milliseconds(20));
+  { std::lock_guard<ProfiledMutex> lock(mutex); }
+  holder.join();
+
+  LockStats stats = DiffLockStats(before, SnapshotLockStats())["ProfiledMutex contended"];
+  EXPECT_THAT(stats.acquisitions, Eq(2));
+  EXPECT_THAT(stats.contended, Eq(1));
+  EXPECT_THAT(stats.total_wait, Ge(milliseconds(10)));
+  EXPECT_THAT(WaitPercentile(stats, 0.99), Ge(stats.total_wait));
+}
+
+TEST(ProfiledSharedMutex, ShouldRecordSharedAcquisitionsThatWaitForAWriter) {
+  map<string, LockStats> before = SnapshotLockStats();
+  ProfiledSharedMutex mutex("ProfiledSharedMutex");
+  std::thread holder = HoldLock(mutex, milliseconds(20));
+  { std::shared_lock<ProfiledSharedMutex> lock(mutex); }
+  holder.join();
+  { std::shared_lock<ProfiledSharedMutex> lock(mutex); }
+
+  LockStats stats = DiffLockStats(before, SnapshotLockStats())["ProfiledSharedMutex"];
+  EXPECT_THAT(stats.acquisitions, Eq(3));
+  EXPECT_THAT(stats.contended, Eq(1));
+}
+
+TEST(ProfiledConditionVariable, ShouldNotCountWaitingForANotificationAsContention) {
+  map<string, LockStats> before = SnapshotLockStats();
+  ProfiledMutex mutex("ProfiledConditionVariable mutex");
+  ProfiledConditionVariable condition("ProfiledConditionVariable");
+  bool is_ready = false;
+  std::thread notifier([&]() {
+    std::this_thread::sleep_for(milliseconds(10));
+    {
+      std::lock_guard<ProfiledMutex> lock(mutex);
+      is_ready = true;
+    }
+    condition.notify_all();
+  });
+  {
+    std::unique_lock<ProfiledMutex> lock(mutex);
+    condition.wait(lock, [&is_ready]() { return is_ready; });
+  }
+  notifier.join();
+
+  LockStats stats = DiffLockStats(before, SnapshotLockStats())["ProfiledConditionVariable"];
+  EXPECT_THAT(stats.acquisitions, Ge(1));
+  EXPECT_THAT(stats.contended, Eq(0));
+}
+
+TEST(ProfiledConditionVariable, ShouldCountWaitsThatBlockReacquiringTheLock) {
+  map<string, LockStats> before = SnapshotLockStats();
+  ProfiledMutex mutex("ProfiledConditionVariable reacquired mutex");
+  ProfiledConditionVariable condition("ProfiledConditionVariable reacquired");
+  bool is_ready = false;
+  std::thread notifier([&]() {
+    std::this_thread::sleep_for(milliseconds(10));
+    std::lock_guard<ProfiledMutex> lock(mutex);
+    is_ready = true;
+    condition.notify_all();
+    std::this_thread::sleep_for(milliseconds(20));
+  });
+  {
+    std::unique_lock<ProfiledMutex> lock(mutex);
+    condition.wait(lock, [&is_ready]() { return is_ready; });
+  }
+  notifier.join();
+
+  LockStats stats = DiffLockStats(before, SnapshotLockStats())["ProfiledConditionVariable reacquired"];
+  EXPECT_THAT(stats.contended, Eq(1));
+  EXPECT_THAT(stats.total_wait, Ge(milliseconds(10)));
+}
+
+TEST(CheckLockContention, ShouldDescribeEachThresholdExceeded) {
+  LockStats stats;
+  stats.acquisitions = 4;
+  stats.contended = 2;
+  stats.total_wait = nanoseconds(3000);
+  stats.wait_histogram[10] = 2;
+  EXPECT_THAT(WaitPercentile(stats, 0.5), Eq(nanoseconds(2048)));
+
+  LockContentionThresholds thresholds;
+  EXPECT_THAT(CheckLockContention({{"queue", stats}}, thresholds), ElementsAre());
+  thresholds.max_contended_ratio = 0.25;
+  thresholds.max_total_wait = nanoseconds(1000);
+  thresholds.max_p99_wait = nanoseconds(4096);
+  EXPECT_THAT(CheckLockContention({{"queue", stats}}, thresholds),
+              ElementsAre("queue was contended 50.0% of the time, more than 25.0%",
+                          "queue was waited for 3.0 us, more than 1.0 us"));
+}
+
+TEST(ExecuteSuiteWithLockProfiling, ShouldReportLocksAndFailRowsOverTheThresholds) {
+  ProfiledMutex mutex("ExecuteSuiteWithLockProfiling");
+  function<int(bool)> add = [&mutex](bool is_contended) {
+    std::thread holder;
+    if (is_contended) {
+      holder = HoldLock(mutex, milliseconds(5));
+    }
+    std::lock_guard<ProfiledMutex> lock(mutex);
+    if (holder.joinable()) {
+      holder.join();
+    }
+    return 1;
+  };
+  LockContentionThresholds thresholds;
+  thresholds.max_contended_ratio = 0.0;
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuiteWithLockProfiling(
+        "Locks", add, {MakeTest("Alone", 1, tuple(false)), MakeTest("Contended", 1, tuple(true))}, thresholds);
+  };
+  string printed = TinyTest::InterceptCout(wrapper);
+
+  EXPECT_THAT(results.Passed(), Eq(1));
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.FailureMessages(),
+              ElementsAre("Locks::Contended ExecuteSuiteWithLockProfiling was contended 50.0% of the time, more "
+                          "than 0.0%"));
+  EXPECT_THAT(printed, HasSubstr("    🔒ExecuteSuiteWithLockProfiling: 1 acquisitions, 0 contended (0.0%)\n"));
+  EXPECT_THAT(printed, HasSubstr("    🔒ExecuteSuiteWithLockProfiling: 2 acquisitions, 1 contended (50.0%)"));
+}
+}  // End namespace
@@ -0,0 +1,176 @@
+/***************************************************************************************
+ * @file memory_resources.cpp                                                          *
+ *                                                                                     *
+ * @brief Defines functions for running suites under different std::pmr allocators.    *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "memory_resources.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace TinyTest {
+namespace {
+using std::endl;
+using std::string;
+using std::unique_ptr;
+using std::pmr::memory_resource;
+
+thread_local memory_resource* current_memory_resource = nullptr;
+}  // End namespace
+
+string FormatMemoryResourceStats(const MemoryResourceStats& stats) {
+  std::ostringstream os;
+  os << stats.allocations << " allocations of " << stats.allocated_bytes << " bytes, peak " << stats.peak_bytes
+     << " bytes, " << stats.upstream_allocations << " upstream allocations of " << stats.upstream_bytes << " bytes";
+  return os.str();
+}
+
+// Begin CountingResource methods
+CountingResource::CountingResource(memory_resource* upstream) : current_bytes_(0), stats_(), upstream_(upstream) {}
+
+MemoryResourceStats CountingResource::Stats() const {
+  return stats_;
+}
+
+void CountingResource::ResetStats() {
+  stats_ = MemoryResourceStats();
+  stats_.peak_bytes = current_bytes_;
+}
+
+void* CountingResource::do_allocate(size_t bytes, size_t alignment) {
+  void* pointer = upstream_->allocate(bytes, alignment);
+  stats_.allocations++;
+  stats_.allocated_bytes += bytes;
+  current_bytes_ += bytes;
+  stats_.peak_bytes = std::max(stats_.peak_bytes, current_bytes_);
+  return pointer;
+}
+
+void CountingResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+  upstream_->deallocate(pointer, bytes, alignment);
+  stats_.deallocations++;
+  current_bytes_ -= std::min<uint64_t>(bytes, current_bytes_);
+}
+
+bool CountingResource::do_is_equal(const memory_resource& other) const noexcept {
+  return this == &other;
+}
+// End CountingResource methods
+
+// Begin TracingResource methods
+TracingResource::TracingResource(std::ostream& os, memory_resource* upstream) : os_(os), upstream_(upstream) {}
+
+void* TracingResource::do_allocate(size_t bytes, size_t alignment) {
+  void* pointer = upstream_->allocate(bytes, alignment);
+  os_ << "allocate " << bytes << " bytes aligned to " << alignment << " at " << pointer << endl;
+  return pointer;
+}
+
+void TracingResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+  os_ << "deallocate " << bytes << " bytes aligned to " << alignment << " at " << pointer << endl;
+  upstream_->deallocate(pointer, bytes, alignment);
+}
+
+bool TracingResource::do_is_equal(const memory_resource& other) const noexcept {
+  return this == &other;
+}
+// End TracingResource methods
+
+MemoryResourceVariant NewDeleteResourceVariant() {
+  return {"new_delete", [](memory_resource*) { return unique_ptr<memory_resource>(); }, nullptr};
+}
+
+MemoryResourceVariant MonotonicBufferResourceVariant(size_t initial_size) {
+  return {"monotonic",
+          [initial_size](memory_resource* upstream) -> unique_ptr<memory_resource> {
+            if (initial_size == 0) {
+              return std::make_unique<std::pmr::monotonic_buffer_resource>(upstream);
+            }
+            return std::make_unique<std::pmr::monotonic_buffer_resource>(initial_size, upstream);
+          },
+          [](memory_resource* resource) { static_cast<std::pmr::monotonic_buffer_resource*>(resource)->release(); }};
+}
+
+MemoryResourceVariant UnsynchronizedPoolResourceVariant() {
+  return {"unsynchronized_pool",
+          [](memory_resource* upstream) -> unique_ptr<memory_resource> {
+            return std::make_unique<std::pmr::unsynchronized_pool_resource>(upstream);
+          },
+          nullptr};
+}
+
+MemoryResourceVariant SynchronizedPoolResourceVariant() {
+  return {"synchronized_pool",
+          [](memory_resource* upstream) -> unique_ptr<memory_resource> {
+            return std::make_unique<std::pmr::synchronized_pool_resource>(upstream);
+          },
+          nullptr};
+}
+
+MemoryResourceVariant TracingResourceVariant(std::ostream& os) {
+  return {"tracing",
+          [&os](memory_resource* upstream) -> unique_ptr<memory_resource> {
+            return std::make_unique<TracingResource>(os, upstream);
+          },
+          nullptr};
+}
+
+std::vector<MemoryResourceVariant> StandardMemoryResourceVariants() {
+  return {NewDeleteResourceVariant(),
+          MonotonicBufferResourceVariant(),
+          UnsynchronizedPoolResourceVariant(),
+          SynchronizedPoolResourceVariant()};
+}
+
+// Begin VariantMemoryResource methods
+VariantMemoryResource::VariantMemoryResource(const MemoryResourceVariant& variant)
+    : upstream_(),
+      variant_resource_(variant.make_resource ? variant.make_resource(&upstream_) : nullptr),
+      counting_(variant_resource_ == nullptr ? static_cast<memory_resource*>(&upstream_) : variant_resource_.get()),
+      variant_(variant) {}
+
+memory_resource* VariantMemoryResource::Resource() {
+  return &counting_;
+}
+
+MemoryResourceStats VariantMemoryResource::Stats() const {
+  MemoryResourceStats stats = counting_.Stats();
+  MemoryResourceStats upstream_stats = upstream_.Stats();
+  stats.upstream_allocations = upstream_stats.allocations;
+  stats.upstream_bytes = upstream_stats.allocated_bytes;
+  return stats;
+}
+
+void VariantMemoryResource::ResetStats() {
+  counting_.ResetStats();
+  upstream_.ResetStats();
+}
+
+void VariantMemoryResource::ReleaseAfterCall() {
+  if (variant_.release_after_call && variant_resource_ != nullptr) {
+    variant_.release_after_call(variant_resource_.get());
+  }
+}
+// End VariantMemoryResource methods
+
+// Begin MemoryResourceScope methods
+MemoryResourceScope::MemoryResourceScope(memory_resource* resource) : previous_(current_memory_resource) {
+  current_memory_resource = resource;
+}
+
+MemoryResourceScope::~MemoryResourceScope() {
+  current_memory_resource = previous_;
+}
+// End MemoryResourceScope methods
+
+memory_resource* CurrentMemoryResource() {
+  return current_memory_resource == nullptr ? std::pmr::get_default_resource() : current_memory_resource;
+}
+
+}  // End namespace TinyTest
@@ -0,0 +1,320 @@
+#ifndef TinyTest__memory_resources_h__
+#define TinyTest__memory_resources_h__
+/***************************************************************************************
+ * @file memory_resources.h                                                            *
+ *                                                                                     *
+ * @brief Defines functions for running suites under different std::pmr allocators.    *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup memory_resources Memory Resources
+///
+/// ExecuteSuiteWithResources runs every row of a suite once for each MemoryResourceVariant. function_to_test takes the
+/// std::pmr::memory_resource* of the variant as its first parameter and before_each and after_each can get it from
+/// CurrentMemoryResource(). Each test is labeled "test_label [variant]" and prints the allocations made between
+/// before_each and after_each and how long that took.
+///
+/// Each variant's resource is made fresh for every row. Allocations are counted twice. The calls made by the code under
+/// test are counted on the way in, and the calls the variant makes to new and delete are counted as upstream.
+
+/// @addtogroup memory_resources
+/// @{
+
+/// @brief Allocation counts collected by a CountingResource.
+struct MemoryResourceStats {
+  /// @brief The number of calls to allocate.
+  uint64_t allocations = 0;
+  /// @brief The number of calls to deallocate.
+  uint64_t deallocations = 0;
+  /// @brief The total bytes requested from allocate.
+  uint64_t allocated_bytes = 0;
+  /// @brief The most bytes allocated and not yet deallocated at once.
+  uint64_t peak_bytes = 0;
+  /// @brief The number of allocations the variant made from new and delete.
+  uint64_t upstream_allocations = 0;
+  /// @brief The total bytes the variant allocated from new and delete.
+  uint64_t upstream_bytes = 0;
+};
+
+/// @brief Formats stats for printing.
+/// @param stats The stats to format.
+/// @return The stats on one line.
+std::string FormatMemoryResourceStats(const MemoryResourceStats& stats);
+
+/// @brief A memory resource that counts the calls made to it and passes them on to another resource.
+///
+/// This is not synchronized. Use it from one thread at a time.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  /// @brief Creates a counting resource.
+  /// @param upstream The resource to allocate from.
+  explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+  /// @brief Gets the counts since the resource was created or ResetStats was called.
+  ///
+  /// The upstream fields are always zero.
+  /// @return The counts.
+  MemoryResourceStats Stats() const;
+
+  /// @brief Clears the counts. The peak starts again from the bytes currently allocated.
+  void ResetStats();
+
+ protected:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+ private:
+  uint64_t current_bytes_;
+  MemoryResourceStats stats_;
+  std::pmr::memory_resource* upstream_;
+};
+
+/// @brief A memory resource that writes every call made to it to a stream and passes them on to another resource.
+class TracingResource : public std::pmr::memory_resource {
+ public:
+  /// @brief Creates a tracing resource.
+  /// @param os The stream to write to.
+  /// @param upstream The resource to allocate from.
+  explicit TracingResource(std::ostream& os, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+ protected:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+ private:
+  std::ostream& os_;
+  std::pmr::memory_resource* upstream_;
+};
+
+/// @brief This is a type that represents a function that makes the resource for a variant.
+///
+/// It is called with the resource the variant should allocate from. It may return nullptr to use that resource
+/// directly.
+using MemoryResourceFactory =
+    std::function<std::unique_ptr<std::pmr::memory_resource>(std::pmr::memory_resource* upstream)>;
+
+/// @brief A named way to make the memory resource a row runs under.
+struct MemoryResourceVariant {
+  /// @brief The name used in labels and reports.
+  std::string name;
+  /// @brief Makes the resource.
+  MemoryResourceFactory make_resource;
+  /// @brief If set, this is called with the resource after each call when a row is benchmarked. Use it to release
+  /// memory from resources like std::pmr::monotonic_buffer_resource that otherwise only grow.
+  std::function<void(std::pmr::memory_resource* resource)> release_after_call;
+};
+
+/// @brief Gets a variant that allocates directly with new and delete.
+/// @return The variant named "new_delete".
+MemoryResourceVariant NewDeleteResourceVariant();
+
+/// @brief Gets a variant that uses a std::pmr::monotonic_buffer_resource.
+/// @param initial_size The size of the first buffer the resource allocates or zero for the default.
+/// @return The variant named "monotonic".
+MemoryResourceVariant MonotonicBufferResourceVariant(size_t initial_size = 0);
+
+/// @brief Gets a variant that uses a std::pmr::unsynchronized_pool_resource.
+/// @return The variant named "unsynchronized_pool".
+MemoryResourceVariant UnsynchronizedPoolResourceVariant();
+
+/// @brief Gets a variant that uses a std::pmr::synchronized_pool_resource.
+/// @return The variant named "synchronized_pool".
+MemoryResourceVariant SynchronizedPoolResourceVariant();
+
+/// @brief Gets a variant that writes every allocation to a stream.
+/// @param os The stream to write to.
+/// @return The variant named "tracing".
+MemoryResourceVariant TracingResourceVariant(std::ostream& os);
+
+/// @brief Gets the new_delete, monotonic, unsynchronized_pool, and synchronized_pool variants.
+/// @return The variants.
+std::vector<MemoryResourceVariant> StandardMemoryResourceVariants();
+
+/// @brief The resources made for one variant, from the counter seen by the code under test down to new and delete.
+class VariantMemoryResource {
+ public:
+  /// @brief Makes the resources for a variant.
+  /// @param variant The variant. It must outlive this object.
+  explicit VariantMemoryResource(const MemoryResourceVariant& variant);
+
+  VariantMemoryResource(const VariantMemoryResource& other) = delete;
+  VariantMemoryResource& operator=(const VariantMemoryResource& other) = delete;
+
+  /// @brief Gets the resource to pass to the code under test.
+  /// @return The resource.
+  std::pmr::memory_resource* Resource();
+
+  /// @brief Gets the counts since the resources were made or ResetStats was called.
+  /// @return The counts including the upstream counts.
+  MemoryResourceStats Stats() const;
+
+  /// @brief Clears the counts.
+  void ResetStats();
+
+  /// @brief Calls the variant's release_after_call if it has one.
+  void ReleaseAfterCall();
+
+ private:
+  CountingResource upstream_;
+  std::unique_ptr<std::pmr::memory_resource> variant_resource_;
+  CountingResource counting_;
+  const MemoryResourceVariant& variant_;
+};
+
+/// @brief Makes a resource the one returned by CurrentMemoryResource on this thread while it exists.
+class MemoryResourceScope {
+ public:
+  /// @brief Makes resource current.
+  /// @param resource The resource.
+  explicit MemoryResourceScope(std::pmr::memory_resource* resource);
+
+  MemoryResourceScope(const MemoryResourceScope& other) = delete;
+  MemoryResourceScope& operator=(const MemoryResourceScope& other) = delete;
+
+  /// @brief Makes the previously current resource current again.
+  ~MemoryResourceScope();
+
+ private:
+  std::pmr::memory_resource* previous_;
+};
+
+/// @brief Gets the resource of the variant the current test is running under.
+/// @return The resource or std::pmr::get_default_resource() if no test is running under a variant.
+std::pmr::memory_resource* CurrentMemoryResource();
+
+/// @brief This is a type that represents a row run under one MemoryResourceVariant. It is used by
+/// ExecuteSuiteWithResources.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function after the memory resource.
+template <typename TResult, typename... TInputParams>
+using ResourceTestTuple = std::tuple<
+    /// test_name - The label of the test including the variant name.
+    std::string,
+    /// test - The test to run.
+    const TestTuple<TResult, TInputParams...>*,
+    /// variant - The variant to run it under.
+    const MemoryResourceVariant*>;
+
+/// @brief Executes a single test under a MemoryResourceVariant.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function after the memory resource.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite.
+/// @param test_data The test to execute and its variant.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(std::pmr::memory_resource*, TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const ResourceTestTuple<TResult, TInputParams...>& test_data);
+
+/// @brief Executes a TestSuite once for each MemoryResourceVariant.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function after the memory resource.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested. It is called with the variant's resource first.
+/// @param tests An std::initializer_list of test runs.
+/// @param variants The variants to run every test under.
+/// @param suite_Compare A function used to Compare the expected and actual test results.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @return The results of the suite.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteWithResources(
+    std::string suite_label,
+    std::function<TResult(std::pmr::memory_resource*, TInputParams...)> function_to_test,
+    std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+    std::vector<MemoryResourceVariant> variants = StandardMemoryResourceVariants(),
+    MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt,
+    MaybeTestConfigureFunction before_all = std::nullopt,
+    MaybeTestConfigureFunction after_all = std::nullopt,
+    bool is_enabled = true);
+/// @}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(std::pmr::memory_resource*, TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const ResourceTestTuple<TResult, TInputParams...>& test_data) {
+  const MemoryResourceVariant& variant = *std::get<2>(test_data);
+  VariantMemoryResource resource(variant);
+  MemoryResourceScope scope(resource.Resource());
+  std::function<TResult(TInputParams...)> bound_function = [&](TInputParams... inputs) {
+    return function_to_test(resource.Resource(), std::move(inputs)...);
+  };
+
+  // Only count what happens between before_each and after_each.
+  TestTuple<TResult, TInputParams...> test = *std::get<1>(test_data);
+  std::get<0>(test) = std::get<0>(test_data);
+  MaybeTestConfigureFunction before_each = std::get<4>(test);
+  MaybeTestConfigureFunction after_each = std::get<5>(test);
+  std::chrono::steady_clock::time_point start;
+  std::get<4>(test) = [&]() {
+    if (before_each.has_value()) {
+      (*before_each)();
+    }
+    resource.ResetStats();
+    start = std::chrono::steady_clock::now();
+  };
+  std::get<5>(test) = [&]() {
+    std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+    MemoryResourceStats stats = resource.Stats();
+    os << "    🧮" << variant.name << ": " << FormatMemoryResourceStats(stats) << " in "
+       << std::chrono::duration_cast<std::chrono::microseconds>(duration).count() << " us" << std::endl;
+    if (after_each.has_value()) {
+      (*after_each)();
+    }
+  };
+  ExecuteTest(os, results, suite_label, bound_function, suite_Compare, test);
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteWithResources(
+    std::string suite_label,
+    std::function<TResult(std::pmr::memory_resource*, TInputParams...)> function_to_test,
+    std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+    std::vector<MemoryResourceVariant> variants,
+    MaybeTestCompareFunction<TResult> suite_Compare,
+    MaybeTestConfigureFunction before_all,
+    MaybeTestConfigureFunction after_all,
+    bool is_enabled) {
+  std::vector<ResourceTestTuple<TResult, TInputParams...>> variant_tests;
+  variant_tests.reserve(tests.size() * variants.size());
+  for (const TestTuple<TResult, TInputParams...>& test : tests) {
+    for (const MemoryResourceVariant& variant : variants) {
+      variant_tests.emplace_back(std::get<0>(test) + " [" + variant.name + "]", &test, &variant);
+    }
+  }
+  return ExecuteSuiteTests(
+      suite_label, function_to_test, variant_tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__memory_resources_h__)
@@ -0,0 +1,120 @@
+/***************************************************************************************
+ * @file memory_resources_test.cpp                                                     *
+ *                                                                                     *
+ * @brief Tests for running suites under different std::pmr allocators.                *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "memory_resources.h"
+
+#include <functional>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::string;
+using std::vector;
+using testing::Eq;
+using testing::Ge;
+using testing::HasSubstr;
+using TinyTest::CountingResource;
+using TinyTest::CurrentMemoryResource;
+using TinyTest::ExecuteSuiteWithResources;
+using TinyTest::MakeTest;
+using TinyTest::MaybeTestCompareFunction;
+using TinyTest::MaybeTestConfigureFunction;
+using TinyTest::MemoryResourceStats;
+using TinyTest::MemoryResourceVariant;
+using TinyTest::MonotonicBufferResourceVariant;
+using TinyTest::NewDeleteResourceVariant;
+using TinyTest::TestResults;
+using TinyTest::TracingResource;
+using TinyTest::VariantMemoryResource;
+
+TEST(CountingResource, ShouldCountAllocationsAndThePeak) {
+  CountingResource counting;
+  {
+    std::pmr::vector<int> first({1, 2, 3, 4}, &counting);
+    std::pmr::vector<int> second({1, 2}, &counting);
+  }
+  std::pmr::vector<int> third({1}, &counting);
+  MemoryResourceStats stats = counting.Stats();
+  EXPECT_THAT(stats.allocations, Eq(3));
+  EXPECT_THAT(stats.deallocations, Eq(2));
+  EXPECT_THAT(stats.allocated_bytes, Eq(7 * sizeof(int)));
+  EXPECT_THAT(stats.peak_bytes, Eq(6 * sizeof(int)));
+
+  counting.ResetStats();
+  EXPECT_THAT(counting.Stats().allocations, Eq(0));
+  EXPECT_THAT(counting.Stats().peak_bytes, Eq(sizeof(int)));
+}
+
+TEST(TracingResource, ShouldWriteEveryCall) {
+  std::ostringstream os;
+  TracingResource tracing(os);
+  tracing.deallocate(tracing.allocate(16, 8), 16, 8);
+  EXPECT_THAT(os.str(), HasSubstr("allocate 16 bytes aligned to 8 at "));
+  EXPECT_THAT(os.str(), HasSubstr("deallocate 16 bytes aligned to 8 at "));
+}
+
+TEST(VariantMemoryResource, ShouldCountTheVariantsUpstreamAllocationsSeparately) {
+  MemoryResourceVariant variant = MonotonicBufferResourceVariant(4096);
+  VariantMemoryResource resource(variant);
+  for (int count = 0; count < 10; count++) {
+    (void)resource.Resource()->allocate(16, 8);
+  }
+  MemoryResourceStats stats = resource.Stats();
+  EXPECT_THAT(stats.allocations, Eq(10));
+  EXPECT_THAT(stats.allocated_bytes, Eq(160));
+  EXPECT_THAT(stats.upstream_allocations, Eq(1));
+  EXPECT_THAT(stats.upstream_bytes, Ge(4096));
+
+  resource.ReleaseAfterCall();
+  EXPECT_THAT(resource.Stats().upstream_allocations, Eq(1));
+}
+
+TEST(ExecuteSuiteWithResources, ShouldRunEachTestUnderEachVariant) {
+  vector<std::pmr::memory_resource*> seen_by_function;
+  vector<std::pmr::memory_resource*> seen_by_before_each;
+  MaybeTestCompareFunction<size_t> compare = std::nullopt;
+  MaybeTestConfigureFunction before_each = [&]() { seen_by_before_each.push_back(CurrentMemoryResource()); };
+  MaybeTestConfigureFunction after_each = std::nullopt;
+  function<size_t(std::pmr::memory_resource*, int)> fill = [&](std::pmr::memory_resource* resource, int count) {
+    seen_by_function.push_back(resource);
+    std::pmr::vector<int> values(count, 1, resource);
+    return values.size();
+  };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuiteWithResources(
+        "Fill",
+        fill,
+        {
+            MakeTest("Three", (size_t)3, make_tuple(3), compare, before_each, after_each),
+            MakeTest("Wrong", (size_t)0, make_tuple(2)),
+        },
+        {NewDeleteResourceVariant(), MonotonicBufferResourceVariant()});
+  };
+  string captured = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Total(), Eq(4));
+  EXPECT_THAT(results.Passed(), Eq(2));
+  EXPECT_THAT(results.FailureMessages(),
+              Eq(vector<string>({"Fill::Wrong [new_delete] expected: 0, actual: 2",
+                                 "Fill::Wrong [monotonic] expected: 0, actual: 2"})));
+  EXPECT_THAT(seen_by_function.size(), Eq(4));
+  EXPECT_THAT(seen_by_before_each, Eq(vector<std::pmr::memory_resource*>({seen_by_function[0], seen_by_function[1]})));
+  EXPECT_THAT(captured, HasSubstr("  Beginning Test: Three [monotonic]\n"));
+  EXPECT_THAT(captured,
+              HasSubstr("    🧮new_delete: 1 allocations of 12 bytes, peak 12 bytes, 1 upstream allocations"));
+}
+}  // End namespace
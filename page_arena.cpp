@@ -0,0 +1,127 @@
+/***************************************************************************************
+ * @file page_arena.cpp                                                                *
+ *                                                                                     *
+ * @brief Defines a memory resource backed by small or huge pages.                     *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "page_arena.h"
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <new>
+#include <string>
+
+namespace TinyTest {
+namespace {
+thread_local std::pmr::memory_resource* current_page_arena = nullptr;
+
+size_t RoundUp(size_t value, size_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+}  // End namespace
+
+std::string PageKindName(PageKind kind) {
+  switch (kind) {
+    case PageKind::kSmall:
+      return "4 KB pages";
+    case PageKind::kTransparentHuge:
+      return "THP";
+    case PageKind::kHugeTlb:
+      return "hugetlb";
+  }
+  return "unknown";
+}
+
+// Begin PageArena methods
+PageArena::PageArena(PageKind kind, size_t capacity_bytes)
+    : capacity_(capacity_bytes), kind_(kind), mapping_(nullptr), mapping_bytes_(0), start_(nullptr), used_(0) {
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (kind == PageKind::kSmall) {
+    mapping_bytes_ = capacity_;
+  } else if (kind == PageKind::kHugeTlb) {
+    capacity_ = RoundUp(capacity_, kHugePageBytes);
+    mapping_bytes_ = capacity_;
+    flags |= MAP_HUGETLB;
+  } else {
+    // Transparent huge pages are only used for huge page aligned ranges so map extra and align the start.
+    capacity_ = RoundUp(capacity_, kHugePageBytes);
+    mapping_bytes_ = capacity_ + kHugePageBytes;
+  }
+  if (mapping_bytes_ == 0) {
+    return;
+  }
+  void* mapping = mmap(nullptr, mapping_bytes_, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (mapping == MAP_FAILED) {
+    mapping_bytes_ = 0;
+    return;
+  }
+  mapping_ = mapping;
+  start_ = static_cast<char*>(mapping);
+  if (kind == PageKind::kSmall) {
+    madvise(start_, capacity_, MADV_NOHUGEPAGE);
+  } else if (kind == PageKind::kTransparentHuge) {
+    start_ = reinterpret_cast<char*>(RoundUp(reinterpret_cast<uintptr_t>(mapping), kHugePageBytes));
+    madvise(start_, capacity_, MADV_HUGEPAGE);
+  }
+}
+
+PageArena::~PageArena() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mapping_bytes_);
+  }
+}
+
+bool PageArena::IsAvailable() const {
+  return mapping_ != nullptr;
+}
+
+PageKind PageArena::Kind() const {
+  return kind_;
+}
+
+size_t PageArena::Capacity() const {
+  return mapping_ == nullptr ? 0 : capacity_;
+}
+
+size_t PageArena::Used() const {
+  return used_;
+}
+
+void PageArena::Reset() {
+  used_ = 0;
+}
+
+void* PageArena::do_allocate(size_t bytes, size_t alignment) {
+  size_t offset = RoundUp(reinterpret_cast<uintptr_t>(start_) + used_, alignment) - reinterpret_cast<uintptr_t>(start_);
+  if (mapping_ == nullptr || offset > capacity_ || bytes > capacity_ - offset) {
+    throw std::bad_alloc();
+  }
+  used_ = offset + bytes;
+  return start_ + offset;
+}
+
+void PageArena::do_deallocate(void*, size_t, size_t) {}
+
+bool PageArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+  return this == &other;
+}
+// End PageArena methods
+
+// Begin PageArenaScope methods
+PageArenaScope::PageArenaScope(PageArena& arena) : previous_(current_page_arena) {
+  current_page_arena = &arena;
+}
+
+PageArenaScope::~PageArenaScope() {
+  current_page_arena = previous_;
+}
+// End PageArenaScope methods
+
+std::pmr::memory_resource* CurrentPageArena() {
+  return current_page_arena == nullptr ? std::pmr::get_default_resource() : current_page_arena;
+}
+
+}  // End namespace TinyTest
@@ -0,0 +1,126 @@
+#ifndef TinyTest__page_arena_h__
+#define TinyTest__page_arena_h__
+/***************************************************************************************
+ * @file page_arena.h                                                                  *
+ *                                                                                     *
+ * @brief Defines a memory resource backed by small or huge pages.                     *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+
+namespace TinyTest {
+
+/// @defgroup page_arena Page Arenas
+///
+/// A PageArena is a std::pmr::memory_resource that hands out memory from a single mapping made with a chosen page
+/// size. Allocating row inputs and fixture buffers from arenas with different page sizes shows how much of a function's
+/// time goes to TLB misses.
+///
+/// While a PageArenaScope exists CurrentPageArena returns its arena, so before_each can allocate fixture buffers from
+/// whichever arena the benchmark is using.
+
+/// @addtogroup page_arena
+/// @{
+
+/// @brief The kinds of pages a PageArena can be backed by.
+enum class PageKind {
+  /// @brief Regular 4 KB pages. Transparent huge pages are disabled for the mapping with MADV_NOHUGEPAGE.
+  kSmall,
+  /// @brief Transparent huge pages requested with MADV_HUGEPAGE. The kernel may still use small pages for some or all
+  /// of the mapping.
+  kTransparentHuge,
+  /// @brief Huge pages from the hugetlbfs pool mapped with MAP_HUGETLB. These must be reserved ahead of time, for
+  /// example with /proc/sys/vm/nr_hugepages.
+  kHugeTlb,
+};
+
+/// @brief Gets a short name for a PageKind to use in reports.
+/// @param kind The kind of page.
+/// @return The name.
+std::string PageKindName(PageKind kind);
+
+/// @brief A monotonic memory resource backed by one mapping of a chosen page size.
+///
+/// Deallocation does nothing. Memory is only reclaimed by Reset or when the arena is destroyed.
+class PageArena : public std::pmr::memory_resource {
+ public:
+  /// @brief The size of a huge page. Capacities of huge page arenas are rounded up to a multiple of this.
+  static constexpr size_t kHugePageBytes = 2 << 20;
+
+  /// @brief Maps the memory for the arena.
+  ///
+  /// If the mapping can not be made, for example because no hugetlbfs pages are reserved, the arena is not available
+  /// and every allocation throws std::bad_alloc.
+  /// @param kind The kind of pages to use.
+  /// @param capacity_bytes The most bytes the arena can hand out.
+  PageArena(PageKind kind, size_t capacity_bytes);
+
+  PageArena(const PageArena& other) = delete;
+  PageArena& operator=(const PageArena& other) = delete;
+
+  /// @brief Unmaps the memory. Anything allocated from the arena must not be used after this.
+  ~PageArena() override;
+
+  /// @brief Checks if the mapping was made.
+  /// @return True if the arena can allocate.
+  bool IsAvailable() const;
+
+  /// @brief Getter for the kind of pages.
+  /// @return The kind of pages.
+  PageKind Kind() const;
+
+  /// @brief Getter for the most bytes the arena can hand out.
+  /// @return The capacity in bytes.
+  size_t Capacity() const;
+
+  /// @brief Getter for the bytes handed out including alignment padding.
+  /// @return The used bytes.
+  size_t Used() const;
+
+  /// @brief Releases every allocation so the memory can be handed out again.
+  void Reset();
+
+ protected:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+ private:
+  size_t capacity_;
+  PageKind kind_;
+  void* mapping_;
+  size_t mapping_bytes_;
+  char* start_;
+  size_t used_;
+};
+
+/// @brief Makes an arena the one returned by CurrentPageArena on this thread while it exists.
+class PageArenaScope {
+ public:
+  /// @brief Makes arena current.
+  /// @param arena The arena.
+  explicit PageArenaScope(PageArena& arena);
+
+  PageArenaScope(const PageArenaScope& other) = delete;
+  PageArenaScope& operator=(const PageArenaScope& other) = delete;
+
+  /// @brief Makes the previously current arena current again.
+  ~PageArenaScope();
+
+ private:
+  std::pmr::memory_resource* previous_;
+};
+
+/// @brief Gets the arena made current on this thread by a PageArenaScope.
+/// @return The current arena or std::pmr::get_default_resource() if there is none.
+std::pmr::memory_resource* CurrentPageArena();
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__page_arena_h__)
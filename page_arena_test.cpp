@@ -0,0 +1,80 @@
+/***************************************************************************************
+ * @file page_arena_test.cpp                                                           *
+ *                                                                                     *
+ * @brief Tests for memory resources backed by small or huge pages.                    *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "page_arena.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+using testing::Eq;
+using testing::Ge;
+using TinyTest::CurrentPageArena;
+using TinyTest::PageArena;
+using TinyTest::PageArenaScope;
+using TinyTest::PageKind;
+
+TEST(PageArena, ShouldHandOutAlignedMemoryUntilItIsFull) {
+  PageArena arena(PageKind::kSmall, 4096);
+  ASSERT_TRUE(arena.IsAvailable());
+  void* first = arena.allocate(3, 1);
+  void* second = arena.allocate(8, 64);
+  EXPECT_THAT(reinterpret_cast<uintptr_t>(second) % 64, Eq(0));
+  EXPECT_THAT(second > first, Eq(true));
+  EXPECT_THAT(arena.Used(), Eq(72));
+  EXPECT_THROW((void)arena.allocate(4096, 1), std::bad_alloc);
+
+  arena.Reset();
+  EXPECT_THAT(arena.Used(), Eq(0));
+  EXPECT_THAT(arena.allocate(4096, 1), Eq(first));
+}
+
+TEST(PageArena, ShouldAlignTransparentHugePageArenasToHugePages) {
+  PageArena arena(PageKind::kTransparentHuge, 1);
+  ASSERT_TRUE(arena.IsAvailable());
+  EXPECT_THAT(arena.Capacity(), Eq(PageArena::kHugePageBytes));
+  EXPECT_THAT(reinterpret_cast<uintptr_t>(arena.allocate(1, 1)) % PageArena::kHugePageBytes, Eq(0));
+}
+
+TEST(PageArena, ShouldThrowBadAllocWhenTheMappingCanNotBeMade) {
+  PageArena arena(PageKind::kHugeTlb, 1);
+  if (arena.IsAvailable()) {
+    EXPECT_THAT(arena.Capacity(), Eq(PageArena::kHugePageBytes));
+  } else {
+    EXPECT_THAT(arena.Capacity(), Eq(0));
+    EXPECT_THROW((void)arena.allocate(1, 1), std::bad_alloc);
+  }
+}
+
+TEST(PageArena, ShouldBackPmrContainers) {
+  PageArena arena(PageKind::kSmall, 1 << 16);
+  std::pmr::vector<int> values({1, 2, 3}, &arena);
+  EXPECT_THAT(arena.Used(), Ge(3 * sizeof(int)));
+  EXPECT_THAT(values.get_allocator().resource(), Eq(&arena));
+}
+
+TEST(PageArenaScope, ShouldMakeTheArenaCurrentWhileItExists) {
+  PageArena outer_arena(PageKind::kSmall, 4096);
+  PageArena inner_arena(PageKind::kSmall, 4096);
+  EXPECT_THAT(CurrentPageArena(), Eq(std::pmr::get_default_resource()));
+  {
+    PageArenaScope outer(outer_arena);
+    {
+      PageArenaScope inner(inner_arena);
+      EXPECT_THAT(CurrentPageArena(), Eq(&inner_arena));
+    }
+    EXPECT_THAT(CurrentPageArena(), Eq(&outer_arena));
+  }
+  EXPECT_THAT(CurrentPageArena(), Eq(std::pmr::get_default_resource()));
+}
+}  // End namespace
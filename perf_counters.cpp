@@ -0,0 +1,136 @@
+/***************************************************************************************
+ * @file perf_counters.cpp                                                             *
+ *                                                                                     *
+ * @brief Defines hardware counters for counting the instructions a test runs.         *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace TinyTest {
+namespace {
+using std::string;
+
+// The weights cachegrind uses for L1 and last level misses in its estimated cycles.
+constexpr double kL1MissCycles = 10;
+constexpr double kLastLevelMissCycles = 100;
+
+// The layout read from a group leader opened with PERF_FORMAT_GROUP, PERF_FORMAT_TOTAL_TIME_ENABLED, and
+// PERF_FORMAT_TOTAL_TIME_RUNNING.
+struct GroupReading {
+  uint64_t count;
+  uint64_t time_enabled;
+  uint64_t time_running;
+  uint64_t values[3];
+};
+
+int OpenCounter(uint32_t type, uint64_t config, int group_fd) {
+  perf_event_attr attributes = {};
+  attributes.size = sizeof(attributes);
+  attributes.type = type;
+  attributes.config = config;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  if (group_fd < 0) {
+    attributes.disabled = 1;
+    attributes.pinned = 1;
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  }
+  return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+uint64_t CacheConfig(uint64_t cache, uint64_t operation, uint64_t result) {
+  return cache | (operation << 8) | (result << 16);
+}
+}  // End namespace
+
+std::optional<double> EstimatedCycles(const PerfCounts& counts) {
+  if (!counts.l1_misses.has_value() || !counts.last_level_misses.has_value()) {
+    return std::nullopt;
+  }
+  return counts.instructions + kL1MissCycles * *counts.l1_misses + kLastLevelMissCycles * *counts.last_level_misses;
+}
+
+// Begin PerfCounterGroup methods
+PerfCounterGroup::PerfCounterGroup(bool count_cache_misses)
+    : instructions_fd_(-1), l1_misses_fd_(-1), last_level_misses_fd_(-1) {
+  instructions_fd_ = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1);
+  if (instructions_fd_ < 0) {
+    throw std::runtime_error("Unable to count instructions: " + string(strerror(errno)));
+  }
+  if (!count_cache_misses) {
+    return;
+  }
+  l1_misses_fd_ = OpenCounter(PERF_TYPE_HW_CACHE,
+                              CacheConfig(PERF_COUNT_HW_CACHE_L1D,
+                                          PERF_COUNT_HW_CACHE_OP_READ,
+                                          PERF_COUNT_HW_CACHE_RESULT_MISS),
+                              instructions_fd_);
+  if (l1_misses_fd_ >= 0) {
+    last_level_misses_fd_ = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, instructions_fd_);
+  }
+  if (l1_misses_fd_ < 0 || last_level_misses_fd_ < 0) {
+    string error = strerror(errno);
+    for (int fd : {l1_misses_fd_, instructions_fd_}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    throw std::runtime_error("Unable to count cache misses: " + error);
+  }
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+  for (int fd : {last_level_misses_fd_, l1_misses_fd_, instructions_fd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool PerfCounterGroup::IsAvailable() {
+  int fd = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1);
+  if (fd < 0) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+void PerfCounterGroup::Start() {
+  ioctl(instructions_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(instructions_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounts PerfCounterGroup::Stop() {
+  ioctl(instructions_fd_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  GroupReading reading = {};
+  ssize_t size = read(instructions_fd_, &reading, sizeof(reading));
+  if (size < 0) {
+    throw std::runtime_error("Unable to read the performance counters: " + string(strerror(errno)));
+  }
+  // A pinned group that could not be put on the CPU reads as end of file.
+  if (size == 0 || reading.time_running < reading.time_enabled) {
+    throw std::runtime_error("The performance counters were not scheduled for the whole run.");
+  }
+  PerfCounts counts = {reading.values[0], std::nullopt, std::nullopt};
+  if (reading.count == 3) {
+    counts.l1_misses = reading.values[1];
+    counts.last_level_misses = reading.values[2];
+  }
+  return counts;
+}
+// End PerfCounterGroup methods
+
+}  // End namespace TinyTest
@@ -0,0 +1,86 @@
+#ifndef TinyTest__perf_counters_h__
+#define TinyTest__perf_counters_h__
+/***************************************************************************************
+ * @file perf_counters.h                                                               *
+ *                                                                                     *
+ * @brief Defines hardware counters for counting the instructions a test runs.         *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <cstdint>
+#include <optional>
+
+namespace TinyTest {
+
+/// @defgroup perf_counters Performance Counters
+///
+/// Wall clock times on shared machines vary too much to fail a build over a small regression. The number of
+/// instructions a function retires in user space barely varies from run to run, so it can be checked against a tight
+/// threshold. A PerfCounterGroup counts them with perf_event_open for the calling thread only.
+///
+/// It can also count L1 data cache misses and last level cache misses and combine them with the instruction count
+/// into the same estimated cycles cachegrind reports, Ir + 10 * L1m + 100 * LLm. The cache counts vary more than the
+/// instruction count.
+///
+/// Counting needs hardware counters, which many virtual machines do not have, and a perf_event_paranoid setting of 2 or
+/// less.
+
+/// @addtogroup perf_counters
+/// @{
+
+/// @brief Counts from one run of a PerfCounterGroup.
+struct PerfCounts {
+  /// @brief The instructions retired in user space.
+  uint64_t instructions;
+  /// @brief The L1 data cache read misses or nullopt if they were not counted.
+  std::optional<uint64_t> l1_misses;
+  /// @brief The last level cache misses or nullopt if they were not counted.
+  std::optional<uint64_t> last_level_misses;
+};
+
+/// @brief Gets the estimated cycles cachegrind would report for counts.
+/// @param counts The counts.
+/// @return Ir + 10 * L1m + 100 * LLm or nullopt if the cache misses were not counted.
+std::optional<double> EstimatedCycles(const PerfCounts& counts);
+
+/// @brief Counts retired instructions, and optionally cache misses, of the calling thread between Start and Stop.
+///
+/// The counters are opened as one pinned group so they are never multiplexed with other counters and always count the
+/// same code. A group must be started and stopped on the thread that created it.
+class PerfCounterGroup {
+ public:
+  /// @brief Opens the counters.
+  /// @param count_cache_misses If true cache misses are counted too. This needs two more hardware counters.
+  /// @throws std::runtime_error if the counters can not be opened.
+  explicit PerfCounterGroup(bool count_cache_misses = false);
+
+  PerfCounterGroup(const PerfCounterGroup& other) = delete;
+  PerfCounterGroup& operator=(const PerfCounterGroup& other) = delete;
+
+  /// @brief Closes the counters.
+  ~PerfCounterGroup();
+
+  /// @brief Checks if instructions can be counted on this machine.
+  /// @return True if a PerfCounterGroup can be created.
+  static bool IsAvailable();
+
+  /// @brief Resets the counters to zero and starts counting.
+  void Start();
+
+  /// @brief Stops counting and reads the counters.
+  /// @return The counts since Start.
+  /// @throws std::runtime_error if the counters can not be read or were not scheduled on the CPU.
+  PerfCounts Stop();
+
+ private:
+  int instructions_fd_;
+  int l1_misses_fd_;
+  int last_level_misses_fd_;
+};
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__perf_counters_h__)
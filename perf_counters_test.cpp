@@ -0,0 +1,70 @@
+/***************************************************************************************
+ * @file perf_counters_test.cpp                                                        *
+ *                                                                                     *
+ * @brief Tests for hardware counters for counting the instructions a test runs.       *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "perf_counters.h"
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+using testing::Eq;
+using testing::Ge;
+using testing::Le;
+using TinyTest::EstimatedCycles;
+using TinyTest::PerfCounterGroup;
+using TinyTest::PerfCounts;
+
+uint64_t CountLoop(PerfCounterGroup& counters, int length) {
+  volatile int total = 0;
+  counters.Start();
+  for (int index = 0; index < length; index++) {
+    total = total + index;
+  }
+  return counters.Stop().instructions;
+}
+
+TEST(EstimatedCycles, ShouldWeighCacheMissesLikeCachegrind) {
+  EXPECT_THAT(EstimatedCycles({1000, 5, 2}), Eq(1000 + 50 + 200));
+  EXPECT_THAT(EstimatedCycles({1000, std::nullopt, std::nullopt}), Eq(std::nullopt));
+}
+
+TEST(PerfCounterGroup, ShouldCountTheSameInstructionsEveryRun) {
+  if (!PerfCounterGroup::IsAvailable()) {
+    EXPECT_THROW(PerfCounterGroup(), std::runtime_error);
+    return;
+  }
+  PerfCounterGroup counters;
+  uint64_t short_loop = CountLoop(counters, 1000);
+  uint64_t first = CountLoop(counters, 100000);
+  uint64_t second = CountLoop(counters, 100000);
+  EXPECT_THAT(first, Ge(short_loop * 10));
+  // Within a tenth of a percent.
+  EXPECT_THAT(first > second ? first - second : second - first, Le(first / 1000));
+}
+
+TEST(PerfCounterGroup, ShouldCountCacheMissesWhenAsked) {
+  if (!PerfCounterGroup::IsAvailable()) {
+    EXPECT_THROW(PerfCounterGroup(true), std::runtime_error);
+    return;
+  }
+  // Some machines count instructions but not cache misses.
+  try {
+    PerfCounterGroup counters(true);
+    counters.Start();
+    PerfCounts counts = counters.Stop();
+    EXPECT_TRUE(counts.l1_misses.has_value());
+    EXPECT_TRUE(counts.last_level_misses.has_value());
+  } catch (const std::runtime_error& error) {
+    EXPECT_THAT(error.what(), testing::StartsWith("Unable to count cache misses: "));
+  }
+}
+}  // End namespace
@@ -0,0 +1,248 @@
+/***************************************************************************************
+ * @file run_diff.cpp                                                                  *
+ *                                                                                     *
+ * @brief Defines functions for recording test runs and comparing their outcomes.      *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "run_diff.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace TinyTest {
+namespace {
+using std::endl;
+using std::string;
+using std::string_view;
+using std::vector;
+
+// Identifies the format of a written run.
+constexpr string_view kRunHeader = "TinyTest run 1";
+
+char OutcomeCode(TestOutcome outcome) {
+  switch (outcome) {
+    case TestOutcome::kPassed:
+      return 'P';
+    case TestOutcome::kFailed:
+      return 'F';
+    case TestOutcome::kSkipped:
+      return 'S';
+  }
+  return '?';
+}
+
+// Sorts a run by label id and drops all but the last outcome of each label.
+void SortByLabelId(TestRun& run) {
+  std::stable_sort(run.begin(), run.end(), [](const TestRunEntry& left, const TestRunEntry& right) {
+    return left.label_id < right.label_id;
+  });
+  auto last = run.begin();
+  for (auto entry = run.begin(); entry != run.end(); entry++) {
+    if (last != entry && last->label_id != entry->label_id) {
+      last++;
+    }
+    *last = *entry;
+  }
+  run.erase(run.empty() ? run.end() : last + 1, run.end());
+}
+
+vector<string> SortedLabels(const LabelTable& labels, const vector<uint32_t>& label_ids) {
+  vector<string> sorted;
+  sorted.reserve(label_ids.size());
+  for (uint32_t label_id : label_ids) {
+    sorted.push_back(labels.Label(label_id));
+  }
+  std::sort(sorted.begin(), sorted.end());
+  return sorted;
+}
+
+void PrintLabels(std::ostream& os, const string& heading, const vector<string>& labels) {
+  if (labels.empty()) {
+    return;
+  }
+  os << heading << " (" << labels.size() << "):" << endl;
+  for (const string& label : labels) {
+    os << "  " << label << endl;
+  }
+}
+}  // End namespace
+
+// Begin LabelTable methods
+uint32_t LabelTable::Intern(string_view label) {
+  auto existing = label_ids_.find(label);
+  if (existing != label_ids_.end()) {
+    return existing->second;
+  }
+  uint32_t label_id = static_cast<uint32_t>(labels_.size());
+  labels_.emplace_back(label);
+  label_ids_.emplace(labels_.back(), label_id);
+  return label_id;
+}
+
+const string& LabelTable::Label(uint32_t label_id) const {
+  return labels_.at(label_id);
+}
+
+size_t LabelTable::Size() const {
+  return labels_.size();
+}
+// End LabelTable methods
+
+void WriteTestRun(std::ostream& os, const LabelTable& labels, const TestRun& run) {
+  os << kRunHeader << ' ' << run.size() << '\n';
+  for (const TestRunEntry& entry : run) {
+    os << OutcomeCode(entry.outcome) << ' ';
+    for (char c : labels.Label(entry.label_id)) {
+      if (c == '\\') {
+        os << "\\\\";
+      } else if (c == '\n') {
+        os << "\\n";
+      } else if (c == '\r') {
+        os << "\\r";
+      } else {
+        os << c;
+      }
+    }
+    os << '\n';
+  }
+}
+
+TestRun ReadTestRun(std::istream& is, LabelTable& labels) {
+  string line;
+  if (!std::getline(is, line) || line.compare(0, kRunHeader.size(), kRunHeader) != 0) {
+    throw std::runtime_error("Invalid test run header.");
+  }
+  size_t size;
+  try {
+    size = std::stoull(line.substr(kRunHeader.size()));
+  } catch (const std::exception&) {
+    throw std::runtime_error("Invalid test run header.");
+  }
+  TestRun run;
+  run.reserve(size);
+  string label;
+  while (run.size() < size) {
+    if (!std::getline(is, line)) {
+      throw std::runtime_error("Truncated test run.");
+    }
+    if (line.size() < 2 || line[1] != ' ') {
+      throw std::runtime_error("Invalid test run entry: " + line);
+    }
+    TestOutcome outcome;
+    switch (line[0]) {
+      case 'P':
+        outcome = TestOutcome::kPassed;
+        break;
+      case 'F':
+        outcome = TestOutcome::kFailed;
+        break;
+      case 'S':
+        outcome = TestOutcome::kSkipped;
+        break;
+      default:
+        throw std::runtime_error("Invalid test run entry: " + line);
+    }
+    label.clear();
+    for (size_t index = 2; index < line.size(); index++) {
+      if (line[index] != '\\' || index + 1 == line.size()) {
+        label += line[index];
+        continue;
+      }
+      char escaped = line[++index];
+      label += escaped == 'n' ? '\n' : escaped == 'r' ? '\r' : escaped;
+    }
+    run.push_back({labels.Intern(label), outcome});
+  }
+  return run;
+}
+
+TestRunDiff DiffTestRuns(const LabelTable& labels, TestRun before, TestRun after) {
+  SortByLabelId(before);
+  SortByLabelId(after);
+  vector<uint32_t> newly_failing;
+  vector<uint32_t> newly_passing;
+  vector<uint32_t> newly_skipped;
+  vector<uint32_t> missing;
+  vector<uint32_t> added;
+  auto old_entry = before.begin();
+  auto new_entry = after.begin();
+  while (old_entry != before.end() || new_entry != after.end()) {
+    if (new_entry == after.end() || (old_entry != before.end() && old_entry->label_id < new_entry->label_id)) {
+      missing.push_back((old_entry++)->label_id);
+    } else if (old_entry == before.end() || new_entry->label_id < old_entry->label_id) {
+      added.push_back((new_entry++)->label_id);
+    } else {
+      if (old_entry->outcome != new_entry->outcome) {
+        switch (new_entry->outcome) {
+          case TestOutcome::kPassed:
+            newly_passing.push_back(new_entry->label_id);
+            break;
+          case TestOutcome::kFailed:
+            newly_failing.push_back(new_entry->label_id);
+            break;
+          case TestOutcome::kSkipped:
+            newly_skipped.push_back(new_entry->label_id);
+            break;
+        }
+      }
+      old_entry++;
+      new_entry++;
+    }
+  }
+  return {
+      SortedLabels(labels, newly_failing),
+      SortedLabels(labels, newly_passing),
+      SortedLabels(labels, newly_skipped),
+      SortedLabels(labels, missing),
+      SortedLabels(labels, added),
+  };
+}
+
+void PrintTestRunDiff(std::ostream& os, const TestRunDiff& diff) {
+  PrintLabels(os, "❌Newly failing", diff.newly_failing);
+  PrintLabels(os, "✅Newly passing", diff.newly_passing);
+  PrintLabels(os, "🚧Newly skipped", diff.newly_skipped);
+  PrintLabels(os, "Missing", diff.missing);
+  PrintLabels(os, "Added", diff.added);
+  os << "Newly failing: " << diff.newly_failing.size() << endl;
+  os << "Newly passing: " << diff.newly_passing.size() << endl;
+  os << "Newly skipped: " << diff.newly_skipped.size() << endl;
+  os << "Missing:       " << diff.missing.size() << endl;
+  os << "Added:         " << diff.added.size() << endl;
+}
+
+// Begin RunRecorder methods
+RunRecorder::RunRecorder() {
+  listener_id_ = AddTestEventListener([this](const TestEvent& event) {
+    if (event.type != TestEventType::kTestEnd) {
+      return;
+    }
+    string qualified_test_label;
+    qualified_test_label.reserve(event.suite_label.size() + 2 + event.test_label.size());
+    qualified_test_label.append(event.suite_label).append("::").append(event.test_label);
+    std::lock_guard<std::mutex> lock(mutex_);
+    run_.push_back({labels_.Intern(qualified_test_label), event.outcome});
+  });
+}
+
+RunRecorder::~RunRecorder() {
+  RemoveTestEventListener(listener_id_);
+}
+
+void RunRecorder::Write(std::ostream& os) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WriteTestRun(os, labels_, run_);
+}
+
+size_t RunRecorder::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return run_.size();
+}
+// End RunRecorder methods
+
+}  // End namespace TinyTest
@@ -0,0 +1,149 @@
+#ifndef TinyTest__run_diff_h__
+#define TinyTest__run_diff_h__
+/***************************************************************************************
+ * @file run_diff.h                                                                    *
+ *                                                                                     *
+ * @brief Defines functions for recording test runs and comparing their outcomes.      *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup run_diff Run Diffs
+///
+/// A RunRecorder listens for kTestEnd events and records the outcome of every test by its qualified label,
+/// "suite_label::test_label". Recorded runs are written with WriteTestRun and compared with DiffTestRuns to see exactly
+/// which tests changed outcome between two runs.
+///
+/// Labels are interned into a LabelTable so a run is a list of integer ids and outcomes. Reading two runs into the same
+/// LabelTable gives the same label the same id in both, so DiffTestRuns can sort each run by id and merge them without
+/// comparing strings.
+///
+/// The diff_runs tool compares two recorded runs from the command line. It exits with 1 if any test is newly failing or
+/// missing.
+/// @code{.sh}
+/// diff_runs before.run after.run
+/// @endcode
+
+/// @addtogroup run_diff
+/// @{
+
+/// @brief Assigns a small integer id to each distinct label.
+class LabelTable {
+ public:
+  /// @brief Gets the id of a label, adding it if it has not been seen before.
+  /// @param label The label.
+  /// @return The id of the label. Ids start at zero and are assigned in the order labels are first seen.
+  uint32_t Intern(std::string_view label);
+
+  /// @brief Gets the label for an id.
+  /// @param label_id An id returned by Intern.
+  /// @return The label.
+  const std::string& Label(uint32_t label_id) const;
+
+  /// @brief Getter for the number of distinct labels.
+  /// @return The number of labels.
+  size_t Size() const;
+
+ private:
+  // A deque never moves its elements so the string_view keys stay valid.
+  std::deque<std::string> labels_;
+  std::unordered_map<std::string_view, uint32_t> label_ids_;
+};
+
+/// @brief The outcome of one test in a recorded run.
+struct TestRunEntry {
+  /// @brief The id of the qualified label of the test in the LabelTable of the run.
+  uint32_t label_id;
+  /// @brief How the test ended.
+  TestOutcome outcome;
+};
+
+/// @brief This is a type that represents the outcomes of every test in a run.
+using TestRun = std::vector<TestRunEntry>;
+
+/// @brief Writes a run so it can be read by ReadTestRun.
+/// @param os The stream to write to.
+/// @param labels The LabelTable the run was recorded with.
+/// @param run The run to write.
+void WriteTestRun(std::ostream& os, const LabelTable& labels, const TestRun& run);
+
+/// @brief Reads a run written by WriteTestRun.
+/// @param is The stream to read from.
+/// @param labels The LabelTable to intern labels into. Read runs you want to compare into the same LabelTable.
+/// @return The run.
+/// @throws std::runtime_error if is does not contain a run written by WriteTestRun.
+TestRun ReadTestRun(std::istream& is, LabelTable& labels);
+
+/// @brief The tests whose outcomes changed between two runs. Each list is sorted by label.
+struct TestRunDiff {
+  /// @brief Tests that failed in the second run but not in the first.
+  std::vector<std::string> newly_failing;
+  /// @brief Tests that passed in the second run but not in the first.
+  std::vector<std::string> newly_passing;
+  /// @brief Tests that were skipped in the second run but not in the first.
+  std::vector<std::string> newly_skipped;
+  /// @brief Tests that are in the first run but not in the second.
+  std::vector<std::string> missing;
+  /// @brief Tests that are in the second run but not in the first.
+  std::vector<std::string> added;
+};
+
+/// @brief Compares the outcomes of two runs.
+///
+/// If a label appears more than once in a run the last outcome is used.
+/// @param labels The LabelTable both runs were read or recorded with.
+/// @param before The first run.
+/// @param after The second run.
+/// @return The tests whose outcomes changed.
+TestRunDiff DiffTestRuns(const LabelTable& labels, TestRun before, TestRun after);
+
+/// @brief Prints a TestRunDiff.
+/// @param os The stream to print to.
+/// @param diff The diff to print.
+void PrintTestRunDiff(std::ostream& os, const TestRunDiff& diff);
+
+/// @brief Records the outcome of every test that ends while it exists.
+class RunRecorder {
+ public:
+  /// @brief Starts recording.
+  RunRecorder();
+
+  RunRecorder(const RunRecorder& other) = delete;
+  RunRecorder& operator=(const RunRecorder& other) = delete;
+
+  /// @brief Stops recording.
+  ~RunRecorder();
+
+  /// @brief Writes the recorded run so it can be read by ReadTestRun.
+  /// @param os The stream to write to.
+  void Write(std::ostream& os) const;
+
+  /// @brief Getter for the number of recorded tests.
+  /// @return The number of tests.
+  size_t Size() const;
+
+ private:
+  LabelTable labels_;
+  uint64_t listener_id_;
+  mutable std::mutex mutex_;
+  TestRun run_;
+};
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__run_diff_h__)
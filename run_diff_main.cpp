@@ -0,0 +1,54 @@
+/***************************************************************************************
+ * @file run_diff_main.cpp                                                             *
+ *                                                                                     *
+ * @brief Compares the outcomes of two recorded test runs.                             *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "run_diff.h"
+
+namespace {
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using TinyTest::DiffTestRuns;
+using TinyTest::LabelTable;
+using TinyTest::ReadTestRun;
+using TinyTest::TestRun;
+using TinyTest::TestRunDiff;
+
+TestRun ReadTestRunFile(const string& path, LabelTable& labels) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+  return ReadTestRun(file, labels);
+}
+}  // End namespace
+
+// Prints the tests whose outcomes changed between two runs written by RunRecorder. Exits with 1 if any test is newly
+// failing or missing and 2 if the runs can not be read.
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    cerr << "Usage: " << argv[0] << " before.run after.run" << endl;
+    return 2;
+  }
+  try {
+    LabelTable labels;
+    TestRun before = ReadTestRunFile(argv[1], labels);
+    TestRun after = ReadTestRunFile(argv[2], labels);
+    TestRunDiff diff = DiffTestRuns(labels, std::move(before), std::move(after));
+    TinyTest::PrintTestRunDiff(cout, diff);
+    return diff.newly_failing.empty() && diff.missing.empty() ? 0 : 1;
+  } catch (const std::exception& error) {
+    cerr << error.what() << endl;
+    return 2;
+  }
+}
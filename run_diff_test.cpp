@@ -0,0 +1,144 @@
+/***************************************************************************************
+ * @file run_diff_test.cpp                                                             *
+ *                                                                                     *
+ * @brief Tests for recording test runs and comparing their outcomes.                  *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "run_diff.h"
+
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::string;
+using std::vector;
+using testing::Eq;
+using testing::HasSubstr;
+using TinyTest::DiffTestRuns;
+using TinyTest::ExecuteSuite;
+using TinyTest::LabelTable;
+using TinyTest::MakeTest;
+using TinyTest::MaybeTestCompareFunction;
+using TinyTest::MaybeTestConfigureFunction;
+using TinyTest::ReadTestRun;
+using TinyTest::RunRecorder;
+using TinyTest::TestOutcome;
+using TinyTest::TestRun;
+using TinyTest::TestRunDiff;
+using TinyTest::WriteTestRun;
+
+TEST(LabelTable, ShouldGiveEachLabelOneId) {
+  LabelTable labels;
+  EXPECT_THAT(labels.Intern("Suite::First"), Eq(0));
+  EXPECT_THAT(labels.Intern("Suite::Second"), Eq(1));
+  EXPECT_THAT(labels.Intern(string("Suite::First")), Eq(0));
+  EXPECT_THAT(labels.Size(), Eq(2));
+  EXPECT_THAT(labels.Label(1), Eq("Suite::Second"));
+}
+
+TEST(WriteTestRun, ShouldRoundTripThroughReadTestRun) {
+  LabelTable labels;
+  TestRun run = {
+      {labels.Intern("Suite::Passes"), TestOutcome::kPassed},
+      {labels.Intern("Suite::Fails with a\nnew line and a \\"), TestOutcome::kFailed},
+      {labels.Intern("Suite::Skipped"), TestOutcome::kSkipped},
+  };
+  std::stringstream stream;
+  WriteTestRun(stream, labels, run);
+
+  LabelTable read_labels;
+  TestRun read_run = ReadTestRun(stream, read_labels);
+  ASSERT_THAT(read_run.size(), Eq(3));
+  for (size_t index = 0; index < run.size(); index++) {
+    EXPECT_THAT(read_labels.Label(read_run[index].label_id), Eq(labels.Label(run[index].label_id)));
+    EXPECT_THAT(read_run[index].outcome, Eq(run[index].outcome));
+  }
+}
+
+TEST(ReadTestRun, ShouldThrowForTruncatedRuns) {
+  LabelTable labels;
+  std::istringstream stream("TinyTest run 1 2\nP Suite::Test\n");
+  EXPECT_THROW(ReadTestRun(stream, labels), std::runtime_error);
+}
+
+TEST(DiffTestRuns, ShouldReportEveryChangedOutcome) {
+  LabelTable labels;
+  uint32_t stays = labels.Intern("Suite::Stays passing");
+  uint32_t breaks = labels.Intern("Suite::Breaks");
+  uint32_t fixed = labels.Intern("Suite::Fixed");
+  uint32_t disabled = labels.Intern("Suite::Disabled");
+  uint32_t removed = labels.Intern("Suite::Removed");
+  uint32_t added = labels.Intern("Suite::Added");
+  TestRun before = {
+      {removed, TestOutcome::kPassed},
+      {disabled, TestOutcome::kPassed},
+      {fixed, TestOutcome::kFailed},
+      {breaks, TestOutcome::kPassed},
+      {stays, TestOutcome::kPassed},
+  };
+  TestRun after = {
+      {stays, TestOutcome::kPassed},
+      {added, TestOutcome::kFailed},
+      {breaks, TestOutcome::kFailed},
+      {fixed, TestOutcome::kPassed},
+      {disabled, TestOutcome::kSkipped},
+  };
+  TestRunDiff diff = DiffTestRuns(labels, before, after);
+  EXPECT_THAT(diff.newly_failing, Eq(vector<string>({"Suite::Breaks"})));
+  EXPECT_THAT(diff.newly_passing, Eq(vector<string>({"Suite::Fixed"})));
+  EXPECT_THAT(diff.newly_skipped, Eq(vector<string>({"Suite::Disabled"})));
+  EXPECT_THAT(diff.missing, Eq(vector<string>({"Suite::Removed"})));
+  EXPECT_THAT(diff.added, Eq(vector<string>({"Suite::Added"})));
+}
+
+TEST(DiffTestRuns, ShouldUseTheLastOutcomeOfATestThatRanTwice) {
+  LabelTable labels;
+  uint32_t flaky = labels.Intern("Suite::Flaky");
+  TestRun before = {{flaky, TestOutcome::kPassed}};
+  TestRun after = {{flaky, TestOutcome::kPassed}, {flaky, TestOutcome::kFailed}};
+  TestRunDiff diff = DiffTestRuns(labels, before, after);
+  EXPECT_THAT(diff.newly_failing, Eq(vector<string>({"Suite::Flaky"})));
+  EXPECT_THAT(diff.added.size(), Eq(0));
+}
+
+TEST(RunRecorder, ShouldRecordTheOutcomeOfEveryTest) {
+  std::stringstream stream;
+  MaybeTestCompareFunction<int> compare = std::nullopt;
+  MaybeTestConfigureFunction configure = std::nullopt;
+  function<void()> wrapper = [&]() {
+    RunRecorder recorder;
+    ExecuteSuite("Recorded",
+                 function<int(int)>([](int value) { return value * 2; }),
+                 {
+                     MakeTest("Passes", 4, make_tuple(2)),
+                     MakeTest("Fails", 5, make_tuple(2)),
+                     MakeTest("Skipped", 6, make_tuple(3), compare, configure, configure, false),
+                 });
+    EXPECT_THAT(recorder.Size(), Eq(3));
+    recorder.Write(stream);
+  };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(stream.str(), Eq("TinyTest run 1 3\nP Recorded::Passes\nF Recorded::Fails\nS Recorded::Skipped\n"));
+}
+
+TEST(PrintTestRunDiff, ShouldListChangedTestsAndCounts) {
+  TestRunDiff diff;
+  diff.newly_failing = {"Suite::Breaks"};
+  std::ostringstream os;
+  TinyTest::PrintTestRunDiff(os, diff);
+  EXPECT_THAT(os.str(), HasSubstr("❌Newly failing (1):\n  Suite::Breaks\n"));
+  EXPECT_THAT(os.str(), HasSubstr("Newly failing: 1\nNewly passing: 0\n"));
+}
+}  // End namespace
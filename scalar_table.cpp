@@ -0,0 +1,39 @@
+/***************************************************************************************
+ * @file scalar_table.cpp                                                              *
+ *                                                                                     *
+ * @brief Defines a column oriented table of tests for functions of arithmetic types.  *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "scalar_table.h"
+
+#include <cstring>
+#include <vector>
+
+namespace TinyTest {
+
+std::vector<size_t> FindMismatchedRows(const uint8_t* mismatched, size_t row_count) {
+  std::vector<size_t> rows;
+  size_t row = 0;
+  for (; row + sizeof(uint64_t) <= row_count; row += sizeof(uint64_t)) {
+    uint64_t block;
+    memcpy(&block, mismatched + row, sizeof(block));
+    if (block == 0) {
+      continue;
+    }
+    for (size_t offset = 0; offset < sizeof(uint64_t); offset++) {
+      if (mismatched[row + offset] != 0) {
+        rows.push_back(row + offset);
+      }
+    }
+  }
+  for (; row < row_count; row++) {
+    if (mismatched[row] != 0) {
+      rows.push_back(row);
+    }
+  }
+  return rows;
+}
+
+}  // End namespace TinyTest
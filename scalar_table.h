@@ -0,0 +1,305 @@
+#ifndef TinyTest__scalar_table_h__
+#define TinyTest__scalar_table_h__
+/***************************************************************************************
+ * @file scalar_table.h                                                                *
+ *                                                                                     *
+ * @brief Defines a column oriented table of tests for functions of arithmetic types.  *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup scalar_table Scalar Tables
+///
+/// A ScalarTestTable holds the tests of a function whose result and parameters are all arithmetic types. Each input and
+/// the expected results are stored in their own contiguous column instead of in a vector of TestTuples with their
+/// strings, optionals, and std::functions. ExecuteScalarSuite calls function_to_test down the columns and then compares
+/// every expected result in one loop the compiler can vectorize. Only mismatched rows are printed, by row index and
+/// label.
+///
+/// bool values are stored as uint8_t since std::vector<bool> packs them into bits, so predicates get contiguous columns
+/// too.
+///
+/// Rows are compared with operator== and have no compare, before_each, or after_each functions. Use ExecuteSuite for
+/// tests that need them.
+/// @code{.cpp}
+/// TinyTest::ScalarTestTable<int, int, int> table;
+/// table.Add("zeros", 0, 0, 0).Add("one and two", 3, 1, 2);
+/// results += TinyTest::ExecuteScalarSuite("Add", add, table);
+/// @endcode
+
+/// @addtogroup scalar_table
+/// @{
+
+/// @brief The type a ScalarTestTable stores a column of T values as. bool is stored as uint8_t.
+/// @tparam T The type of the values in the column.
+template <typename T>
+using ScalarColumnType = std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>;
+
+/// @brief Tests of a function with arithmetic result and parameter types stored one column per value.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+template <typename TResult, typename... TInputParams>
+class ScalarTestTable {
+  static_assert(std::is_arithmetic_v<TResult> && (std::is_arithmetic_v<TInputParams> && ...),
+                "ScalarTestTable only holds arithmetic types. Use ExecuteSuite for other types.");
+
+ public:
+  /// @brief The row type accepted by the initializer_list constructor.
+  using Row = std::tuple<std::string, TResult, TInputParams...>;
+
+  /// @brief Creates an empty table.
+  ScalarTestTable() = default;
+
+  /// @brief Creates a table from rows of label, expected result, and inputs.
+  /// @param rows The rows.
+  ScalarTestTable(std::initializer_list<Row> rows);
+
+  /// @brief Adds a row.
+  /// @param label The label of the test.
+  /// @param expected The expected result.
+  /// @param inputs The inputs to the function to test.
+  /// @return This table for chaining.
+  ScalarTestTable& Add(const std::string& label, TResult expected, TInputParams... inputs);
+
+  /// @brief Reserves space for rows.
+  /// @param row_count The number of rows to reserve space for.
+  void Reserve(size_t row_count);
+
+  /// @brief Gets the number of rows.
+  /// @return The number of rows.
+  size_t Size() const;
+
+  /// @brief Gets the labels of the rows.
+  /// @return The labels.
+  const std::vector<std::string>& Labels() const;
+
+  /// @brief Gets the expected results of the rows.
+  /// @return The expected results.
+  const std::vector<ScalarColumnType<TResult>>& Expected() const;
+
+  /// @brief Gets the input columns.
+  /// @return One vector per input parameter.
+  const std::tuple<std::vector<ScalarColumnType<TInputParams>>...>& Inputs() const;
+
+ private:
+  std::vector<std::string> labels_;
+  std::vector<ScalarColumnType<TResult>> expected_;
+  std::tuple<std::vector<ScalarColumnType<TInputParams>>...> inputs_;
+};
+
+/// @brief Finds the rows marked as mismatched. Runs of matching rows are skipped eight at a time.
+/// @param mismatched One byte per row that is nonzero if the row mismatched.
+/// @param row_count The number of rows.
+/// @return The indexes of the mismatched rows in order.
+std::vector<size_t> FindMismatchedRows(const uint8_t* mismatched, size_t row_count);
+
+/// @brief Marks the rows where expected and actual differ. The loop has no branches so it can be vectorized.
+/// @tparam TResult The result type of the test.
+/// @param expected The expected results.
+/// @param actual The actual results.
+/// @param mismatched Set to 1 for each row that differs and 0 for each row that matches.
+/// @param row_count The number of rows.
+template <typename TResult>
+void CompareColumns(const TResult* expected, const TResult* actual, uint8_t* mismatched, size_t row_count);
+
+/// @brief Executes a suite of tests stored in a ScalarTestTable.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param table The tests.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the tests are reported as skipped. If true the tests are run as normal.
+/// @return The results of the suite.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteScalarSuite(const std::string& suite_label,
+                               const std::function<TResult(TInputParams...)>& function_to_test,
+                               const ScalarTestTable<TResult, TInputParams...>& table,
+                               MaybeTestConfigureFunction before_all = std::nullopt,
+                               MaybeTestConfigureFunction after_all = std::nullopt,
+                               bool is_enabled = true);
+/// @}
+
+// Begin ScalarTestTable methods
+template <typename TResult, typename... TInputParams>
+ScalarTestTable<TResult, TInputParams...>::ScalarTestTable(std::initializer_list<Row> rows) {
+  Reserve(rows.size());
+  for (const Row& row : rows) {
+    std::apply(
+        [this](const std::string& label, TResult expected, TInputParams... inputs) { Add(label, expected, inputs...); },
+        row);
+  }
+}
+
+template <typename TResult, typename... TInputParams>
+ScalarTestTable<TResult, TInputParams...>& ScalarTestTable<TResult, TInputParams...>::Add(const std::string& label,
+                                                                                          TResult expected,
+                                                                                          TInputParams... inputs) {
+  labels_.push_back(label);
+  expected_.push_back(expected);
+  std::apply(
+      [&inputs...](std::vector<ScalarColumnType<TInputParams>>&... columns) { (columns.push_back(inputs), ...); },
+      inputs_);
+  return *this;
+}
+
+template <typename TResult, typename... TInputParams>
+void ScalarTestTable<TResult, TInputParams...>::Reserve(size_t row_count) {
+  labels_.reserve(row_count);
+  expected_.reserve(row_count);
+  std::apply(
+      [row_count](std::vector<ScalarColumnType<TInputParams>>&... columns) { (columns.reserve(row_count), ...); },
+      inputs_);
+}
+
+template <typename TResult, typename... TInputParams>
+size_t ScalarTestTable<TResult, TInputParams...>::Size() const {
+  return expected_.size();
+}
+
+template <typename TResult, typename... TInputParams>
+const std::vector<std::string>& ScalarTestTable<TResult, TInputParams...>::Labels() const {
+  return labels_;
+}
+
+template <typename TResult, typename... TInputParams>
+const std::vector<ScalarColumnType<TResult>>& ScalarTestTable<TResult, TInputParams...>::Expected() const {
+  return expected_;
+}
+
+template <typename TResult, typename... TInputParams>
+const std::tuple<std::vector<ScalarColumnType<TInputParams>>...>&
+ScalarTestTable<TResult, TInputParams...>::Inputs() const {
+  return inputs_;
+}
+// End ScalarTestTable methods
+
+template <typename TResult>
+void CompareColumns(const TResult* expected, const TResult* actual, uint8_t* mismatched, size_t row_count) {
+  for (size_t row = 0; row < row_count; row++) {
+    mismatched[row] = static_cast<uint8_t>(expected[row] != actual[row]);
+  }
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteScalarSuite(const std::string& suite_label,
+                               const std::function<TResult(TInputParams...)>& function_to_test,
+                               const ScalarTestTable<TResult, TInputParams...>& table,
+                               MaybeTestConfigureFunction before_all,
+                               MaybeTestConfigureFunction after_all,
+                               bool is_enabled) {
+  const size_t row_count = table.Size();
+  if (IsStartupProfilingEnabled()) {
+    RecordSuiteStarted(suite_label, row_count);
+  }
+  TestResults results;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PublishSuiteBegin(suite_label);
+  if (!is_enabled) {
+    std::cout << "🚧Skipping suite: " << suite_label << " because it is disabled." << std::endl;
+    for (const std::string& test_label : table.Labels()) {
+      SkipTest(results, suite_label, test_label, "the suite is disabled.");
+    }
+    PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
+    return results;
+  }
+  if (row_count == 0) {
+    std::cout << "🚧Skipping suite: " << suite_label << " because it is empty." << std::endl;
+    PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
+    return results;
+  }
+  std::cout << "🚀Beginning Suite: " << suite_label << std::endl;
+
+  // Step 1: Suite Setup
+  if (before_all.has_value()) {
+    (*before_all)();
+  }
+
+  // Step 2: Call function_to_test down the columns. Rows are only timed if someone is listening for their events, and
+  // their events are published as each row runs so listeners like CrashReporter know which row is running.
+  const bool is_publishing = HasTestEventListeners();
+  std::vector<ScalarColumnType<TResult>> actual(row_count);
+  std::map<size_t, std::string> errors;
+  std::apply(
+      [&](const std::vector<ScalarColumnType<TInputParams>>&... columns) {
+        for (size_t row = 0; row < row_count; row++) {
+          std::chrono::steady_clock::time_point row_start;
+          if (is_publishing) {
+            PublishTestBegin(suite_label, table.Labels()[row]);
+            row_start = std::chrono::steady_clock::now();
+          }
+          {
+            TestThreadScope thread_scope(suite_label, table.Labels()[row]);
+            try {
+              actual[row] = function_to_test(columns[row]...);
+            } catch (...) {
+              errors[row] = DescribeCaughtException(std::current_exception());
+            }
+          }
+          if (is_publishing) {
+            PublishTestEnd(suite_label,
+                           table.Labels()[row],
+                           table.Expected()[row] != actual[row] ? TestOutcome::kFailed : TestOutcome::kPassed,
+                           errors.count(row) > 0,
+                           std::chrono::steady_clock::now() - row_start);
+          }
+        }
+      },
+      table.Inputs());
+
+  // Step 3: Compare every row at once and only report the mismatches.
+  std::vector<uint8_t> mismatched(row_count);
+  CompareColumns(table.Expected().data(), actual.data(), mismatched.data(), row_count);
+  std::vector<size_t> mismatched_rows = FindMismatchedRows(mismatched.data(), row_count);
+  for (const auto& [row, error] : errors) {
+    ReportTestError(std::cout, results, suite_label + "::" + table.Labels()[row], error);
+  }
+  for (size_t row : mismatched_rows) {
+    TResult expected = table.Expected()[row];
+    TResult row_actual = actual[row];
+    TestMessage::Formatter format = [row, expected, row_actual](std::ostream& message) {
+      message << "(row " << row << ") expected: ";
+      CPPUtils::PrettyPrint(message, expected) << ", actual: ";
+      CPPUtils::PrettyPrint(message, row_actual);
+    };
+    std::cout << "    ❌FAILED: " << table.Labels()[row] << " ";
+    format(std::cout);
+    std::cout << std::endl;
+    results.Fail(TestMessage(suite_label + "::" + table.Labels()[row] + " ", format));
+  }
+  for (size_t row = 0; row < row_count - mismatched_rows.size(); row++) {
+    results.Pass();
+  }
+  std::cout << "  " << row_count - mismatched_rows.size() << " of " << row_count << " rows passed" << std::endl;
+
+  // Step 4: Suite Teardown
+  if (after_all.has_value()) {
+    (*after_all)();
+  }
+  std::cout << "Ending Suite: " << suite_label << std::endl;
+  PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
+  return results;
+}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__scalar_table_h__)
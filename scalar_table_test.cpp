@@ -0,0 +1,167 @@
+/***************************************************************************************
+ * @file scalar_table_test.cpp                                                         *
+ *                                                                                     *
+ * @brief Tests for column oriented tables of tests for arithmetic functions.          *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "scalar_table.h"
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::string;
+using std::vector;
+using testing::ElementsAre;
+using testing::Eq;
+using testing::HasSubstr;
+using TinyTest::AddTestEventListener;
+using TinyTest::CompareColumns;
+using TinyTest::ExecuteScalarSuite;
+using TinyTest::FindMismatchedRows;
+using TinyTest::RemoveTestEventListener;
+using TinyTest::ScalarTestTable;
+using TinyTest::TestEvent;
+using TinyTest::TestEventType;
+using TinyTest::TestOutcome;
+using TinyTest::TestResults;
+
+TEST(ScalarTestTable, ShouldStoreEachValueInItsOwnColumn) {
+  ScalarTestTable<int, int, double> table = {{"first", 1, 2, 3.5}, {"second", 4, 5, 6.5}};
+  table.Add("third", 7, 8, 9.5);
+
+  EXPECT_THAT(table.Size(), Eq(3));
+  EXPECT_THAT(table.Labels(), ElementsAre("first", "second", "third"));
+  EXPECT_THAT(table.Expected(), ElementsAre(1, 4, 7));
+  EXPECT_THAT(std::get<0>(table.Inputs()), ElementsAre(2, 5, 8));
+  EXPECT_THAT(std::get<1>(table.Inputs()), ElementsAre(3.5, 6.5, 9.5));
+}
+
+TEST(FindMismatchedRows, ShouldFindRowsInAndAfterTheFullBlocks) {
+  vector<uint8_t> mismatched(21);
+  mismatched[0] = 1;
+  mismatched[7] = 1;
+  mismatched[16] = 1;
+  mismatched[20] = 1;
+  EXPECT_THAT(FindMismatchedRows(mismatched.data(), mismatched.size()), ElementsAre(0, 7, 16, 20));
+  EXPECT_THAT(FindMismatchedRows(mismatched.data(), 0), ElementsAre());
+}
+
+TEST(CompareColumns, ShouldMarkTheRowsThatDiffer) {
+  vector<float> expected = {1, 2, 3, 4};
+  vector<float> actual = {1, 2.5, 3, 0};
+  vector<uint8_t> mismatched(4, 7);
+  CompareColumns(expected.data(), actual.data(), mismatched.data(), expected.size());
+  EXPECT_THAT(mismatched, ElementsAre(0, 1, 0, 1));
+}
+
+TEST(ExecuteScalarSuite, ShouldReportMismatchesByRowAndLabel) {
+  ScalarTestTable<int, int, int> table;
+  for (int row = 0; row < 100; row++) {
+    table.Add("row" + std::to_string(row), row == 42 ? 0 : row * 2, row, row);
+  }
+  function<int(int, int)> add = [](int left, int right) { return left + right; };
+  TestResults results;
+  function<void()> wrapper = [&]() { results = ExecuteScalarSuite("Add", add, table); };
+  string output = TinyTest::InterceptCout(wrapper);
+
+  EXPECT_THAT(results.Total(), Eq(100));
+  EXPECT_THAT(results.Passed(), Eq(99));
+  EXPECT_THAT(results.FailureMessages(), ElementsAre("Add::row42 (row 42) expected: 0, actual: 84"));
+  EXPECT_THAT(output, HasSubstr("    ❌FAILED: row42 (row 42) expected: 0, actual: 84\n"));
+  EXPECT_THAT(output, HasSubstr("  99 of 100 rows passed\n"));
+}
+
+TEST(ExecuteScalarSuite, ShouldReportErrorsAndPublishAnEventPerRow) {
+  ScalarTestTable<int, int> table = {{"ok", 1, 1}, {"throws", 0, -1}};
+  function<int(int)> identity = [](int value) {
+    if (value < 0) {
+      throw std::invalid_argument("negative");
+    }
+    return value;
+  };
+  vector<string> events;
+  uint64_t listener_id = AddTestEventListener([&events](const TestEvent& event) {
+    if (event.type == TestEventType::kTestEnd) {
+      events.push_back(string(event.test_label) + (event.has_error ? " error" : " no error"));
+    }
+  });
+  TestResults results;
+  function<void()> wrapper = [&]() { results = ExecuteScalarSuite("Identity", identity, table); };
+  TinyTest::InterceptCout(wrapper);
+  RemoveTestEventListener(listener_id);
+
+  EXPECT_THAT(results.Passed(), Eq(2));
+  EXPECT_THAT(results.Errors(), Eq(1));
+  EXPECT_THAT(events, ElementsAre("ok no error", "throws error"));
+}
+
+TEST(ExecuteScalarSuite, ShouldPublishTheEventsOfEachRowAsItRuns) {
+  ScalarTestTable<int, int> table = {{"first", 1, 1}, {"second", 0, 2}};
+  vector<string> events;
+  function<int(int)> identity = [&events](int value) {
+    events.push_back("run " + std::to_string(value));
+    return value;
+  };
+  uint64_t listener_id = AddTestEventListener([&events](const TestEvent& event) {
+    if (event.type == TestEventType::kTestBegin) {
+      events.push_back("begin " + string(event.test_label));
+    } else if (event.type == TestEventType::kTestThreadBegin) {
+      events.push_back("thread begin " + string(event.test_label));
+    } else if (event.type == TestEventType::kTestThreadEnd) {
+      events.push_back("thread end " + string(event.test_label));
+    } else if (event.type == TestEventType::kTestEnd) {
+      events.push_back("end " + string(event.test_label) +
+                       (event.outcome == TestOutcome::kPassed ? " passed" : " failed"));
+    }
+  });
+  function<void()> wrapper = [&]() { ExecuteScalarSuite("Identity", identity, table); };
+  TinyTest::InterceptCout(wrapper);
+  RemoveTestEventListener(listener_id);
+
+  EXPECT_THAT(events,
+              ElementsAre("begin first",
+                          "thread begin first",
+                          "run 1",
+                          "thread end first",
+                          "end first passed",
+                          "begin second",
+                          "thread begin second",
+                          "run 2",
+                          "thread end second",
+                          "end second failed"));
+}
+
+TEST(ExecuteScalarSuite, ShouldRunPredicates) {
+  ScalarTestTable<bool, int> table = {{"zero", true, 0}, {"one", false, 1}, {"two", false, 2}};
+  function<bool(int)> is_even = [](int value) { return value % 2 == 0; };
+  TestResults results;
+  function<void()> wrapper = [&]() { results = ExecuteScalarSuite("IsEven", is_even, table); };
+  string output = TinyTest::InterceptCout(wrapper);
+
+  EXPECT_THAT(results.Passed(), Eq(2));
+  EXPECT_THAT(results.FailureMessages(), ElementsAre("IsEven::two (row 2) expected: 0, actual: 1"));
+  EXPECT_THAT(output, HasSubstr("  2 of 3 rows passed\n"));
+}
+
+TEST(ExecuteScalarSuite, ShouldSkipEveryRowWhenDisabled) {
+  ScalarTestTable<int, int> table = {{"first", 1, 1}, {"second", 2, 2}};
+  function<int(int)> identity = [](int value) { return value; };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteScalarSuite("Identity", identity, table, std::nullopt, std::nullopt, false);
+  };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Skipped(), Eq(2));
+}
+}  // End namespace
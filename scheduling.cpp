@@ -0,0 +1,224 @@
+/***************************************************************************************
+ * @file scheduling.cpp                                                                *
+ *                                                                                     *
+ * @brief Defines longest-first scheduling of tests from their past durations.         *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "scheduling.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace TinyTest {
+namespace {
+using std::endl;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::chrono::nanoseconds;
+
+// Identifies the format of a written history.
+constexpr string_view kHistoryHeader = "TinyTest durations 1";
+
+// The estimate for a row with no history when no row has history.
+constexpr nanoseconds kDefaultEstimate = std::chrono::milliseconds(1);
+}  // End namespace
+
+// Begin DurationHistory methods
+void DurationHistory::Record(const string& qualified_test_label, nanoseconds duration) {
+  auto existing = durations_.find(qualified_test_label);
+  if (existing == durations_.end()) {
+    durations_.emplace(qualified_test_label, duration);
+  } else {
+    existing->second = (existing->second + duration) / 2;
+  }
+}
+
+std::optional<nanoseconds> DurationHistory::Predict(const string& qualified_test_label) const {
+  auto existing = durations_.find(qualified_test_label);
+  if (existing == durations_.end()) {
+    return std::nullopt;
+  }
+  return existing->second;
+}
+
+size_t DurationHistory::Size() const {
+  return durations_.size();
+}
+
+void DurationHistory::Write(std::ostream& os) const {
+  // Sorted so the file is stable between runs and diffs well.
+  vector<std::pair<string_view, nanoseconds>> sorted(durations_.begin(), durations_.end());
+  std::sort(sorted.begin(), sorted.end());
+  os << kHistoryHeader << ' ' << sorted.size() << '\n';
+  for (const auto& [label, duration] : sorted) {
+    os << duration.count() << ' ';
+    for (char c : label) {
+      if (c == '\\') {
+        os << "\\\\";
+      } else if (c == '\n') {
+        os << "\\n";
+      } else if (c == '\r') {
+        os << "\\r";
+      } else {
+        os << c;
+      }
+    }
+    os << '\n';
+  }
+}
+
+DurationHistory DurationHistory::Read(std::istream& is) {
+  string line;
+  if (!std::getline(is, line) || line.compare(0, kHistoryHeader.size(), kHistoryHeader) != 0) {
+    throw std::runtime_error("Invalid duration history header.");
+  }
+  size_t size;
+  try {
+    size = std::stoull(line.substr(kHistoryHeader.size()));
+  } catch (const std::exception&) {
+    throw std::runtime_error("Invalid duration history header.");
+  }
+  DurationHistory history;
+  string label;
+  for (size_t index = 0; index < size; index++) {
+    if (!std::getline(is, line)) {
+      throw std::runtime_error("Truncated duration history.");
+    }
+    size_t separator = line.find(' ');
+    nanoseconds::rep count;
+    try {
+      count = std::stoll(line.substr(0, separator));
+    } catch (const std::exception&) {
+      throw std::runtime_error("Invalid duration history entry: " + line);
+    }
+    if (separator == string::npos || count < 0) {
+      throw std::runtime_error("Invalid duration history entry: " + line);
+    }
+    label.clear();
+    for (size_t position = separator + 1; position < line.size(); position++) {
+      if (line[position] != '\\' || position + 1 == line.size()) {
+        label += line[position];
+        continue;
+      }
+      char escaped = line[++position];
+      label += escaped == 'n' ? '\n' : escaped == 'r' ? '\r' : escaped;
+    }
+    history.durations_[label] = nanoseconds(count);
+  }
+  return history;
+}
+
+DurationHistory DurationHistory::Load(const string& path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return DurationHistory();
+  }
+  return Read(file);
+}
+
+void DurationHistory::Save(const string& path) const {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Unable to write " + path + ": " + strerror(errno));
+  }
+  Write(file);
+  file.flush();
+  if (!file) {
+    throw std::runtime_error("Unable to write " + path + ".");
+  }
+}
+// End DurationHistory methods
+
+TestSchedule ScheduleLongestFirst(const vector<std::optional<nanoseconds>>& predicted_durations, size_t shard_count) {
+  // Step 1: Estimate the rows with no history.
+  nanoseconds known_total(0);
+  size_t known_count = 0;
+  for (const std::optional<nanoseconds>& predicted : predicted_durations) {
+    if (predicted.has_value()) {
+      known_total += *predicted;
+      known_count++;
+    }
+  }
+  // Rows that took no time at all would give every estimated row no weight, so they do not count as history.
+  nanoseconds estimate =
+      known_total > nanoseconds(0) ? known_total / static_cast<nanoseconds::rep>(known_count) : kDefaultEstimate;
+  TestSchedule schedule = {vector<TestShard>(std::max<size_t>(shard_count, 1)),
+                           nanoseconds(0),
+                           predicted_durations.size() - known_count};
+  vector<nanoseconds> durations;
+  durations.reserve(predicted_durations.size());
+  for (const std::optional<nanoseconds>& predicted : predicted_durations) {
+    durations.push_back(predicted.value_or(estimate));
+  }
+
+  // Step 2: Hand out the longest rows first.
+  vector<size_t> order(durations.size());
+  for (size_t row = 0; row < order.size(); row++) {
+    order[row] = row;
+  }
+  std::stable_sort(order.begin(), order.end(), [&durations](size_t left, size_t right) {
+    return durations[left] > durations[right];
+  });
+
+  // Step 3: Give each row to the shard with the least predicted time. Ties go to the shard with the fewest rows and
+  // then to the lowest numbered shard.
+  using ShardLoad = std::tuple<nanoseconds, size_t, size_t>;
+  std::priority_queue<ShardLoad, vector<ShardLoad>, std::greater<ShardLoad>> loads;
+  for (size_t shard = 0; shard < schedule.shards.size(); shard++) {
+    schedule.shards[shard].predicted_time = nanoseconds(0);
+    loads.push({nanoseconds(0), 0, shard});
+  }
+  for (size_t row : order) {
+    size_t least = std::get<2>(loads.top());
+    loads.pop();
+    TestShard& shard = schedule.shards[least];
+    shard.rows.push_back(row);
+    shard.predicted_time += durations[row];
+    schedule.predicted_makespan = std::max(schedule.predicted_makespan, shard.predicted_time);
+    loads.push({shard.predicted_time, shard.rows.size(), least});
+  }
+  return schedule;
+}
+
+TestSchedule ScheduleLongestFirst(const DurationHistory& history,
+                                  const string& suite_label,
+                                  const vector<string>& test_labels,
+                                  size_t shard_count) {
+  vector<std::optional<nanoseconds>> predicted_durations;
+  predicted_durations.reserve(test_labels.size());
+  for (const string& test_label : test_labels) {
+    predicted_durations.push_back(history.Predict(suite_label + "::" + test_label));
+  }
+  return ScheduleLongestFirst(predicted_durations, shard_count);
+}
+
+void PrintScheduleReport(std::ostream& os, const TestSchedule& schedule, const vector<nanoseconds>& actual_times) {
+  nanoseconds actual_makespan(0);
+  for (size_t shard = 0; shard < schedule.shards.size(); shard++) {
+    nanoseconds actual = shard < actual_times.size() ? actual_times[shard] : nanoseconds(0);
+    actual_makespan = std::max(actual_makespan, actual);
+    os << "  Shard " << shard << ": " << schedule.shards[shard].rows.size() << " tests, predicted "
+       << FormatDuration(schedule.shards[shard].predicted_time) << ", actual " << FormatDuration(actual) << endl;
+  }
+  os << "⏱Makespan: predicted " << FormatDuration(schedule.predicted_makespan) << ", actual "
+     << FormatDuration(actual_makespan);
+  if (schedule.estimated_rows > 0) {
+    os << " (" << schedule.estimated_rows << " tests had no history)";
+  }
+  os << endl;
+}
+
+}  // End namespace TinyTest
@@ -0,0 +1,275 @@
+#ifndef TinyTest__scheduling_h__
+#define TinyTest__scheduling_h__
+/***************************************************************************************
+ * @file scheduling.h                                                                  *
+ *                                                                                     *
+ * @brief Defines longest-first scheduling of tests from their past durations.         *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup scheduling Scheduling
+///
+/// When tests run in parallel the run takes as long as its slowest shard, so one long test that starts last decides the
+/// wall-clock time. A DurationHistory remembers how long each test took in past runs and is kept in a local file
+/// between runs. ScheduleLongestFirst uses it to split rows into shards with about the same predicted time. It hands
+/// out rows longest first, each to the shard with the least predicted time so far. Tests with no history are predicted
+/// to take as long as the average test that has history, so until there is history the shards are balanced by row
+/// count.
+///
+/// ExecuteSuiteSharded runs each shard on its own thread, records the new durations in the history, and reports the
+/// predicted and actual makespan.
+/// @code{.cpp}
+/// TinyTest::DurationHistory history = TinyTest::DurationHistory::Load("durations.txt");
+/// results += TinyTest::ExecuteSuiteSharded("Solver", solve, {...}, 8, history);
+/// history.Save("durations.txt");
+/// @endcode
+
+/// @addtogroup scheduling
+/// @{
+
+/// @brief How long each test took in past runs keyed by its qualified label, "suite_label::test_label".
+class DurationHistory {
+ public:
+  /// @brief Records a new duration for a test.
+  ///
+  /// The prediction for a test that already has one becomes the average of the old prediction and this duration so a
+  /// single slow run does not dominate it.
+  /// @param qualified_test_label The qualified label of the test.
+  /// @param duration How long the test took.
+  void Record(const std::string& qualified_test_label, std::chrono::nanoseconds duration);
+
+  /// @brief Gets the predicted duration of a test.
+  /// @param qualified_test_label The qualified label of the test.
+  /// @return The predicted duration or nullopt if the test has no history.
+  std::optional<std::chrono::nanoseconds> Predict(const std::string& qualified_test_label) const;
+
+  /// @brief Getter for the number of tests with history.
+  /// @return The number of tests.
+  size_t Size() const;
+
+  /// @brief Writes the history so it can be read by Read.
+  /// @param os The stream to write to.
+  void Write(std::ostream& os) const;
+
+  /// @brief Reads a history written by Write.
+  /// @param is The stream to read from.
+  /// @return The history.
+  /// @throws std::runtime_error if is does not contain a history written by Write.
+  static DurationHistory Read(std::istream& is);
+
+  /// @brief Reads a history file.
+  /// @param path The path of the file.
+  /// @return The history or an empty history if the file does not exist.
+  /// @throws std::runtime_error if the file exists but does not contain a history.
+  static DurationHistory Load(const std::string& path);
+
+  /// @brief Writes the history to a file, replacing it if it exists.
+  /// @param path The path of the file.
+  /// @throws std::runtime_error if the file can not be written.
+  void Save(const std::string& path) const;
+
+ private:
+  std::unordered_map<std::string, std::chrono::nanoseconds> durations_;
+};
+
+/// @brief Some rows of a suite that are run together.
+struct TestShard {
+  /// @brief The indexes of the rows in the order they should run, longest first.
+  std::vector<size_t> rows;
+  /// @brief The sum of the predicted durations of the rows.
+  std::chrono::nanoseconds predicted_time;
+};
+
+/// @brief Rows split into shards with about the same predicted time.
+struct TestSchedule {
+  /// @brief The shards. Every row is in exactly one shard. Some shards are empty if there are fewer rows than shards.
+  std::vector<TestShard> shards;
+  /// @brief The predicted time of the slowest shard.
+  std::chrono::nanoseconds predicted_makespan;
+  /// @brief The number of rows with no history whose durations were estimated.
+  size_t estimated_rows;
+};
+
+/// @brief Splits rows into shards by handing out the longest rows first, each to the shard with the least predicted
+/// time so far.
+///
+/// Rows with no prediction are estimated to take the average of the rows that have one. If no row has one, or they all
+/// predict no time, they each count as 1 ms so the shards are balanced by row count. Rows with equal predictions keep
+/// their original order and shards with equal predicted times take rows in turn.
+/// @param predicted_durations The predicted duration of each row or nullopt if it has no history.
+/// @param shard_count The number of shards. This is at least 1.
+/// @return The schedule.
+TestSchedule ScheduleLongestFirst(const std::vector<std::optional<std::chrono::nanoseconds>>& predicted_durations,
+                                  size_t shard_count);
+
+/// @brief Splits the rows of a suite into shards using the durations in a history.
+/// @param history The history to predict durations from.
+/// @param suite_label The label of the suite.
+/// @param test_labels The label of each row.
+/// @param shard_count The number of shards. This is at least 1.
+/// @return The schedule.
+TestSchedule ScheduleLongestFirst(const DurationHistory& history,
+                                  const std::string& suite_label,
+                                  const std::vector<std::string>& test_labels,
+                                  size_t shard_count);
+
+/// @brief Prints how long each shard was predicted to take and how long it took.
+/// @param os The stream to print to.
+/// @param schedule The schedule that was run.
+/// @param actual_times How long each shard took, in the same order as schedule.shards.
+void PrintScheduleReport(std::ostream& os,
+                         const TestSchedule& schedule,
+                         const std::vector<std::chrono::nanoseconds>& actual_times);
+
+/// @brief Executes a suite with its rows split into shards by ScheduleLongestFirst and each shard run on its own
+/// thread.
+///
+/// function_to_test, the compare functions, and before_each and after_each may be called from several threads at once.
+/// The output of each shard is buffered and printed in shard order after every shard has finished. The durations of
+/// the rows that ran are recorded in history.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param tests The test runs.
+/// @param shard_count The number of shards to run at once.
+/// @param history The history to predict durations from and record new durations in.
+/// @param suite_Compare A function used to Compare the expected and actual test results.
+/// @param before_all This is called before any shard is started.
+/// @param after_all This is called after every shard has finished.
+/// @return The results of the suite.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteSharded(std::string suite_label,
+                                std::function<TResult(TInputParams...)> function_to_test,
+                                std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                size_t shard_count,
+                                DurationHistory& history,
+                                MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt,
+                                MaybeTestConfigureFunction before_all = std::nullopt,
+                                MaybeTestConfigureFunction after_all = std::nullopt);
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteSharded(std::string suite_label,
+                                std::function<TResult(TInputParams...)> function_to_test,
+                                std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                size_t shard_count,
+                                DurationHistory& history,
+                                MaybeTestCompareFunction<TResult> suite_Compare,
+                                MaybeTestConfigureFunction before_all,
+                                MaybeTestConfigureFunction after_all) {
+  const TestTuple<TResult, TInputParams...>* rows = tests.begin();
+  // Disabled rows are skipped before the shards start so they are left out of the schedule.
+  std::vector<size_t> enabled_rows;
+  std::vector<std::optional<std::chrono::nanoseconds>> predicted_durations;
+  for (size_t row = 0; row < tests.size(); row++) {
+    if (std::get<6>(rows[row])) {
+      enabled_rows.push_back(row);
+      predicted_durations.push_back(history.Predict(suite_label + "::" + std::get<0>(rows[row])));
+    }
+  }
+  TestSchedule schedule = ScheduleLongestFirst(predicted_durations, shard_count);
+  for (TestShard& shard : schedule.shards) {
+    for (size_t& row : shard.rows) {
+      row = enabled_rows[row];
+    }
+  }
+
+  TestResults results;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PublishSuiteBegin(suite_label);
+  if (tests.size() == 0) {
+    std::cout << "🚧Skipping suite: " << suite_label << " because it is empty." << std::endl;
+    PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
+    return results;
+  }
+  std::cout << "🚀Beginning Suite: " << suite_label << std::endl;
+
+  // Step 1: Suite Setup
+  if (before_all.has_value()) {
+    (*before_all)();
+  }
+
+  // Step 2: Skip the disabled rows and execute each shard on its own thread.
+  for (const TestTuple<TResult, TInputParams...>& test : tests) {
+    if (!std::get<6>(test)) {
+      ExecuteTest(std::cout, results, suite_label, function_to_test, suite_Compare, test);
+    }
+  }
+  size_t count = schedule.shards.size();
+  std::vector<std::ostringstream> outputs(count);
+  std::vector<TestResults> shard_results(count);
+  std::vector<std::chrono::nanoseconds> actual_times(count);
+  std::vector<std::chrono::nanoseconds> row_durations(tests.size());
+  std::vector<std::exception_ptr> errors(count);
+  std::vector<std::thread> threads;
+  for (size_t shard = 0; shard < count; shard++) {
+    threads.emplace_back([&, shard]() {
+      std::chrono::steady_clock::time_point shard_start = std::chrono::steady_clock::now();
+      try {
+        for (size_t row : schedule.shards[shard].rows) {
+          std::chrono::steady_clock::time_point row_start = std::chrono::steady_clock::now();
+          ExecuteTest(outputs[shard], shard_results[shard], suite_label, function_to_test, suite_Compare, rows[row]);
+          row_durations[row] = std::chrono::steady_clock::now() - row_start;
+        }
+      } catch (...) {
+        errors[shard] = std::current_exception();
+      }
+      actual_times[shard] = std::chrono::steady_clock::now() - shard_start;
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  std::exception_ptr error = nullptr;
+  for (size_t shard = 0; shard < count; shard++) {
+    if (error == nullptr) {
+      error = errors[shard];
+    }
+    std::cout << outputs[shard].str();
+    results += shard_results[shard];
+  }
+  if (error == nullptr) {
+    for (size_t row : enabled_rows) {
+      history.Record(suite_label + "::" + std::get<0>(rows[row]), row_durations[row]);
+    }
+  }
+
+  // Step 3: Suite Teardown
+  if (after_all.has_value()) {
+    (*after_all)();
+  }
+  if (error == nullptr) {
+    PrintScheduleReport(std::cout, schedule, actual_times);
+  }
+  std::cout << "Ending Suite: " << suite_label << std::endl;
+  PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
+  // A shard that threw stopped early, so its exception is rethrown only after the suite has been torn down.
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+  return results;
+}
+
+/// @}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__scheduling_h__)
@@ -0,0 +1,201 @@
+/***************************************************************************************
+ * @file scheduling_test.cpp                                                           *
+ *                                                                                     *
+ * @brief Tests for longest-first scheduling of tests from their past durations.       *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "scheduling.h"
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::make_tuple;
+using std::optional;
+using std::string;
+using std::vector;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using testing::Eq;
+using testing::HasSubstr;
+using TinyTest::DurationHistory;
+using TinyTest::ExecuteSuiteSharded;
+using TinyTest::MakeTest;
+using TinyTest::PrintScheduleReport;
+using TinyTest::ScheduleLongestFirst;
+using TinyTest::TestResults;
+using TinyTest::TestSchedule;
+
+TEST(ScheduleLongestFirst, ShouldBalanceThePredictedTimeOfTheShards) {
+  vector<optional<nanoseconds>> predicted;
+  for (int row = 0; row < 8; row++) {
+    predicted.push_back(milliseconds(row + 1));
+  }
+  TestSchedule schedule = ScheduleLongestFirst(predicted, 2);
+  ASSERT_THAT(schedule.shards.size(), Eq(2));
+  EXPECT_THAT(schedule.shards[0].rows, Eq(vector<size_t>({7, 4, 3, 0})));
+  EXPECT_THAT(schedule.shards[1].rows, Eq(vector<size_t>({6, 5, 2, 1})));
+  EXPECT_THAT(schedule.shards[0].predicted_time, Eq(milliseconds(18)));
+  EXPECT_THAT(schedule.predicted_makespan, Eq(milliseconds(18)));
+  EXPECT_THAT(schedule.estimated_rows, Eq(0));
+}
+
+TEST(ScheduleLongestFirst, ShouldEstimateRowsWithNoHistory) {
+  // The new rows are estimated at the 3 ms average of the rows with history.
+  TestSchedule schedule = ScheduleLongestFirst({milliseconds(4), std::nullopt, milliseconds(2), std::nullopt}, 2);
+  EXPECT_THAT(schedule.shards[0].rows, Eq(vector<size_t>({0, 2})));
+  EXPECT_THAT(schedule.shards[1].rows, Eq(vector<size_t>({1, 3})));
+  EXPECT_THAT(schedule.predicted_makespan, Eq(milliseconds(6)));
+  EXPECT_THAT(schedule.estimated_rows, Eq(2));
+
+  // With no history at all the shards are balanced by row count in row order.
+  schedule = ScheduleLongestFirst({std::nullopt, std::nullopt, std::nullopt}, 2);
+  EXPECT_THAT(schedule.shards[0].rows, Eq(vector<size_t>({0, 2})));
+  EXPECT_THAT(schedule.shards[1].rows, Eq(vector<size_t>({1})));
+}
+
+TEST(ScheduleLongestFirst, ShouldBalanceRowsThatTakeNoTimeByRowCount) {
+  TestSchedule schedule =
+      ScheduleLongestFirst({nanoseconds(0), nanoseconds(0), std::nullopt, std::nullopt, std::nullopt}, 2);
+  EXPECT_THAT(schedule.shards[0].rows, Eq(vector<size_t>({2, 4})));
+  EXPECT_THAT(schedule.shards[1].rows, Eq(vector<size_t>({3, 0, 1})));
+  EXPECT_THAT(schedule.predicted_makespan, Eq(milliseconds(2)));
+}
+
+TEST(DurationHistory, ShouldAverageNewDurationsAndRoundTrip) {
+  DurationHistory history;
+  history.Record("Suite::Slow", milliseconds(10));
+  history.Record("Suite::Slow", milliseconds(20));
+  history.Record("Suite::Odd\\label\n", nanoseconds(7));
+  EXPECT_THAT(history.Predict("Suite::Slow"), Eq(milliseconds(15)));
+  EXPECT_THAT(history.Predict("Suite::Missing"), Eq(std::nullopt));
+
+  std::stringstream written;
+  history.Write(written);
+  EXPECT_THAT(written.str(), Eq("TinyTest durations 1 2\n7 Suite::Odd\\\\label\\n\n15000000 Suite::Slow\n"));
+  DurationHistory read = DurationHistory::Read(written);
+  EXPECT_THAT(read.Size(), Eq(2));
+  EXPECT_THAT(read.Predict("Suite::Odd\\label\n"), Eq(nanoseconds(7)));
+  EXPECT_THAT(read.Predict("Suite::Slow"), Eq(milliseconds(15)));
+
+  std::istringstream invalid("TinyTest run 1 0\n");
+  EXPECT_THROW(DurationHistory::Read(invalid), std::runtime_error);
+  EXPECT_THAT(DurationHistory::Load(testing::TempDir() + "scheduling_test_missing.txt").Size(), Eq(0));
+}
+
+TEST(PrintScheduleReport, ShouldComparePredictedAndActualTimes) {
+  TestSchedule schedule = ScheduleLongestFirst({milliseconds(3), std::nullopt}, 2);
+  std::ostringstream os;
+  PrintScheduleReport(os, schedule, {milliseconds(4), nanoseconds(2500)});
+  EXPECT_THAT(os.str(),
+              Eq("  Shard 0: 1 tests, predicted 3.0 ms, actual 4.0 ms\n"
+                 "  Shard 1: 1 tests, predicted 3.0 ms, actual 2.5 us\n"
+                 "⏱Makespan: predicted 3.0 ms, actual 4.0 ms (1 tests had no history)\n"));
+}
+
+TEST(ExecuteSuiteSharded, ShouldRunEveryRowAndRecordTheirDurations) {
+  DurationHistory history;
+  history.Record("Square::Two", milliseconds(5));
+  TinyTest::MaybeTestCompareFunction<int> compare = std::nullopt;
+  TinyTest::MaybeTestConfigureFunction configure = std::nullopt;
+  function<int(int)> square = [](int value) { return value * value; };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuiteSharded("Square",
+                                  square,
+                                  {
+                                      MakeTest("One", 1, make_tuple(1)),
+                                      MakeTest("Two", 4, make_tuple(2)),
+                                      MakeTest("Three", 0, make_tuple(3)),
+                                      MakeTest("Four", 16, make_tuple(4), compare, configure, configure, false),
+                                  },
+                                  2,
+                                  history);
+  };
+  string captured = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Total(), Eq(4));
+  EXPECT_THAT(results.Passed(), Eq(2));
+  EXPECT_THAT(results.Skipped(), Eq(1));
+  EXPECT_THAT(results.FailureMessages(), Eq(vector<string>({"Square::Three expected: 0, actual: 9"})));
+  EXPECT_THAT(history.Size(), Eq(3));
+  EXPECT_THAT(history.Predict("Square::One").has_value(), Eq(true));
+  EXPECT_THAT(history.Predict("Square::Four").has_value(), Eq(false));
+  EXPECT_THAT(captured, HasSubstr("🚀Beginning Suite: Square\n"));
+  EXPECT_THAT(captured, HasSubstr("  Shard 1: "));
+  EXPECT_THAT(captured, HasSubstr("⏱Makespan: predicted "));
+}
+
+TEST(ExecuteSuiteSharded, ShouldLeaveDisabledRowsOutOfTheSchedule) {
+  DurationHistory history;
+  TinyTest::MaybeTestCompareFunction<int> compare = std::nullopt;
+  TinyTest::MaybeTestConfigureFunction configure = std::nullopt;
+  function<int(int)> identity = [](int value) { return value; };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuiteSharded("Identity",
+                                  identity,
+                                  {
+                                      MakeTest("0", 0, make_tuple(0)),
+                                      MakeTest("1", 1, make_tuple(1)),
+                                      MakeTest("2", 2, make_tuple(2)),
+                                      MakeTest("3", 3, make_tuple(3)),
+                                      MakeTest("4", 4, make_tuple(4)),
+                                      MakeTest("5", 5, make_tuple(5)),
+                                      MakeTest("6", 6, make_tuple(6)),
+                                      MakeTest("7", 7, make_tuple(7)),
+                                      MakeTest("Disabled", 8, make_tuple(8), compare, configure, configure, false),
+                                  },
+                                  4,
+                                  history);
+  };
+  string captured = TinyTest::InterceptCout(wrapper);
+  EXPECT_THAT(results.Passed(), Eq(8));
+  EXPECT_THAT(results.Skipped(), Eq(1));
+  for (int shard = 0; shard < 4; shard++) {
+    EXPECT_THAT(captured, HasSubstr("  Shard " + std::to_string(shard) + ": 2 tests, predicted 2.0 ms"));
+  }
+}
+
+TEST(ExecuteSuiteSharded, ShouldTearDownTheSuiteBeforeRethrowing) {
+  DurationHistory history;
+  TinyTest::MaybeTestCompareFunction<int> compare = std::nullopt;
+  TinyTest::MaybeTestConfigureFunction throws = []() { throw std::runtime_error("setup failed"); };
+  bool was_torn_down = false;
+  TinyTest::MaybeTestConfigureFunction before_all = std::nullopt;
+  TinyTest::MaybeTestConfigureFunction after_all = [&was_torn_down]() { was_torn_down = true; };
+  function<int(int)> identity = [](int value) { return value; };
+  // InterceptCout does not restore std::cout if its function throws, so the exception is caught inside it.
+  bool did_throw = false;
+  function<void()> wrapper = [&]() {
+    try {
+      ExecuteSuiteSharded("Identity",
+                          identity,
+                          {MakeTest("One", 1, make_tuple(1)), MakeTest("Two", 2, make_tuple(2), compare, throws)},
+                          2,
+                          history,
+                          compare,
+                          before_all,
+                          after_all);
+    } catch (const std::runtime_error&) {
+      did_throw = true;
+    }
+  };
+  TinyTest::InterceptCout(wrapper);
+  EXPECT_TRUE(did_throw);
+  EXPECT_TRUE(was_torn_down);
+  EXPECT_THAT(history.Size(), Eq(0));
+}
+}  // End namespace
@@ -9,10 +9,29 @@
 #define _XOPEN_SOURCE_EXTENDED
 #include "tinytest.h"
 
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace TinyTest {
@@ -20,6 +39,134 @@ namespace {
 using std::endl;
 using std::string;
 using std::vector;
+
+struct RegisteredListener {
+  RegisteredListener(uint64_t id, TestEventListener function) : id(id), function(std::move(function)) {}
+
+  uint64_t id;
+  TestEventListener function;
+  // The number of threads calling function. RemoveTestEventListener waits for this to reach zero.
+  std::atomic<int> calls{0};
+  std::atomic<bool> is_removed{false};
+};
+
+struct TestEventListeners {
+  std::mutex mutex;
+  // This is notified when the last call to a removed listener returns.
+  std::condition_variable removed_listener_idle;
+  uint64_t next_id = 1;
+  // Publishing copies this pointer so listeners can be added and removed while events are being published.
+  std::shared_ptr<const vector<std::shared_ptr<RegisteredListener>>> listeners =
+      std::make_shared<const vector<std::shared_ptr<RegisteredListener>>>();
+};
+
+std::atomic<bool> has_test_event_listeners(false);
+
+std::atomic<uint32_t> max_printed_failure_details(20);
+
+TestEventListeners& GetTestEventListeners() {
+  static TestEventListeners listeners;
+  return listeners;
+}
+
+// Ends a call to listener and wakes RemoveTestEventListener if it is waiting for the last one.
+void EndListenerCall(TestEventListeners& registry, RegisteredListener& listener) {
+  if (--listener.calls == 0 && listener.is_removed) {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.removed_listener_idle.notify_all();
+  }
+}
+
+struct StartupProfiler {
+  StartupProfiler();
+
+  std::atomic<bool> is_enabled;
+  std::mutex mutex;
+  StartupProfile profile;
+  // The time the first test of the table being built was made and the bytes made for it so far.
+  std::optional<std::chrono::steady_clock::time_point> table_start;
+  size_t table_bytes = 0;
+  size_t table_test_count = 0;
+};
+
+void PrintStartupProfileAtExit() {
+  PrintStartupProfile(std::cerr, GetStartupProfile());
+}
+
+StartupProfiler::StartupProfiler() : is_enabled(false) {
+  const char* value = std::getenv("TINYTEST_PROFILE_STARTUP");
+  if (value != nullptr && string(value) != "" && string(value) != "0") {
+    is_enabled = true;
+    std::atexit(PrintStartupProfileAtExit);
+  }
+}
+
+StartupProfiler& GetStartupProfiler() {
+  // This is never deleted so it is still usable when the profile is printed at exit.
+  static StartupProfiler* profiler = new StartupProfiler();
+  return *profiler;
+}
+
+// Ends the table being built and records it as suite_label. The caller must hold profiler.mutex.
+void FinishSuiteTable(StartupProfiler& profiler, const string& suite_label, size_t test_count, size_t table_bytes) {
+  std::chrono::nanoseconds construction_time(0);
+  if (profiler.table_start.has_value()) {
+    construction_time = std::chrono::steady_clock::now() - *profiler.table_start;
+  }
+  profiler.profile.suites.push_back({suite_label, test_count, profiler.table_bytes + table_bytes, construction_time});
+  profiler.table_start = std::nullopt;
+  profiler.table_bytes = 0;
+  profiler.table_test_count = 0;
+}
+
+string FormatMilliseconds(std::chrono::nanoseconds duration) {
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(3) << std::chrono::duration<double, std::milli>(duration).count() << "ms";
+  return os.str();
+}
+
+// Writes message on one line by escaping backslashes and line breaks.
+void WriteEscapedLine(std::ostream& os, const string& message) {
+  for (char c : message) {
+    if (c == '\\') {
+      os << "\\\\";
+    } else if (c == '\n') {
+      os << "\\n";
+    } else if (c == '\r') {
+      os << "\\r";
+    } else {
+      os << c;
+    }
+  }
+  os << '\n';
+}
+
+string ReadEscapedLine(std::istream& is) {
+  string line;
+  if (!std::getline(is, line)) {
+    throw std::runtime_error("Truncated test results.");
+  }
+  string message;
+  message.reserve(line.size());
+  for (size_t index = 0; index < line.size(); index++) {
+    if (line[index] != '\\' || index + 1 == line.size()) {
+      message += line[index];
+      continue;
+    }
+    char escaped = line[++index];
+    message += escaped == 'n' ? '\n' : escaped == 'r' ? '\r' : escaped;
+  }
+  return message;
+}
+
+vector<string> FormatMessages(const vector<TestMessage>& messages) {
+  vector<string> formatted_messages;
+  formatted_messages.reserve(messages.size());
+  for (const TestMessage& message : messages) {
+    formatted_messages.push_back(message.Text());
+  }
+  return formatted_messages;
+}
 }  // End namespace
 
 // TODO: Add TShared(*)(string /*test_name*/, UUID /*testRunId*/)
@@ -34,12 +181,72 @@ using std::vector;
 //   function. Suite and/or Test compare functions may consume this shared data,
 //   but it will not be shared with the execution of function_to_test.
 
+// Begin TestMessage methods
+TestMessage::TestMessage() {}
+
+TestMessage::TestMessage(string text) {
+  if (text.size() >= kCompressionThreshold) {
+    compressed_prefix_ = std::make_shared<const CompressedString>(text);
+  } else {
+    prefix_ = std::move(text);
+  }
+}
+
+TestMessage::TestMessage(string prefix, Formatter formatter)
+    : formatter_(std::make_shared<const Formatter>(std::move(formatter))), prefix_(std::move(prefix)) {}
+
+bool TestMessage::IsDeferred() const {
+  return formatter_ != nullptr;
+}
+
+bool TestMessage::IsCompressed() const {
+  return compressed_prefix_ != nullptr;
+}
+
+std::ostream& TestMessage::Print(std::ostream& os) const {
+  if (compressed_prefix_ != nullptr) {
+    os << compressed_prefix_->Text();
+  }
+  os << prefix_;
+  if (formatter_ != nullptr) {
+    (*formatter_)(os);
+  }
+  return os;
+}
+
+string TestMessage::Text() const {
+  if (formatter_ == nullptr && compressed_prefix_ == nullptr) {
+    return prefix_;
+  }
+  std::ostringstream os;
+  Print(os);
+  return os.str();
+}
+// End TestMessage methods
+
+string TestErrorKindName(TestErrorKind kind) {
+  switch (kind) {
+    case TestErrorKind::kException:
+      return "Exception";
+    case TestErrorKind::kMemoryLimit:
+      return "Memory limit exceeded";
+    case TestErrorKind::kCpuTimeLimit:
+      return "CPU time limit exceeded";
+    case TestErrorKind::kOpenFileLimit:
+      return "Open file limit exceeded";
+    case TestErrorKind::kCrashed:
+      return "Crashed";
+  }
+  return "Unknown";
+}
+
 // Begin TestResults methods
 TestResults::TestResults() : errors_(0), failed_(0), passed_(0), skipped_(0), total_(0) {}
 
 TestResults::TestResults(const TestResults& other)
     : error_messages_(other.error_messages_),
       errors_(other.errors_),
+      errors_by_kind_(other.errors_by_kind_),
       failed_(other.failed_),
       failure_messages_(other.failure_messages_),
       passed_(other.passed_),
@@ -54,24 +261,36 @@ TestResults::TestResults(uint32_t errors,
                          uint32_t total,
                          vector<string> error_messages,
                          vector<string> failure_messages,
-                         vector<string> skip_messages)
-    : error_messages_(error_messages),
+                         vector<string> skip_messages,
+                         std::map<TestErrorKind, uint32_t> errors_by_kind)
+    : error_messages_(error_messages.begin(), error_messages.end()),
       errors_(errors),
+      errors_by_kind_(std::move(errors_by_kind)),
       failed_(failed),
-      failure_messages_(failure_messages),
+      failure_messages_(failure_messages.begin(), failure_messages.end()),
       passed_(passed),
-      skip_messages_(skip_messages),
+      skip_messages_(skip_messages.begin(), skip_messages.end()),
       skipped_(skipped),
-      total_(total) {}
+      total_(total) {
+  if (errors_by_kind_.empty() && errors_ > 0) {
+    errors_by_kind_[TestErrorKind::kException] = errors_;
+  }
+}
 
 TestResults& TestResults::Error() {
   errors_++;
+  errors_by_kind_[TestErrorKind::kException]++;
   return *this;
 }
 
 TestResults& TestResults::Error(string message) {
+  return Error(TestErrorKind::kException, std::move(message));
+}
+
+TestResults& TestResults::Error(TestErrorKind kind, string message) {
   errors_++;
-  error_messages_.push_back(message);
+  errors_by_kind_[kind]++;
+  error_messages_.push_back(std::move(message));
   return *this;
 }
 
@@ -88,7 +307,18 @@ TestResults& TestResults::Fail(const string& message) {
   return *this;
 }
 
+TestResults& TestResults::Fail(TestMessage message) {
+  total_++;
+  failed_++;
+  failure_messages_.push_back(std::move(message));
+  return *this;
+}
+
 vector<string> TestResults::FailureMessages() const {
+  return FormatMessages(failure_messages_);
+}
+
+const vector<TestMessage>& TestResults::LazyFailureMessages() const {
   return failure_messages_;
 }
 
@@ -112,10 +342,18 @@ TestResults& TestResults::Skip(const string& message) {
 }
 
 vector<string> TestResults::SkipMessages() const {
+  return FormatMessages(skip_messages_);
+}
+
+const vector<TestMessage>& TestResults::LazySkipMessages() const {
   return skip_messages_;
 }
 
 vector<string> TestResults::ErrorMessages() const {
+  return FormatMessages(error_messages_);
+}
+
+const vector<TestMessage>& TestResults::LazyErrorMessages() const {
   return error_messages_;
 }
 
@@ -123,6 +361,15 @@ uint32_t TestResults::Errors() const {
   return errors_;
 }
 
+uint32_t TestResults::Errors(TestErrorKind kind) const {
+  auto count = errors_by_kind_.find(kind);
+  return count == errors_by_kind_.end() ? 0 : count->second;
+}
+
+const std::map<TestErrorKind, uint32_t>& TestResults::ErrorsByKind() const {
+  return errors_by_kind_;
+}
+
 uint32_t TestResults::Failed() const {
   return failed_;
 }
@@ -140,29 +387,17 @@ uint32_t TestResults::Total() const {
 }
 
 TestResults TestResults::operator+(const TestResults& other) const {
-  vector<string> error_messages;
-  error_messages.insert(error_messages.end(), error_messages_.begin(), error_messages_.end());
-  error_messages.insert(error_messages.end(), other.error_messages_.begin(), other.error_messages_.end());
-  vector<string> failure_messages;
-  failure_messages.insert(failure_messages.end(), failure_messages_.begin(), failure_messages_.end());
-  failure_messages.insert(failure_messages.end(), other.failure_messages_.begin(), other.failure_messages_.end());
-  vector<string> skip_messages;
-  skip_messages.insert(skip_messages.end(), skip_messages_.begin(), skip_messages_.end());
-  skip_messages.insert(skip_messages.end(), other.skip_messages_.begin(), other.skip_messages_.end());
-
-  return TestResults(errors_ + other.errors_,
-                     failed_ + other.failed_,
-                     passed_ + other.passed_,
-                     skipped_ + other.skipped_,
-                     total_ + other.total_,
-                     error_messages,
-                     failure_messages,
-                     skip_messages);
+  TestResults results(*this);
+  results += other;
+  return results;
 }
 
 TestResults& TestResults::operator+=(const TestResults& other) {
   error_messages_.insert(error_messages_.end(), other.error_messages_.begin(), other.error_messages_.end());
   errors_ += other.errors_;
+  for (const auto& count : other.errors_by_kind_) {
+    errors_by_kind_[count.first] += count.second;
+  }
   failed_ += other.failed_;
   failure_messages_.insert(failure_messages_.end(), other.failure_messages_.begin(), other.failure_messages_.end());
   passed_ += other.passed_;
@@ -172,26 +407,30 @@ TestResults& TestResults::operator+=(const TestResults& other) {
   return *this;
 }
 
-void PrintResults(std::ostream& os, TestResults results) {
-  auto skip_messages = results.SkipMessages();
+void PrintResults(std::ostream& os, TestResults results, uint32_t max_failure_messages) {
+  const vector<TestMessage>& skip_messages = results.LazySkipMessages();
   if (skip_messages.size() > 0) {
     os << "Skipped:" << endl;
-    for_each(skip_messages.begin(), skip_messages.end(), [&os](const string& message) {
-      os << "🚧Skipped: " << message << endl;
+    for_each(skip_messages.begin(), skip_messages.end(), [&os](const TestMessage& message) {
+      message.Print(os << "🚧Skipped: ") << endl;
     });
   }
-  auto failure_messages = results.FailureMessages();
+  const vector<TestMessage>& failure_messages = results.LazyFailureMessages();
   if (failure_messages.size() > 0) {
     os << "Failures:" << endl;
-    for_each(failure_messages.begin(), failure_messages.end(), [&os](const string& message) {
-      os << "❌FAILED: " << message << endl;
+    size_t printed_count = std::min<size_t>(failure_messages.size(), max_failure_messages);
+    for_each(failure_messages.begin(), failure_messages.begin() + printed_count, [&os](const TestMessage& message) {
+      message.Print(os << "❌FAILED: ") << endl;
     });
+    if (printed_count < failure_messages.size()) {
+      os << "❌...and " << failure_messages.size() - printed_count << " more failures." << endl;
+    }
   }
-  auto error_messages = results.ErrorMessages();
+  const vector<TestMessage>& error_messages = results.LazyErrorMessages();
   if (error_messages.size() > 0) {
     os << "Errors:" << endl;
-    for_each(error_messages.begin(), error_messages.end(), [&os](const string& message) {
-      os << "🔥ERROR: " << message << endl;
+    for_each(error_messages.begin(), error_messages.end(), [&os](const TestMessage& message) {
+      message.Print(os << "🔥ERROR: ") << endl;
     });
   }
   os << "Total tests: " << results.Total() << endl;
@@ -199,45 +438,512 @@ void PrintResults(std::ostream& os, TestResults results) {
   os << "Failed:      " << results.Failed() << " ❌" << endl;
   os << "Skipped:     " << results.Skipped() << " 🚧" << endl;
   os << "Errors:      " << results.Errors() << " 🔥" << endl;
+  for (const auto& count : results.ErrorsByKind()) {
+    if (count.first != TestErrorKind::kException) {
+      os << "  " << TestErrorKindName(count.first) << ": " << count.second << endl;
+    }
+  }
+}
+
+uint32_t MaxPrintedFailureDetails() {
+  return max_printed_failure_details.load(std::memory_order_relaxed);
 }
 
+void SetMaxPrintedFailureDetails(uint32_t max_failure_details) {
+  max_printed_failure_details = max_failure_details;
+}
+
+
+void WriteTestResults(std::ostream& os, const TestResults& results) {
+  vector<string> error_messages = results.ErrorMessages();
+  vector<string> failure_messages = results.FailureMessages();
+  vector<string> skip_messages = results.SkipMessages();
+  os << results.Errors() << ' ' << results.Failed() << ' ' << results.Passed() << ' ' << results.Skipped() << ' '
+     << results.Total() << ' ' << error_messages.size() << ' ' << failure_messages.size() << ' '
+     << skip_messages.size() << ' ' << results.ErrorsByKind().size();
+  for (const auto& count : results.ErrorsByKind()) {
+    os << ' ' << static_cast<int>(count.first) << ' ' << count.second;
+  }
+  os << '\n';
+  for (const vector<string>* messages : {&error_messages, &failure_messages, &skip_messages}) {
+    for (const string& message : *messages) {
+      WriteEscapedLine(os, message);
+    }
+  }
+}
+
+TestResults ReadTestResults(std::istream& is) {
+  uint32_t errors, failed, passed, skipped, total;
+  size_t message_counts[3];
+  size_t kind_count;
+  if (!(is >> errors >> failed >> passed >> skipped >> total >> message_counts[0] >> message_counts[1] >>
+        message_counts[2] >> kind_count)) {
+    throw std::runtime_error("Invalid test results header.");
+  }
+  std::map<TestErrorKind, uint32_t> errors_by_kind;
+  for (size_t index = 0; index < kind_count; index++) {
+    int kind;
+    uint32_t count;
+    if (!(is >> kind >> count) || kind < 0 || kind > static_cast<int>(TestErrorKind::kCrashed)) {
+      throw std::runtime_error("Invalid test results header.");
+    }
+    errors_by_kind[static_cast<TestErrorKind>(kind)] = count;
+  }
+  if (is.get() != '\n') {
+    throw std::runtime_error("Invalid test results header.");
+  }
+  vector<string> messages[3];
+  for (int kind = 0; kind < 3; kind++) {
+    for (size_t index = 0; index < message_counts[kind]; index++) {
+      messages[kind].push_back(ReadEscapedLine(is));
+    }
+  }
+  return TestResults(
+      errors, failed, passed, skipped, total, messages[0], messages[1], messages[2], std::move(errors_by_kind));
+}
 // End TestResults methods.
 
 MaybeTestConfigureFunction DefaultTestConfigureFunction() {
   return std::nullopt;
 }
 
-MaybeTestConfigureFunction Coalesce(MaybeTestConfigureFunction first, MaybeTestConfigureFunction second) {
-  if (first.has_value()) {
-    if (second.has_value()) {
-      // This is the only place we actually need to combine them.
-      return [&first, &second]() {
-        first.value()();
-        second.value()();
-      };
+// Begin TestConfigurePipeline methods
+TestConfigurePipeline::TestConfigurePipeline() : functions_(std::make_shared<vector<TestConfigureFunction>>()) {}
+
+TestConfigurePipeline::TestConfigurePipeline(std::initializer_list<MaybeTestConfigureFunction> functions)
+    : TestConfigurePipeline(vector<MaybeTestConfigureFunction>(functions)) {}
+
+TestConfigurePipeline::TestConfigurePipeline(const vector<MaybeTestConfigureFunction>& functions) {
+  auto flattened = std::make_shared<vector<TestConfigureFunction>>();
+  for (const MaybeTestConfigureFunction& function : functions) {
+    if (!function.has_value()) {
+      continue;
+    }
+    const TestConfigurePipeline* pipeline = function->target<TestConfigurePipeline>();
+    if (pipeline != nullptr) {
+      flattened->insert(flattened->end(), pipeline->functions_->begin(), pipeline->functions_->end());
     } else {
-      return first;
+      flattened->push_back(*function);
     }
-  } else {
-    return second;
+  }
+  functions_ = flattened;
+}
+
+void TestConfigurePipeline::operator()() const {
+  for (const TestConfigureFunction& function : *functions_) {
+    function();
   }
 }
 
+const vector<TestConfigureFunction>& TestConfigurePipeline::Functions() const {
+  return *functions_;
+}
+
+size_t TestConfigurePipeline::Size() const {
+  return functions_->size();
+}
+// End TestConfigurePipeline methods
+
+MaybeTestConfigureFunction Coalesce(MaybeTestConfigureFunction first, MaybeTestConfigureFunction second) {
+  return Coalesce({first, second});
+}
+
+MaybeTestConfigureFunction Coalesce(std::initializer_list<MaybeTestConfigureFunction> functions) {
+  const MaybeTestConfigureFunction* only_function = nullptr;
+  size_t count = 0;
+  for (const MaybeTestConfigureFunction& function : functions) {
+    if (function.has_value()) {
+      only_function = &function;
+      count++;
+    }
+  }
+  if (count == 0) {
+    return std::nullopt;
+  }
+  if (count == 1) {
+    return *only_function;
+  }
+  // This is the only place we actually need to combine them.
+  return TestConfigurePipeline(functions);
+}
+
+// Begin test event functions
+uint64_t AddTestEventListener(TestEventListener listener) {
+  TestEventListeners& registry = GetTestEventListeners();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto listeners = std::make_shared<vector<std::shared_ptr<RegisteredListener>>>(*registry.listeners);
+  uint64_t listener_id = registry.next_id++;
+  listeners->push_back(std::make_shared<RegisteredListener>(listener_id, std::move(listener)));
+  registry.listeners = listeners;
+  has_test_event_listeners = true;
+  return listener_id;
+}
+
+void RemoveTestEventListener(uint64_t listener_id) {
+  TestEventListeners& registry = GetTestEventListeners();
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  auto listeners = std::make_shared<vector<std::shared_ptr<RegisteredListener>>>(*registry.listeners);
+  auto removed = std::find_if(listeners->begin(), listeners->end(), [listener_id](const auto& listener) {
+    return listener->id == listener_id;
+  });
+  if (removed == listeners->end()) {
+    return;
+  }
+  std::shared_ptr<RegisteredListener> listener = *removed;
+  listeners->erase(removed);
+  has_test_event_listeners = !listeners->empty();
+  registry.listeners = listeners;
+  // Publishers that copied the old list may still be calling the listener. Any that have not started yet see
+  // is_removed and skip it.
+  listener->is_removed = true;
+  registry.removed_listener_idle.wait(lock, [&listener]() { return listener->calls == 0; });
+}
+
+bool HasTestEventListeners() {
+  return has_test_event_listeners.load(std::memory_order_relaxed);
+}
+
+void PublishTestEvent(const TestEvent& event) {
+  if (!HasTestEventListeners()) {
+    return;
+  }
+  TestEventListeners& registry = GetTestEventListeners();
+  std::shared_ptr<const vector<std::shared_ptr<RegisteredListener>>> listeners;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    listeners = registry.listeners;
+  }
+  for (const std::shared_ptr<RegisteredListener>& listener : *listeners) {
+    listener->calls++;
+    try {
+      if (!listener->is_removed) {
+        listener->function(event);
+      }
+    } catch (...) {
+      EndListenerCall(registry, *listener);
+      throw;
+    }
+    EndListenerCall(registry, *listener);
+  }
+}
+
+void PublishSuiteBegin(const string& suite_label) {
+  if (HasTestEventListeners()) {
+    PublishTestEvent({TestEventType::kSuiteBegin, suite_label, {}, TestOutcome::kPassed, false, {}});
+  }
+}
+
+void PublishSuiteEnd(const string& suite_label, std::chrono::nanoseconds duration) {
+  if (HasTestEventListeners()) {
+    PublishTestEvent({TestEventType::kSuiteEnd, suite_label, {}, TestOutcome::kPassed, false, duration});
+  }
+}
+
+void PublishTestBegin(const string& suite_label, const string& test_label) {
+  if (HasTestEventListeners()) {
+    PublishTestEvent({TestEventType::kTestBegin, suite_label, test_label, TestOutcome::kPassed, false, {}});
+  }
+}
+
+void PublishTestEnd(const string& suite_label,
+                    const string& test_label,
+                    TestOutcome outcome,
+                    bool has_error,
+                    std::chrono::nanoseconds duration) {
+  if (HasTestEventListeners()) {
+    PublishTestEvent({TestEventType::kTestEnd, suite_label, test_label, outcome, has_error, duration});
+  }
+}
+// End test event functions
+
+// Begin TestThreadScope methods
+TestThreadScope::TestThreadScope(const string& suite_label, const string& test_label)
+    : suite_label_(suite_label), test_label_(test_label) {
+  if (HasTestEventListeners()) {
+    PublishTestEvent({TestEventType::kTestThreadBegin, suite_label_, test_label_, TestOutcome::kPassed, false, {}});
+  }
+}
+
+TestThreadScope::~TestThreadScope() {
+  if (HasTestEventListeners()) {
+    PublishTestEvent({TestEventType::kTestThreadEnd, suite_label_, test_label_, TestOutcome::kPassed, false, {}});
+  }
+}
+// End TestThreadScope methods
+
+// Begin startup profile functions
+bool IsStartupProfilingEnabled() {
+  return GetStartupProfiler().is_enabled.load(std::memory_order_relaxed);
+}
+
+void EnableStartupProfiling(bool is_enabled) {
+  GetStartupProfiler().is_enabled = is_enabled;
+}
+
+StartupProfile GetStartupProfile() {
+  StartupProfiler& profiler = GetStartupProfiler();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  return profiler.profile;
+}
+
+void ResetStartupProfile() {
+  StartupProfiler& profiler = GetStartupProfiler();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  profiler.profile = StartupProfile();
+  profiler.table_start = std::nullopt;
+  profiler.table_bytes = 0;
+  profiler.table_test_count = 0;
+}
+
+void RecordTestConstructed(std::chrono::steady_clock::time_point start, size_t table_bytes) {
+  StartupProfiler& profiler = GetStartupProfiler();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  if (!profiler.table_start.has_value()) {
+    profiler.table_start = start;
+  }
+  profiler.table_bytes += table_bytes;
+  profiler.table_test_count++;
+}
+
+void RecordSuiteConstructed(const string& suite_label, size_t test_count, size_t table_bytes) {
+  StartupProfiler& profiler = GetStartupProfiler();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  FinishSuiteTable(profiler, suite_label, test_count, table_bytes);
+}
+
+void RecordSuiteStarted(const string& suite_label, size_t test_count) {
+  std::optional<std::chrono::nanoseconds> time_since_process_start = TimeSinceProcessStart();
+  StartupProfiler& profiler = GetStartupProfiler();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  if (!profiler.profile.time_to_first_suite.has_value()) {
+    profiler.profile.time_to_first_suite = time_since_process_start;
+  }
+  // Tests passed straight to ExecuteSuite never went through MakeTestSuite so their table ends here.
+  if (profiler.table_test_count > 0) {
+    FinishSuiteTable(profiler, suite_label, test_count, 0);
+  }
+}
+
+std::optional<std::chrono::nanoseconds> TimeSinceProcessStart() {
+#ifdef __linux__
+  // Field 22 of /proc/self/stat is the time the process started in clock ticks since boot. The name in field 2 can
+  // contain spaces so we start after its closing parenthesis, which leaves starttime as the 20th field.
+  std::ifstream stat("/proc/self/stat");
+  string contents((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+  size_t name_end = contents.rfind(')');
+  if (name_end == string::npos) {
+    return std::nullopt;
+  }
+  std::istringstream fields(contents.substr(name_end + 1));
+  string field;
+  for (int index = 0; index < 19; index++) {
+    fields >> field;
+  }
+  unsigned long long start_ticks;
+  long ticks_per_second = sysconf(_SC_CLK_TCK);
+  timespec now;
+  if (!(fields >> start_ticks) || ticks_per_second <= 0 || clock_gettime(CLOCK_BOOTTIME, &now) != 0) {
+    return std::nullopt;
+  }
+  std::chrono::nanoseconds uptime = std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+  std::chrono::nanoseconds start = std::chrono::nanoseconds(start_ticks * 1000000000ULL / ticks_per_second);
+  return uptime - start;
+#else
+  return std::nullopt;
+#endif
+}
+
+void PrintStartupProfile(std::ostream& os, const StartupProfile& profile) {
+  vector<SuiteStartupProfile> suites = profile.suites;
+  std::stable_sort(suites.begin(), suites.end(), [](const auto& left, const auto& right) {
+    return left.construction_time > right.construction_time;
+  });
+  size_t test_count = 0;
+  size_t table_bytes = 0;
+  std::chrono::nanoseconds construction_time(0);
+  for (const SuiteStartupProfile& suite : suites) {
+    test_count += suite.test_count;
+    table_bytes += suite.table_bytes;
+    construction_time += suite.construction_time;
+  }
+  os << "Startup Profile:" << endl;
+  os << "  Time to first suite: "
+     << (profile.time_to_first_suite.has_value() ? FormatMilliseconds(*profile.time_to_first_suite) : "unknown")
+     << endl;
+  os << "  Test tables: " << suites.size() << " suites, " << test_count << " tests, " << table_bytes << " bytes, "
+     << FormatMilliseconds(construction_time) << endl;
+  for (const SuiteStartupProfile& suite : suites) {
+    os << "    " << FormatMilliseconds(suite.construction_time) << " " << suite.test_count << " tests "
+       << suite.table_bytes << " bytes " << suite.suite_label << endl;
+  }
+}
+// End startup profile functions
+
 // Utility functions.
 TestResults& SkipTest(TestResults& results,
                       const std::string& suite_label,
                       const std::string& test_label,
                       std::optional<const std::string> reason) {
+  return SkipTest(std::cout, results, suite_label, test_label, reason);
+}
+
+TestResults& SkipTest(std::ostream& os,
+                      TestResults& results,
+                      const std::string& suite_label,
+                      const std::string& test_label,
+                      std::optional<const std::string> reason) {
   std::string qualified_test_label = suite_label + "::" + test_label;
-  std::cout << "  🚧Skipping Test: " << test_label;
+  os << "  🚧Skipping Test: " << test_label;
   if (reason.has_value()) {
-    std::cout << " because " << reason.value();
+    os << " because " << reason.value();
   }
-  std::cout << std::endl;
+  os << std::endl;
   results.Skip(qualified_test_label + (reason.has_value() ? " because " + reason.value() : ""));
+  PublishTestEnd(suite_label, test_label, TestOutcome::kSkipped, false, std::chrono::nanoseconds(0));
   return results;
 }
 
+string DescribeCaughtException(std::exception_ptr error) {
+  std::ostringstream os;
+  try {
+    std::rethrow_exception(error);
+  } catch (const std::exception& ex) {
+    os << "Caught exception \"" << ex.what() << "\".";
+  } catch (const std::string& message) {
+    os << "Caught string \"" << message << "\".";
+  } catch (const char* message) {
+    os << "Caught c-string \"" << message << "\".";
+  } catch (...) {
+    os << "Caught something that is neither an std::exception nor an std::string.";
+  }
+  return os.str();
+}
+
+string FormatDuration(std::chrono::duration<double, std::nano> duration) {
+  const char* unit = "ns";
+  double value = duration.count();
+  if (value >= 1e9) {
+    value /= 1e9;
+    unit = "s";
+  } else if (value >= 1e6) {
+    value /= 1e6;
+    unit = "ms";
+  } else if (value >= 1e3) {
+    value /= 1e3;
+    unit = "us";
+  }
+  char formatted[32];
+  snprintf(formatted, sizeof(formatted), "%.1f %s", value, unit);
+  return formatted;
+}
+
+void WriteJsonString(std::ostream& os, std::string_view text) {
+  os << '"';
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        os << "\\\"";
+        break;
+      case '\\':
+        os << "\\\\";
+        break;
+      case '\n':
+        os << "\\n";
+        break;
+      case '\r':
+        os << "\\r";
+        break;
+      case '\t':
+        os << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[7];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+          os << escaped;
+        } else {
+          os << c;
+        }
+    }
+  }
+  os << '"';
+}
+
+std::optional<string> ReadFirstLine(const string& path) {
+  std::ifstream file(path);
+  string line;
+  if (!std::getline(file, line)) {
+    return std::nullopt;
+  }
+  return line;
+}
+
+void ReportTestError(std::ostream& os,
+                     TestResults& results,
+                     const string& qualified_test_label,
+                     const string& message) {
+  results.Error(qualified_test_label + " " + message);
+  os << "    🔥ERROR: " << message << endl;
+}
+
+// Begin PipelineStage methods
+PipelineStage::PipelineStage() : is_busy_(false), is_stopping_(false), thread_(&PipelineStage::Run, this) {}
+
+PipelineStage::~PipelineStage() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.clear();
+    is_stopping_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+}
+
+void PipelineStage::Submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  changed_.notify_all();
+}
+
+void PipelineStage::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this]() { return jobs_.empty() && !is_busy_; });
+  if (error_ != nullptr) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void PipelineStage::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    changed_.wait(lock, [this]() { return is_stopping_ || !jobs_.empty(); });
+    if (is_stopping_) {
+      return;
+    }
+    std::function<void()> job = std::move(jobs_.front());
+    jobs_.pop_front();
+    is_busy_ = true;
+    lock.unlock();
+    try {
+      job();
+    } catch (...) {
+      lock.lock();
+      if (error_ == nullptr) {
+        error_ = std::current_exception();
+      }
+      lock.unlock();
+    }
+    lock.lock();
+    is_busy_ = false;
+    changed_.notify_all();
+  }
+}
+// End PipelineStage methods
+
 // TODO: Factor out the pretty printing into a separate module so it can be tested separately.
 // TODO: Consider making separate files for test suite, tests, test cases, and test results.
 // TODO: Come up with a way to autogenerat a main function that runs all tests in a *_test.cpp file.
@@ -8,19 +8,30 @@
  * Licensed under the MIT license see the LICENSE file for details.                    *
  ***************************************************************************************/
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <initializer_list>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <regex>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "compression.h"
 #include "pretty_print.h"
 
 namespace TinyTest {
@@ -31,6 +42,8 @@ namespace TinyTest {
 /// @defgroup test_execution Test Execution
 /// @defgroup configure_functions Configure Functions
 /// @defgroup compare_functions Compare Functions
+/// @defgroup test_events Test Events
+/// @defgroup startup_profile Startup Profile
 /// @defgroup helpers Helpers
 
 /// @addtogroup configure_functions
@@ -46,11 +59,55 @@ using MaybeTestConfigureFunction = std::optional<TestConfigureFunction>;
 /// @return The default configure function. This is currently std::nullopt.
 MaybeTestConfigureFunction DefaultTestConfigureFunction();
 
+/// @brief A list of test configure functions that are called in order as a single configure function.
+///
+/// The functions are stored in one flat list that is shared between copies and never modified, so a pipeline is cheap
+/// to copy and safe to call from several threads at once as long as the functions in it are.
+class TestConfigurePipeline {
+ public:
+  /// @brief Creates an empty pipeline. Calling it does nothing.
+  TestConfigurePipeline();
+
+  /// @brief Creates a pipeline from a list of configure functions.
+  ///
+  /// Functions that are nullopt are skipped. Functions that are themselves pipelines are flattened into this one.
+  /// @param functions The functions to call in the order they should be called.
+  TestConfigurePipeline(std::initializer_list<MaybeTestConfigureFunction> functions);
+
+  /// @brief Creates a pipeline from a list of configure functions.
+  ///
+  /// Functions that are nullopt are skipped. Functions that are themselves pipelines are flattened into this one.
+  /// @param functions The functions to call in the order they should be called.
+  explicit TestConfigurePipeline(const std::vector<MaybeTestConfigureFunction>& functions);
+
+  /// @brief Calls every function in the pipeline in order.
+  void operator()() const;
+
+  /// @brief Getter for the functions in this pipeline.
+  /// @return The functions in the order they are called.
+  const std::vector<TestConfigureFunction>& Functions() const;
+
+  /// @brief Getter for the number of functions in this pipeline.
+  /// @return The number of functions in this pipeline.
+  size_t Size() const;
+
+ private:
+  std::shared_ptr<const std::vector<TestConfigureFunction>> functions_;
+};
+
 /// @brief Combines multiple test configure functions into a single one.
 /// @param first The first setup function if this is nullopt it is ignored.
 /// @param second The second setup function if this is nullopt it is ignored.
 /// @return The resulting setup function or nullopt if both first and second are nullopt.
 MaybeTestConfigureFunction Coalesce(MaybeTestConfigureFunction first, MaybeTestConfigureFunction second);
+
+/// @brief Combines any number of test configure functions into a single one.
+///
+/// If more than one function is present the result is a single flat TestConfigurePipeline no matter how many times
+/// Coalesce has already been applied to the inputs.
+/// @param functions The functions to combine in the order they should be called. Any that are nullopt are ignored.
+/// @return The resulting configure function or nullopt if all of the functions are nullopt.
+MaybeTestConfigureFunction Coalesce(std::initializer_list<MaybeTestConfigureFunction> functions);
 /// @}
 
 /// @addtogroup compare_functions
@@ -134,6 +191,78 @@ TestTuple<TResult, TInputParams...> MakeTest(const std::string& test_name,
                                              MaybeTestConfigureFunction before_each = std::nullopt,
                                              MaybeTestConfigureFunction after_each = std::nullopt,
                                              bool is_enabled = true);
+
+/// @brief This is a type that represents an individual test whose values are all literals.
+///
+/// Unlike TestTuple this can be constexpr so a table of them is built at compile time, needs no work or allocation at
+/// startup, and is placed in read-only memory. It has no compare, before_each, or after_each functions. The suite's
+/// functions are used instead.
+/// @tparam TResult The return type of the test function. This must be a literal type.
+/// @tparam ...TInputParams The parameters to pass to the test function. These must be literal types.
+template <typename TResult, typename... TInputParams>
+using LiteralTestTuple = std::tuple<
+    /// test_name
+    std::string_view,
+    /// expected_output
+    TResult,
+    /// input_params
+    std::tuple<TInputParams...>,
+    /// is_enabled
+    bool>;
+
+/// @brief Makes a LiteralTestTuple. This can be used to initialize a constexpr table of tests.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param test_name The label for this test.
+/// @param expected The expected output of calling the test function with these input parameters.
+/// @param input_params The input parameters to use when calling the test function.
+/// @param is_enabled If false this test run is not executed and considered skipped for reporting purposes.
+/// @return A LiteralTestTuple suitable for use in a table passed to ExecuteSuite.
+template <typename TResult, typename... TInputParams>
+constexpr LiteralTestTuple<TResult, TInputParams...> MakeLiteralTest(std::string_view test_name,
+                                                                     TResult expected,
+                                                                     std::tuple<TInputParams...> input_params,
+                                                                     bool is_enabled = true);
+
+/// @brief This is a type that represents an individual test of a function that returns a range.
+///
+/// The range returned by the function is compared to expected one item at a time as both are iterated so neither is
+/// ever stored in full. Use this for functions that produce very long or lazily generated sequences.
+/// @tparam TExpectedRange The type of the expected range. This can be any type usable in a range-based for loop such
+/// as a container, IstreamRange, or GeneratorRange.
+/// @tparam ...TInputParams The parameters to pass to the test function.
+template <typename TExpectedRange, typename... TInputParams>
+using RangeTestTuple = std::tuple<
+    /// test_name
+    std::string,
+    /// expected_output - This is copied before each test run and iterated once.
+    TExpectedRange,
+    /// input_params
+    std::tuple<TInputParams...>,
+    /// test_setup_function
+    MaybeTestConfigureFunction,
+    /// test_teardown_function
+    MaybeTestConfigureFunction,
+    /// is_enabled
+    bool>;
+
+/// @brief Makes a RangeTestTuple.
+/// @tparam TExpectedRange The type of the expected range.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param test_name The label for this test.
+/// @param expected The range the test function's output is expected to match.
+/// @param input_params The input parameters to use when calling the test function.
+/// @param before_each This is called to setup the environment before running the test.
+/// @param after_each This is called after the test run to cleanup anything allocated in before_each.
+/// @param is_enabled If false this test run is not executed and considered skipped for reporting purposes.
+/// @return A RangeTestTuple suitable for use with ExecuteRangeSuite.
+template <typename TExpectedRange, typename... TInputParams>
+RangeTestTuple<TExpectedRange, TInputParams...> MakeRangeTest(const std::string& test_name,
+                                                              const TExpectedRange& expected,
+                                                              std::tuple<TInputParams...> input_params,
+                                                              MaybeTestConfigureFunction before_each = std::nullopt,
+                                                              MaybeTestConfigureFunction after_each = std::nullopt,
+                                                              bool is_enabled = true);
 /// @}
 
 /// @addtogroup test_suites
@@ -209,10 +338,178 @@ auto& Compare(std::basic_ostream<TChar, TTraits>& error_message,
               std::vector<TItem> expected,
               std::vector<TItem> actual);
 
+/// @brief This function compares two ranges one item at a time and stops at the first difference.
+///
+/// Only the current item of each range is held at a time so this works with ranges that are too large to store.
+/// @tparam TChar The character type of the stream to write to.
+/// @tparam TTraits The character_traits type of the stream to write to.
+/// @tparam TExpectedRange The type of the expected range.
+/// @tparam TActualRange The type of the actual range.
+/// @param error_message The stream to write the first difference to.
+/// @param expected The expected range. This is iterated once.
+/// @param actual The actual range. This is iterated once.
+/// @return True if the ranges have the same length and equal items and false otherwise.
+template <typename TChar, typename TTraits, typename TExpectedRange, typename TActualRange>
+bool CompareRanges(std::basic_ostream<TChar, TTraits>& error_message, TExpectedRange& expected, TActualRange& actual);
+
+/// @brief A single pass range of the items read from an input stream with operator>>.
+///
+/// Use this to compare a function's output against expected values stored in a file without loading the whole file.
+/// @tparam TItem The type of item to read.
+template <typename TItem>
+class IstreamRange {
+ public:
+  /// @brief Creates a range that reads from is. The stream must outlive the range.
+  /// @param is The stream to read items from.
+  explicit IstreamRange(std::istream& is) : is_(&is) {}
+
+  /// @brief Reads the first item.
+  /// @return An iterator to the first item.
+  std::istream_iterator<TItem> begin() const { return std::istream_iterator<TItem>(*is_); }
+
+  /// @brief Gets the iterator for the end of the stream.
+  /// @return The end iterator.
+  std::istream_iterator<TItem> end() const { return std::istream_iterator<TItem>(); }
+
+ private:
+  std::istream* is_;
+};
+
+/// @brief A single pass range of the items returned by a function until it returns nullopt.
+///
+/// Use this to return a lazily computed sequence from a function under test. Copies of the range copy the generator
+/// so a generator that keeps its state in captured values starts over in each copy.
+/// @tparam TItem The type of item produced.
+template <typename TItem>
+class GeneratorRange {
+ public:
+  /// @brief A function that returns the next item or nullopt when there are no more items.
+  using Generator = std::function<std::optional<TItem>()>;
+
+  /// @brief An input iterator over the items of a GeneratorRange.
+  class Iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = TItem;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const TItem*;
+    using reference = const TItem&;
+
+    /// @brief Creates an end iterator.
+    Iterator() : generator_(nullptr) {}
+
+    /// @brief Creates an iterator at the next item of generator.
+    /// @param generator The generator to pull items from.
+    explicit Iterator(Generator* generator) : generator_(generator), current_((*generator)()) {}
+
+    const TItem& operator*() const { return *current_; }
+
+    const TItem* operator->() const { return &*current_; }
+
+    Iterator& operator++() {
+      current_ = (*generator_)();
+      return *this;
+    }
+
+    /// @brief Two iterators are equal if both are at the end. Iterators that are not at the end are never equal.
+    bool operator==(const Iterator& other) const { return !current_.has_value() && !other.current_.has_value(); }
+
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    Generator* generator_;
+    std::optional<TItem> current_;
+  };
+
+  /// @brief Creates a range of the items returned by generator.
+  /// @param generator The function to pull items from.
+  explicit GeneratorRange(Generator generator) : generator_(std::move(generator)) {}
+
+  /// @brief Pulls the first item.
+  /// @return An iterator to the first item.
+  Iterator begin() { return Iterator(&generator_); }
+
+  /// @brief Gets the end iterator.
+  /// @return The end iterator.
+  Iterator end() { return Iterator(); }
+
+ private:
+  Generator generator_;
+};
+
 /// @}
 
 /// @addtogroup test_results
 
+/// @brief The kinds of errors recorded in TestResults.
+enum class TestErrorKind {
+  /// @brief function_to_test threw something or the test could not be run. This is the kind used by Error().
+  kException,
+  /// @brief An isolated test ran out of address space.
+  kMemoryLimit,
+  /// @brief An isolated test used more CPU time than it was allowed.
+  kCpuTimeLimit,
+  /// @brief An isolated test used every file descriptor it was allowed.
+  kOpenFileLimit,
+  /// @brief An isolated test crashed or exited without reporting results.
+  kCrashed,
+};
+
+/// @brief Gets a short human readable name for kind.
+/// @param kind The kind of error.
+/// @return The name of kind.
+std::string TestErrorKindName(TestErrorKind kind);
+
+/// @brief A message stored in TestResults whose text may be formatted only when it is needed.
+///
+/// A message is made of a fixed prefix and an optional formatter that writes the rest of the text. ExecuteSuite uses
+/// the formatter to defer pretty printing the expected and actual values of failures past MaxPrintedFailureDetails
+/// until the message is printed, which is never for most failures in a large run. Fixed text of at least
+/// kCompressionThreshold bytes, such as captured output or the values of a failure that were written to the console, is
+/// stored compressed and only decompressed when it is printed. Copies share the same storage.
+class TestMessage {
+ public:
+  /// @brief A function that writes the deferred part of a message to a stream.
+  using Formatter = std::function<void(std::ostream& os)>;
+
+  /// @brief Fixed text at least this long is stored compressed.
+  static constexpr size_t kCompressionThreshold = 4096;
+
+  /// @brief Creates an empty message.
+  TestMessage();
+
+  /// @brief Creates a message with fixed text.
+  /// @param text The text of the message. If it is at least kCompressionThreshold bytes long it is compressed.
+  TestMessage(std::string text);
+
+  /// @brief Creates a message whose text is formatted when it is needed.
+  /// @param prefix The text at the start of the message.
+  /// @param formatter The function that writes the rest of the message after prefix.
+  TestMessage(std::string prefix, Formatter formatter);
+
+  /// @brief Checks if some of this message still has to be formatted.
+  /// @return True if this message has a formatter and false if it is fixed text.
+  bool IsDeferred() const;
+
+  /// @brief Checks if the fixed text of this message is stored compressed.
+  /// @return True if the fixed text is compressed.
+  bool IsCompressed() const;
+
+  /// @brief Writes this message to a stream, formatting any deferred part directly into it.
+  /// @param os The stream to write to.
+  /// @return The stream.
+  std::ostream& Print(std::ostream& os) const;
+
+  /// @brief Formats this message.
+  /// @return The full text of this message.
+  std::string Text() const;
+
+ private:
+  std::shared_ptr<const CompressedString> compressed_prefix_;
+  std::shared_ptr<const Formatter> formatter_;
+  std::string prefix_;
+};
+
 /// @brief Represents the results of running some number of tests.
 ///
 /// This type may evolve over time, but currently it tracks:
@@ -232,6 +529,11 @@ class TestResults {
   /// @param other
   TestResults(const TestResults& other);
 
+  /// @brief Replaces the counts and messages of this instance with those of other.
+  /// @param other The TestResults to copy.
+  /// @return A reference to this instance.
+  TestResults& operator=(const TestResults& other) = default;
+
   /// @brief Creates a new TestResults instance with specific counts.
   /// @param errors The number of errors while running the tests.
   /// @param failed The number of failed tests.
@@ -241,6 +543,7 @@ class TestResults {
   /// @param error_messages The list of error messages.
   /// @param failure_messages The list of failure messages.
   /// @param skip_messages The list of skip messages.
+  /// @param errors_by_kind The number of errors of each kind. If this is empty every error is a kException.
   TestResults(uint32_t errors,
               uint32_t failed,
               uint32_t passed,
@@ -248,7 +551,8 @@ class TestResults {
               uint32_t total,
               std::vector<std::string> error_messages,
               std::vector<std::string> failure_messages,
-              std::vector<std::string> skip_messages);
+              std::vector<std::string> skip_messages,
+              std::map<TestErrorKind, uint32_t> errors_by_kind = {});
 
   /// @brief Adds an error. This increments errors.
   /// @return A reference to this instance. Used for chaining.
@@ -260,6 +564,13 @@ class TestResults {
   /// @return A reference to this instance. Used for chaining.
   TestResults& Error(std::string message);
 
+  /// @brief Adds an error of a specific kind with a message. This increments errors and the count for kind as well as
+  /// saving the error message.
+  /// @param kind The kind of error.
+  /// @param message The error message.
+  /// @return A reference to this instance. Used for chaining.
+  TestResults& Error(TestErrorKind kind, std::string message);
+
   /// @brief Adds a failed test. This increments total and failed.
   /// @return A reference to this instance. Used for chaining.
   TestResults& Fail();
@@ -270,6 +581,12 @@ class TestResults {
   /// @return A reference to this instance. Used for chaining.
   TestResults& Fail(const std::string& message);
 
+  /// @brief Adds a failed test with a message that may be formatted later. This increments total and failed as well
+  /// as saving the failure message.
+  /// @param message The reason the test failed.
+  /// @return A reference to this instance. Used for chaining.
+  TestResults& Fail(TestMessage message);
+
   /// @brief Adds a passed test. This increments total and passed.
   /// @return A reference to this instance. Used for chaining.
   TestResults& Pass();
@@ -288,18 +605,37 @@ class TestResults {
   /// @return
   std::vector<std::string> ErrorMessages() const;
 
+  /// @brief Getter for the list of error messages without formatting or decompressing them.
+  /// @return The list of error messages.
+  const std::vector<TestMessage>& LazyErrorMessages() const;
+
   /// @brief Getter for the count of errors.
   /// @return
   uint32_t Errors() const;
 
+  /// @brief Getter for the number of errors of one kind.
+  /// @param kind The kind of error to count.
+  /// @return The number of errors of that kind.
+  uint32_t Errors(TestErrorKind kind) const;
+
+  /// @brief Getter for the number of errors of each kind. Kinds with no errors are left out.
+  /// @return The number of errors of each kind.
+  const std::map<TestErrorKind, uint32_t>& ErrorsByKind() const;
+
   /// @brief Getter for the count of failed tests.
   /// @return The count of failed tests.
   uint32_t Failed() const;
 
   /// @brief Getter for the list of failure messages.
+  ///
+  /// This formats every deferred failure message. Use LazyFailureMessages to format only some of them.
   /// @return The list of failure messages.
   std::vector<std::string> FailureMessages() const;
 
+  /// @brief Getter for the list of failure messages without formatting or decompressing them.
+  /// @return The list of failure messages.
+  const std::vector<TestMessage>& LazyFailureMessages() const;
+
   /// @brief Getter for the count of passed tests.
   /// @return The count of passed tests.
   uint32_t Passed() const;
@@ -312,6 +648,10 @@ class TestResults {
   /// @return The list of skip messages.
   std::vector<std::string> SkipMessages() const;
 
+  /// @brief Getter for the list of skip messages without formatting or decompressing them.
+  /// @return The list of skip messages.
+  const std::vector<TestMessage>& LazySkipMessages() const;
+
   /// @brief Getter for the count of total tests.
   /// @return The count of total tests run.
   uint32_t Total() const;
@@ -328,12 +668,13 @@ class TestResults {
   TestResults& operator+=(const TestResults& other);
 
  private:
-  std::vector<std::string> error_messages_;
+  std::vector<TestMessage> error_messages_;
   uint32_t errors_;
+  std::map<TestErrorKind, uint32_t> errors_by_kind_;
   uint32_t failed_;
-  std::vector<std::string> failure_messages_;
+  std::vector<TestMessage> failure_messages_;
   uint32_t passed_;
-  std::vector<std::string> skip_messages_;
+  std::vector<TestMessage> skip_messages_;
   uint32_t skipped_;
   uint32_t total_;
 };
@@ -341,7 +682,231 @@ class TestResults {
 /// @brief Writes a friendly version of results to the provided stream.
 /// @param os The stream to write to.
 /// @param results The TestResults to write.
-void PrintResults(std::ostream& os, TestResults results);
+/// @param max_failure_messages The most failure messages to format and write. The number of failure messages left out
+/// is written instead of the rest.
+void PrintResults(std::ostream& os, TestResults results, uint32_t max_failure_messages = UINT32_MAX);
+
+/// @brief Gets the most failures in each suite whose expected and actual values are written to the console.
+///
+/// Later failures in the suite are written as just "❌FAILED" and their values are only formatted if the results are
+/// printed. The default is 20.
+/// @return The most failures per suite written with their values.
+uint32_t MaxPrintedFailureDetails();
+
+/// @brief Sets the most failures in each suite whose expected and actual values are written to the console.
+/// @param max_failure_details The most failures per suite to write with their values. UINT32_MAX writes every one.
+void SetMaxPrintedFailureDetails(uint32_t max_failure_details);
+
+/// @brief Writes results to os in a compact text form that ReadTestResults can read back.
+///
+/// Use this to send results between processes. Deferred messages are formatted before they are written.
+/// @param os The stream to write to.
+/// @param results The TestResults to write.
+void WriteTestResults(std::ostream& os, const TestResults& results);
+
+/// @brief Reads results written by WriteTestResults.
+/// @param is The stream to read from.
+/// @return The TestResults that were written.
+/// @throws std::runtime_error if is does not contain results written by WriteTestResults.
+TestResults ReadTestResults(std::istream& is);
+
+/// @addtogroup test_events
+/// @{
+
+/// @brief The kinds of events published while executing suites.
+enum class TestEventType {
+  /// @brief A suite is starting. This is published before before_all is called.
+  kSuiteBegin,
+  /// @brief A suite has finished. This is published after after_all is called.
+  kSuiteEnd,
+  /// @brief A test is starting. This is published before before_each is called.
+  kTestBegin,
+  /// @brief A test has finished or was skipped. This is published after after_each is called.
+  kTestEnd,
+  /// @brief A thread is starting to run before_each, function_to_test, or after_each for a test. This is published on
+  /// that thread. ExecuteSuitePipelined runs them on different threads, so it is not always the thread that published
+  /// kTestBegin.
+  kTestThreadBegin,
+  /// @brief A thread has finished running code for a test. This is published on the thread that published the matching
+  /// kTestThreadBegin.
+  kTestThreadEnd,
+};
+
+/// @brief How a test ended.
+enum class TestOutcome {
+  kPassed,
+  kFailed,
+  kSkipped,
+};
+
+/// @brief An event published while executing suites.
+///
+/// The labels are only valid while the event is being published. Copy them if you need to keep them.
+struct TestEvent {
+  /// @brief What happened.
+  TestEventType type;
+  /// @brief The label of the suite.
+  std::string_view suite_label;
+  /// @brief The label of the test. This is empty for suite events.
+  std::string_view test_label;
+  /// @brief How the test ended. This is only set for kTestEnd events.
+  TestOutcome outcome;
+  /// @brief True if function_to_test threw something. This is only set for kTestEnd events.
+  bool has_error;
+  /// @brief How long the test or suite took. This is only set for kTestEnd and kSuiteEnd events.
+  std::chrono::nanoseconds duration;
+};
+
+/// @brief This is a type that represents a function that is called for every published TestEvent.
+///
+/// Listeners may be called from more than one thread at a time, for example by ExecuteSuitePipelined, and are called
+/// on the thread running the tests so they should return quickly.
+using TestEventListener = std::function<void(const TestEvent& event)>;
+
+/// @brief Registers a listener that is called for every TestEvent published by this process.
+/// @param listener The listener to call.
+/// @return An id that can be passed to RemoveTestEventListener.
+uint64_t AddTestEventListener(TestEventListener listener);
+
+/// @brief Unregisters a listener added by AddTestEventListener.
+///
+/// This waits for calls to the listener already in progress on other threads to return, so once it returns the
+/// listener is never called again and whatever it captured may be destroyed. It must not be called from inside the
+/// listener being removed.
+/// @param listener_id The id returned by AddTestEventListener.
+void RemoveTestEventListener(uint64_t listener_id);
+
+/// @brief Checks if any listeners are registered. Publishing with no listeners does nothing.
+/// @return True if at least one listener is registered.
+bool HasTestEventListeners();
+
+/// @brief Calls every registered listener with event.
+/// @param event The event to publish.
+void PublishTestEvent(const TestEvent& event);
+
+/// @brief Publishes a kSuiteBegin event.
+/// @param suite_label The label of the suite.
+void PublishSuiteBegin(const std::string& suite_label);
+
+/// @brief Publishes a kSuiteEnd event.
+/// @param suite_label The label of the suite.
+/// @param duration How long the suite took.
+void PublishSuiteEnd(const std::string& suite_label, std::chrono::nanoseconds duration);
+
+/// @brief Publishes a kTestBegin event.
+/// @param suite_label The label of the suite.
+/// @param test_label The label of the test.
+void PublishTestBegin(const std::string& suite_label, const std::string& test_label);
+
+/// @brief Publishes a kTestEnd event.
+/// @param suite_label The label of the suite.
+/// @param test_label The label of the test.
+/// @param outcome How the test ended.
+/// @param has_error True if function_to_test threw something.
+/// @param duration How long the test took.
+void PublishTestEnd(const std::string& suite_label,
+                    const std::string& test_label,
+                    TestOutcome outcome,
+                    bool has_error,
+                    std::chrono::nanoseconds duration);
+
+/// @brief Publishes kTestThreadBegin when it is created and kTestThreadEnd when it is destroyed on the calling thread.
+///
+/// Listeners that keep per-thread state, like which test a crash happened in, use these to know which thread runs a
+/// test's code.
+class TestThreadScope {
+ public:
+  /// @brief Publishes a kTestThreadBegin event.
+  /// @param suite_label The label of the suite. This must outlive the scope.
+  /// @param test_label The label of the test. This must outlive the scope.
+  TestThreadScope(const std::string& suite_label, const std::string& test_label);
+
+  TestThreadScope(const TestThreadScope& other) = delete;
+  TestThreadScope& operator=(const TestThreadScope& other) = delete;
+
+  /// @brief Publishes a kTestThreadEnd event.
+  ~TestThreadScope();
+
+ private:
+  const std::string& suite_label_;
+  const std::string& test_label_;
+};
+/// @}
+
+/// @addtogroup startup_profile
+/// @{
+
+/// @brief How long one suite's test table took to build and how much memory it uses.
+struct SuiteStartupProfile {
+  /// @brief The label of the suite.
+  std::string suite_label;
+  /// @brief The number of tests in the table.
+  size_t test_count;
+  /// @brief The approximate size of the table in bytes. This counts the test tuples and their labels but not heap
+  /// memory owned by expected values or inputs.
+  size_t table_bytes;
+  /// @brief The time from the first MakeTest call for this table until the table was finished by MakeTestSuite or
+  /// handed to ExecuteSuite.
+  std::chrono::nanoseconds construction_time;
+};
+
+/// @brief Where a test binary spent its time before running tests.
+struct StartupProfile {
+  /// @brief The time from process start until the first suite began executing. This is empty if no suite has run yet
+  /// or the process start time is not available.
+  std::optional<std::chrono::nanoseconds> time_to_first_suite;
+  /// @brief One entry per test table in the order the tables were built.
+  std::vector<SuiteStartupProfile> suites;
+};
+
+/// @brief Checks if startup profiling is enabled.
+///
+/// Profiling is enabled at startup if the environment variable TINYTEST_PROFILE_STARTUP is set to anything other than
+/// "" or "0". When it is enabled that way the profile is printed to std::cerr when the process exits.
+/// @return True if MakeTest, MakeTestSuite, and ExecuteSuite are recording a StartupProfile.
+bool IsStartupProfilingEnabled();
+
+/// @brief Turns startup profiling on or off.
+/// @param is_enabled True to record a StartupProfile.
+void EnableStartupProfiling(bool is_enabled);
+
+/// @brief Gets a copy of the profile recorded so far.
+/// @return The StartupProfile.
+StartupProfile GetStartupProfile();
+
+/// @brief Forgets everything recorded so far.
+void ResetStartupProfile();
+
+/// @brief Records that a test tuple was made. MakeTest calls this when profiling is enabled.
+/// @param start The time MakeTest was called.
+/// @param table_bytes The approximate size of the test tuple in bytes.
+void RecordTestConstructed(std::chrono::steady_clock::time_point start, size_t table_bytes);
+
+/// @brief Records that the tests made since the last suite form a table for suite_label.
+///
+/// MakeTestSuite, ExecuteSuite, and ExecuteSuitePipelined call this when profiling is enabled. Only the first call for
+/// a table counts so a suite made by MakeTestSuite and then executed is recorded once.
+/// @param suite_label The label of the suite.
+/// @param test_count The number of tests in the suite.
+/// @param table_bytes The approximate size in bytes of the suite not counting its tests.
+void RecordSuiteConstructed(const std::string& suite_label, size_t test_count, size_t table_bytes);
+
+/// @brief Records that a suite is about to execute. The first call sets time_to_first_suite.
+/// @param suite_label The label of the suite.
+/// @param test_count The number of tests in the suite.
+void RecordSuiteStarted(const std::string& suite_label, size_t test_count);
+
+/// @brief Gets how long this process has been running according to the kernel.
+///
+/// This only works on Linux and only has the resolution of the kernel's clock ticks, usually 10ms.
+/// @return The time since the process started or an empty optional if it is not available.
+std::optional<std::chrono::nanoseconds> TimeSinceProcessStart();
+
+/// @brief Writes a startup profile to os with the slowest tables first.
+/// @param os The ostream to write to.
+/// @param profile The profile to write.
+void PrintStartupProfile(std::ostream& os, const StartupProfile& profile);
+/// @}
 
 /// @addtogroup test_execution
 /// @{
@@ -357,6 +922,229 @@ TestResults& SkipTest(TestResults& results,
                       const std::string& test_label,
                       std::optional<const std::string> reason = std::nullopt);
 
+/// @brief This function marks a test as skipped with an optional reason and writes the skip message to os.
+/// @param os The stream to write the skip message to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param test_label The label for the test.
+/// @param reason The optional reason the test is being skipped.
+/// @return The TestResults for chaining.
+TestResults& SkipTest(std::ostream& os,
+                      TestResults& results,
+                      const std::string& suite_label,
+                      const std::string& test_label,
+                      std::optional<const std::string> reason = std::nullopt);
+
+/// @brief Builds the error message for an exception caught while running a test.
+/// @param error The caught exception.
+/// @return A message describing what was caught.
+std::string DescribeCaughtException(std::exception_ptr error);
+
+/// @brief Formats a duration in ns, us, ms, or s with one decimal place, like "12.3 ms".
+/// @param duration The duration. Fractions of a nanosecond are kept so it can be a time per iteration.
+/// @return The formatted duration.
+std::string FormatDuration(std::chrono::duration<double, std::nano> duration);
+
+/// @brief Writes text as a quoted JSON string, escaping quotes, backslashes, and control characters.
+/// @param os The stream to write to.
+/// @param text The text to write.
+void WriteJsonString(std::ostream& os, std::string_view text);
+
+/// @brief Reads the first line of a file, like the value of a sysfs attribute.
+/// @param path The path of the file.
+/// @return The first line without its newline or nullopt if the file can not be read or is empty.
+std::optional<std::string> ReadFirstLine(const std::string& path);
+
+/// @brief Records an error for a test in results and writes it to os.
+/// @param os The stream to write the error to.
+/// @param results The TestResults to update.
+/// @param qualified_test_label The label of the test including the suite label.
+/// @param message The error message.
+void ReportTestError(std::ostream& os,
+                     TestResults& results,
+                     const std::string& qualified_test_label,
+                     const std::string& message);
+
+/// @brief Picks the compare function for a test.
+/// @tparam TResult The result type of the test.
+/// @param test_Compare The compare function for the test. This has the highest priority.
+/// @param suite_Compare The compare function for the suite. This is used if test_Compare is nullopt.
+/// @return The compare function to use. If both test_Compare and suite_Compare are nullopt this uses operator==.
+template <typename TResult>
+TestCompareFunction<TResult> ChooseCompareFunction(const MaybeTestCompareFunction<TResult>& test_Compare,
+                                                   const MaybeTestCompareFunction<TResult>& suite_Compare);
+
+/// @brief Calls function_to_test with input_params and stores the return value in actual.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param function_to_test The function to call.
+/// @param input_params The parameters to call function_to_test with.
+/// @param actual Where to store the return value of function_to_test.
+/// @return nullopt if function_to_test returned normally or a message describing what it threw.
+template <typename TResult, typename... TInputParams>
+std::optional<std::string> InvokeTestFunction(const std::function<TResult(TInputParams...)>& function_to_test,
+                                              const std::tuple<TInputParams...>& input_params,
+                                              TResult& actual);
+
+/// @brief Compares the expected and actual results of a test, records a pass or failure, and writes it to os.
+///
+/// Once results has MaxPrintedFailureDetails failures the values of later failures are not written to os.
+/// @tparam TResult The result type of the test.
+/// @param os The stream to write the outcome to.
+/// @param results The TestResults to update.
+/// @param qualified_test_label The label of the test including the suite label.
+/// @param compare The compare function to use.
+/// @param expected The expected output of the test.
+/// @param actual The actual output of the test.
+/// @return The outcome of the test.
+template <typename TResult>
+TestOutcome ReportTestOutcome(std::ostream& os,
+                              TestResults& results,
+                              const std::string& qualified_test_label,
+                              const TestCompareFunction<TResult>& compare,
+                              const TResult& expected,
+                              const TResult& actual);
+
+/// @brief How the body of a test run by ExecuteTestLifecycle ended.
+struct TestBodyResult {
+  /// @brief Whether the test passed or failed.
+  TestOutcome outcome;
+  /// @brief True if function_to_test threw something.
+  bool has_error;
+};
+
+/// @brief Runs the body of a test between the setup and teardown every ExecuteTest shares.
+///
+/// Setup publishes kTestBegin, scopes the test to this thread, writes "Beginning Test", and calls before_each. Teardown
+/// calls after_each, writes "Ending Test", ends the thread scope, and publishes kTestEnd with the test's duration.
+/// Overloads of ExecuteTest for other kinds of test tuple use this so they only supply how their test is run and
+/// judged.
+/// @tparam TBody The type of body.
+/// @param os The stream to write progress to.
+/// @param suite_label The label for the test suite.
+/// @param test_label The label for the test.
+/// @param before_each This is called before body.
+/// @param after_each This is called after body.
+/// @param body Runs the test method, records whether it passed in the suite's TestResults, and returns a
+/// TestBodyResult.
+template <typename TBody>
+void ExecuteTestLifecycle(std::ostream& os,
+                          const std::string& suite_label,
+                          const std::string& test_label,
+                          const MaybeTestConfigureFunction& before_each,
+                          const MaybeTestConfigureFunction& after_each,
+                          TBody body);
+
+/// @brief Executes a single test from a suite and writes its progress to os.
+///
+/// This runs before_each, function_to_test, the compare function, and after_each for the test in that order.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite.
+/// @param test_data The test to execute.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const TestTuple<TResult, TInputParams...>& test_data);
+
+/// @brief Executes a single test from a table of LiteralTestTuples by converting it to a TestTuple.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite.
+/// @param test_data The test to execute.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const LiteralTestTuple<TResult, TInputParams...>& test_data);
+
+/// @brief Executes a single test of a function that returns a range.
+/// @tparam TActualRange The type of range returned by function_to_test.
+/// @tparam TExpectedRange The type of the expected range.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare This is ignored. Range tests are always compared with CompareRanges.
+/// @param test_data The test to execute.
+template <typename TActualRange, typename TExpectedRange, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TActualRange(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TActualRange>& suite_Compare,
+                 const RangeTestTuple<TExpectedRange, TInputParams...>& test_data);
+
+/// @brief Executes every test in tests as one suite. This is shared by the ExecuteSuite overloads.
+/// @tparam TTests The type of the collection of tests. Its items must be TestTuples or LiteralTestTuples.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param tests The test runs.
+/// @param suite_Compare A function used to Compare the expected and actual test results.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @return The results of the suite.
+template <typename TTests, typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteTests(const std::string& suite_label,
+                              const std::function<TResult(TInputParams...)>& function_to_test,
+                              const TTests& tests,
+                              const MaybeTestCompareFunction<TResult>& suite_Compare,
+                              const MaybeTestConfigureFunction& before_all,
+                              const MaybeTestConfigureFunction& after_all,
+                              bool is_enabled);
+
+/// @brief Runs jobs one at a time on a dedicated thread in the order they were submitted.
+///
+/// This is used to run one stage of a pipelined suite alongside the other stages.
+class PipelineStage {
+ public:
+  /// @brief Starts the thread for this stage.
+  PipelineStage();
+
+  PipelineStage(const PipelineStage& other) = delete;
+  PipelineStage& operator=(const PipelineStage& other) = delete;
+
+  /// @brief Discards any jobs that have not started, waits for the current job, and stops the thread.
+  ~PipelineStage();
+
+  /// @brief Queues a job to run after all previously submitted jobs.
+  /// @param job The job to run.
+  void Submit(std::function<void()> job);
+
+  /// @brief Blocks until every submitted job has finished.
+  ///
+  /// If a job threw an exception the first one thrown is rethrown here.
+  void Wait();
+
+ private:
+  void Run();
+
+  std::condition_variable changed_;
+  std::exception_ptr error_;
+  bool is_busy_;
+  bool is_stopping_;
+  std::deque<std::function<void()>> jobs_;
+  std::mutex mutex_;
+  std::thread thread_;
+};
+
 /// @brief Executes a TestSuite.
 /// @tparam TResult The result type of the test.
 /// @tparam TInputParams... The types of parameters sent to the test function.
@@ -390,6 +1178,87 @@ TestResults ExecuteSuite(std::string suite_label,
 template <typename TResult, typename... TInputParams>
 TestResults ExecuteSuite(const TestSuite<TResult, TInputParams...>& test_suite);
 
+/// @brief Executes a suite from a table of LiteralTestTuples.
+///
+/// Each row is converted to a TestTuple just before it runs so the table itself can stay constexpr.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @tparam kTestCount The number of tests in the table.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param tests A table of test runs. This is usually a constexpr array of LiteralTestTuples.
+/// @param suite_Compare A function used to Compare the expected and actual test results.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+template <typename TResult, typename... TInputParams, size_t kTestCount>
+TestResults ExecuteSuite(std::string suite_label,
+                         std::function<TResult(TInputParams...)> function_to_test,
+                         const LiteralTestTuple<TResult, TInputParams...> (&tests)[kTestCount],
+                         MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt,
+                         MaybeTestConfigureFunction before_all = std::nullopt,
+                         MaybeTestConfigureFunction after_all = std::nullopt,
+                         bool is_enabled = true);
+
+/// @brief Executes a suite for a function that returns a range.
+///
+/// For each test the returned range and the expected range are iterated together and compared with CompareRanges.
+/// The test fails at the first item that differs and neither range is stored, so memory use does not depend on the
+/// length of the ranges.
+/// @tparam TActualRange The type of range returned by function_to_test.
+/// @tparam TExpectedRange The type of the expected ranges.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param tests An std::initializer_list of test runs.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @return The results of the suite.
+template <typename TActualRange, typename TExpectedRange, typename... TInputParams>
+TestResults ExecuteRangeSuite(std::string suite_label,
+                              std::function<TActualRange(TInputParams...)> function_to_test,
+                              std::initializer_list<RangeTestTuple<TExpectedRange, TInputParams...>> tests,
+                              MaybeTestConfigureFunction before_all = std::nullopt,
+                              MaybeTestConfigureFunction after_all = std::nullopt,
+                              bool is_enabled = true);
+
+/// @brief Executes a TestSuite with the stages of consecutive tests overlapped.
+///
+/// While function_to_test runs for one test, before_each for the next test runs on a setup thread, and the compare
+/// function, reporting, and after_each for the previous test run on a report thread. The stages of each test still run
+/// in order and results and output are reported in the same order as ExecuteSuite. Use this when before_each and
+/// after_each are slow, for example when they do I/O.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested. This is always called on the calling thread.
+/// @param tests An std::initializer_list of test runs.
+/// @param suite_Compare A function used to Compare the expected and actual test results.
+/// @param before_all This is called before any test in the suite is started.
+/// @param after_all This is called after every test in the suite has finished.
+/// @param is_enabled If false the test is reported as skipped. If true the test is run as normal.
+/// @param ordered_tests The labels of tests that must not overlap with any other test. All stages of the previous
+/// test finish before these start and all of their stages finish before the next test starts.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuitePipelined(std::string suite_label,
+                                  std::function<TResult(TInputParams...)> function_to_test,
+                                  std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                  MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt,
+                                  MaybeTestConfigureFunction before_all = std::nullopt,
+                                  MaybeTestConfigureFunction after_all = std::nullopt,
+                                  bool is_enabled = true,
+                                  std::vector<std::string> ordered_tests = {});
+
+/// @brief Executes a TestSuite with the stages of consecutive tests overlapped.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param test_suite A tuple representing the test suite configuration.
+/// @param ordered_tests The labels of tests that must not overlap with any other test.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuitePipelined(const TestSuite<TResult, TInputParams...>& test_suite,
+                                  std::vector<std::string> ordered_tests = {});
+
 /// @}
 
 template <typename TResult>
@@ -405,9 +1274,31 @@ TestTuple<TResult, TInputParams...> MakeTest(const std::string& test_name,
                                              MaybeTestConfigureFunction before_each,
                                              MaybeTestConfigureFunction after_each,
                                              bool is_enabled) {
+  if (IsStartupProfilingEnabled()) {
+    RecordTestConstructed(std::chrono::steady_clock::now(),
+                          sizeof(TestTuple<TResult, TInputParams...>) + test_name.size());
+  }
   return make_tuple(test_name, expected, input_params, test_compare_function, before_each, after_each, is_enabled);
 }
 
+template <typename TResult, typename... TInputParams>
+constexpr LiteralTestTuple<TResult, TInputParams...> MakeLiteralTest(std::string_view test_name,
+                                                                     TResult expected,
+                                                                     std::tuple<TInputParams...> input_params,
+                                                                     bool is_enabled) {
+  return LiteralTestTuple<TResult, TInputParams...>(test_name, expected, input_params, is_enabled);
+}
+
+template <typename TExpectedRange, typename... TInputParams>
+RangeTestTuple<TExpectedRange, TInputParams...> MakeRangeTest(const std::string& test_name,
+                                                              const TExpectedRange& expected,
+                                                              std::tuple<TInputParams...> input_params,
+                                                              MaybeTestConfigureFunction before_each,
+                                                              MaybeTestConfigureFunction after_each,
+                                                              bool is_enabled) {
+  return make_tuple(test_name, expected, input_params, before_each, after_each, is_enabled);
+}
+
 template <typename TResult, typename TFunctionToTest, typename... TInputParams>
 TestSuite<TResult, TInputParams...> MakeTestSuite(const std::string& suite_name,
                                                   TFunctionToTest function_to_test,
@@ -416,6 +1307,10 @@ TestSuite<TResult, TInputParams...> MakeTestSuite(const std::string& suite_name,
                                                   MaybeTestConfigureFunction before_each,
                                                   MaybeTestConfigureFunction after_each,
                                                   bool is_enabled) {
+  if (IsStartupProfilingEnabled()) {
+    RecordSuiteConstructed(
+        suite_name, test_data.size(), sizeof(TestSuite<TResult, TInputParams...>) + suite_name.size());
+  }
   return make_tuple(suite_name, function_to_test, test_data, compare, before_each, after_each, is_enabled);
 }
 
@@ -457,25 +1352,241 @@ auto& Compare(std::basic_ostream<TChar, TTraits>& error_message,
   return error_message;
 }
 
+template <typename TChar, typename TTraits, typename TExpectedRange, typename TActualRange>
+bool CompareRanges(std::basic_ostream<TChar, TTraits>& error_message, TExpectedRange& expected, TActualRange& actual) {
+  auto expected_it = expected.begin();
+  auto expected_end = expected.end();
+  auto actual_it = actual.begin();
+  auto actual_end = actual.end();
+  size_t index = 0;
+  for (; expected_it != expected_end && actual_it != actual_end; ++expected_it, ++actual_it, ++index) {
+    if (!(*expected_it == *actual_it)) {
+      error_message << "ranges differ at index " << index << ", ";
+      CPPUtils::PrettyPrint(error_message, *expected_it) << " != ";
+      CPPUtils::PrettyPrint(error_message, *actual_it);
+      return false;
+    }
+  }
+  if (expected_it != expected_end) {
+    error_message << "actual range ended early at index " << index << ", expected: ";
+    CPPUtils::PrettyPrint(error_message, *expected_it);
+    return false;
+  }
+  if (actual_it != actual_end) {
+    error_message << "actual range is longer than expected at index " << index << ", actual: ";
+    CPPUtils::PrettyPrint(error_message, *actual_it);
+    return false;
+  }
+  return true;
+}
+
+template <typename TResult>
+TestCompareFunction<TResult> ChooseCompareFunction(const MaybeTestCompareFunction<TResult>& test_Compare,
+                                                   const MaybeTestCompareFunction<TResult>& suite_Compare) {
+  return test_Compare.has_value()    ? *test_Compare
+         : suite_Compare.has_value() ? *suite_Compare
+                                     : [](const TResult& l, const TResult& r) { return l == r; };
+}
+
 template <typename TResult, typename... TInputParams>
-TestResults ExecuteSuite(std::string suite_label,
-                         std::function<TResult(TInputParams...)> function_to_test,
-                         std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
-                         MaybeTestCompareFunction<TResult> suite_Compare,
-                         MaybeTestConfigureFunction before_all,
-                         MaybeTestConfigureFunction after_all,
-                         bool is_enabled) {
+std::optional<std::string> InvokeTestFunction(const std::function<TResult(TInputParams...)>& function_to_test,
+                                              const std::tuple<TInputParams...>& input_params,
+                                              TResult& actual) {
+  try {
+    actual = std::apply(function_to_test, input_params);
+  } catch (...) {
+    return DescribeCaughtException(std::current_exception());
+  }
+  return std::nullopt;
+}
+
+template <typename TResult>
+TestOutcome ReportTestOutcome(std::ostream& os,
+                              TestResults& results,
+                              const std::string& qualified_test_label,
+                              const TestCompareFunction<TResult>& compare,
+                              const TResult& expected,
+                              const TResult& actual) {
+  if (compare(expected, actual)) {
+    results.Pass();
+    os << "    ✅PASSED" << std::endl;
+    return TestOutcome::kPassed;
+  }
+  // Keep copies of the values and only pretty print them for the results when they are actually printed.
+  TestMessage::Formatter format = [expected, actual](std::ostream& message) {
+    message << "expected: ";
+    CPPUtils::PrettyPrint(message, expected) << ", actual: ";
+    CPPUtils::PrettyPrint(message, actual);
+  };
+  if (results.Failed() >= MaxPrintedFailureDetails()) {
+    os << "    ❌FAILED" << std::endl;
+    results.Fail(TestMessage(qualified_test_label + " ", format));
+    return TestOutcome::kFailed;
+  }
+  // The values are formatted for os anyway, so keep that text instead of the copies. Large text is stored compressed.
+  std::ostringstream details;
+  format(details);
+  os << "    ❌FAILED: " << details.str() << std::endl;
+  results.Fail(TestMessage(qualified_test_label + " " + details.str()));
+  return TestOutcome::kFailed;
+}
+
+template <typename TBody>
+void ExecuteTestLifecycle(std::ostream& os,
+                          const std::string& suite_label,
+                          const std::string& test_label,
+                          const MaybeTestConfigureFunction& before_each,
+                          const MaybeTestConfigureFunction& after_each,
+                          TBody body) {
+  // Step 2: Test Setup
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PublishTestBegin(suite_label, test_label);
+  std::optional<TestThreadScope> thread_scope(std::in_place, suite_label, test_label);
+  os << "  Beginning Test: " << test_label << std::endl;
+  if (before_each.has_value()) {
+    (*before_each)();
+  }
+
+  // Steps 3 and 4: Execute the test method and pass or fail.
+  TestBodyResult result = body();
+
+  // Step 5: Test Teardown
+  if (after_each.has_value()) {
+    (*after_each)();
+  }
+  os << "  Ending Test: " << test_label << std::endl;
+  thread_scope.reset();
+  PublishTestEnd(suite_label, test_label, result.outcome, result.has_error, std::chrono::steady_clock::now() - start);
+}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const TestTuple<TResult, TInputParams...>& test_data) {
+  // Step 1: Extract our variables from the TestTuple.
+  const std::string& test_label = std::get<0>(test_data);
+  const std::string qualified_test_label = suite_label + "::" + test_label;
+
+  if (!std::get<6>(test_data)) {
+    SkipTest(os, results, suite_label, test_label);
+    return;
+  }
+
+  ExecuteTestLifecycle(os, suite_label, test_label, std::get<4>(test_data), std::get<5>(test_data), [&]() {
+    // Step 3: Execute the test method.
+    TResult actual{};
+    std::optional<std::string> error = InvokeTestFunction(function_to_test, std::get<2>(test_data), actual);
+    if (error.has_value()) {
+      ReportTestError(os, results, qualified_test_label, *error);
+    }
+
+    // Step 4: Pass or fail.
+    TestOutcome outcome = ReportTestOutcome(os,
+                                            results,
+                                            qualified_test_label,
+                                            ChooseCompareFunction(std::get<3>(test_data), suite_Compare),
+                                            std::get<1>(test_data),
+                                            actual);
+    return TestBodyResult{outcome, error.has_value()};
+  });
+}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const LiteralTestTuple<TResult, TInputParams...>& test_data) {
+  ExecuteTest(os,
+              results,
+              suite_label,
+              function_to_test,
+              suite_Compare,
+              TestTuple<TResult, TInputParams...>(std::string(std::get<0>(test_data)),
+                                                  std::get<1>(test_data),
+                                                  std::get<2>(test_data),
+                                                  std::nullopt,
+                                                  std::nullopt,
+                                                  std::nullopt,
+                                                  std::get<3>(test_data)));
+}
+
+template <typename TActualRange, typename TExpectedRange, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TActualRange(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TActualRange>&,
+                 const RangeTestTuple<TExpectedRange, TInputParams...>& test_data) {
+  // Step 1: Extract our variables from the RangeTestTuple.
+  const std::string& test_label = std::get<0>(test_data);
+  const std::string qualified_test_label = suite_label + "::" + test_label;
+
+  if (!std::get<5>(test_data)) {
+    SkipTest(os, results, suite_label, test_label);
+    return;
+  }
+
+  ExecuteTestLifecycle(os, suite_label, test_label, std::get<3>(test_data), std::get<4>(test_data), [&]() {
+    // Step 3: Execute the test method and compare its output as it is produced. Lazy ranges can throw while they are
+    // being iterated so the comparison is inside the try too.
+    std::ostringstream difference;
+    bool is_equal = false;
+    std::optional<std::string> error;
+    try {
+      TActualRange actual = std::apply(function_to_test, std::get<2>(test_data));
+      TExpectedRange expected = std::get<1>(test_data);
+      is_equal = CompareRanges(difference, expected, actual);
+    } catch (...) {
+      error = DescribeCaughtException(std::current_exception());
+    }
+    if (error.has_value()) {
+      ReportTestError(os, results, qualified_test_label, *error);
+    }
+
+    // Step 4: Pass or fail.
+    if (is_equal) {
+      results.Pass();
+      os << "    ✅PASSED" << std::endl;
+      return TestBodyResult{TestOutcome::kPassed, error.has_value()};
+    }
+    std::string message = error.has_value() ? "the ranges could not be compared" : difference.str();
+    os << "    ❌FAILED: " << message << std::endl;
+    results.Fail(qualified_test_label + " " + message);
+    return TestBodyResult{TestOutcome::kFailed, error.has_value()};
+  });
+}
+
+template <typename TTests, typename TResult, typename... TInputParams>
+TestResults ExecuteSuiteTests(const std::string& suite_label,
+                              const std::function<TResult(TInputParams...)>& function_to_test,
+                              const TTests& tests,
+                              const MaybeTestCompareFunction<TResult>& suite_Compare,
+                              const MaybeTestConfigureFunction& before_all,
+                              const MaybeTestConfigureFunction& after_all,
+                              bool is_enabled) {
+  if (IsStartupProfilingEnabled()) {
+    RecordSuiteStarted(suite_label, std::size(tests));
+  }
   TestResults results;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PublishSuiteBegin(suite_label);
   if (!is_enabled) {
     std::cout << "🚧Skipping suite: " << suite_label << " because it is disabled." << std::endl;
-    for (auto test : tests) {
-      std::string test_label = std::get<0>(test);
+    for (const auto& test : tests) {
+      std::string test_label(std::get<0>(test));
       SkipTest(results, suite_label, test_label, "the suite is disabled.");
     }
+    PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
     return results;
   }
-  if (tests.size() == 0) {
+  if (std::size(tests) == 0) {
     std::cout << "🚧Skipping suite: " << suite_label << " because it is empty." << std::endl;
+    PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
     return results;
   }
   std::cout << "🚀Beginning Suite: " << suite_label << std::endl;
@@ -487,89 +1598,57 @@ TestResults ExecuteSuite(std::string suite_label,
   }
 
   // Step 2: Execute Tests
-  for_each(tests.begin(),
-           tests.end(),
-           [&suite_label, &function_to_test, &results, &suite_Compare](TestTuple<TResult, TInputParams...> test_data) {
-             // Step 2a: Extract our variables from the TestTuple.
-             const std::string& test_label = std::get<0>(test_data);
-             const std::string qualified_test_label = suite_label + "::" + test_label;
-             const TResult& expected_output = std::get<1>(test_data);
-             std::tuple<TInputParams...> input_params = std::get<2>(test_data);
-             MaybeTestCompareFunction<TResult> maybe_Compare_function = std::get<3>(test_data);
-             TestCompareFunction<TResult> Compare_function =
-                 maybe_Compare_function.has_value() ? *maybe_Compare_function
-                 : suite_Compare.has_value()        ? *suite_Compare
-                                                    : [](const TResult& l, const TResult& r) { return l == r; };
-             MaybeTestConfigureFunction before_each = std::get<4>(test_data);
-             MaybeTestConfigureFunction after_each = std::get<5>(test_data);
-             bool is_enabled = std::get<6>(test_data);
-
-             if (!is_enabled) {
-               SkipTest(results, suite_label, test_label);
-               return;
-             }
-
-             // Step 2b: Test Setup
-             std::cout << "  Beginning Test: " << test_label << std::endl;
-             if (before_each.has_value()) {
-               (*before_each)();
-             }
-
-             TResult actual;
-             try {
-               // Step 2c: Execute the test method.
-               actual = std::apply(function_to_test, input_params);
-             } catch (const std::exception& ex) {
-               std::ostringstream os;
-               os << "Caught exception \"" << ex.what() << "\".";
-               results.Error(qualified_test_label + " " + os.str());
-               std::cout << "    🔥ERROR: " << os.str() << std::endl;
-             } catch (const std::string& message) {
-               std::ostringstream os;
-               os << "Caught string \"" << message << "\".";
-               results.Error(qualified_test_label + " " + os.str());
-               std::cout << "    🔥ERROR: " << os.str() << std::endl;
-             } catch (const char* message) {
-               std::ostringstream os;
-               os << "Caught c-string \"" << message << "\".";
-               results.Error(qualified_test_label + " " + os.str());
-               std::cout << "    🔥ERROR: " << os.str() << std::endl;
-             } catch (...) {
-               std::string message =
-                   "Caught something that is neither an std::exception "
-                   "nor an std::string.";
-               results.Error(qualified_test_label + " " + message);
-               std::cout << "    🔥ERROR: " << message << std::endl;
-             }
-
-             // Step 2d: Pass or fail.
-             if (Compare_function(expected_output, actual)) {
-               results.Pass();
-               std::cout << "    ✅PASSED" << std::endl;
-             } else {
-               std::ostringstream os;
-               os << "expected: ";
-               CPPUtils::PrettyPrint(os, expected_output) << ", actual: ";
-               CPPUtils::PrettyPrint(os, actual);
-               results.Fail(qualified_test_label + " " + os.str());
-               std::cout << "    ❌FAILED: " << os.str() << std::endl;
-             }
-
-             // Step 2e: Test Teardown
-             if (after_each.has_value()) {
-               (*after_each)();
-             }
-             std::cout << "  Ending Test: " << test_label << std::endl;
-           });
+  for (const auto& test_data : tests) {
+    ExecuteTest(std::cout, results, suite_label, function_to_test, suite_Compare, test_data);
+  }
 
   // Step 3: Suite Teardown
   if (after_all.has_value()) {
     (*after_all)();
   }
   std::cout << "Ending Suite: " << suite_label << std::endl;
+  PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
   return results;
 }
 
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuite(std::string suite_label,
+                         std::function<TResult(TInputParams...)> function_to_test,
+                         std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                         MaybeTestCompareFunction<TResult> suite_Compare,
+                         MaybeTestConfigureFunction before_all,
+                         MaybeTestConfigureFunction after_all,
+                         bool is_enabled) {
+  return ExecuteSuiteTests(suite_label, function_to_test, tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+template <typename TResult, typename... TInputParams, size_t kTestCount>
+TestResults ExecuteSuite(std::string suite_label,
+                         std::function<TResult(TInputParams...)> function_to_test,
+                         const LiteralTestTuple<TResult, TInputParams...> (&tests)[kTestCount],
+                         MaybeTestCompareFunction<TResult> suite_Compare,
+                         MaybeTestConfigureFunction before_all,
+                         MaybeTestConfigureFunction after_all,
+                         bool is_enabled) {
+  return ExecuteSuiteTests(suite_label, function_to_test, tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+template <typename TActualRange, typename TExpectedRange, typename... TInputParams>
+TestResults ExecuteRangeSuite(std::string suite_label,
+                              std::function<TActualRange(TInputParams...)> function_to_test,
+                              std::initializer_list<RangeTestTuple<TExpectedRange, TInputParams...>> tests,
+                              MaybeTestConfigureFunction before_all,
+                              MaybeTestConfigureFunction after_all,
+                              bool is_enabled) {
+  return ExecuteSuiteTests(suite_label,
+                           function_to_test,
+                           tests,
+                           MaybeTestCompareFunction<TActualRange>(),
+                           before_all,
+                           after_all,
+                           is_enabled);
+}
+
 template <typename TResult, typename... TInputParams>
 TestResults ExecuteSuite(const TestSuite<TResult, TInputParams...>& test_suite) {
   std::string suite_label = std::get<0>(test_suite);
@@ -582,6 +1661,152 @@ TestResults ExecuteSuite(const TestSuite<TResult, TInputParams...>& test_suite)
   return ExecuteSuite(suite_label, function_to_test, tests, suite_Compare, before_all, after_all, is_enabled);
 }
 
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuitePipelined(std::string suite_label,
+                                  std::function<TResult(TInputParams...)> function_to_test,
+                                  std::initializer_list<TestTuple<TResult, TInputParams...>> tests,
+                                  MaybeTestCompareFunction<TResult> suite_Compare,
+                                  MaybeTestConfigureFunction before_all,
+                                  MaybeTestConfigureFunction after_all,
+                                  bool is_enabled,
+                                  std::vector<std::string> ordered_tests) {
+  if (IsStartupProfilingEnabled()) {
+    RecordSuiteStarted(suite_label, tests.size());
+  }
+  TestResults results;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PublishSuiteBegin(suite_label);
+  if (!is_enabled) {
+    std::cout << "🚧Skipping suite: " << suite_label << " because it is disabled." << std::endl;
+    for (const TestTuple<TResult, TInputParams...>& test : tests) {
+      SkipTest(results, suite_label, std::get<0>(test), "the suite is disabled.");
+    }
+    PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
+    return results;
+  }
+  if (tests.size() == 0) {
+    std::cout << "🚧Skipping suite: " << suite_label << " because it is empty." << std::endl;
+    PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
+    return results;
+  }
+  std::cout << "🚀Beginning Suite: " << suite_label << std::endl;
+
+  // Step 1: Suite Setup
+  if (before_all.has_value()) {
+    (*before_all)();
+  }
+
+  // Each test writes its output to its own buffer so it can be printed in order by the report stage.
+  struct PipelinedTest {
+    const TestTuple<TResult, TInputParams...>* test_data = nullptr;
+    bool is_ordered = false;
+    std::ostringstream output;
+    std::chrono::steady_clock::time_point start;
+    TResult actual{};
+    std::optional<std::string> error;
+  };
+  std::vector<PipelinedTest> pipelined_tests(tests.size());
+  size_t index = 0;
+  for (const TestTuple<TResult, TInputParams...>& test_data : tests) {
+    PipelinedTest& test = pipelined_tests[index++];
+    test.test_data = &test_data;
+    test.is_ordered =
+        std::find(ordered_tests.begin(), ordered_tests.end(), std::get<0>(test_data)) != ordered_tests.end();
+  }
+
+  auto setup = [&suite_label](PipelinedTest* test) {
+    const TestTuple<TResult, TInputParams...>& test_data = *test->test_data;
+    if (!std::get<6>(test_data)) {
+      return;
+    }
+    test->start = std::chrono::steady_clock::now();
+    PublishTestBegin(suite_label, std::get<0>(test_data));
+    test->output << "  Beginning Test: " << std::get<0>(test_data) << std::endl;
+    if (std::get<4>(test_data).has_value()) {
+      TestThreadScope thread_scope(suite_label, std::get<0>(test_data));
+      (*std::get<4>(test_data))();
+    }
+  };
+  auto report = [&suite_label, &suite_Compare, &results](PipelinedTest* test) {
+    const TestTuple<TResult, TInputParams...>& test_data = *test->test_data;
+    const std::string& test_label = std::get<0>(test_data);
+    if (!std::get<6>(test_data)) {
+      SkipTest(test->output, results, suite_label, test_label);
+    } else {
+      const std::string qualified_test_label = suite_label + "::" + test_label;
+      if (test->error.has_value()) {
+        ReportTestError(test->output, results, qualified_test_label, *test->error);
+      }
+      TestOutcome outcome = ReportTestOutcome(test->output,
+                                              results,
+                                              qualified_test_label,
+                                              ChooseCompareFunction(std::get<3>(test_data), suite_Compare),
+                                              std::get<1>(test_data),
+                                              test->actual);
+      if (std::get<5>(test_data).has_value()) {
+        TestThreadScope thread_scope(suite_label, test_label);
+        (*std::get<5>(test_data))();
+      }
+      test->output << "  Ending Test: " << test_label << std::endl;
+      PublishTestEnd(suite_label,
+                     test_label,
+                     outcome,
+                     test->error.has_value(),
+                     std::chrono::steady_clock::now() - test->start);
+    }
+    std::cout << test->output.str() << std::flush;
+    test->output = std::ostringstream();
+  };
+
+  // Step 2: Execute Tests
+  // The stages are declared after pipelined_tests so they are stopped before the tests they refer to are destroyed.
+  PipelineStage setup_stage;
+  PipelineStage report_stage;
+  setup_stage.Submit([&setup, test = &pipelined_tests[0]]() { setup(test); });
+  for (size_t current = 0; current < pipelined_tests.size(); current++) {
+    PipelinedTest& test = pipelined_tests[current];
+    PipelinedTest* next = current + 1 < pipelined_tests.size() ? &pipelined_tests[current + 1] : nullptr;
+    bool is_isolated = test.is_ordered || (next != nullptr && next->is_ordered);
+    setup_stage.Wait();
+    if (next != nullptr && !is_isolated) {
+      setup_stage.Submit([&setup, next]() { setup(next); });
+    }
+    if (std::get<6>(*test.test_data)) {
+      TestThreadScope thread_scope(suite_label, std::get<0>(*test.test_data));
+      test.error = InvokeTestFunction(function_to_test, std::get<2>(*test.test_data), test.actual);
+    }
+    report_stage.Submit([&report, test = &test]() { report(test); });
+    if (is_isolated) {
+      report_stage.Wait();
+      if (next != nullptr) {
+        setup_stage.Submit([&setup, next]() { setup(next); });
+      }
+    }
+  }
+  report_stage.Wait();
+
+  // Step 3: Suite Teardown
+  if (after_all.has_value()) {
+    (*after_all)();
+  }
+  std::cout << "Ending Suite: " << suite_label << std::endl;
+  PublishSuiteEnd(suite_label, std::chrono::steady_clock::now() - start);
+  return results;
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteSuitePipelined(const TestSuite<TResult, TInputParams...>& test_suite,
+                                  std::vector<std::string> ordered_tests) {
+  return ExecuteSuitePipelined(std::get<0>(test_suite),
+                               std::get<1>(test_suite),
+                               std::get<2>(test_suite),
+                               std::get<3>(test_suite),
+                               std::get<4>(test_suite),
+                               std::get<5>(test_suite),
+                               std::get<6>(test_suite),
+                               ordered_tests);
+}
+
 }  // End namespace TinyTest
 
 #endif  // End !defined(TinyTest__tinytest_h__)
@@ -8,9 +8,14 @@
 
 #include "tinytest.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -27,21 +32,50 @@ using std::string;
 using std::tuple;
 using std::vector;
 using testing::Eq;
+using testing::HasSubstr;
 using testing::Ne;
+using TinyTest::AddTestEventListener;
 using TinyTest::Coalesce;
 using TinyTest::Compare;
+using TinyTest::CompareRanges;
 using TinyTest::DefaultTestCompareFunction;
 using TinyTest::DefaultTestConfigureFunction;
+using TinyTest::EnableStartupProfiling;
+using TinyTest::ExecuteRangeSuite;
 using TinyTest::ExecuteSuite;
+using TinyTest::ExecuteSuitePipelined;
+using TinyTest::FormatDuration;
+using TinyTest::GeneratorRange;
+using TinyTest::GetStartupProfile;
 using TinyTest::InterceptCout;
+using TinyTest::IstreamRange;
+using TinyTest::LiteralTestTuple;
+using TinyTest::MakeLiteralTest;
+using TinyTest::MakeRangeTest;
 using TinyTest::MakeTest;
 using TinyTest::MakeTestSuite;
 using TinyTest::MaybeTestCompareFunction;
 using TinyTest::MaybeTestConfigureFunction;
 using TinyTest::PrintResults;
+using TinyTest::PrintStartupProfile;
+using TinyTest::PublishTestEvent;
+using TinyTest::ReadTestResults;
+using TinyTest::RemoveTestEventListener;
+using TinyTest::ResetStartupProfile;
+using TinyTest::SetMaxPrintedFailureDetails;
+using TinyTest::StartupProfile;
+using TinyTest::SuiteStartupProfile;
+using TinyTest::TestConfigurePipeline;
+using TinyTest::TestErrorKind;
+using TinyTest::TestEvent;
+using TinyTest::TestEventType;
+using TinyTest::TestMessage;
+using TinyTest::TestOutcome;
 using TinyTest::TestResults;
 using TinyTest::TestSuite;
 using TinyTest::TestTuple;
+using TinyTest::WriteJsonString;
+using TinyTest::WriteTestResults;
 
 TEST(VectorCompare, ShouldPrintSizeMismatch) {
   ostringstream os;
@@ -76,6 +110,121 @@ TEST(VectorCompare, ShouldPrintNothingWhenVectorsAreEqual) {
   EXPECT_THAT(os.str(), Eq(""));
 }
 
+// Returns the integers from 0 up to but not including count one at a time and counts how many were pulled.
+GeneratorRange<int> CountTo(int count, int* pulled) {
+  int next = 0;
+  return GeneratorRange<int>([next, count, pulled]() mutable -> std::optional<int> {
+    if (next >= count) {
+      return nullopt;
+    }
+    if (pulled != nullptr) {
+      (*pulled)++;
+    }
+    return next++;
+  });
+}
+
+TEST(CompareRanges, ShouldPrintNothingWhenRangesAreEqual) {
+  ostringstream os;
+  vector expected = vector({0, 1, 2, 3});
+  GeneratorRange<int> actual = CountTo(4, nullptr);
+  EXPECT_THAT(CompareRanges(os, expected, actual), Eq(true));
+  EXPECT_THAT(os.str(), Eq(""));
+}
+
+TEST(CompareRanges, ShouldStopAtTheFirstDifference) {
+  ostringstream os;
+  vector expected = vector({0, 1, 2, 7, 4, 5});
+  int pulled = 0;
+  GeneratorRange<int> actual = CountTo(1000000, &pulled);
+  EXPECT_THAT(CompareRanges(os, expected, actual), Eq(false));
+  EXPECT_THAT(os.str(), Eq("ranges differ at index 3, 7 != 3"));
+  EXPECT_THAT(pulled, Eq(4));
+}
+
+TEST(CompareRanges, ShouldPrintWhenActualIsShorter) {
+  ostringstream os;
+  vector expected = vector({0, 1, 2, 3});
+  GeneratorRange<int> actual = CountTo(2, nullptr);
+  EXPECT_THAT(CompareRanges(os, expected, actual), Eq(false));
+  EXPECT_THAT(os.str(), Eq("actual range ended early at index 2, expected: 2"));
+}
+
+TEST(CompareRanges, ShouldPrintWhenActualIsLonger) {
+  ostringstream os;
+  std::istringstream is("0 1");
+  IstreamRange<int> expected(is);
+  GeneratorRange<int> actual = CountTo(3, nullptr);
+  EXPECT_THAT(CompareRanges(os, expected, actual), Eq(false));
+  EXPECT_THAT(os.str(), Eq("actual range is longer than expected at index 2, actual: 2"));
+}
+
+TEST(ExecuteRangeSuite, ShouldCompareRangesAsTheyAreProduced) {
+  function<GeneratorRange<int>(int)> count_to = [](int count) { return CountTo(count, nullptr); };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteRangeSuite("CountTo",
+                                count_to,
+                                {
+                                    MakeRangeTest("Should count to five", CountTo(5, nullptr), make_tuple(5)),
+                                    MakeRangeTest("Should count to a million",
+                                                  CountTo(1000000, nullptr),
+                                                  make_tuple(1000000)),
+                                    MakeRangeTest("Should fail", CountTo(3, nullptr), make_tuple(2)),
+                                });
+  };
+  string output = InterceptCout(wrapper);
+  EXPECT_THAT(output,
+              Eq("🚀Beginning Suite: CountTo\n"
+                 "  Beginning Test: Should count to five\n"
+                 "    ✅PASSED\n"
+                 "  Ending Test: Should count to five\n"
+                 "  Beginning Test: Should count to a million\n"
+                 "    ✅PASSED\n"
+                 "  Ending Test: Should count to a million\n"
+                 "  Beginning Test: Should fail\n"
+                 "    ❌FAILED: actual range ended early at index 2, expected: 2\n"
+                 "  Ending Test: Should fail\n"
+                 "Ending Suite: CountTo\n"));
+  EXPECT_THAT(results.Passed(), Eq(2));
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.FailureMessages(),
+              Eq(vector<string>({"CountTo::Should fail actual range ended early at index 2, expected: 2"})));
+}
+
+TEST(ExecuteRangeSuite, ShouldCompareAgainstAStream) {
+  std::istringstream expected_stream("0 1 2 3 4");
+  function<GeneratorRange<int>(int)> count_to = [](int count) { return CountTo(count, nullptr); };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteRangeSuite("CountTo",
+                                count_to,
+                                {
+                                    MakeRangeTest("Should count to five",
+                                                  IstreamRange<int>(expected_stream),
+                                                  make_tuple(5)),
+                                });
+  };
+  InterceptCout(wrapper);
+  EXPECT_THAT(results.Passed(), Eq(1));
+  EXPECT_THAT(results.Total(), Eq(1));
+}
+
+TEST(ExecuteRangeSuite, ShouldReportRangesThatThrowWhileBeingCompared) {
+  function<GeneratorRange<int>()> throws = []() {
+    return GeneratorRange<int>([]() -> std::optional<int> { throw std::runtime_error("generator failed"); });
+  };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteRangeSuite("Throws", throws, {MakeRangeTest("Should throw", vector({1}), make_tuple())});
+  };
+  InterceptCout(wrapper);
+  EXPECT_THAT(results.Errors(), Eq(1));
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.ErrorMessages(),
+              Eq(vector<string>({"Throws::Should throw Caught exception \"generator failed\"."})));
+}
+
 TEST(TestResults, ShouldConstructTheDefaultInstance) {
   TestResults actual;
   EXPECT_THAT(actual.ErrorMessages().size(), Eq(0));
@@ -141,6 +290,16 @@ TEST(TestResults, ShouldReportAnErrorWithAMessage) {
   EXPECT_THAT(actual.Total(), Eq(0));
 }
 
+TEST(TestResults, ShouldCountErrorsByKind) {
+  TestResults actual;
+  actual.Error("my error message").Error(TestErrorKind::kMemoryLimit, "out of memory");
+  EXPECT_THAT(actual.Errors(), Eq(2));
+  EXPECT_THAT(actual.Errors(TestErrorKind::kException), Eq(1));
+  EXPECT_THAT(actual.Errors(TestErrorKind::kMemoryLimit), Eq(1));
+  EXPECT_THAT(actual.Errors(TestErrorKind::kCrashed), Eq(0));
+  EXPECT_THAT(actual.ErrorMessages(), Eq(vector<string>({"my error message", "out of memory"})));
+}
+
 TEST(TestResults, ShouldReportAFailureWithoutAMessage) {
   TestResults actual;
   actual.Fail();
@@ -563,6 +722,147 @@ Errors:      2 🔥
 )test"));
 }
 
+TEST(PrintResults, ShouldCountErrorsThatAreNotExceptionsByKind) {
+  TestResults results;
+  results.Error().Error(TestErrorKind::kOpenFileLimit, "too many files").Fail();
+  ostringstream os;
+  PrintResults(os, results);
+  EXPECT_THAT(os.str(), HasSubstr("Errors:      2 🔥\n  Open file limit exceeded: 1\n"));
+}
+
+TEST(WriteTestResults, ShouldRoundTripThroughReadTestResults) {
+  TestResults results(1,
+                      2,
+                      3,
+                      4,
+                      10,
+                      {"error with a\nnew line"},
+                      {"failure with a \\ backslash", "failure\r\n"},
+                      {"skipped", "", "skipped again"});
+  std::stringstream stream;
+  WriteTestResults(stream, results);
+  TestResults read_results = ReadTestResults(stream);
+  EXPECT_THAT(read_results.Errors(), Eq(1));
+  EXPECT_THAT(read_results.Failed(), Eq(2));
+  EXPECT_THAT(read_results.Passed(), Eq(3));
+  EXPECT_THAT(read_results.Skipped(), Eq(4));
+  EXPECT_THAT(read_results.Total(), Eq(10));
+  EXPECT_THAT(read_results.ErrorMessages(), Eq(results.ErrorMessages()));
+  EXPECT_THAT(read_results.FailureMessages(), Eq(results.FailureMessages()));
+  EXPECT_THAT(read_results.SkipMessages(), Eq(results.SkipMessages()));
+}
+
+TEST(WriteTestResults, ShouldRoundTripErrorKinds) {
+  TestResults results;
+  results.Error().Error(TestErrorKind::kCpuTimeLimit, "too slow").Error(TestErrorKind::kCrashed, "crashed");
+  std::stringstream stream;
+  WriteTestResults(stream, results);
+  TestResults read_results = ReadTestResults(stream);
+  EXPECT_THAT(read_results.ErrorsByKind(), Eq(results.ErrorsByKind()));
+  EXPECT_THAT(read_results.Errors(TestErrorKind::kCpuTimeLimit), Eq(1));
+}
+
+TEST(ReadTestResults, ShouldThrowForTruncatedResults) {
+  std::istringstream stream("0 1 0 0 1 0 1 0\n");
+  EXPECT_THROW(ReadTestResults(stream), std::runtime_error);
+}
+
+TEST(PrintResults, ShouldLimitTheNumberOfFailureMessagesFormatted) {
+  int format_count = 0;
+  TestResults results;
+  for (int index = 0; index < 5; index++) {
+    results.Fail(TestMessage("failure " + std::to_string(index),
+                             [&format_count](std::ostream& os) { os << " formatted " << ++format_count; }));
+  }
+  ostringstream os;
+  PrintResults(os, results, 2);
+  EXPECT_THAT(format_count, Eq(2));
+  EXPECT_THAT(os.str(), Eq(R"test(Failures:
+❌FAILED: failure 0 formatted 1
+❌FAILED: failure 1 formatted 2
+❌...and 3 more failures.
+Total tests: 5
+Passed:      0 ✅
+Failed:      5 ❌
+Skipped:     0 🚧
+Errors:      0 🔥
+)test"));
+}
+
+TEST(TestMessage, ShouldNotFormatUntilAsked) {
+  int format_count = 0;
+  TestMessage message("prefix ", [&format_count](std::ostream& os) { os << "formatted " << ++format_count; });
+  TestResults results;
+  results.Fail(message).Fail("plain");
+  TestResults combined = results + results;
+  EXPECT_THAT(format_count, Eq(0));
+  EXPECT_THAT(combined.LazyFailureMessages().size(), Eq(4));
+  EXPECT_THAT(combined.LazyFailureMessages().at(0).IsDeferred(), Eq(true));
+  EXPECT_THAT(combined.LazyFailureMessages().at(1).IsDeferred(), Eq(false));
+  EXPECT_THAT(message.Text(), Eq("prefix formatted 1"));
+  EXPECT_THAT(results.FailureMessages(), Eq(vector<string>({"prefix formatted 2", "plain"})));
+}
+
+TEST(ExecuteSuiteWithParams, ShouldKeepTheTextOfPrintedFailureMessages) {
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuite("My Suite", function<int()>([]() { return 1; }), {MakeTest("Test Name", 2, make_tuple())});
+  };
+  InterceptCout(wrapper);
+  ASSERT_THAT(results.LazyFailureMessages().size(), Eq(1));
+  EXPECT_THAT(results.LazyFailureMessages().at(0).IsDeferred(), Eq(false));
+  EXPECT_THAT(results.LazyFailureMessages().at(0).IsCompressed(), Eq(false));
+  EXPECT_THAT(results.FailureMessages().at(0), Eq("My Suite::Test Name expected: 2, actual: 1"));
+}
+
+TEST(ExecuteSuiteWithParams, ShouldCompressLargeFailureMessages) {
+  const string expected(TestMessage::kCompressionThreshold, 'a');
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuite("My Suite",
+                           function<string()>([&expected]() { return expected + "b"; }),
+                           {MakeTest("Test Name", expected, make_tuple())});
+  };
+  InterceptCout(wrapper);
+  ASSERT_THAT(results.LazyFailureMessages().size(), Eq(1));
+  EXPECT_THAT(results.LazyFailureMessages().at(0).IsCompressed(), Eq(true));
+  EXPECT_THAT(results.FailureMessages().at(0),
+              Eq("My Suite::Test Name expected: " + expected + ", actual: " + expected + "b"));
+}
+
+TEST(ExecuteSuiteWithParams, ShouldOnlyPrintTheValuesOfTheFirstFailures) {
+  SetMaxPrintedFailureDetails(1);
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuite("My Suite",
+                           function<int(int)>([](int value) { return value; }),
+                           {
+                               MakeTest("First", 2, make_tuple(1)),
+                               MakeTest("Second", 4, make_tuple(3)),
+                           });
+  };
+  string output = InterceptCout(wrapper);
+  SetMaxPrintedFailureDetails(20);
+  EXPECT_THAT(output, HasSubstr("  Beginning Test: First\n    ❌FAILED: expected: 2, actual: 1\n"));
+  EXPECT_THAT(output, HasSubstr("  Beginning Test: Second\n    ❌FAILED\n"));
+  ASSERT_THAT(results.LazyFailureMessages().size(), Eq(2));
+  EXPECT_THAT(results.LazyFailureMessages().at(1).IsDeferred(), Eq(true));
+  EXPECT_THAT(results.FailureMessages().at(1), Eq("My Suite::Second expected: 4, actual: 3"));
+}
+
+TEST(FormatDuration, ShouldUseTheLargestUnitThatKeepsTheValueAtLeastOne) {
+  EXPECT_THAT(FormatDuration(std::chrono::duration<double, std::nano>(0.5)), Eq("0.5 ns"));
+  EXPECT_THAT(FormatDuration(std::chrono::nanoseconds(999)), Eq("999.0 ns"));
+  EXPECT_THAT(FormatDuration(std::chrono::microseconds(1500)), Eq("1.5 ms"));
+  EXPECT_THAT(FormatDuration(std::chrono::seconds(2)), Eq("2.0 s"));
+}
+
+TEST(WriteJsonString, ShouldEscapeQuotesBackslashesAndControlCharacters) {
+  std::ostringstream os;
+  WriteJsonString(os, "a \"b\" \\c\n\t\x01");
+  EXPECT_THAT(os.str(), Eq("\"a \\\"b\\\" \\\\c\\n\\t\\u0001\""));
+}
+
 TEST(Coalesce, ShouldCombineTwoNulls) {
   MaybeTestConfigureFunction fn1 = nullopt;
   MaybeTestConfigureFunction fn2 = nullopt;
@@ -619,6 +919,119 @@ TEST(Coalesce, ShouldExecuteInTheCorrectOrder) {
   EXPECT_THAT(lines.at(1), Eq("Line 2"));
 }
 
+TEST(Coalesce, ShouldCombineManyFunctionsInOrder) {
+  vector<string> lines;
+  MaybeTestConfigureFunction fn1 = [&lines]() { lines.push_back("Line 1"); };
+  MaybeTestConfigureFunction fn2 = [&lines]() { lines.push_back("Line 2"); };
+  MaybeTestConfigureFunction fn3 = [&lines]() { lines.push_back("Line 3"); };
+  MaybeTestConfigureFunction actual = Coalesce({fn1, nullopt, fn2, fn3});
+  EXPECT_THAT(actual.has_value(), Eq(true));
+  actual.value()();
+  EXPECT_THAT(lines, Eq(vector<string>({"Line 1", "Line 2", "Line 3"})));
+}
+
+TEST(Coalesce, ShouldFlattenNestedPipelines) {
+  vector<string> lines;
+  MaybeTestConfigureFunction fn1 = [&lines]() { lines.push_back("Line 1"); };
+  MaybeTestConfigureFunction fn2 = [&lines]() { lines.push_back("Line 2"); };
+  MaybeTestConfigureFunction fn3 = [&lines]() { lines.push_back("Line 3"); };
+  MaybeTestConfigureFunction actual = Coalesce(Coalesce(fn1, fn2), Coalesce(nullopt, fn3));
+  ASSERT_THAT(actual.has_value(), Eq(true));
+  const TestConfigurePipeline* pipeline = actual->target<TestConfigurePipeline>();
+  ASSERT_THAT(pipeline, Ne(nullptr));
+  EXPECT_THAT(pipeline->Size(), Eq(3));
+  actual.value()();
+  EXPECT_THAT(lines, Eq(vector<string>({"Line 1", "Line 2", "Line 3"})));
+}
+
+TEST(Coalesce, ShouldOutliveItsArguments) {
+  int call_count = 0;
+  MaybeTestConfigureFunction actual;
+  {
+    MaybeTestConfigureFunction fn1 = [&call_count]() { call_count++; };
+    MaybeTestConfigureFunction fn2 = [&call_count]() { call_count += 10; };
+    actual = Coalesce(fn1, fn2);
+  }
+  actual.value()();
+  EXPECT_THAT(call_count, Eq(11));
+}
+
+TEST(TestConfigurePipeline, ShouldDoNothingWhenEmpty) {
+  TestConfigurePipeline pipeline;
+  EXPECT_THAT(pipeline.Size(), Eq(0));
+  pipeline();
+}
+
+TEST(TestConfigurePipeline, ShouldShareFunctionsBetweenCopies) {
+  int call_count = 0;
+  TestConfigurePipeline original = {[&call_count]() { call_count++; }, nullopt, [&call_count]() { call_count++; }};
+  TestConfigurePipeline copy = original;
+  EXPECT_THAT(copy.Size(), Eq(2));
+  EXPECT_THAT(&copy.Functions(), Eq(&original.Functions()));
+  copy();
+  original();
+  EXPECT_THAT(call_count, Eq(4));
+}
+
+constexpr LiteralTestTuple<int, int, int> kLiteralAddTests[] = {
+    MakeLiteralTest("Should add positive numbers", 3, make_tuple(1, 2)),
+    MakeLiteralTest("Should add negative numbers", -3, make_tuple(-1, -2)),
+    MakeLiteralTest("Should be skipped", 0, make_tuple(0, 0), false),
+};
+static_assert(std::get<1>(kLiteralAddTests[1]) == -3, "Literal test tables should be usable in constant expressions.");
+
+TEST(ExecuteSuiteWithParams, ShouldExecuteAConstexprTableOfLiteralTests) {
+  function<int(int, int)> add = [](int left, int right) { return left + right; };
+  TestResults literal_results;
+  function<void()> literal_wrapper = [&]() { literal_results = ExecuteSuite("My Suite", add, kLiteralAddTests); };
+  string literal_output = InterceptCout(literal_wrapper);
+  MaybeTestCompareFunction<int> test_Compare = nullopt;
+  MaybeTestConfigureFunction before_each = nullopt;
+  MaybeTestConfigureFunction after_each = nullopt;
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuite("My Suite",
+                           add,
+                           {
+                               MakeTest("Should add positive numbers", 3, make_tuple(1, 2)),
+                               MakeTest("Should add negative numbers", -3, make_tuple(-1, -2)),
+                               MakeTest("Should be skipped",
+                                        0,
+                                        make_tuple(0, 0),
+                                        test_Compare,
+                                        before_each,
+                                        after_each,
+                                        false),
+                           });
+  };
+  string output = InterceptCout(wrapper);
+  EXPECT_THAT(literal_output, Eq(output));
+  EXPECT_THAT(literal_results.Passed(), Eq(2));
+  EXPECT_THAT(literal_results.Skipped(), Eq(1));
+  EXPECT_THAT(literal_results.Total(), Eq(3));
+}
+
+TEST(ExecuteSuiteWithParams, ShouldSkipEveryLiteralTestInADisabledSuite) {
+  constexpr LiteralTestTuple<bool, std::string_view> tests[] = {
+      MakeLiteralTest("Should be empty", true, make_tuple(std::string_view(""))),
+      MakeLiteralTest("Should not be empty", false, make_tuple(std::string_view("text"))),
+  };
+  MaybeTestCompareFunction<bool> suite_Compare = nullopt;
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuite("My Suite",
+                           function<bool(std::string_view)>([](std::string_view text) { return text.empty(); }),
+                           tests,
+                           suite_Compare,
+                           nullopt,
+                           nullopt,
+                           false);
+  };
+  InterceptCout(wrapper);
+  EXPECT_THAT(results.Skipped(), Eq(2));
+  EXPECT_THAT(results.Total(), Eq(2));
+}
+
 TEST(ExecuteSuiteWithParams, ShouldNotExecuteADisabledSuite) {
   bool suite_Compare_called = false;
   MaybeTestCompareFunction<bool> suite_Compare = [&suite_Compare_called](bool left, bool right) {
@@ -1224,6 +1637,279 @@ TEST(ExecuteSuiteWithTuple, ShouldNotExecuteADisabledSuite) {
   EXPECT_THAT(after_each_called, Eq(false));
 }
 
+TEST(ExecuteSuitePipelined, ShouldPrintTheSameOutputAsExecuteSuite) {
+  function<int(int)> test_function = [](int value) { return value * 2; };
+  MaybeTestConfigureFunction before_each = []() {};
+  MaybeTestConfigureFunction after_each = []() {};
+  MaybeTestCompareFunction<int> test_Compare = nullopt;
+  function<void()> sequential = [&]() {
+    ExecuteSuite("My Suite",
+                 test_function,
+                 {
+                     MakeTest("Passes", 4, make_tuple(2), test_Compare, before_each, after_each, true),
+                     MakeTest("Fails", 5, make_tuple(2), test_Compare, before_each, after_each, true),
+                     MakeTest("Skips", 4, make_tuple(2), test_Compare, before_each, after_each, false),
+                     MakeTest("Passes Again", 6, make_tuple(3), test_Compare, before_each, after_each, true),
+                 });
+  };
+  function<void()> pipelined = [&]() {
+    ExecuteSuitePipelined("My Suite",
+                          test_function,
+                          {
+                              MakeTest("Passes", 4, make_tuple(2), test_Compare, before_each, after_each, true),
+                              MakeTest("Fails", 5, make_tuple(2), test_Compare, before_each, after_each, true),
+                              MakeTest("Skips", 4, make_tuple(2), test_Compare, before_each, after_each, false),
+                              MakeTest("Passes Again", 6, make_tuple(3), test_Compare, before_each, after_each, true),
+                          });
+  };
+
+  string expected = InterceptCout(sequential);
+  string actual = InterceptCout(pipelined);
+  EXPECT_THAT(actual, Eq(expected));
+  EXPECT_THAT(actual, Eq(R"test(🚀Beginning Suite: My Suite
+  Beginning Test: Passes
+    ✅PASSED
+  Ending Test: Passes
+  Beginning Test: Fails
+    ❌FAILED: expected: 5, actual: 4
+  Ending Test: Fails
+  🚧Skipping Test: Skips
+  Beginning Test: Passes Again
+    ✅PASSED
+  Ending Test: Passes Again
+Ending Suite: My Suite
+)test"));
+}
+
+TEST(ExecuteSuitePipelined, ShouldSetUpTheNextTestWhileTheCurrentTestRuns) {
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool second_is_set_up = false;
+  bool first_saw_second_set_up = false;
+  function<bool(bool)> test_function = [&](bool is_first) {
+    if (is_first) {
+      std::unique_lock<std::mutex> lock(mutex);
+      first_saw_second_set_up =
+          changed.wait_for(lock, std::chrono::seconds(5), [&second_is_set_up]() { return second_is_set_up; });
+    }
+    return true;
+  };
+  MaybeTestCompareFunction<bool> test_Compare = nullopt;
+  MaybeTestConfigureFunction before_second = [&]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    second_is_set_up = true;
+    changed.notify_all();
+  };
+
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteSuitePipelined("My Suite",
+                                    test_function,
+                                    {
+                                        MakeTest("First", true, make_tuple(true)),
+                                        MakeTest("Second", true, make_tuple(false), test_Compare, before_second),
+                                    });
+  };
+  InterceptCout(wrapper);
+  EXPECT_THAT(first_saw_second_set_up, Eq(true));
+  EXPECT_THAT(results.Passed(), Eq(2));
+  EXPECT_THAT(results.Total(), Eq(2));
+}
+
+TEST(ExecuteSuitePipelined, ShouldNotOverlapOrderedTests) {
+  std::mutex mutex;
+  vector<string> events;
+  auto record = [&mutex, &events](const string& event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(event);
+  };
+  function<bool(string)> test_function = [&record](string label) {
+    record("run " + label);
+    return true;
+  };
+  MaybeTestCompareFunction<bool> test_Compare = nullopt;
+  auto make_ordered_test = [&record, &test_Compare](const string& label) {
+    return MakeTest(label,
+                    true,
+                    make_tuple(label),
+                    test_Compare,
+                    MaybeTestConfigureFunction([&record, label]() { record("before " + label); }),
+                    MaybeTestConfigureFunction([&record, label]() { record("after " + label); }));
+  };
+
+  function<void()> wrapper = [&]() {
+    ExecuteSuitePipelined("My Suite",
+                          test_function,
+                          {make_ordered_test("A"), make_ordered_test("B")},
+                          test_Compare,
+                          nullopt,
+                          nullopt,
+                          true,
+                          {"B"});
+  };
+  InterceptCout(wrapper);
+  EXPECT_THAT(events, Eq(vector<string>({"before A", "run A", "after A", "before B", "run B", "after B"})));
+}
+
+TEST(TestEvents, ShouldPublishEventsForEachSuiteAndTest) {
+  vector<string> events;
+  uint64_t listener_id = AddTestEventListener([&events](const TestEvent& event) {
+    string description = string(event.suite_label) + "/" + string(event.test_label);
+    switch (event.type) {
+      case TestEventType::kSuiteBegin:
+        events.push_back("suite begin " + description);
+        break;
+      case TestEventType::kSuiteEnd:
+        events.push_back("suite end " + description);
+        break;
+      case TestEventType::kTestBegin:
+        events.push_back("test begin " + description);
+        break;
+      case TestEventType::kTestEnd:
+        events.push_back("test end " + description + (event.outcome == TestOutcome::kPassed    ? " passed"
+                                                      : event.outcome == TestOutcome::kFailed ? " failed"
+                                                                                              : " skipped") +
+                         (event.has_error ? " with error" : ""));
+        break;
+      case TestEventType::kTestThreadBegin:
+        events.push_back("thread begin " + description);
+        break;
+      case TestEventType::kTestThreadEnd:
+        events.push_back("thread end " + description);
+        break;
+    }
+  });
+  MaybeTestCompareFunction<int> test_Compare = nullopt;
+  MaybeTestConfigureFunction before_each = nullopt;
+  MaybeTestConfigureFunction after_each = nullopt;
+  function<void()> wrapper = [&]() {
+    ExecuteSuite("My Suite",
+                 function<int(int)>([](int value) {
+                   if (value < 0) {
+                     throw "negative";
+                   }
+                   return value;
+                 }),
+                 {
+                     MakeTest("Passes", 1, make_tuple(1)),
+                     MakeTest("Throws", 1, make_tuple(-1)),
+                     MakeTest("Skips", 1, make_tuple(1), test_Compare, before_each, after_each, false),
+                 });
+  };
+  InterceptCout(wrapper);
+  RemoveTestEventListener(listener_id);
+  InterceptCout(wrapper);
+
+  EXPECT_THAT(events,
+              Eq(vector<string>({
+                  "suite begin My Suite/",
+                  "test begin My Suite/Passes",
+                  "thread begin My Suite/Passes",
+                  "thread end My Suite/Passes",
+                  "test end My Suite/Passes passed",
+                  "test begin My Suite/Throws",
+                  "thread begin My Suite/Throws",
+                  "thread end My Suite/Throws",
+                  "test end My Suite/Throws failed with error",
+                  "test end My Suite/Skips skipped",
+                  "suite end My Suite/",
+              })));
+}
+
+TEST(TestEvents, ShouldWaitForCallsInProgressWhenRemovingAListener) {
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool is_in_listener = false;
+  bool is_released = false;
+  uint64_t listener_id = AddTestEventListener([&](const TestEvent&) {
+    std::unique_lock<std::mutex> lock(mutex);
+    is_in_listener = true;
+    changed.notify_all();
+    changed.wait(lock, [&]() { return is_released; });
+  });
+  std::thread publisher(
+      []() { PublishTestEvent({TestEventType::kSuiteBegin, "Suite", {}, TestOutcome::kPassed, false, {}}); });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() { return is_in_listener; });
+  }
+  std::atomic<bool> is_removed(false);
+  std::thread remover([&]() {
+    RemoveTestEventListener(listener_id);
+    is_removed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(is_removed);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    is_released = true;
+  }
+  changed.notify_all();
+  remover.join();
+  publisher.join();
+  EXPECT_TRUE(is_removed);
+}
+
+TEST(StartupProfile, ShouldRecordEachSuiteTable) {
+  EnableStartupProfiling(true);
+  ResetStartupProfile();
+  auto suite = MakeTestSuite("Made Suite",
+                             function<int(int)>([](int value) { return value; }),
+                             {
+                                 MakeTest("First", 1, make_tuple(1)),
+                                 MakeTest("Second", 2, make_tuple(2)),
+                             });
+  function<void()> wrapper = [&]() {
+    ExecuteSuite(suite);
+    ExecuteSuite("Inline Suite",
+                 function<int(int)>([](int value) { return value; }),
+                 {
+                     MakeTest("Only", 1, make_tuple(1)),
+                 });
+  };
+  InterceptCout(wrapper);
+  StartupProfile profile = GetStartupProfile();
+  EnableStartupProfiling(false);
+  ResetStartupProfile();
+
+  ASSERT_THAT(profile.suites.size(), Eq(2));
+  EXPECT_THAT(profile.suites[0].suite_label, Eq("Made Suite"));
+  EXPECT_THAT(profile.suites[0].test_count, Eq(2));
+  EXPECT_THAT(profile.suites[0].table_bytes >= 2 * sizeof(TestTuple<int, int>), Eq(true));
+  EXPECT_THAT(profile.suites[1].suite_label, Eq("Inline Suite"));
+  EXPECT_THAT(profile.suites[1].test_count, Eq(1));
+  EXPECT_THAT(profile.suites[1].table_bytes, Eq(sizeof(TestTuple<int, int>) + 4));
+#ifdef __linux__
+  EXPECT_THAT(profile.time_to_first_suite.has_value(), Eq(true));
+#endif
+}
+
+TEST(StartupProfile, ShouldNotRecordAnythingWhenDisabled) {
+  EnableStartupProfiling(false);
+  ResetStartupProfile();
+  MakeTestSuite("Made Suite",
+                function<int(int)>([](int value) { return value; }),
+                {
+                    MakeTest("First", 1, make_tuple(1)),
+                });
+  EXPECT_THAT(GetStartupProfile().suites.size(), Eq(0));
+}
+
+TEST(PrintStartupProfile, ShouldPrintTheSlowestTablesFirst) {
+  StartupProfile profile;
+  profile.time_to_first_suite = std::chrono::microseconds(12500);
+  profile.suites.push_back({"Fast Suite", 2, 300, std::chrono::microseconds(250)});
+  profile.suites.push_back({"Slow Suite", 40, 6000, std::chrono::microseconds(3000)});
+  ostringstream os;
+  PrintStartupProfile(os, profile);
+  EXPECT_THAT(os.str(),
+              Eq("Startup Profile:\n"
+                 "  Time to first suite: 12.500ms\n"
+                 "  Test tables: 2 suites, 42 tests, 6300 bytes, 3.250ms\n"
+                 "    3.000ms 40 tests 6000 bytes Slow Suite\n"
+                 "    0.250ms 2 tests 300 bytes Fast Suite\n"));
+}
+
 // TODO: Add tests for ExecuteSuite with tuple.
 /*
 For each ExecuteSuite variant.
@@ -0,0 +1,135 @@
+/***************************************************************************************
+ * @file trace_replay.cpp                                                              *
+ *                                                                                     *
+ * @brief Defines a suite that replays recorded input traces through a function.       *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "trace_replay.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace TinyTest {
+namespace {
+using std::string;
+using std::string_view;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+constexpr size_t kTimestampBytes = 8;
+constexpr size_t kLengthBytes = 4;
+// Payloads are read this many bytes at a time so a corrupt length cannot allocate more than the trace holds.
+constexpr uint64_t kPayloadChunkBytes = 64 * 1024;
+
+void WriteLittleEndian(std::ostream& os, uint64_t value, size_t bytes) {
+  for (size_t byte = 0; byte < bytes; byte++) {
+    os.put(static_cast<char>((value >> (8 * byte)) & 0xff));
+  }
+}
+
+// Reads a little endian integer. Returns the number of bytes read, which is less than bytes at the end of the stream.
+size_t ReadLittleEndian(std::istream& is, uint64_t& value, size_t bytes) {
+  unsigned char buffer[kTimestampBytes];
+  is.read(reinterpret_cast<char*>(buffer), bytes);
+  size_t read = is.gcount();
+  value = 0;
+  for (size_t byte = 0; byte < read; byte++) {
+    value |= static_cast<uint64_t>(buffer[byte]) << (8 * byte);
+  }
+  return read;
+}
+}  // End namespace
+
+void WriteTraceRecord(std::ostream& os, nanoseconds timestamp, string_view payload) {
+  WriteLittleEndian(os, static_cast<uint64_t>(timestamp.count()), kTimestampBytes);
+  WriteLittleEndian(os, payload.size(), kLengthBytes);
+  os.write(payload.data(), payload.size());
+}
+
+// Begin TraceReader methods
+TraceReader::TraceReader(std::istream& is) : is_(is), records_read_(0) {}
+
+bool TraceReader::Next(TraceRecord& record) {
+  uint64_t timestamp;
+  size_t read = ReadLittleEndian(is_, timestamp, kTimestampBytes);
+  if (read == 0) {
+    return false;
+  }
+  uint64_t length = 0;
+  if (read < kTimestampBytes || ReadLittleEndian(is_, length, kLengthBytes) < kLengthBytes) {
+    throw std::runtime_error("The trace ends in the middle of the header of record " + std::to_string(records_read_));
+  }
+  record.timestamp = nanoseconds(static_cast<int64_t>(timestamp));
+  record.payload.clear();
+  while (record.payload.size() < length) {
+    size_t offset = record.payload.size();
+    uint64_t chunk = std::min(length - offset, kPayloadChunkBytes);
+    record.payload.resize(offset + chunk);
+    is_.read(record.payload.data() + offset, chunk);
+    if (static_cast<uint64_t>(is_.gcount()) < chunk) {
+      throw std::runtime_error("The trace ends in the middle of the payload of record " +
+                               std::to_string(records_read_));
+    }
+  }
+  records_read_++;
+  return true;
+}
+// End TraceReader methods
+
+LoadReport ReplayTrace(std::istream& trace,
+                       const TraceReplayOptions& options,
+                       const std::function<void(string_view payload)>& replay_record) {
+  ValidateTraceReplayOptions(options);
+  LoadReport report = {0, 0, std::nullopt, nanoseconds(0), LatencyHistogram()};
+  TraceReader reader(trace);
+  TraceRecord record;
+  std::optional<nanoseconds> first_timestamp;
+  steady_clock::time_point start = steady_clock::now();
+  while (reader.Next(record)) {
+    steady_clock::time_point intended_start = steady_clock::now();
+    if (options.timing == ReplayTiming::kRecorded) {
+      if (!first_timestamp.has_value()) {
+        first_timestamp = record.timestamp;
+      }
+      // Records captured out of order start right away.
+      intended_start = std::max(start, start + std::chrono::duration_cast<nanoseconds>(
+                                                   (record.timestamp - *first_timestamp) / options.speed));
+      std::this_thread::sleep_until(intended_start);
+    }
+    try {
+      replay_record(record.payload);
+    } catch (...) {
+      report.errors++;
+      if (!report.first_error.has_value()) {
+        report.first_error = DescribeCaughtException(std::current_exception());
+      }
+    }
+    report.latency.Record(steady_clock::now() - intended_start);
+  }
+  report.elapsed = steady_clock::now() - start;
+  report.requests = report.latency.Count();
+  return report;
+}
+
+void ValidateTraceReplayOptions(const TraceReplayOptions& options) {
+  if (!(options.speed > 0)) {
+    throw std::invalid_argument("A trace replay needs a positive speed.");
+  }
+}
+
+void PrintTraceReplayReport(std::ostream& os, const LoadReport& report) {
+  double elapsed_seconds = std::chrono::duration<double>(report.elapsed).count();
+  char rate[32];
+  snprintf(rate, sizeof(rate), "%.1f/s", elapsed_seconds > 0 ? report.requests / elapsed_seconds : 0);
+  os << "    📼Replayed " << report.requests << " records in " << FormatDuration(report.elapsed) << " (" << rate
+     << ", " << report.errors << " errors): ";
+  PrintLatencyPercentiles(os, report.latency);
+}
+
+}  // End namespace TinyTest
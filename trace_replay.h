@@ -0,0 +1,251 @@
+#ifndef TinyTest__trace_replay_h__
+#define TinyTest__trace_replay_h__
+/***************************************************************************************
+ * @file trace_replay.h                                                                *
+ *                                                                                     *
+ * @brief Defines a suite that replays recorded input traces through a function.       *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "load_generator.h"
+#include "tinytest.h"
+
+namespace TinyTest {
+
+/// @defgroup trace_replay Trace Replay
+///
+/// A trace is a file of requests recorded from production. ExecuteTraceReplaySuite streams each trace through
+/// function_to_test one record at a time, so traces do not have to fit in memory. A user supplied TraceDecoder turns
+/// the payload of each record into the parameters of function_to_test.
+///
+/// Each record is the time it was captured in nanoseconds as an 8 byte little endian integer, the length of its payload
+/// as a 4 byte little endian integer, and then the payload. WriteTraceRecord writes records in this format.
+///
+/// Records are replayed in order on one thread, either as fast as possible or with the gaps they were recorded with.
+/// When the recorded gaps are kept the latency of a record is measured from when it should have started, so records
+/// delayed by a slow record before them count the delay like they would in production.
+/// @code{.cpp}
+/// TinyTest::TraceDecoder<std::string> decoder = [](std::string_view payload) {
+///   return std::make_tuple(std::string(payload));
+/// };
+/// results += ExecuteTraceReplaySuite("Parse", parse, decoder, {{"Monday", "traces/monday.trace"}});
+/// @endcode
+
+/// @addtogroup trace_replay
+/// @{
+
+/// @brief This is a type that represents a function that decodes the payload of a record into the parameters of
+/// function_to_test. It may throw if the payload is malformed.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+template <typename... TInputParams>
+using TraceDecoder = std::function<std::tuple<TInputParams...>(std::string_view payload)>;
+
+/// @brief One record of a trace.
+struct TraceRecord {
+  /// @brief When the record was captured.
+  std::chrono::nanoseconds timestamp;
+  /// @brief The recorded request.
+  std::string payload;
+};
+
+/// @brief Writes a record to a trace.
+/// @param os The stream to write to. It should be opened in binary mode.
+/// @param timestamp When the record was captured.
+/// @param payload The recorded request.
+void WriteTraceRecord(std::ostream& os, std::chrono::nanoseconds timestamp, std::string_view payload);
+
+/// @brief Reads the records of a trace one at a time.
+class TraceReader {
+ public:
+  /// @brief Creates a reader.
+  /// @param is The stream to read. It should be opened in binary mode.
+  explicit TraceReader(std::istream& is);
+
+  /// @brief Reads the next record.
+  /// @param record Where to store the record. Its payload is reused to avoid allocating for every record.
+  /// @return True if a record was read or false at the end of the trace.
+  /// @throws std::runtime_error if the trace ends in the middle of a record, including when a corrupt length runs past
+  /// the end of the trace.
+  bool Next(TraceRecord& record);
+
+ private:
+  std::istream& is_;
+  uint64_t records_read_;
+};
+
+/// @brief How records are paced.
+enum class ReplayTiming {
+  /// @brief Each record starts as soon as the one before it finishes.
+  kAsFastAsPossible,
+  /// @brief Each record starts after the gap it was recorded with divided by speed.
+  kRecorded,
+};
+
+/// @brief Options that control how traces are replayed.
+struct TraceReplayOptions {
+  /// @brief How records are paced.
+  ReplayTiming timing = ReplayTiming::kAsFastAsPossible;
+  /// @brief How much faster than recorded to replay with ReplayTiming::kRecorded. This must be positive.
+  double speed = 1;
+  /// @brief The latency SLOs of every trace.
+  std::vector<LatencySlo> slos;
+};
+
+/// @brief Replays each record of a trace.
+///
+/// A record that throws is counted as an error.
+/// @param trace The stream to read the trace from.
+/// @param options The options that control how records are paced.
+/// @param replay_record The function to call with the payload of each record.
+/// @return The number of records, their latencies, and their errors.
+/// @throws std::invalid_argument if options.speed is not positive.
+/// @throws std::runtime_error if the trace ends in the middle of a record.
+LoadReport ReplayTrace(std::istream& trace,
+                       const TraceReplayOptions& options,
+                       const std::function<void(std::string_view payload)>& replay_record);
+
+/// @brief Checks that options can be used to replay a trace.
+/// @param options The options to check.
+/// @throws std::invalid_argument if options.speed is not positive.
+void ValidateTraceReplayOptions(const TraceReplayOptions& options);
+
+/// @brief Prints the throughput and latency percentiles of a replay.
+/// @param os The stream to print to.
+/// @param report The report of the replay.
+void PrintTraceReplayReport(std::ostream& os, const LoadReport& report);
+
+/// @brief This is a type that represents a trace replayed by ExecuteTraceReplaySuite.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+template <typename... TInputParams>
+using TraceReplayTestTuple = std::tuple<
+    /// test_name - The label of the trace.
+    std::string,
+    /// trace_path - The path of the trace file.
+    std::string,
+    /// decoder - The function that decodes records.
+    const TraceDecoder<TInputParams...>*,
+    /// options - The options that control how the trace is replayed.
+    const TraceReplayOptions*>;
+
+/// @brief Replays a single trace and checks it for errors and against its SLOs.
+/// @tparam TResult The result type of the test.
+/// @tparam ...TInputParams The types of parameters sent to the test function.
+/// @param os The stream to write progress to.
+/// @param results The TestResults to update.
+/// @param suite_label The label for the test suite.
+/// @param function_to_test The function to test.
+/// @param suite_Compare The compare function for the suite. This is ignored.
+/// @param test_data The trace to replay.
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>& suite_Compare,
+                 const TraceReplayTestTuple<TInputParams...>& test_data);
+
+/// @brief Replays each trace through function_to_test.
+///
+/// Each trace is a test. It passes if every record was decoded and replayed without throwing and its latency
+/// percentiles are within options.slos. Return values are ignored.
+/// @tparam TResult The result type of the test.
+/// @tparam TInputParams... The types of parameters sent to the test function.
+/// @param suite_label The label for this test suite.
+/// @param function_to_test The function to be tested.
+/// @param decoder The function that decodes the payload of each record into the parameters of function_to_test.
+/// @param traces The label and path of each trace.
+/// @param options The options that control how traces are replayed.
+/// @param before_all This is called before any trace is replayed.
+/// @param after_all This is called after every trace has been replayed.
+/// @param is_enabled If false the traces are reported as skipped. If true they are replayed as normal.
+/// @return The results of the suite.
+/// @throws std::invalid_argument if options.speed is not positive.
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteTraceReplaySuite(std::string suite_label,
+                                    std::function<TResult(TInputParams...)> function_to_test,
+                                    TraceDecoder<TInputParams...> decoder,
+                                    std::initializer_list<std::pair<std::string, std::string>> traces,
+                                    TraceReplayOptions options = {},
+                                    MaybeTestConfigureFunction before_all = std::nullopt,
+                                    MaybeTestConfigureFunction after_all = std::nullopt,
+                                    bool is_enabled = true);
+/// @}
+
+template <typename TResult, typename... TInputParams>
+void ExecuteTest(std::ostream& os,
+                 TestResults& results,
+                 const std::string& suite_label,
+                 const std::function<TResult(TInputParams...)>& function_to_test,
+                 const MaybeTestCompareFunction<TResult>&,
+                 const TraceReplayTestTuple<TInputParams...>& test_data) {
+  // Step 1: Extract our variables from the TraceReplayTestTuple.
+  const std::string& test_label = std::get<0>(test_data);
+  const std::string qualified_test_label = suite_label + "::" + test_label;
+  const TraceDecoder<TInputParams...>& decoder = *std::get<2>(test_data);
+  const TraceReplayOptions& options = *std::get<3>(test_data);
+
+  ExecuteTestLifecycle(os, suite_label, test_label, std::nullopt, std::nullopt, [&]() {
+    std::ifstream trace(std::get<1>(test_data), std::ios::binary);
+    std::optional<std::string> trace_error;
+    if (!trace.is_open()) {
+      trace_error = "Unable to open the trace " + std::get<1>(test_data);
+    } else {
+      // Step 3: Replay the trace through the test method.
+      try {
+        LoadReport report = ReplayTrace(trace, options, [&function_to_test, &decoder](std::string_view payload) {
+          std::apply(function_to_test, decoder(payload));
+        });
+        PrintTraceReplayReport(os, report);
+
+        // Step 4: Pass or fail.
+        TestOutcome outcome = ReportLoadOutcome(os, results, qualified_test_label, report, options.slos);
+        return TestBodyResult{outcome, report.first_error.has_value()};
+      } catch (const std::runtime_error& error) {
+        trace_error = "The trace " + std::get<1>(test_data) + " is malformed: " + error.what();
+      }
+    }
+    ReportTestError(os, results, qualified_test_label, *trace_error);
+    os << "    ❌FAILED: the trace could not be replayed" << std::endl;
+    results.Fail(qualified_test_label + " the trace could not be replayed");
+    return TestBodyResult{TestOutcome::kFailed, true};
+  });
+}
+
+template <typename TResult, typename... TInputParams>
+TestResults ExecuteTraceReplaySuite(std::string suite_label,
+                                    std::function<TResult(TInputParams...)> function_to_test,
+                                    TraceDecoder<TInputParams...> decoder,
+                                    std::initializer_list<std::pair<std::string, std::string>> traces,
+                                    TraceReplayOptions options,
+                                    MaybeTestConfigureFunction before_all,
+                                    MaybeTestConfigureFunction after_all,
+                                    bool is_enabled) {
+  ValidateTraceReplayOptions(options);
+  std::vector<TraceReplayTestTuple<TInputParams...>> replay_tests;
+  replay_tests.reserve(traces.size());
+  for (const std::pair<std::string, std::string>& trace : traces) {
+    replay_tests.emplace_back(trace.first, trace.second, &decoder, &options);
+  }
+  MaybeTestCompareFunction<TResult> suite_Compare = std::nullopt;
+  return ExecuteSuiteTests(
+      suite_label, function_to_test, replay_tests, suite_Compare, before_all, after_all, is_enabled);
+}
+
+}  // End namespace TinyTest
+
+#endif  // End !defined(TinyTest__trace_replay_h__)
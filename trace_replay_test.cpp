@@ -0,0 +1,185 @@
+/***************************************************************************************
+ * @file trace_replay_test.cpp                                                         *
+ *                                                                                     *
+ * @brief Tests for a suite that replays recorded input traces through a function.     *
+ * @copyright Copyright 2023 Tom Hicks <headhunter3@gmail.com>                         *
+ * Licensed under the MIT license see the LICENSE file for details.                    *
+ ***************************************************************************************/
+
+#include "trace_replay.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "load_generator.h"
+#include "tinytest.h"
+
+namespace {
+using std::function;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::chrono::milliseconds;
+using testing::ElementsAre;
+using testing::Eq;
+using testing::Ge;
+using testing::HasSubstr;
+using testing::Lt;
+using TinyTest::ExecuteTraceReplaySuite;
+using TinyTest::LoadReport;
+using TinyTest::ReplayTiming;
+using TinyTest::ReplayTrace;
+using TinyTest::TestResults;
+using TinyTest::TraceDecoder;
+using TinyTest::TraceReader;
+using TinyTest::TraceRecord;
+using TinyTest::TraceReplayOptions;
+using TinyTest::WriteTraceRecord;
+
+// Makes a trace with a record every gap holding each payload.
+string MakeTrace(const vector<string>& payloads, milliseconds gap) {
+  std::ostringstream trace;
+  for (size_t index = 0; index < payloads.size(); index++) {
+    WriteTraceRecord(trace, gap * index, payloads[index]);
+  }
+  return trace.str();
+}
+
+TEST(TraceReader, ShouldReadBackWhatWasWritten) {
+  std::istringstream trace(MakeTrace({"first", "", string("\0\1\2", 3)}, milliseconds(7)));
+  TraceReader reader(trace);
+  TraceRecord record;
+  vector<string> payloads;
+  while (reader.Next(record)) {
+    payloads.push_back(record.payload);
+  }
+  EXPECT_THAT(payloads, ElementsAre("first", "", string("\0\1\2", 3)));
+  EXPECT_THAT(record.timestamp, Eq(milliseconds(14)));
+}
+
+TEST(TraceReader, ShouldThrowForTruncatedRecords) {
+  string trace = MakeTrace({"first", "second"}, milliseconds(1));
+  std::istringstream truncated(trace.substr(0, trace.size() - 1));
+  TraceReader reader(truncated);
+  TraceRecord record;
+  EXPECT_TRUE(reader.Next(record));
+  EXPECT_THROW(reader.Next(record), std::runtime_error);
+}
+
+TEST(TraceReader, ShouldNotTrustTheLengthOfCorruptRecords) {
+  // A timestamp of zero and a length of 4 GiB - 1 followed by only three bytes.
+  std::istringstream corrupt(string(8, '\0') + string(4, '\xff') + "abc");
+  TraceReader reader(corrupt);
+  TraceRecord record;
+  EXPECT_THROW(reader.Next(record), std::runtime_error);
+  EXPECT_THAT(record.payload.capacity(), Lt(1024 * 1024));
+}
+
+TEST(ReplayTrace, ShouldKeepTheRecordedGapsWhenAsked) {
+  string trace = MakeTrace({"a", "b", "c", "d", "e"}, milliseconds(10));
+  vector<string> replayed;
+  function<void(string_view)> replay = [&replayed](string_view payload) { replayed.emplace_back(payload); };
+  TraceReplayOptions options;
+
+  std::istringstream fast_trace(trace);
+  LoadReport fast = ReplayTrace(fast_trace, options, replay);
+  EXPECT_THAT(fast.requests, Eq(5));
+  EXPECT_THAT(fast.elapsed, Lt(milliseconds(20)));
+
+  options.timing = ReplayTiming::kRecorded;
+  options.speed = 2;
+  std::istringstream recorded_trace(trace);
+  LoadReport recorded = ReplayTrace(recorded_trace, options, replay);
+  EXPECT_THAT(recorded.requests, Eq(5));
+  EXPECT_THAT(recorded.elapsed, Ge(milliseconds(20)));
+  EXPECT_THAT(replayed, ElementsAre("a", "b", "c", "d", "e", "a", "b", "c", "d", "e"));
+}
+
+TEST(ReplayTrace, ShouldRejectSpeedsThatAreNotPositive) {
+  TraceReplayOptions options;
+  options.timing = ReplayTiming::kRecorded;
+  function<void(string_view)> replay = [](string_view) {};
+  for (double speed : {0.0, -1.0}) {
+    options.speed = speed;
+    std::istringstream trace("");
+    EXPECT_THROW(ReplayTrace(trace, options, replay), std::invalid_argument);
+  }
+}
+
+TEST(ReplayTrace, ShouldCountRecordsThatThrow) {
+  std::istringstream trace(MakeTrace({"1", "x", "3"}, milliseconds(0)));
+  LoadReport report = ReplayTrace(trace, {}, [](string_view payload) {
+    if (payload == "x") {
+      throw std::invalid_argument("not a number");
+    }
+  });
+  EXPECT_THAT(report.requests, Eq(3));
+  EXPECT_THAT(report.errors, Eq(1));
+  ASSERT_TRUE(report.first_error.has_value());
+  EXPECT_THAT(*report.first_error, HasSubstr("not a number"));
+}
+
+TEST(ReplayTrace, ShouldThrowForTruncatedTraces) {
+  string trace = MakeTrace({"1", "2"}, milliseconds(0));
+  std::istringstream truncated(trace.substr(0, trace.size() - 1));
+  function<void(string_view)> replay = [](string_view) {};
+  EXPECT_THROW(ReplayTrace(truncated, {}, replay), std::runtime_error);
+}
+
+TEST(ExecuteTraceReplaySuite, ShouldReplayEachTraceThroughTheDecoder) {
+  string good_path = testing::TempDir() + "trace_replay_test_good_" + std::to_string(getpid()) + ".trace";
+  string bad_path = testing::TempDir() + "trace_replay_test_bad_" + std::to_string(getpid()) + ".trace";
+  std::ofstream(good_path, std::ios::binary) << MakeTrace({"1", "2", "3"}, milliseconds(0));
+  std::ofstream(bad_path, std::ios::binary) << MakeTrace({"4", "five"}, milliseconds(0));
+  int total = 0;
+  function<int(int)> add = [&total](int value) { return total += value; };
+  TraceDecoder<int> decoder = [](string_view payload) { return std::make_tuple(std::stoi(string(payload))); };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteTraceReplaySuite(
+        "Add", add, decoder, {{"Good", good_path}, {"Bad", bad_path}, {"Missing", good_path + ".missing"}});
+  };
+  string output = TinyTest::InterceptCout(wrapper);
+
+  EXPECT_THAT(total, Eq(10));
+  EXPECT_THAT(results.Total(), Eq(3));
+  EXPECT_THAT(results.Passed(), Eq(1));
+  EXPECT_THAT(results.Failed(), Eq(2));
+  EXPECT_THAT(results.Errors(), Eq(2));
+  EXPECT_THAT(results.FailureMessages()[0], HasSubstr("Add::Bad 1 of 2 requests threw"));
+  EXPECT_THAT(results.FailureMessages()[1], HasSubstr("Add::Missing the trace could not be replayed"));
+  EXPECT_THAT(output, HasSubstr("    📼Replayed 3 records in "));
+  EXPECT_THAT(output, HasSubstr("(1 of 2 requests threw)"));
+  EXPECT_THAT(output, HasSubstr("Unable to open the trace "));
+}
+
+TEST(ExecuteTraceReplaySuite, ShouldFailTruncatedTraces) {
+  string path = testing::TempDir() + "trace_replay_test_truncated_" + std::to_string(getpid()) + ".trace";
+  string trace = MakeTrace({"1", "2"}, milliseconds(0));
+  std::ofstream(path, std::ios::binary) << trace.substr(0, trace.size() - 1);
+  function<int(int)> identity = [](int value) { return value; };
+  TraceDecoder<int> decoder = [](string_view payload) { return std::make_tuple(std::stoi(string(payload))); };
+  TestResults results;
+  function<void()> wrapper = [&]() {
+    results = ExecuteTraceReplaySuite("Identity", identity, decoder, {{"Truncated", path}});
+  };
+  string output = TinyTest::InterceptCout(wrapper);
+
+  EXPECT_THAT(results.Total(), Eq(1));
+  EXPECT_THAT(results.Failed(), Eq(1));
+  EXPECT_THAT(results.Errors(), Eq(1));
+  EXPECT_THAT(results.FailureMessages()[0], HasSubstr("Identity::Truncated the trace could not be replayed"));
+  EXPECT_THAT(output, HasSubstr(" is malformed: The trace ends in the middle of the payload of record 1"));
+}
+}  // End namespace